@@ -207,12 +207,12 @@ EndianU64_BtoL                  (UInt64                 value);
 #if TARGET_RT_LITTLE_ENDIAN
 
 struct BigEndianLong {
-    long                            bigEndianValue;
+    SInt32                          bigEndianValue;
 };
 typedef struct BigEndianLong            BigEndianLong;
 
 struct BigEndianUnsignedLong {
-    unsigned long                   bigEndianValue;
+    UInt32                          bigEndianValue;
 };
 typedef struct BigEndianUnsignedLong    BigEndianUnsignedLong;
 
@@ -242,8 +242,8 @@ struct BigEndianOSType {
 typedef struct BigEndianOSType          BigEndianOSType;
 #else
 
-typedef long                            BigEndianLong;
-typedef unsigned long                   BigEndianUnsignedLong;
+typedef SInt32                          BigEndianLong;
+typedef UInt32                          BigEndianUnsignedLong;
 typedef short                           BigEndianShort;
 typedef unsigned short                  BigEndianUnsignedShort;
 typedef Fixed                           BigEndianFixed;
@@ -24,6 +24,59 @@ limitations under the License.
 
 //==========================================================================================
 
+// read the header of the atom starting at offset into entry; an atom with size 0 runs to maxOffset,
+//   in which case *runsToEndOut is set and it must be the last one at this level
+int GetAtomOffsetEntry( atomOffsetEntry *aoe, UInt64 offset, UInt64 maxOffset, 
+			atomOffsetEntry *entry, Boolean *runsToEndOut )
+{
+	int err = noErr;
+	startAtomType startAtom;
+	UInt64 largeSize;
+	uuidType uuid;
+	UInt64 curOffset = offset;
+	long minAtomSize;
+	
+	*runsToEndOut = false;
+	memset(entry, 0, sizeof(atomOffsetEntry));	// clear out entry
+	entry->offset = curOffset;
+	BAILIFERR( GetFileDataN32( aoe, &startAtom.size, curOffset, &curOffset ) );
+	BAILIFERR( GetFileDataN32( aoe, &startAtom.type, curOffset, &curOffset ) );
+	minAtomSize = sizeof(startAtom);
+	entry->size = startAtom.size;
+	entry->type = startAtom.type;
+	if (startAtom.size == 1) {
+		BAILIFERR( GetFileDataN64( aoe, &largeSize, curOffset, &curOffset ) );
+		entry->size = largeSize;
+		minAtomSize += sizeof(largeSize);
+		
+	}
+	if (startAtom.type == 'uuid') {
+		BAILIFERR( GetFileData( aoe, &uuid, curOffset, sizeof(uuid), &curOffset ) );
+		//entry->uuid = uuid;
+		memcpy(&entry->uuid, &uuid, sizeof(uuid));
+		minAtomSize += sizeof(uuid);
+	}
+	
+	entry->atomStartSize = minAtomSize;
+	entry->maxOffset = entry->offset + entry->size;
+	
+	if (entry->size == 0) {
+		// we go to the end
+		entry->size = maxOffset - entry->offset;
+		*runsToEndOut = true;
+		goto bail;
+	}
+	
+	BAILIF( (entry->size < (UInt64)minAtomSize), badAtomSize );
+	// a largesize from the file can be anything; one that wraps the offset around would walk backwards
+	BAILIF( (entry->size > ~(UInt64)0 - entry->offset), badAtomSize );
+
+bail:
+	if (!err && vg.headerOnly && (entry->type == 'mdat'))
+		err = AddPayloadRange( entry->offset + entry->atomStartSize, entry->offset + entry->size );
+	return err;
+}
+
 int FindAtomOffsets( atomOffsetEntry *aoe, UInt64 minOffset, UInt64 maxOffset, 
 			long *atomCountOut, atomOffsetEntry **atomOffsetsOut )
 {
@@ -31,59 +84,29 @@ int FindAtomOffsets( atomOffsetEntry *aoe, UInt64 minOffset, UInt64 maxOffset,
 	long cnt = 0;
 	atomOffsetEntry *atomOffsets = nil;
 	long max = 20;
-	startAtomType startAtom;
-	UInt64 largeSize;
-	uuidType uuid;
 	UInt64 curOffset = minOffset;
-	long minAtomSize;
+	Boolean runsToEnd;
 	
-	BAILIFNULL( atomOffsets = (atomOffsetEntry *)calloc( max, sizeof(atomOffsetEntry)), allocFailedErr );
+	// the list goes with the rest of the parsed state; growing it usually extends it in place
+	BAILIFNULL( atomOffsets = (atomOffsetEntry *)ArenaCalloc( &vg.arena, max, sizeof(atomOffsetEntry)), allocFailedErr );
 	
 	while (curOffset< maxOffset) {
-		memset(&atomOffsets[cnt], 0, sizeof(atomOffsetEntry));	// clear out entry
-		atomOffsets[cnt].offset = curOffset;
-		BAILIFERR( GetFileDataN32( aoe, &startAtom.size, curOffset, &curOffset ) );
-		BAILIFERR( GetFileDataN32( aoe, &startAtom.type, curOffset, &curOffset ) );
-		minAtomSize = sizeof(startAtom);
-		atomOffsets[cnt].size = startAtom.size;
-		atomOffsets[cnt].type = startAtom.type;
-		if (startAtom.size == 1) {
-			BAILIFERR( GetFileDataN64( aoe, &largeSize, curOffset, &curOffset ) );
-			atomOffsets[cnt].size = largeSize;
-			minAtomSize += sizeof(largeSize);
-			
-		}
-		if (startAtom.type == 'uuid') {
-			BAILIFERR( GetFileData( aoe, &uuid, curOffset, sizeof(uuid), &curOffset ) );
-			//atomOffsets[cnt].uuid = uuid;
-			memcpy(&atomOffsets[cnt].uuid, &uuid, sizeof(uuid));
-			minAtomSize += sizeof(uuid);
-		}
-		
-		atomOffsets[cnt].atomStartSize = minAtomSize;
-		atomOffsets[cnt].maxOffset = atomOffsets[cnt].offset + atomOffsets[cnt].size;
-		
-		if (atomOffsets[cnt].size == 0) {
-			// we go to the end
-			atomOffsets[cnt].size = maxOffset - atomOffsets[cnt].offset;
+		BAILIFERR( GetAtomOffsetEntry( aoe, curOffset, maxOffset, &atomOffsets[cnt], &runsToEnd ) );
+		if (runsToEnd)
 			break;
-		}
-		
-		BAILIF( (atomOffsets[cnt].size < (UInt64)minAtomSize), badAtomSize );
 		
 		curOffset = atomOffsets[cnt].offset + atomOffsets[cnt].size;
 		cnt++;
 		if (cnt >= max) {
-			max += 20;
-			atomOffsets = (atomOffsetEntry *)realloc(atomOffsets, max * sizeof(atomOffsetEntry));
+			BAILIFNULL( atomOffsets = (atomOffsetEntry *)ArenaGrow( &vg.arena, atomOffsets, max * sizeof(atomOffsetEntry), 2 * max * sizeof(atomOffsetEntry)), allocFailedErr );
+			memset( &atomOffsets[max], 0, max * sizeof(atomOffsetEntry) );
+			max *= 2;
 		}
 	}
 
 bail:
 	if (err) {
 		cnt = 0;
-		if (atomOffsets) 
-			free(atomOffsets);
 		atomOffsets = nil;
 	}
 	*atomCountOut = cnt;
@@ -91,6 +114,519 @@ bail:
 	return err;
 }
 
+//==========================================================================================
+
+// Allocations are 16 byte aligned, enough for any of the records and columns
+#define kArenaAlign				16
+#define ArenaRound(n)			(((n) + (kArenaAlign - 1)) & ~(UInt64)(kArenaAlign - 1))
+#define ArenaBlockData(block)	((char *)(block) + ArenaRound(sizeof(ArenaBlock)))
+
+void *ArenaAlloc( Arena *arena, UInt64 size )
+{
+	ArenaBlock *block = arena->current;
+	ArenaBlock *newBlock;
+	char *p;
+	
+	size = size ? ArenaRound(size) : kArenaAlign;
+	if ((block == nil) || (block->size - block->used < size)) {
+		UInt64 blockSize = (size > kArenaBlockSize/4) ? size : kArenaBlockSize;
+		
+		newBlock = (ArenaBlock *)malloc( ArenaRound(sizeof(ArenaBlock)) + blockSize );
+		if (newBlock == nil)
+			return nil;
+		newBlock->size = blockSize;
+		newBlock->used = 0;
+		arena->blockCount++;
+		arena->reserved += blockSize;
+		if (arena->reserved > arena->highWater)
+			arena->highWater = arena->reserved;
+		
+		if (block && (blockSize != kArenaBlockSize)) {
+			// an outsized request; keep filling the current block
+			newBlock->next = block->next;
+			block->next = newBlock;
+			block = newBlock;
+		} else {
+			newBlock->next = block;
+			arena->current = block = newBlock;
+		}
+	}
+	
+	p = ArenaBlockData(block) + block->used;
+	block->used += size;
+	arena->allocated += size;
+	arena->allocCount++;
+	return p;
+}
+
+void *ArenaCalloc( Arena *arena, UInt64 count, UInt64 size )
+{
+	void *p;
+	
+	if (size && (count > ~(UInt64)0 / size))
+		return nil;
+	p = ArenaAlloc( arena, count * size );
+	if (p)
+		memset( p, 0, count * size );
+	return p;
+}
+
+// realloc() for arena memory: the most recent allocation grows in place if its block has room, and
+//   an allocation with a block to itself grows with its block; anything else is copied, and the old
+//   copy stays behind until the arena is released
+void *ArenaGrow( Arena *arena, void *p, UInt64 oldSize, UInt64 newSize )
+{
+	ArenaBlock *block = arena->current;
+	ArenaBlock *prev = nil;
+	void *grown;
+	
+	if (p == nil)
+		return ArenaAlloc( arena, newSize );
+	
+	if (block && ((char *)p + ArenaRound(oldSize) == ArenaBlockData(block) + block->used)
+			  && (ArenaRound(newSize) >= ArenaRound(oldSize))
+			  && (ArenaRound(newSize) - ArenaRound(oldSize) <= block->size - block->used)) {
+		block->used += ArenaRound(newSize) - ArenaRound(oldSize);
+		arena->allocated += ArenaRound(newSize) - ArenaRound(oldSize);
+		return p;
+	}
+	
+	if (block && (ArenaBlockData(block) != p)) {
+		prev = block;
+		block = block->next;
+	}
+	if (block && (ArenaBlockData(block) == p) && (block->used == ArenaRound(oldSize))
+			  && (ArenaRound(newSize) > kArenaBlockSize/4)) {
+		UInt64 oldBlockSize = block->size;
+		
+		block = (ArenaBlock *)realloc( block, ArenaRound(sizeof(ArenaBlock)) + ArenaRound(newSize) );
+		if (block == nil)
+			return nil;
+		block->size = block->used = ArenaRound(newSize);
+		if (prev)
+			prev->next = block;
+		else
+			arena->current = block;
+		arena->allocated += ArenaRound(newSize) - ArenaRound(oldSize);
+		arena->reserved += block->size - oldBlockSize;
+		if (arena->reserved > arena->highWater)
+			arena->highWater = arena->reserved;
+		return ArenaBlockData(block);
+	}
+	
+	grown = ArenaAlloc( arena, newSize );
+	if (grown)
+		memcpy( grown, p, (oldSize < newSize) ? oldSize : newSize );
+	return grown;
+}
+
+void ArenaRelease( Arena *arena )
+{
+	ArenaBlock *block = arena->current;
+	
+	while (block) {
+		ArenaBlock *next = block->next;
+		
+		free( block );
+		block = next;
+	}
+	arena->current = nil;
+	arena->allocated = 0;
+	arena->allocCount = 0;
+	arena->blockCount = 0;
+	arena->reserved = 0;
+}
+
+void ArenaPrintStats( Arena *arena, const char *name )
+{
+	reportprint("<!-- %s: %llu bytes in %u allocations, %u blocks holding %llu bytes, high water %llu bytes -->\n",
+				name, arena->allocated, arena->allocCount, arena->blockCount, arena->reserved, arena->highWater );
+}
+
+//==========================================================================================
+
+// Open addressing with linear probing; the table is kept at most half full.
+//   A key that is already present keeps its first value, so lookups find the same record
+//   a front-to-back scan of the array would.
+
+static UInt32 KeyIndexSlot( KeyIndex *ki, UInt64 key )
+{
+	return (UInt32)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (ki->capacity - 1);
+}
+
+OSErr KeyIndexInsert( KeyIndex *ki, UInt64 key, UInt32 value )
+{
+	OSErr err = noErr;
+	UInt32 slot;
+	
+	if ((ki->count + 1) * 2 > ki->capacity) {
+		KeyIndex grown;
+		UInt32 i;
+		
+		grown.capacity = ki->capacity ? ki->capacity * 2 : 16;
+		grown.count = 0;
+		BAILIFNIL( grown.keys = (UInt64 *)ArenaAlloc( &vg.arena, grown.capacity * sizeof(UInt64) ), allocFailedErr );
+		BAILIFNIL( grown.values = (UInt32 *)ArenaCalloc( &vg.arena, grown.capacity, sizeof(UInt32) ), allocFailedErr );
+		for (i = 0; i < ki->capacity; i++) {
+			if (ki->values[i]) {
+				slot = KeyIndexSlot( &grown, ki->keys[i] );
+				while (grown.values[slot])
+					slot = (slot + 1) & (grown.capacity - 1);
+				grown.keys[slot] = ki->keys[i];
+				grown.values[slot] = ki->values[i];
+				grown.count++;
+			}
+		}
+		*ki = grown;		// the old tables stay in the arena
+	}
+	
+	slot = KeyIndexSlot( ki, key );
+	while (ki->values[slot]) {
+		if (ki->keys[slot] == key)
+			goto bail;
+		slot = (slot + 1) & (ki->capacity - 1);
+	}
+	ki->keys[slot] = key;
+	ki->values[slot] = value + 1;
+	ki->count++;
+	
+bail:
+	return err;
+}
+
+// returns notFound if the key is not in the index
+UInt32 KeyIndexFind( KeyIndex *ki, UInt64 key, UInt32 notFound )
+{
+	UInt32 slot;
+	
+	if (ki->count == 0)
+		return notFound;
+	
+	slot = KeyIndexSlot( ki, key );
+	while (ki->values[slot]) {
+		if (ki->keys[slot] == key)
+			return ki->values[slot] - 1;
+		slot = (slot + 1) & (ki->capacity - 1);
+	}
+	return notFound;
+}
+
+//==========================================================================================
+
+// Finds the type index of the list, making it the first time round and bringing it up to cnt
+//   atoms as the list grows (only ever at the end). Lists live in vg.arena, which is never freed
+//   from under them, so their address names them until dispose_mir. Returns nil for a list that
+//   is short enough to scan.
+AtomTypeIndex *AtomTypeIndexFor( atomOffsetEntry *list, long cnt )
+{
+	OSErr err = noErr;
+	AtomTypeIndex *index = nil;
+	UInt32 pos;
+	long i;
+	
+	if (cnt < kAtomTypeIndexMinCount)
+		return nil;
+	
+	pos = KeyIndexFind( &vg.atomTypeIndexByList, (UInt64)(uintptr_t)list, vg.numAtomTypeIndexes );
+	if (pos < vg.numAtomTypeIndexes)
+		index = vg.atomTypeIndexes[pos];
+	else {
+		if (vg.numAtomTypeIndexes == vg.atomTypeIndexCapacity) {
+			UInt32 capacity = vg.atomTypeIndexCapacity ? vg.atomTypeIndexCapacity * 2 : 16;
+			
+			BAILIFNIL( vg.atomTypeIndexes = (AtomTypeIndex **)ArenaGrow( &vg.arena, vg.atomTypeIndexes, 
+				vg.atomTypeIndexCapacity * sizeof(AtomTypeIndex *), capacity * sizeof(AtomTypeIndex *) ), allocFailedErr );
+			vg.atomTypeIndexCapacity = capacity;
+		}
+		BAILIFNIL( index = (AtomTypeIndex *)ArenaCalloc( &vg.arena, 1, sizeof(AtomTypeIndex) ), allocFailedErr );
+		index->list = list;
+		BAILIFERR( KeyIndexInsert( &vg.atomTypeIndexByList, (UInt64)(uintptr_t)list, vg.numAtomTypeIndexes ) );
+		vg.atomTypeIndexes[vg.numAtomTypeIndexes++] = index;
+	}
+	
+	if (index->broken)
+		return nil;
+	
+	if (cnt > index->capacity) {
+		long capacity = (cnt > 2 * index->capacity) ? cnt : 2 * index->capacity;
+		
+		BAILIFNIL( index->next = (long *)ArenaGrow( &vg.arena, index->next, index->capacity * sizeof(long), capacity * sizeof(long) ), allocFailedErr );
+		index->capacity = capacity;
+	}
+	
+	for (i = index->cnt; i < cnt; i++) {
+		AtomTypeBucket *bucket;
+		UInt32 b = KeyIndexFind( &index->types, list[i].type, index->numBuckets );
+		
+		if (b == index->numBuckets) {
+			if (index->numBuckets == index->bucketCapacity) {
+				UInt32 capacity = index->bucketCapacity ? index->bucketCapacity * 2 : 8;
+				
+				BAILIFNIL( index->buckets = (AtomTypeBucket *)ArenaGrow( &vg.arena, index->buckets, 
+					index->bucketCapacity * sizeof(AtomTypeBucket), capacity * sizeof(AtomTypeBucket) ), allocFailedErr );
+				index->bucketCapacity = capacity;
+			}
+			BAILIFERR( KeyIndexInsert( &index->types, list[i].type, b ) );
+			index->buckets[b].last = -1;
+			index->buckets[b].pending = -1;
+			index->buckets[b].settled = 0;
+			index->numBuckets++;
+		}
+		
+		bucket = &index->buckets[b];
+		index->next[i] = -1;
+		if (bucket->last >= 0)
+			index->next[bucket->last] = i;
+		if (bucket->pending < 0)
+			bucket->pending = i;
+		bucket->last = i;
+		index->cnt = i + 1;
+	}
+
+bail:
+	if (err) {
+		if (index)
+			index->broken = true;
+		return nil;
+	}
+	return index;
+}
+
+//==========================================================================================
+
+// A tick count times a timescale takes up to 96 bits; such products are kept as magnitudes
+//   split into two 64-bit halves
+static void MediaTimeMultiply( UInt64 a, UInt64 b, UInt64 *hi, UInt64 *lo )
+{
+	UInt64 ll = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+	UInt64 lh = (a & 0xFFFFFFFF) * (b >> 32);
+	UInt64 hl = (a >> 32) * (b & 0xFFFFFFFF);
+	UInt64 mid = (ll >> 32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+	
+	*lo = (mid << 32) | (ll & 0xFFFFFFFF);
+	*hi = (a >> 32) * (b >> 32) + (lh >> 32) + (hl >> 32) + (mid >> 32);
+}
+
+static int MediaTimeCompareWide( UInt64 aHi, UInt64 aLo, UInt64 bHi, UInt64 bLo )
+{
+	if (aHi != bHi)
+		return aHi < bHi ? -1 : 1;
+	if (aLo != bLo)
+		return aLo < bLo ? -1 : 1;
+	return 0;
+}
+
+static UInt64 MediaTimeMagnitude( SInt64 value )
+{
+	return value < 0 ? (UInt64)0 - (UInt64)value : (UInt64)value;
+}
+
+MediaTime MediaTimeMake( SInt64 value, UInt32 timescale )
+{
+	MediaTime t;
+	
+	t.value = value;
+	t.timescale = timescale;
+	return t;
+}
+
+// -1, 0 or 1 as a is before, at or after b; exact whatever the two timescales
+int MediaTimeCompare( MediaTime a, MediaTime b )
+{
+	UInt64 aHi, aLo, bHi, bLo;
+	int sign;
+	
+	if (a.timescale == b.timescale)
+		return a.value < b.value ? -1 : (a.value > b.value ? 1 : 0);
+	
+	if ((a.value < 0) != (b.value < 0))
+		return a.value < 0 ? -1 : 1;
+	sign = a.value < 0 ? -1 : 1;
+	
+	MediaTimeMultiply( MediaTimeMagnitude(a.value), b.timescale, &aHi, &aLo );
+	MediaTimeMultiply( MediaTimeMagnitude(b.value), a.timescale, &bHi, &bLo );
+	return sign * MediaTimeCompareWide( aHi, aLo, bHi, bLo );
+}
+
+// Whether a and b are more than one tick of timescale apart, the tolerance of the duration checks
+Boolean MediaTimeApart( MediaTime a, MediaTime b, UInt32 timescale )
+{
+	UInt64 aHi, aLo, bHi, bLo, dHi, dLo, t;
+	
+	if (timescale == 0)
+		return false;
+	
+	// |a.value * b.timescale - b.value * a.timescale| against a.timescale * b.timescale / timescale
+	MediaTimeMultiply( MediaTimeMagnitude(a.value), b.timescale, &aHi, &aLo );
+	MediaTimeMultiply( MediaTimeMagnitude(b.value), a.timescale, &bHi, &bLo );
+	if ((a.value < 0) != (b.value < 0)) {
+		dLo = aLo + bLo;
+		dHi = aHi + bHi + (dLo < aLo);
+	} else {
+		if (MediaTimeCompareWide( aHi, aLo, bHi, bLo ) < 0) {
+			t = aHi; aHi = bHi; bHi = t;
+			t = aLo; aLo = bLo; bLo = t;
+		}
+		dLo = aLo - bLo;
+		dHi = aHi - bHi - (aLo < bLo);
+	}
+	return (dHi != 0) || (dLo > (UInt64)a.timescale * b.timescale / timescale);
+}
+
+// value ticks of fromTimescale in ticks of toTimescale, truncated toward zero;
+//   false (and the result clamped) if that does not fit in 64 bits
+Boolean MediaTimeRescale( SInt64 value, UInt32 fromTimescale, UInt32 toTimescale, SInt64 *result )
+{
+	UInt64 hi, lo, part, q;
+	
+	if (fromTimescale == toTimescale) {
+		*result = value;
+		return true;
+	}
+	if (fromTimescale == 0) {
+		*result = 0;
+		return false;
+	}
+	
+	// hi is below 2^32, so the 96-bit product is divided 32 bits at a time
+	MediaTimeMultiply( MediaTimeMagnitude(value), toTimescale, &hi, &lo );
+	if (hi >= fromTimescale) {
+		*result = value < 0 ? kMediaTimeMin : kMediaTimeMax;
+		return false;
+	}
+	part = (hi << 32) | (lo >> 32);
+	q = part / fromTimescale;
+	part = ((part % fromTimescale) << 32) | (lo & 0xFFFFFFFF);
+	q = (q << 32) | (part / fromTimescale);
+	
+	if (q > (UInt64)kMediaTimeMax) {
+		*result = value < 0 ? kMediaTimeMin : kMediaTimeMax;
+		return false;
+	}
+	*result = value < 0 ? (SInt64)((UInt64)0 - q) : (SInt64)q;
+	return true;
+}
+
+// *sum += ticks, or false with *sum held at the end of the timeline it would pass
+Boolean MediaTimeAdd( SInt64 *sum, SInt64 ticks )
+{
+	if ((ticks > 0) && (*sum > kMediaTimeMax - ticks)) {
+		*sum = kMediaTimeMax;
+		return false;
+	}
+	if ((ticks < 0) && (*sum < kMediaTimeMin - ticks)) {
+		*sum = kMediaTimeMin;
+		return false;
+	}
+	*sum += ticks;
+	return true;
+}
+
+long double MediaTimeSeconds( MediaTime t )
+{
+	return (long double)t.value / (long double)t.timescale;
+}
+
+//==========================================================================================
+
+// A trun takes its samples from the end of the last block, or from a new block if they do not fit.
+//   The columns start out as Validate_trun_Atom expects them: not yet timed, to be presented, no SAP 3/4.
+OSErr FragmentSamplesAllocate( FragmentSampleStore *store, TrunInfoRec *trunInfo )
+{
+	OSErr err = noErr;
+	FragmentSampleBlock *block = store->last;
+	UInt32 n = trunInfo->sample_count;
+	UInt32 first, i;
+	
+	trunInfo->firstSample = store->count;
+	trunInfo->sample_duration = trunInfo->sample_size = trunInfo->sample_flags = trunInfo->sample_composition_time_offset = NULL;
+	trunInfo->sampleDecodeTime = NULL;
+	trunInfo->samplePresentationTime = NULL;
+	trunInfo->sampleToBePresented = trunInfo->sap3 = trunInfo->sap4 = NULL;
+	if (n == 0)
+		goto bail;
+	
+	if ((block == NULL) || (block->capacity - block->count < n)) {
+		UInt32 capacity = block ? block->capacity * 2 : kFragmentSampleBlockMin;
+		size_t header = (sizeof(FragmentSampleBlock) + 15) & ~15;
+		char *p;
+		
+		if (capacity > kFragmentSampleBlockMax)
+			capacity = kFragmentSampleBlockMax;
+		if (capacity < n)
+			capacity = n;
+		
+		BAILIFNIL( block = (FragmentSampleBlock *)ArenaAlloc( &vg.arena, header + 
+			(size_t)capacity * (sizeof(SInt64) + sizeof(UInt64) + 4*sizeof(UInt32) + 3*sizeof(Boolean)) ), allocFailedErr );
+		
+		// widest columns first so each stays aligned
+		p = (char *)block + header;
+		block->presentationTime = (SInt64 *)p;			p += capacity * sizeof(SInt64);
+		block->decodeTime = (UInt64 *)p;				p += capacity * sizeof(UInt64);
+		block->duration = (UInt32 *)p;					p += capacity * sizeof(UInt32);
+		block->size = (UInt32 *)p;						p += capacity * sizeof(UInt32);
+		block->flags = (UInt32 *)p;						p += capacity * sizeof(UInt32);
+		block->compositionOffset = (UInt32 *)p;			p += capacity * sizeof(UInt32);
+		block->toBePresented = (Boolean *)p;			p += capacity * sizeof(Boolean);
+		block->sap3 = (Boolean *)p;						p += capacity * sizeof(Boolean);
+		block->sap4 = (Boolean *)p;
+		
+		block->next = NULL;
+		block->firstSample = store->count;
+		block->count = 0;
+		block->capacity = capacity;
+		if (store->last)
+			store->last->next = block;
+		else
+			store->first = block;
+		store->last = block;
+	}
+	
+	first = block->count;
+	for (i = first; i < first + n; i++) {
+		block->presentationTime[i] = 0;
+		block->toBePresented[i] = true;		//By default true, unless edit lists decide elsewise
+	}
+	memset( &block->sap3[first], 0, n * sizeof(Boolean) );
+	memset( &block->sap4[first], 0, n * sizeof(Boolean) );
+	
+	trunInfo->sample_duration = &block->duration[first];
+	trunInfo->sample_size = &block->size[first];
+	trunInfo->sample_flags = &block->flags[first];
+	trunInfo->sample_composition_time_offset = &block->compositionOffset[first];
+	trunInfo->sampleDecodeTime = &block->decodeTime[first];
+	trunInfo->samplePresentationTime = &block->presentationTime[first];
+	trunInfo->sampleToBePresented = &block->toBePresented[first];
+	trunInfo->sap3 = &block->sap3[first];
+	trunInfo->sap4 = &block->sap4[first];
+	
+	block->count += n;
+	store->count += n;
+	
+bail:
+	return err;
+}
+
+//==========================================================================================
+
+// Track lookups go through mir->trakByID, which holds every track whose 'tkhd' has been read.
+//   A miss falls back to scanning tirList so a track with a missing or unreadable 'tkhd'
+//   is still found by its (zero) track_ID, as it always was.
+static UInt32 findTrakIndex( MovieInfoRec *mir, UInt32 track_ID )
+{
+	UInt32 i;
+	
+	i = KeyIndexFind( &mir->trakByID, track_ID, (UInt32)mir->numTIRs );
+	if ((i < (UInt32)mir->numTIRs) && (mir->tirList[i].trackID == track_ID))
+		return i;
+	
+	for (i = 0; i < (UInt32)mir->numTIRs; i++)
+		if (mir->tirList[i].trackID == track_ID)
+			return i;
+	
+	return (UInt32)mir->numTIRs;
+}
+
 TrackInfoRec * check_track( UInt32 theID )
 {
 	MovieInfoRec	*mir = vg.mir;
@@ -101,9 +637,8 @@ TrackInfoRec * check_track( UInt32 theID )
 		return 0;
 	}
 	
-	for (i=0; i<(UInt32)mir->numTIRs; ++i) {
-			if ((mir->tirList[i].trackID) == theID) return &(mir->tirList[i]);
-	}		
+	i = findTrakIndex( mir, theID );
+	if (i < (UInt32)mir->numTIRs) return &(mir->tirList[i]);
 	errprint("Track ID %d in track reference atoms references a non-existent track\n",theID);
     
     return 0;
@@ -111,90 +646,160 @@ TrackInfoRec * check_track( UInt32 theID )
 
 UInt32 getTrakIndexByID(UInt32 track_ID)
 {
-    UInt32 i = 0;
+    UInt32 i = findTrakIndex(vg.mir, track_ID);
     
-    for(i = 0 ; i < (UInt32)vg.mir->numTIRs ; i++)
-        if(vg.mir->tirList[i].trackID == track_ID)
-            return i;
+    if(i < (UInt32)vg.mir->numTIRs)
+        return i;
 
     errprint("getTrakIndexByID: Track ID %d is not a known track!\n",track_ID);
 
     return vg.mir->numTIRs;
 }
 
-UInt32 getSgpdIndex(SgpdInfoRec *sgpd, UInt32 numSgpd, UInt32 grouping_type)
+// A 'traf' of an unknown track is left out; its 'trun's are rejected, so it has no samples to look at
+OSErr TrackFragmentsAppend( MovieInfoRec *mir, UInt32 moofIndex, UInt32 trafIndex, UInt32 track_ID )
 {
-    for(UInt32 i = 0; i < numSgpd ; i++)
-        if(sgpd[i].grouping_type == grouping_type)
-            return i;
+	OSErr err = noErr;
+	UInt32 i = findTrakIndex( mir, track_ID );
+	TrackInfoRec *tir;
+	
+	if (i >= (UInt32)mir->numTIRs)
+		goto bail;
+	
+	tir = &mir->tirList[i];
+	if (tir->numTrackFragments == tir->trackFragmentCapacity) {
+		UInt32 capacity = tir->trackFragmentCapacity ? 2 * tir->trackFragmentCapacity : 64;
+		
+		BAILIFNIL( tir->trackFragments = (TrackFragmentRef *)ArenaGrow( &vg.arena, tir->trackFragments, 
+			tir->trackFragmentCapacity * sizeof(TrackFragmentRef), capacity * sizeof(TrackFragmentRef) ), allocFailedErr );
+		tir->trackFragmentCapacity = capacity;
+	}
+	
+	tir->trackFragments[tir->numTrackFragments].moofIndex = moofIndex;
+	tir->trackFragments[tir->numTrackFragments].trafIndex = trafIndex;
+	tir->numTrackFragments++;
+	
+bail:
+	return err;
+}
 
-    return numSgpd;
+// The entries are in file order, so sorted by moofIndex; returns the first one in or after moof moofIndex
+UInt32 TrackFragmentsFind( TrackInfoRec *tir, UInt32 moofIndex )
+{
+	UInt32 lo = 0, hi = tir->numTrackFragments;
+	
+	while (lo < hi) {
+		UInt32 mid = lo + (hi - lo) / 2;
+		
+		if (tir->trackFragments[mid].moofIndex < moofIndex)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
 }
 
+UInt32 getSgpdIndex(TrafInfoRec *trafInfo, UInt32 grouping_type)
+{
+    UInt32 i = KeyIndexFind(&trafInfo->sgpdByGroupingType, grouping_type, trafInfo->numSgpd);
 
-UInt32 getMoofIndexByOffset(MoofInfoRec *moofInfo, UInt32 numFragments, UInt64 offset)
+    if(i < trafInfo->numSgpd && trafInfo->sgpdInfo[i].grouping_type == grouping_type)
+        return i;
+
+    return trafInfo->numSgpd;
+}
+
+
+UInt32 getMoofIndexByOffset(MovieInfoRec *mir, UInt64 offset)
 {
-    UInt32 i;
+    UInt32 i = KeyIndexFind(&mir->moofByOffset, offset, mir->numFragments);
 
-    for(i = 0 ; i < numFragments ; i++)
-    {
-        if(moofInfo[i].offset == offset)
-            return i;
-    }
+    if(i < mir->numFragments && mir->moofInfo[i].offset == offset)
+        return i;
 
-    return numFragments;
+    return mir->numFragments;
 }
 
 
-SidxInfoRec *getSidxByOffset(SidxInfoRec *sidxInfo, UInt32 numSidx, UInt64 offset)
+SidxInfoRec *getSidxByOffset(MovieInfoRec *mir, UInt64 offset)
 {
-    UInt32 i;
+    UInt32 i = KeyIndexFind(&mir->sidxByOffset, offset, mir->numSidx);
 
-    for(i = 0 ; i < numSidx ; i++)
-        if(sidxInfo[i].offset == offset)
-            return &sidxInfo[i];
+    if(i < mir->numSidx && mir->sidxInfo[i].offset == offset)
+        return &mir->sidxInfo[i];
 
     return (SidxInfoRec *)NULL;
 }
 
-bool checkSegmentBoundry(UInt64 offsetLow, UInt64 offsetHigh)
+// The first segment that ends beyond offset, i.e. the (non-empty) segment holding it, or
+//   segmentInfoSize if offset is past the last one.  Lookups mostly walk forward through the
+//   file, so the segment found last time and the one after it are tried before a binary search.
+static long findSegmentEndingAfter(UInt64 offset)
 {
-    UInt64 currentBoundry = 0;
+    long cursor = vg.segmentCursor;
+    long low = 0, high = vg.segmentInfoSize;
 
-    for(int i = 0 ; i < vg.segmentInfoSize ; i++)
+    if(cursor < vg.segmentInfoSize && offset < vg.segmentEnds[cursor])
     {
-        currentBoundry += vg.segmentSizes[i];
-        
-        if(offsetLow < currentBoundry && offsetHigh >= currentBoundry)
-            return true;
+        if(cursor == 0 || offset >= vg.segmentEnds[cursor - 1])
+            return cursor;
+    }
+    else if(cursor + 1 < vg.segmentInfoSize && offset >= vg.segmentEnds[cursor] && offset < vg.segmentEnds[cursor + 1])
+    {
+        vg.segmentCursor = cursor + 1;
+        return cursor + 1;
     }
 
-    return false;
-        
+    while(low < high)
+    {
+        long mid = low + (high - low)/2;
+
+        if(vg.segmentEnds[mid] > offset)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+
+    if(low < vg.segmentInfoSize)
+        vg.segmentCursor = low;
+    return low;
+}
+
+// Is there a segment boundary in (offsetLow, offsetHigh]?
+bool checkSegmentBoundry(UInt64 offsetLow, UInt64 offsetHigh)
+{
+    long i = findSegmentEndingAfter(offsetLow);
+
+    return (i < vg.segmentInfoSize && vg.segmentEnds[i] <= offsetHigh);
 }
 
 int getSegmentNumberByOffset(UInt64 offset)
 {
-    UInt64 currentBoundry = 0;
+    return (int)findSegmentEndingAfter(offset);
+}
+
+// The first segment that starts at offset, or segmentInfoSize if none does
+int getSegmentNumberStartingAt(UInt64 offset)
+{
+    long i;
 
-    for(int i = 0 ; i < (vg.segmentInfoSize - 1) ; i++)
-    {
-        currentBoundry += vg.segmentSizes[i];
-        
-        if(offset >= currentBoundry )
-            return i;
-    }
+    if(offset == 0)
+        return 0;
 
-    return vg.segmentInfoSize;
-        
+    i = findSegmentEndingAfter(offset - 1);
+    if(i >= vg.segmentInfoSize || vg.segmentEnds[i] != offset)
+        return vg.segmentInfoSize;
+
+    // segment i ends at offset; the one starting there is the next (empty ones included)
+    return (int)(i + 1);
 }
 
 void logtempInfo(MovieInfoRec *mir)
 {
-    FILE *leafInfoFile = fopen("sidxinfo.txt","wt");
+    FILE *leafInfoFile = OpenOutputFile("sidxinfo.txt","wt");
     if(leafInfoFile == NULL)
     {
-        printf("Error opening sidxinfo.txt, logging will not be done!\n");
+        reportprint("Error opening sidxinfo.txt, logging will not be done!\n");
         return;
     }
     
@@ -203,7 +808,7 @@ void logtempInfo(MovieInfoRec *mir)
     for(int i = 0 ; i < mir->numTIRs ; i++)
     {
         TrackInfoRec *tir = &(mir->tirList[i]);
-        fprintf(leafInfoFile,"%lu\n",tir->mediaTimeScale);
+        fprintf(leafInfoFile,"%u\n",tir->mediaTimeScale);
     }
         
     
@@ -221,7 +826,7 @@ void logtempInfo(MovieInfoRec *mir)
         
         for(UInt32 j = 0 ; j < tir->numLeafs ; j++)
             if(tir->leafInfo[j].hasFragments)
-                fprintf(leafInfoFile,"%d, %llu, %llu\n",tir->leafInfo[j].firstInSegment,(UInt64)roundl(tir->leafInfo[j].earliestPresentationTime*(long double)tir->mediaTimeScale),tir->leafInfo[j].offset);
+                fprintf(leafInfoFile,"%d, %llu, %llu\n",tir->leafInfo[j].firstInSegment,(UInt64)tir->leafInfo[j].earliestPresentationTime.value,tir->leafInfo[j].offset);
             
     }
 
@@ -230,14 +835,14 @@ void logtempInfo(MovieInfoRec *mir)
 
 void logLeafInfo(MovieInfoRec *mir)
 {
-    FILE *leafInfoFile = fopen("leafinfo.txt","wt");
+    FILE *leafInfoFile = OpenOutputFile("leafinfo.txt","wt");
     if(leafInfoFile == NULL)
     {
-        printf("Error opening leafinfo.txt, logging will not be done!\n");
+        reportprint("Error opening leafinfo.txt, logging will not be done!\n");
         return;
     }
     
-    fprintf(leafInfoFile,"%lu\n",vg.accessUnitDurationNonIndexedTrack);
+    fprintf(leafInfoFile,"%u\n",vg.accessUnitDurationNonIndexedTrack);
 
     fprintf(leafInfoFile,"%ld\n",mir->numTIRs);
 
@@ -245,7 +850,7 @@ void logLeafInfo(MovieInfoRec *mir)
     for(int i = 0 ; i < mir->numTIRs ; i++)
     {
         TrackInfoRec *tir = &(mir->tirList[i]);
-        fprintf(leafInfoFile,"%lu %lu\n",tir->trackID,tir->hdlrInfo->componentSubType);
+        fprintf(leafInfoFile,"%u %u\n",tir->trackID,tir->hdlrInfo->componentSubType);
     }
         
     
@@ -263,7 +868,7 @@ void logLeafInfo(MovieInfoRec *mir)
         
         for(UInt32 j = 0 ; j < tir->numLeafs ; j++)
             if(tir->leafInfo[j].hasFragments)
-                fprintf(leafInfoFile,"%d %Lf %Lf\n",tir->leafInfo[j].firstInSegment,tir->leafInfo[j].earliestPresentationTime,tir->leafInfo[j].lastPresentationTime);
+                fprintf(leafInfoFile,"%d %Lf %Lf\n",tir->leafInfo[j].firstInSegment,MediaTimeSeconds(tir->leafInfo[j].earliestPresentationTime),MediaTimeSeconds(tir->leafInfo[j].lastPresentationTime));
             
     }
 
@@ -27,13 +27,16 @@ limitations under the License.
 
 int FindAtomOffsets( atomOffsetEntry *aoe, UInt64 minOffset, UInt64 maxOffset, 
 			long *atomCountOut, atomOffsetEntry **atomOffsetsOut );
+int GetAtomOffsetEntry( atomOffsetEntry *aoe, UInt64 offset, UInt64 maxOffset, 
+			atomOffsetEntry *entry, Boolean *runsToEndOut );
 TrackInfoRec * check_track( UInt32 theID );
 UInt32 getTrakIndexByID(UInt32 track_ID);
-UInt32 getMoofIndexByOffset(MoofInfoRec *moofInfo, UInt32 numFragments, UInt64 offset);
-UInt32 getSgpdIndex(SgpdInfoRec *sgpd, UInt32 numSgpd, UInt32 grouping_type);
-SidxInfoRec *getSidxByOffset(SidxInfoRec *sidxInfo, UInt32 numSidx, UInt64 offset);
+UInt32 getMoofIndexByOffset(MovieInfoRec *mir, UInt64 offset);
+UInt32 getSgpdIndex(TrafInfoRec *trafInfo, UInt32 grouping_type);
+SidxInfoRec *getSidxByOffset(MovieInfoRec *mir, UInt64 offset);
 bool checkSegmentBoundry(UInt64 offsetLow, UInt64 offsetHigh);
 int getSegmentNumberByOffset(UInt64 offset);
+int getSegmentNumberStartingAt(UInt64 offset);
 void logLeafInfo(MovieInfoRec *mir);
 
 #endif //#define _SRC_HELPER_METHODS_H_
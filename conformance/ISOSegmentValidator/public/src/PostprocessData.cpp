@@ -24,6 +24,7 @@ limitations under the License.
 #include <math.h> 
 #include <sstream>
 #include <fstream>
+#include <time.h>
 
 #define scaleToTIR(x) ((long double)(x)/(long double)tir->mediaTimeScale)
 using namespace std;
@@ -48,13 +49,17 @@ void checkDASHBoxOrder(long cnt, atomOffsetEntry *list, long segmentInfoSize, bo
     bool sidxFoundInPreviousSegment = false;
     bool sidxFound = false;
     bool ftypFound = false;
+    int firstBox = 0;   // the boxes are in file order, so each segment's scan starts where the last one left off
 
     for (int index = (initializationSegment ? 1 : 0); index < segmentInfoSize; index++) {
         bool boxAtSegmentStartFound = false;
         bool sidxFoundInSegment = false;
         bool ssixFoundInSegment = false;
 
-        for (int i = 0; i < cnt; i++) {
+        while (firstBox < cnt && list[firstBox].offset < offset)
+            firstBox++;
+
+        for (int i = firstBox; i < cnt; i++) {
             if (list[i].offset >= (offset + segmentSizes[index])) //Segment end
             {
                 break;
@@ -73,7 +78,7 @@ void checkDASHBoxOrder(long cnt, atomOffsetEntry *list, long segmentInfoSize, bo
                 bool fragmentInSegmentFound = false;
                 bool moovInSegmentFound = false;
 
-                for (int j = i; list[j].offset < (offset + segmentSizes[index]); j++) {
+                for (int j = i; (j < cnt) && (list[j].offset < (offset + segmentSizes[index])); j++) {
                     if (list[j].type == 'ftyp') {
                         ftypFound = 1;
                     } else if (list[j].type == 'moov') {
@@ -214,7 +219,11 @@ OSErr postprocessFragmentInfo(MovieInfoRec *mir) {
 
                 if (mir->moofInfo[i].trafInfo[j].tfdtFound) {
                     if (mir->moofInfo[i].trafInfo[j].baseMediaDecodeTime != mir->tirList[index].cumulatedTackFragmentDecodeTime) {
-                        if (i == 0 && vg.dashSegment) {
+                        if (i == 0 && vg.rangeCutsStart) {
+                            // -range: the window starts part way in, so the timeline picks up from here
+                            mir->tirList[index].cumulatedTackFragmentDecodeTime = mir->moofInfo[i].trafInfo[j].baseMediaDecodeTime;
+                            mir->moofInfo[i].tfdt[index] = mir->tirList[index].cumulatedTackFragmentDecodeTime;
+                        } else if (i == 0 && vg.dashSegment) {
                             warnprint("Warning: tfdt base media decode time %Lf not equal to accumulated decode time %Lf for track %d for the first fragment of the movie. \n", (long double) mir->moofInfo[i].trafInfo[j].baseMediaDecodeTime / (long double) mir->tirList[index].mediaTimeScale, (long double) mir->tirList[index].cumulatedTackFragmentDecodeTime / (long double) mir->tirList[index].mediaTimeScale, mir->moofInfo[i].trafInfo[j].track_ID);
                             mir->tirList[index].cumulatedTackFragmentDecodeTime = mir->moofInfo[i].trafInfo[j].baseMediaDecodeTime;
                             mir->moofInfo[i].tfdt[index] = mir->tirList[index].cumulatedTackFragmentDecodeTime;
@@ -235,7 +244,7 @@ void initializeLeafInfo(MovieInfoRec *mir, long numMediaSegments) {
     for (long i = 0; i < mir->numTIRs; i++) {
         if (mir->tirList[i].numLeafs > 0) //Indexed
         {
-            mir->tirList[i].leafInfo = (LeafInfo *) malloc(mir->tirList[i].numLeafs * sizeof (LeafInfo));
+            mir->tirList[i].leafInfo = (LeafInfo *) ArenaAlloc(&vg.arena, mir->tirList[i].numLeafs * sizeof (LeafInfo));
 
             for (UInt32 j = 0; j < mir->tirList[i].numLeafs; j++)
                 mir->tirList[i].leafInfo[j].segmentIndexed = true;
@@ -244,7 +253,7 @@ void initializeLeafInfo(MovieInfoRec *mir, long numMediaSegments) {
         } else {
             mir->tirList[i].numLeafs = numMediaSegments;
 
-            mir->tirList[i].leafInfo = (LeafInfo *) malloc(mir->tirList[i].numLeafs * sizeof (LeafInfo));
+            mir->tirList[i].leafInfo = (LeafInfo *) ArenaAlloc(&vg.arena, mir->tirList[i].numLeafs * sizeof (LeafInfo));
 
             for (UInt32 j = 0; j < mir->tirList[i].numLeafs; j++)
                 mir->tirList[i].leafInfo[j].segmentIndexed = false;
@@ -258,21 +267,21 @@ void initializeLeafInfo(MovieInfoRec *mir, long numMediaSegments) {
                     moof->firstFragmentInSegment = true;
                     mir->tirList[i].leafInfo[mediaSegmentNumber].firstMoofIndex = moof->index;
                     mir->tirList[i].leafInfo[mediaSegmentNumber].firstInSegment = true;
-                    mir->tirList[i].leafInfo[mediaSegmentNumber].earliestPresentationTime = moof->moofEarliestPresentationTimePerTrack[i];
-                    mir->tirList[i].leafInfo[mediaSegmentNumber].sidxReportedDuration = 0; //Not indexed
+                    mir->tirList[i].leafInfo[mediaSegmentNumber].earliestPresentationTime = MediaTimeMake(moof->moofEarliestPresentationTimePerTrack[i], mir->tirList[i].mediaTimeScale);
+                    mir->tirList[i].leafInfo[mediaSegmentNumber].sidxReportedDuration = MediaTimeMake(0, mir->tirList[i].mediaTimeScale); //Not indexed
                     mir->tirList[i].leafInfo[mediaSegmentNumber].hasFragments = true;
 
                     if (mediaSegmentNumber > 0) {
                         mir->tirList[i].leafInfo[mediaSegmentNumber - 1].lastMoofIndex = mir->moofInfo[k - 1].index;
-                        mir->tirList[i].leafInfo[mediaSegmentNumber - 1].lastPresentationTime = mir->moofInfo[k - 1].moofLastPresentationTimePerTrack[i];
-                        mir->tirList[i].leafInfo[mediaSegmentNumber - 1].presentationEndTime = mir->moofInfo[k - 1].moofPresentationEndTimePerTrack[i];
+                        mir->tirList[i].leafInfo[mediaSegmentNumber - 1].lastPresentationTime = MediaTimeMake(mir->moofInfo[k - 1].moofLastPresentationTimePerTrack[i], mir->tirList[i].mediaTimeScale);
+                        mir->tirList[i].leafInfo[mediaSegmentNumber - 1].presentationEndTime = MediaTimeMake(mir->moofInfo[k - 1].moofPresentationEndTimePerTrack[i], mir->tirList[i].mediaTimeScale);
                         mir->tirList[i].leafInfo[mediaSegmentNumber - 1].offset = mir->moofInfo[k - 1].offset;
                     }
 
                     if ((long) mediaSegmentNumber == (numMediaSegments - 1)) {
                         mir->tirList[i].leafInfo[mediaSegmentNumber].lastMoofIndex = mir->moofInfo[mir->numFragments - 1].index;
-                        mir->tirList[i].leafInfo[mediaSegmentNumber].lastPresentationTime = mir->moofInfo[mir->numFragments - 1].moofLastPresentationTimePerTrack[i];
-                        mir->tirList[i].leafInfo[mediaSegmentNumber].presentationEndTime = mir->moofInfo[mir->numFragments - 1].moofPresentationEndTimePerTrack[i];
+                        mir->tirList[i].leafInfo[mediaSegmentNumber].lastPresentationTime = MediaTimeMake(mir->moofInfo[mir->numFragments - 1].moofLastPresentationTimePerTrack[i], mir->tirList[i].mediaTimeScale);
+                        mir->tirList[i].leafInfo[mediaSegmentNumber].presentationEndTime = MediaTimeMake(mir->moofInfo[mir->numFragments - 1].moofPresentationEndTimePerTrack[i], mir->tirList[i].mediaTimeScale);
                         mir->tirList[i].leafInfo[mediaSegmentNumber].offset = mir->moofInfo[mir->numFragments - 1].offset;
                     }
 
@@ -283,110 +292,538 @@ void initializeLeafInfo(MovieInfoRec *mir, long numMediaSegments) {
     }
 }
 
-void estimatePresentationTimes(MovieInfoRec *mir) {
-    //Calcualte deltas based on edit lists
-    for (int i = 0; i < mir->numTIRs; i++) {
-        TrackInfoRec *tir = &(mir->tirList[i]);
+//==========================================================================================
 
-        SInt64 presentationTime = 0;
+UInt64 postprocessClock() {
+#if defined(_MSC_VER)
+    return (UInt64) clock() * (1000000000 / CLOCKS_PER_SEC);
+#else
+    struct timespec now;
 
-        for (UInt32 e = 0; e < tir->numEdits; e++) {
-            if (tir->elstInfo[e].mediaTime < 0) {
-                printf("Empty edits not handled. Processing unreliable.\n");
-            }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (UInt64) now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
 
-            SInt64 segmentDurationInMediaTimescale = (SInt64)((long double)tir->elstInfo[e].duration/(long double)mir->mvhd_timescale*(long double)tir->mediaTimeScale);
+// -printtype timing: report the time since *since as spent in the named step, and restart the clock
+void postprocessTiming(const char *name, UInt64 *since) {
+    UInt64 now;
 
-            for (UInt32 j = 0; j < mir->numFragments; j++) {
-                UInt64 cummulatedDuration = 0;
-                MoofInfoRec *moof = &mir->moofInfo[j];
-                moof->samplesToBePresented = false;
+    if (!vg.print_timing)
+        return;
 
-                for (UInt32 k = 0; k < moof->numTrackFragments; k++) {
-                    if (moof->trafInfo[k].track_ID == tir->trackID && moof->trafInfo[k].numTrun > 0)//Assuming 'trun' cannot be empty, 14496-12 version 4 does not indicate such a possiblity.
-                    {
-                        for (UInt32 l = 0; l < moof->trafInfo[k].numTrun; l++) {
-                            for (UInt32 m = 0; m < moof->trafInfo[k].trunInfo[l].sample_count; m++) {
-                                SInt64 sample_composition_time_offset = moof->trafInfo[k].trunInfo[l].version != 0 ? (SInt64) ((Int32) moof->trafInfo[k].trunInfo[l].sample_composition_time_offset[m]) : (UInt32) moof->trafInfo[k].trunInfo[l].sample_composition_time_offset[m];
-                                SInt64 sampleCompositionTime = sample_composition_time_offset + (SInt64) moof->tfdt[i] + cummulatedDuration;
-
-                                if (tir->elstInfo[e].mediaTime >= 0) {
-                                    if (sampleCompositionTime >= tir->elstInfo[e].mediaTime && (tir->elstInfo[e].duration == 0 || sampleCompositionTime < (tir->elstInfo[e].mediaTime + segmentDurationInMediaTimescale))) {
-                                        moof->trafInfo[k].trunInfo[l].samplePresentationTime[m] = 0 - (tir->elstInfo[e].mediaTime - presentationTime); //Save the delta in: presentationTime = CompositionTime - (editMediaTime_i - presntationDuration)
-                                        moof->trafInfo[k].trunInfo[l].sampleToBePresented[m] = true;
-                                        moof->samplesToBePresented = true;
-                                    } else if (sampleCompositionTime >= tir->elstInfo[e].mediaTime) // A later edit should update this. Else sample not to be presented
-                                        moof->trafInfo[k].trunInfo[l].sampleToBePresented[m] = false;
-                                } else
-                                    ; //Nothing related to conformance, sampleToBePresented is initialized as false: moof->trafInfo[k].trunInfo[l].sampleToBePresented[m] = false;
-
-                                cummulatedDuration += moof->trafInfo[k].trunInfo[l].sample_duration[m];
-                            }
-                        }
-                    }
-                }
-            }
+    now = postprocessClock();
+    reportprint("<!-- postprocess %s: %.3f ms -->\n", name, (double) (now - *since) / 1e6);
+    *since = postprocessClock();
+}
 
-            presentationTime += segmentDurationInMediaTimescale;
-        }
+void initFragmentSampleVisitor(FragmentSampleVisitor *visitor, const char *name, void *state) {
+    memset(visitor, 0, sizeof (FragmentSampleVisitor));
+    visitor->name = name;
+    visitor->state = state;
+}
+
+static void visitFragmentSamples(FragmentSampleVisitor *visitor, FragmentSampleVisitorProc proc, FragmentSampleCursor *cursor) {
+    UInt64 start;
+
+    if (proc == NULL || !visitor->active)
+        return;
+
+    if (!vg.print_timing) {
+        proc(visitor, cursor);
+        return;
     }
 
-    //Apply deltas to samples. This is done separatley since absence of an edit list is an entirely different case.
+    start = postprocessClock();
+    proc(visitor, cursor);
+    visitor->nanoseconds += postprocessClock() - start;
+}
 
-    for (int i = 0; i < mir->numTIRs; i++) {
-        TrackInfoRec *tir = &(mir->tirList[i]);
+// Diagnostics printed while walking would come out interleaved with those of the other visitors,
+//   so visitors hold on to their findings until report, which runs visitor by visitor once all
+//   tracks are walked. The output is then in the order one pass per check would have given.
+OSErr walkFragmentSamples(MovieInfoRec *mir, FragmentSampleVisitor *visitors, int numVisitors) {
+    OSErr err = noErr;
+    FragmentSampleCursor cursor;
+    int v;
+
+    memset(&cursor, 0, sizeof (cursor));
+    cursor.mir = mir;
+
+    for (long i = 0; i < mir->numTIRs; i++) {
+        bool anyActive = false;
+        UInt32 f = 0;
+
+        cursor.tir = &mir->tirList[i];
+        cursor.trackIndex = i;
+        cursor.firstSample = 0;
+        cursor.needs = 0;
+        cursor.overflow = false;
+
+        for (v = 0; v < numVisitors; v++) {
+            visitors[v].active = true;
+            visitFragmentSamples(&visitors[v], visitors[v].beginTrack, &cursor);
+            if (visitors[v].active) {
+                anyActive = true;
+                cursor.needs |= visitors[v].needs;
+            }
+        }
+
+        if (!anyActive)
+            continue;
 
         for (UInt32 j = 0; j < mir->numFragments; j++) {
-            SInt64 cummulatedDuration = 0;
             MoofInfoRec *moof = &mir->moofInfo[j];
+            SInt64 cummulatedDuration = 0;
 
-            moof->moofPresentationEndTimePerTrack[i] = j > 0 ? mir->moofInfo[j - 1].moofPresentationEndTimePerTrack[i] : 0;
-            moof->moofLastPresentationTimePerTrack[i] = j > 0 ? mir->moofInfo[j - 1].moofPresentationEndTimePerTrack[i] : 0;
-            moof->moofEarliestPresentationTimePerTrack[i] = std::numeric_limits<long double>::max();
+            cursor.moofIndex = j;
+            cursor.moof = moof;
 
-            for (UInt32 k = 0; k < moof->numTrackFragments; k++) {
-                if (moof->trafInfo[k].track_ID == tir->trackID && moof->trafInfo[k].numTrun > 0) //Assuming 'trun' cannot be empty, 14496-12 version 4 does not indicate such a possiblity.
-                {
-                    for (UInt32 l = 0; l < moof->trafInfo[k].numTrun; l++) {
-                        for (UInt32 m = 0; m < moof->trafInfo[k].trunInfo[l].sample_count; m++) {
-                            SInt64 sample_composition_time_offset = moof->trafInfo[k].trunInfo[l].version != 0 ? (SInt64) ((Int32) moof->trafInfo[k].trunInfo[l].sample_composition_time_offset[m]) : (UInt32) moof->trafInfo[k].trunInfo[l].sample_composition_time_offset[m];
-                            SInt64 sampleCompositionTime = sample_composition_time_offset + (SInt64) moof->tfdt[i] + cummulatedDuration;
+            for (v = 0; v < numVisitors; v++)
+                visitFragmentSamples(&visitors[v], visitors[v].beginMoof, &cursor);
+
+            // every moof is begun and ended, but only this track's trafs are walked
+            for (; f < cursor.tir->numTrackFragments && cursor.tir->trackFragments[f].moofIndex == j; f++) {
+                UInt32 k = cursor.tir->trackFragments[f].trafIndex;
+                TrafInfoRec *traf = &moof->trafInfo[k];
+
+                cursor.trafIndex = k;
+                cursor.traf = traf;
+
+                for (UInt32 l = 0; l < traf->numTrun; l++) {
+                    TrunInfoRec *trun = &traf->trunInfo[l];
+
+                    if (trun->sample_count == 0)
+                        continue;
 
-                            moof->trafInfo[k].trunInfo[l].samplePresentationTime[m] = (long double) (moof->trafInfo[k].trunInfo[l].samplePresentationTime[m] + sampleCompositionTime) / (long double) tir->mediaTimeScale;
+                    // the scratch columns only ever grow, the old ones are left to the arena
+                    if (trun->sample_count > cursor.runCapacity) {
+                        cursor.runCapacity = trun->sample_count > 2 * cursor.runCapacity ? trun->sample_count : 2 * cursor.runCapacity;
+                        BAILIFNIL(cursor.compositionTime = (SInt64 *) ArenaAlloc(&vg.arena, cursor.runCapacity * sizeof (SInt64)), allocFailedErr);
+                        BAILIFNIL(cursor.sapType = (UInt8 *) ArenaAlloc(&vg.arena, cursor.runCapacity * sizeof (UInt8)), allocFailedErr);
+                    }
+
+                    if (cursor.needs & kFragmentSampleCompositionTime) {
+                        SInt64 *compositionTime = cursor.compositionTime;
+                        SInt64 decodeTime = moof->tfdt[i] <= (UInt64) kMediaTimeMax ? (SInt64) moof->tfdt[i] : kMediaTimeMax;
+                        SInt64 runEnd;
+                        bool fits;
+
+                        // The run's decode times span its cummulatedSampleDuration and an offset is less than 2^32 either way,
+                        //   so only a run at the far end of the timeline takes the checked sums
+                        fits = moof->tfdt[i] <= (UInt64) kMediaTimeMax && MediaTimeAdd(&decodeTime, cummulatedDuration);
+                        runEnd = decodeTime;
+                        fits = fits && trun->cummulatedSampleDuration <= (UInt64) kMediaTimeMax && MediaTimeAdd(&runEnd, (SInt64) trun->cummulatedSampleDuration) && MediaTimeAdd(&runEnd, 0x100000000LL);
 
-                            if (moof->trafInfo[k].trunInfo[l].sampleToBePresented[m] && moof->trafInfo[k].trunInfo[l].samplePresentationTime[m] >= moof->moofLastPresentationTimePerTrack[i]) {
-                                moof->moofLastPresentationTimePerTrack[i] = moof->trafInfo[k].trunInfo[l].samplePresentationTime[m];
+                        if (fits) {
+                            for (UInt32 m = 0; m < trun->sample_count; m++) {
+                                SInt64 sample_composition_time_offset = trun->version != 0 ? (SInt64) ((Int32) trun->sample_composition_time_offset[m]) : (UInt32) trun->sample_composition_time_offset[m];
+
+                                compositionTime[m] = sample_composition_time_offset + decodeTime;
+                                decodeTime += trun->sample_duration[m];
                             }
+                        } else {
+                            cursor.overflow = cursor.overflow || moof->tfdt[i] > (UInt64) kMediaTimeMax;
 
-                            if (j == (mir->numFragments - 1) || !mir->moofInfo[j + 1].samplesToBePresented) //Only for last fragment, or if next fragment doesnt have presentable samples, use sample delta to calculate durations. Otherwise it is estimated from the EPT of the next moof, done after the loop
-                            {
-                                long double samplePresentationEndTime = moof->trafInfo[k].trunInfo[l].samplePresentationTime[m] + (long double) moof->trafInfo[k].trunInfo[l].sample_duration[m] / (long double) tir->mediaTimeScale;
+                            for (UInt32 m = 0; m < trun->sample_count; m++) {
+                                SInt64 sample_composition_time_offset = trun->version != 0 ? (SInt64) ((Int32) trun->sample_composition_time_offset[m]) : (UInt32) trun->sample_composition_time_offset[m];
 
-                                if (moof->trafInfo[k].trunInfo[l].sampleToBePresented[m] && (samplePresentationEndTime > moof->moofPresentationEndTimePerTrack[i]))
-                                    moof->moofPresentationEndTimePerTrack[i] = samplePresentationEndTime;
+                                compositionTime[m] = decodeTime;
+                                if (!MediaTimeAdd(&compositionTime[m], sample_composition_time_offset) || !MediaTimeAdd(&decodeTime, trun->sample_duration[m]))
+                                    cursor.overflow = true;
                             }
+                        }
+                    }
+
+                    if (cursor.needs & kFragmentSampleSAPType) {
+                        UInt8 *sapType = cursor.sapType;
 
-                            if (moof->trafInfo[k].trunInfo[l].sampleToBePresented[m] && (moof->trafInfo[k].trunInfo[l].samplePresentationTime[m] < moof->moofEarliestPresentationTimePerTrack[i]))
-                                moof->moofEarliestPresentationTimePerTrack[i] = moof->trafInfo[k].trunInfo[l].samplePresentationTime[m];
+                        for (UInt32 m = 0; m < trun->sample_count; m++) {
+                            bool sample_is_non_sync_sample = ((trun->sample_flags[m] & 0x10000) >> 16) != 0;
 
-                            cummulatedDuration += moof->trafInfo[k].trunInfo[l].sample_duration[m];
+                            sapType[m] = !sample_is_non_sync_sample ? 1 : trun->sap3[m] ? 3 : trun->sap4[m] ? 4 : 7;
                         }
                     }
+
+                    if (trun->cummulatedSampleDuration > (UInt64) kMediaTimeMax || !MediaTimeAdd(&cummulatedDuration, (SInt64) trun->cummulatedSampleDuration)) {
+                        cummulatedDuration = kMediaTimeMax;
+                        cursor.overflow = true;
+                    }
+
+                    cursor.trunIndex = l;
+                    cursor.trun = trun;
+
+                    for (v = 0; v < numVisitors; v++) {
+                        if (visitors[v].active)
+                            visitors[v].samples += trun->sample_count;
+                        visitFragmentSamples(&visitors[v], visitors[v].run, &cursor);
+                    }
+
+                    cursor.firstSample += trun->sample_count;
                 }
             }
 
-            if (moof->moofEarliestPresentationTimePerTrack[i] == std::numeric_limits<long double>::max())//Still uninitialized
-                moof->moofEarliestPresentationTimePerTrack[i] = j > 0 ? mir->moofInfo[j - 1].moofPresentationEndTimePerTrack[i] : 0;
+            for (v = 0; v < numVisitors; v++)
+                visitFragmentSamples(&visitors[v], visitors[v].endMoof, &cursor);
+        }
+
+        for (v = 0; v < numVisitors; v++)
+            visitFragmentSamples(&visitors[v], visitors[v].endTrack, &cursor);
+
+        if (cursor.overflow)
+            cursor.tir->timelineOverflow = true;
+    }
+
+    for (v = 0; v < numVisitors; v++) {
+        visitors[v].active = true;
+        visitFragmentSamples(&visitors[v], visitors[v].report, &cursor);
+
+        if (vg.print_timing)
+            reportprint("<!-- postprocess %s: %llu samples, %.3f ms -->\n", visitors[v].name, visitors[v].samples, (double) visitors[v].nanoseconds / 1e6);
+    }
+
+bail:
+    return err;
+}
+
+//==========================================================================================
+
+// Each sample takes the presentation offset of the last edit covering its composition time,
+//   and a moof has samples to be presented when the track's last edit covers one of them
+//   (the last track with edits has the final say, the flag is per moof).
+// The edits cut the composition timeline into intervals over which all of that is constant, so
+//   the intervals are worked out once per track and each sample only looks up its interval.
+enum {
+    kEditIntervalKeep = 0,          // no edit starts at or before the interval, the sample is left as it is
+    kEditIntervalPresented,         // the last edit starting at or before the interval covers it
+    kEditIntervalHidden             // the last edit starting at or before the interval has ended
+};
+
+typedef struct {
+    SInt64  start;                  // composition time the interval starts at, it runs to the next one's start
+    SInt64  presentationDelta;      // presentation time less composition time, of the last edit covering the interval
+    Boolean covered;                // some edit covers the interval, presentationDelta is set
+    Boolean lastEdit;               // the track's last edit covers the interval
+    UInt8   presentation;           // kEditInterval*
+} EditInterval;
+
+typedef struct {
+    SInt64 *segmentEnd;             // per edit, in media timescale
+    SInt64 *presentationDelta;      // per edit, presentation time less composition time, in media timescale
+    EditInterval *intervals;        // sorted by start, the first one starts at kMediaTimeMin
+    UInt32 numIntervals;
+} EditMappingState;
+
+typedef struct {
+    SInt64 time;
+    UInt32 edit;
+} EditBoundary;
+
+static int compareSInt64(const void *a, const void *b) {
+    SInt64 x = *(const SInt64 *) a;
+    SInt64 y = *(const SInt64 *) b;
+
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static int compareEditBoundaries(const void *a, const void *b) {
+    const EditBoundary *x = (const EditBoundary *) a;
+    const EditBoundary *y = (const EditBoundary *) b;
+
+    if (x->time != y->time)
+        return x->time < y->time ? -1 : 1;
+    return x->edit < y->edit ? -1 : x->edit > y->edit ? 1 : 0;
+}
+
+static Boolean editCovers(TrackInfoRec *tir, EditMappingState *state, UInt32 e, SInt64 compositionTime) {
+    return tir->elstInfo[e].mediaTime >= 0 && compositionTime >= tir->elstInfo[e].mediaTime && (tir->elstInfo[e].duration == 0 || compositionTime < state->segmentEnd[e]);
+}
+
+// Sweeps the edit starts and ends in time order. The edits that have started are kept in a max-heap
+//   by edit index, those that ended are only dropped once they come to the top.
+static OSErr buildEditIntervals(TrackInfoRec *tir, EditMappingState *state) {
+    OSErr err = noErr;
+    EditBoundary *starts = NULL;
+    SInt64 *times = NULL;
+    UInt32 *heap = NULL;
+    UInt32 numStarts = 0, numTimes = 0, heapSize = 0, s = 0;
+    SInt64 lastStarted = -1;
+
+    BAILIFNIL(starts = (EditBoundary *) ArenaAlloc(&vg.arena, tir->numEdits * sizeof (EditBoundary)), allocFailedErr);
+    BAILIFNIL(times = (SInt64 *) ArenaAlloc(&vg.arena, 2 * tir->numEdits * sizeof (SInt64)), allocFailedErr);
+    BAILIFNIL(heap = (UInt32 *) ArenaAlloc(&vg.arena, tir->numEdits * sizeof (UInt32)), allocFailedErr);
+
+    for (UInt32 e = 0; e < tir->numEdits; e++) {
+        if (tir->elstInfo[e].mediaTime < 0)
+            continue; //Empty edits map no samples
+
+        starts[numStarts].time = tir->elstInfo[e].mediaTime;
+        starts[numStarts].edit = e;
+        numStarts++;
+        times[numTimes++] = tir->elstInfo[e].mediaTime;
+        if (tir->elstInfo[e].duration != 0 && state->segmentEnd[e] > tir->elstInfo[e].mediaTime)
+            times[numTimes++] = state->segmentEnd[e];
+    }
+
+    qsort(starts, numStarts, sizeof (EditBoundary), compareEditBoundaries);
+    qsort(times, numTimes, sizeof (SInt64), compareSInt64);
+
+    BAILIFNIL(state->intervals = (EditInterval *) ArenaAlloc(&vg.arena, (numTimes + 1) * sizeof (EditInterval)), allocFailedErr);
+    state->intervals[0].start = kMediaTimeMin;
+    state->intervals[0].presentationDelta = 0;
+    state->intervals[0].covered = false;
+    state->intervals[0].lastEdit = false;
+    state->intervals[0].presentation = kEditIntervalKeep;
+    state->numIntervals = 1;
+
+    for (UInt32 t = 0; t < numTimes; t++) {
+        SInt64 now = times[t];
+        EditInterval *interval;
+
+        if (t > 0 && now == times[t - 1])
+            continue;
+
+        for (; s < numStarts && starts[s].time <= now; s++) {
+            UInt32 child = heapSize++;
+
+            // sift the edit up
+            while (child > 0 && heap[(child - 1) / 2] < starts[s].edit) {
+                heap[child] = heap[(child - 1) / 2];
+                child = (child - 1) / 2;
+            }
+            heap[child] = starts[s].edit;
+
+            if ((SInt64) starts[s].edit > lastStarted)
+                lastStarted = starts[s].edit;
+        }
+
+        while (heapSize > 0 && !editCovers(tir, state, heap[0], now)) {
+            UInt32 moved = heap[--heapSize];
+            UInt32 parent = 0;
+
+            // sift the last edit down from the top
+            for (;;) {
+                UInt32 child = 2 * parent + 1;
+
+                if (child >= heapSize)
+                    break;
+                if (child + 1 < heapSize && heap[child + 1] > heap[child])
+                    child++;
+                if (heap[child] <= moved)
+                    break;
+                heap[parent] = heap[child];
+                parent = child;
+            }
+            if (heapSize > 0)
+                heap[parent] = moved;
+        }
+
+        interval = &state->intervals[state->numIntervals++];
+        interval->start = now;
+        interval->covered = heapSize > 0;
+        interval->presentationDelta = heapSize > 0 ? state->presentationDelta[heap[0]] : 0;
+        interval->lastEdit = editCovers(tir, state, tir->numEdits - 1, now);
+        interval->presentation = lastStarted < 0 ? kEditIntervalKeep : editCovers(tir, state, (UInt32) lastStarted, now) ? kEditIntervalPresented : kEditIntervalHidden;
+    }
+
+bail:
+    return err;
+}
+
+static void editMappingBeginTrack(FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor) {
+    EditMappingState *state = (EditMappingState *) visitor->state;
+    TrackInfoRec *tir = cursor->tir;
+    SInt64 presentationTime = 0;
+
+    if (tir->numEdits == 0) {
+        visitor->active = false;
+        return;
+    }
+
+    state->segmentEnd = (SInt64 *) ArenaAlloc(&vg.arena, tir->numEdits * sizeof (SInt64));
+    state->presentationDelta = (SInt64 *) ArenaAlloc(&vg.arena, tir->numEdits * sizeof (SInt64));
+    if (state->segmentEnd == NULL || state->presentationDelta == NULL) {
+        visitor->active = false;
+        return;
+    }
+
+    for (UInt32 e = 0; e < tir->numEdits; e++) {
+        EditListEntryVers1Record *edit = &tir->elstInfo[e];
+        SInt64 segmentDuration;
+
+        //The edit duration is in movie timescale, truncated to whole media ticks
+        if (!MediaTimeRescale(edit->duration <= (UInt64) kMediaTimeMax ? (SInt64) edit->duration : kMediaTimeMax, cursor->mir->mvhd_timescale, tir->mediaTimeScale, &segmentDuration) && cursor->mir->mvhd_timescale != 0)
+            cursor->overflow = true;
+
+        state->segmentEnd[e] = edit->mediaTime;
+        state->presentationDelta[e] = presentationTime;
+        if (!MediaTimeAdd(&state->segmentEnd[e], segmentDuration) || (edit->mediaTime >= 0 && !MediaTimeAdd(&state->presentationDelta[e], -edit->mediaTime)) || !MediaTimeAdd(&presentationTime, segmentDuration))
+            cursor->overflow = true;
+    }
+
+    if (buildEditIntervals(tir, state) != noErr)
+        visitor->active = false;
+}
+
+static void editMappingBeginMoof(FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor) {
+#pragma unused(visitor)
+    cursor->moof->samplesToBePresented = false;
+}
 
-            if (j > 0 && moof->samplesToBePresented) {
-                mir->moofInfo[j - 1].moofPresentationEndTimePerTrack[i] = moof->moofEarliestPresentationTimePerTrack[i];
+// Composition times mostly rise through a run, so the interval of the previous sample is tried first
+static void editMappingRun(FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor) {
+    EditMappingState *state = (EditMappingState *) visitor->state;
+    TrunInfoRec *trun = cursor->trun;
+    EditInterval *intervals = state->intervals;
+    UInt32 k = 0;
+
+    for (UInt32 m = 0; m < trun->sample_count; m++) {
+        SInt64 sampleCompositionTime = cursor->compositionTime[m];
+        EditInterval *interval;
+
+        if (sampleCompositionTime < intervals[k].start || (k + 1 < state->numIntervals && sampleCompositionTime >= intervals[k + 1].start)) {
+            UInt32 lo = 0, hi = state->numIntervals - 1;
+
+            // the last interval starting at or before the sample
+            while (lo < hi) {
+                UInt32 mid = lo + (hi - lo + 1) / 2;
+
+                if (intervals[mid].start <= sampleCompositionTime)
+                    lo = mid;
+                else
+                    hi = mid - 1;
             }
+            k = lo;
+        }
+
+        interval = &intervals[k];
+        if (interval->covered)
+            trun->samplePresentationTime[m] = interval->presentationDelta; //Save the delta in: presentationTime = CompositionTime - (editMediaTime_i - presntationDuration)
+        if (interval->presentation != kEditIntervalKeep)
+            trun->sampleToBePresented[m] = interval->presentation == kEditIntervalPresented;
+        if (interval->lastEdit)
+            cursor->moof->samplesToBePresented = true;
+    }
+}
+
+static void editMappingReport(FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor) {
+#pragma unused(visitor)
+    MovieInfoRec *mir = cursor->mir;
+
+    for (int i = 0; i < mir->numTIRs; i++)
+        for (UInt32 e = 0; e < mir->tirList[i].numEdits; e++)
+            if (mir->tirList[i].elstInfo[e].mediaTime < 0)
+                reportprint("Empty edits not handled. Processing unreliable.\n");
+}
 
+// Apply the deltas to the samples; this takes the edit mapping of all tracks, as where a moof
+//   ends depends on whether the next moof has samples to be presented
+typedef struct {
+    Boolean endFromSamples;
+} PresentationTimesState;
+
+static void presentationTimesBeginMoof(FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor) {
+    PresentationTimesState *state = (PresentationTimesState *) visitor->state;
+    MovieInfoRec *mir = cursor->mir;
+    MoofInfoRec *moof = cursor->moof;
+    UInt32 j = cursor->moofIndex;
+    long i = cursor->trackIndex;
+
+    moof->moofPresentationEndTimePerTrack[i] = j > 0 ? mir->moofInfo[j - 1].moofPresentationEndTimePerTrack[i] : 0;
+    moof->moofLastPresentationTimePerTrack[i] = j > 0 ? mir->moofInfo[j - 1].moofPresentationEndTimePerTrack[i] : 0;
+    moof->moofEarliestPresentationTimePerTrack[i] = kMediaTimeMax;
+
+    //Only for last fragment, or if next fragment doesnt have presentable samples, use sample delta to calculate durations. Otherwise it is estimated from the EPT of the next moof, done in endMoof
+    state->endFromSamples = j == (mir->numFragments - 1) || !mir->moofInfo[j + 1].samplesToBePresented;
+}
+
+static void presentationTimesRun(FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor) {
+    PresentationTimesState *state = (PresentationTimesState *) visitor->state;
+    MoofInfoRec *moof = cursor->moof;
+    TrunInfoRec *trun = cursor->trun;
+    long i = cursor->trackIndex;
+    SInt64 lastPresentationTime = moof->moofLastPresentationTimePerTrack[i];
+    SInt64 presentationEndTime = moof->moofPresentationEndTimePerTrack[i];
+    SInt64 earliestPresentationTime = moof->moofEarliestPresentationTimePerTrack[i];
+
+    for (UInt32 m = 0; m < trun->sample_count; m++) {
+        SInt64 samplePresentationTime = trun->samplePresentationTime[m];
+
+        if (!MediaTimeAdd(&samplePresentationTime, cursor->compositionTime[m]))
+            cursor->overflow = true;
+        trun->samplePresentationTime[m] = samplePresentationTime;
+
+        if (!trun->sampleToBePresented[m])
+            continue;
+
+        if (samplePresentationTime >= lastPresentationTime)
+            lastPresentationTime = samplePresentationTime;
+
+        if (state->endFromSamples) {
+            SInt64 samplePresentationEndTime = samplePresentationTime;
+
+            if (!MediaTimeAdd(&samplePresentationEndTime, trun->sample_duration[m]))
+                cursor->overflow = true;
+
+            if (samplePresentationEndTime > presentationEndTime)
+                presentationEndTime = samplePresentationEndTime;
         }
 
+        if (samplePresentationTime < earliestPresentationTime)
+            earliestPresentationTime = samplePresentationTime;
+    }
+
+    moof->moofLastPresentationTimePerTrack[i] = lastPresentationTime;
+    moof->moofPresentationEndTimePerTrack[i] = presentationEndTime;
+    moof->moofEarliestPresentationTimePerTrack[i] = earliestPresentationTime;
+}
+
+static void presentationTimesEndMoof(FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor) {
+#pragma unused(visitor)
+    MovieInfoRec *mir = cursor->mir;
+    MoofInfoRec *moof = cursor->moof;
+    UInt32 j = cursor->moofIndex;
+    long i = cursor->trackIndex;
+
+    if (moof->moofEarliestPresentationTimePerTrack[i] == kMediaTimeMax)//Still uninitialized
+        moof->moofEarliestPresentationTimePerTrack[i] = j > 0 ? mir->moofInfo[j - 1].moofPresentationEndTimePerTrack[i] : 0;
+
+    if (j > 0 && moof->samplesToBePresented) {
+        mir->moofInfo[j - 1].moofPresentationEndTimePerTrack[i] = moof->moofEarliestPresentationTimePerTrack[i];
     }
+}
+
+OSErr estimatePresentationTimes(MovieInfoRec *mir) {
+    OSErr err = noErr;
+    EditMappingState editMapping;
+    PresentationTimesState presentationTimes;
+    FragmentSampleVisitor visitor;
+
+    //Calcualte deltas based on edit lists, all edits in the one pass
+    initFragmentSampleVisitor(&visitor, "edit list mapping", &editMapping);
+    visitor.needs = kFragmentSampleCompositionTime;
+    visitor.beginTrack = editMappingBeginTrack;
+    visitor.beginMoof = editMappingBeginMoof;
+    visitor.run = editMappingRun;
+    visitor.report = editMappingReport;
+    BAILIFERR(walkFragmentSamples(mir, &visitor, 1));
+
+    //Apply deltas to samples. This is done separatley since absence of an edit list is an entirely different case.
+    initFragmentSampleVisitor(&visitor, "presentation times", &presentationTimes);
+    visitor.needs = kFragmentSampleCompositionTime;
+    visitor.beginMoof = presentationTimesBeginMoof;
+    visitor.run = presentationTimesRun;
+    visitor.endMoof = presentationTimesEndMoof;
+    BAILIFERR(walkFragmentSamples(mir, &visitor, 1));
+
+    for (long i = 0; i < mir->numTIRs; i++)
+        if (mir->tirList[i].timelineOverflow)
+            errprint("Presentation times of track %d do not fit in 64 bits at timescale %u and were clamped, the timing checks of this track are unreliable\n", mir->tirList[i].trackID, mir->tirList[i].mediaTimeScale);
 
     initializeLeafInfo(mir, vg.segmentInfoSize - (vg.initializationSegment ? 1 : 0));
+
+bail:
+    return err;
 }
 
 void processSAP34(MovieInfoRec *mir) {
@@ -404,7 +841,7 @@ void processSAP34(MovieInfoRec *mir) {
 
                 for (UInt32 l = 0; l < moof->trafInfo[k].numSbgp; l++) {
                     for (UInt32 m = 0; m < moof->trafInfo[k].sbgpInfo[l].entry_count; m++)
-                        numSamples += moof->trafInfo[k].sbgpInfo[l].sample_count[m];
+                        numSamples += moof->trafInfo[k].sbgpInfo[l].entries[m].sample_count;
                 }
 
                 bool *sap3 = (bool *)malloc(sizeof (bool) * numSamples);
@@ -414,11 +851,11 @@ void processSAP34(MovieInfoRec *mir) {
 
                 for (UInt32 l = 0; l < moof->trafInfo[k].numSbgp; l++) {
                     for (UInt32 m = 0; m < moof->trafInfo[k].sbgpInfo[l].entry_count; m++) {
-                        for (UInt32 n = 0; n < moof->trafInfo[k].sbgpInfo[l].sample_count[m]; n++, sampleIndex++) {
+                        for (UInt32 n = 0; n < moof->trafInfo[k].sbgpInfo[l].entries[m].sample_count; n++, sampleIndex++) {
                             sap3[sampleIndex] = (moof->trafInfo[k].sbgpInfo[l].grouping_type == 'rap ');
 
                             if (moof->trafInfo[k].sbgpInfo[l].grouping_type == 'roll' && (tir->hdlrInfo->componentSubType == 'vide' || tir->hdlrInfo->componentSubType == 'soun')) {
-                                UInt32 sgpdIndex = getSgpdIndex(moof->trafInfo[k].sgpdInfo, moof->trafInfo[k].numSgpd, moof->trafInfo[k].sbgpInfo[l].grouping_type);
+                                UInt32 sgpdIndex = getSgpdIndex(&moof->trafInfo[k], moof->trafInfo[k].sbgpInfo[l].grouping_type);
                                 if (sgpdIndex == moof->trafInfo[k].numSgpd) {
                                     errprint("grouping_type %s in sbgp is not found for any sgpd in moof number %d\n", ostypetostr(moof->trafInfo[k].sbgpInfo[l].grouping_type), j + 1);
                                     continue;
@@ -428,7 +865,7 @@ void processSAP34(MovieInfoRec *mir) {
 
                                 AudioVisualRollRecoveryEntry *avRollRecoveryEntry;
 
-                                avRollRecoveryEntry = (AudioVisualRollRecoveryEntry *) sgpd->SampleGroupDescriptionEntry[moof->trafInfo[k].sbgpInfo[l].group_description_index[m]];
+                                avRollRecoveryEntry = (AudioVisualRollRecoveryEntry *) sgpd->SampleGroupDescriptionEntry[moof->trafInfo[k].sbgpInfo[l].entries[m].group_description_index];
 
                                 if (avRollRecoveryEntry->roll_distance > 0)
                                     sap4[sampleIndex] = true;
@@ -471,85 +908,215 @@ void verifyLeafDurations(MovieInfoRec *mir) {
             continue;
 
         for (UInt32 j = 0; j < tir->numLeafs; j++) {
-            long double diff = ABS((tir->leafInfo[j].presentationEndTime - tir->leafInfo[j].earliestPresentationTime) - tir->leafInfo[j].sidxReportedDuration);
+            LeafInfo *leaf = &tir->leafInfo[j];
+            MediaTime leafDuration = MediaTimeMake(leaf->presentationEndTime.value, tir->mediaTimeScale);
 
-            if (!tir->leafInfo[j].hasFragments)
+            if (!leaf->hasFragments)
                 continue;
 
-            if (diff > (long double) 1.0 / (long double) tir->mediaTimeScale)
-                errprint("Referenced track duration %Lf of track %d does not match to subsegment_duration %Lf for leaf with EPT %Lf, difference %Le, threshold %Le (Leaf count %d)\n", (tir->leafInfo[j].presentationEndTime - tir->leafInfo[j].earliestPresentationTime), tir->trackID, tir->leafInfo[j].sidxReportedDuration, tir->leafInfo[j].earliestPresentationTime, diff, (long double) 1.0 / (long double) tir->mediaTimeScale, j + 1);
+            MediaTimeAdd(&leafDuration.value, -leaf->earliestPresentationTime.value);
+
+            if (MediaTimeApart(leafDuration, leaf->sidxReportedDuration, tir->mediaTimeScale)) {
+                long double diff = ABS(MediaTimeSeconds(leafDuration) - MediaTimeSeconds(leaf->sidxReportedDuration));
+                errprint("Referenced track duration %Lf of track %d does not match to subsegment_duration %Lf for leaf with EPT %Lf, difference %Le, threshold %Le (Leaf count %d)\n", MediaTimeSeconds(leafDuration), tir->trackID, MediaTimeSeconds(leaf->sidxReportedDuration), MediaTimeSeconds(leaf->earliestPresentationTime), diff, (long double) 1.0 / (long double) tir->mediaTimeScale, j + 1);
+            }
         }
     }
 }
 
-void checkNonIndexedSamples(MovieInfoRec *mir) {
-    UInt32 accessUnitDuration = 0;
-    bool indexedTrackFound = false;  //if there is any indexed track
-    bool nonIndexTrackFound = false;
-    
+void verifyAlignment(MovieInfoRec *mir) {
+    if (vg.checkSegAlignment == false && vg.checkSubSegAlignment == false)
+        return;
+
+    if (vg.numControlTracks != (unsigned int) mir->numTIRs) {
+        errprint("Number of tracks logged %d in alignment control file not equal to the number of indexed tracks %ld for this representation\n", vg.numControlTracks, mir->numTIRs);
+        return;
+    }
+
     for (int i = 0; i < mir->numTIRs; i++) {
         TrackInfoRec *tir = &(mir->tirList[i]);
 
-        if (tir->leafInfo[0].segmentIndexed) {
-            indexedTrackFound = true;
-            break;
+        if (vg.numControlLeafs[i] != tir->numLeafs) {
+            errprint("Number of leafs %d in alignment control file for track %d not equal to the number of leafs %d for this representation\n", vg.numControlLeafs[i], tir->trackID, tir->numLeafs);
+            continue;
         }
+
+        for (UInt32 j = 0; j < (tir->numLeafs - 1); j++) {
+            if (vg.checkSubSegAlignment || (vg.checkSegAlignment && vg.controlLeafInfo[i][j + 1].firstInSegment > 0))
+                if (MediaTimeCompare(vg.controlLeafInfo[i][j + 1].earliestPresentationTime, tir->leafInfo[j].lastPresentationTime) <= 0) {
+                    if (vg.controlLeafInfo[i][j + 1].firstInSegment > 0)
+                        errprint("Overlapping segment: EPT of control leaf %Lf for leaf number %d is <= the latest presentation time %Lf corresponding leaf\n", MediaTimeSeconds(vg.controlLeafInfo[i][j + 1].earliestPresentationTime), j + 1, MediaTimeSeconds(tir->leafInfo[j].lastPresentationTime));
+                    else
+                        errprint("Overlapping subsegment: EPT of control leaf %Lf for leaf number %d is <= the latest presentation time %Lf corresponding leaf\n", MediaTimeSeconds(vg.controlLeafInfo[i][j + 1].earliestPresentationTime), j + 1, MediaTimeSeconds(tir->leafInfo[j].lastPresentationTime));
+                }
+        }
+
     }
+}
+
+void verifyBSS(MovieInfoRec *mir) {
+    if (!vg.bss)
+        return;
+
+    if (mir->numTIRs != (long) vg.numControlTracks)
+        errprint("Number of tracks %ld is not equal to number of tracks (%d) in control info, bitstream switching is not possible.", mir->numTIRs, vg.numControlTracks);
 
     for (int i = 0; i < mir->numTIRs; i++) {
         TrackInfoRec *tir = &(mir->tirList[i]);
 
-//            if (tir->leafInfo[0].segmentIndexed)
-//                continue; //An indexed stream
-        bool currentTrackIndexed = tir->leafInfo[0].segmentIndexed;
-        if(!currentTrackIndexed)
-            nonIndexTrackFound = true;
+        bool correspondingTrackFound = 0;
 
-        bool reportInequalDuration = true;
-        bool reportInequalControlDuration = true;
-        UInt64 nonSyncSamples = 0;
-        UInt64 syncSamples = 0;
+        for (unsigned int j = 0; j < vg.numControlTracks; j++) {
+            if (vg.trackTypeInfo[j].track_ID == tir->trackID && vg.trackTypeInfo[j].componentSubType == tir->hdlrInfo->componentSubType) {
+                correspondingTrackFound = true;
+                break;
+            }
+        }
 
-        for (UInt32 j = 0; j < mir->numFragments; j++) {
-            MoofInfoRec *moof = &mir->moofInfo[j];
+        if (!correspondingTrackFound)
+            errprint("No corresponding track found in control info for track ID %u with type %s, bitstream switching is not possible: Section 7.3.3.2. of ISO/IEC 23009-1:2012(E): The track IDs for the same media content component are identical for each Representation in each Adaptation Set", tir->trackID, ostypetostr(tir->hdlrInfo->componentSubType));
+    }
 
-            for (UInt32 k = 0; k < moof->numTrackFragments; k++) {
-                if (moof->trafInfo[k].track_ID == tir->trackID && moof->trafInfo[k].numTrun > 0) //Assuming 'trun' cannot be empty, 14496-12 version 4 does not indicate such a possiblity.
-                {
-                    for (UInt32 l = 0; l < moof->trafInfo[k].numTrun; l++) {
-                        for (UInt32 m = 0; m < moof->trafInfo[k].trunInfo[l].sample_count; m++) {
-                            bool sample_is_non_sync_sample = ((moof->trafInfo[k].trunInfo[l].sample_flags[m] & 0x10000) >> 16) != 0;
-                            bool sample_is_SAP = !sample_is_non_sync_sample || moof->trafInfo[k].trunInfo[l].sap3[m] || moof->trafInfo[k].trunInfo[l].sap4[m];
+}
 
-                            if (sample_is_SAP)
-                                syncSamples++;
-                            else
-                                nonSyncSamples++;
+//==========================================================================================
 
-                            if (accessUnitDuration == 0)
-                                accessUnitDuration = moof->trafInfo[k].trunInfo[l].sample_duration[m];
+// Section 5.3.3.2. of ISO/IEC 23009-1: @startWithSAP, checked on the first sample of each segment
+typedef struct {
+    UInt32 trackID;
+    int segment;
+    int sapType;
+} StartWithSAPFinding;
 
-                            if (!currentTrackIndexed && indexedTrackFound && reportInequalDuration && moof->trafInfo[k].trunInfo[l].sample_duration[m] != accessUnitDuration) {
-                                errprint("Sample duration (%lu) of at least one sample of a non-index track (%d) is inequal to a previously reported duration (%lu), violating Section 7.2.2. of ISO/IEC 23009-1:2012(E): non-indexed media streams in all Representations of an Adaptation Set shall have the same access unit duration\n", moof->trafInfo[k].trunInfo[l].sample_duration[m], mir->tirList[i].trackID, accessUnitDuration);
-                                reportInequalDuration = false;
-                            }
+typedef struct {
+    bool segmentStarted;
+    int segmentCount;
+    UInt32 numFindings;
+    StartWithSAPFinding *findings;
+} StartWithSAPState;
 
-                            if (!currentTrackIndexed && indexedTrackFound && vg.accessUnitDurationNonIndexedTrack != 0 && reportInequalControlDuration && moof->trafInfo[k].trunInfo[l].sample_duration[m] != vg.accessUnitDurationNonIndexedTrack) {
-                                errprint("Control sample duration %lu is inequal to the sample duration of this stream (%lu) for non-indexed track (%d), violating Section 7.2.2. of ISO/IEC 23009-1:2012(E): non-indexed media streams in all Representations of an Adaptation Set shall have the same access unit duration\n", vg.accessUnitDurationNonIndexedTrack, moof->trafInfo[k].trunInfo[l].sample_duration[m], mir->tirList[i].trackID);
-                                reportInequalControlDuration = false;
-                            }
-                        }
-                    }
-                }
-            }
+static void startWithSAPBeginTrack(FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor) {
+#pragma unused(cursor)
+    StartWithSAPState *state = (StartWithSAPState *) visitor->state;
+
+    state->segmentStarted = false;
+    state->segmentCount = 0;
+}
+
+static void startWithSAPBeginMoof(FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor) {
+    StartWithSAPState *state = (StartWithSAPState *) visitor->state;
+
+    if (cursor->moof->firstFragmentInSegment) {
+        state->segmentStarted = true;
+        state->segmentCount++;
+    }
+}
+
+static void startWithSAPRun(FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor) {
+    StartWithSAPState *state = (StartWithSAPState *) visitor->state;
+
+    // only the first sample after a segment start is looked at
+    if (state->segmentStarted) {
+        if (cursor->sapType[0] > vg.startWithSAP) {
+            StartWithSAPFinding *finding = &state->findings[state->numFindings++];
+
+            finding->trackID = cursor->tir->trackID;
+            finding->segment = state->segmentCount;
+            finding->sapType = cursor->sapType[0];
         }
+        cursor->moof->announcedSAP = true;
+    }
+    state->segmentStarted = false;
+}
+
+static void startWithSAPReport(FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor) {
+#pragma unused(cursor)
+    StartWithSAPState *state = (StartWithSAPState *) visitor->state;
+
+    for (UInt32 i = 0; i < state->numFindings; i++) {
+        StartWithSAPFinding *finding = &state->findings[i];
 
-        if (!currentTrackIndexed && indexedTrackFound && nonSyncSamples > 0)
-            errprint("%lld non-sync samples found out of total %lld samples, for non-indexed track %d, violating Section 6.2.3.2. of ISO/IEC 23009-1:2012(E): every access unit of the non-indexed streams shall be a SAP of type 1.\n", nonSyncSamples, nonSyncSamples + syncSamples, mir->tirList[i].trackID);
+        if (finding->sapType == 7)
+            errprint("MPD startWithSAP %d, no known SAP type found for track ID %d for segement %d\n", vg.startWithSAP, finding->trackID, finding->segment);
+        else
+            errprint("MPD startWithSAP %d, while SAP type found %d (> @startWithSAP) for track ID %d for segement %d\n", vg.startWithSAP, finding->sapType, finding->trackID, finding->segment);
     }
+}
+
+// Section 6.2.3.2. and 7.2.2. of ISO/IEC 23009-1:2012(E): the access units of the non-indexed streams
+typedef struct {
+    bool indexed;
+    bool inequalDurationFound;
+    bool inequalControlDurationFound;
+    UInt64 inequalDurationSample;
+    UInt64 inequalControlDurationSample;
+    UInt32 inequalDuration;
+    UInt32 inequalAccessUnitDuration;
+    UInt32 inequalControlDuration;
+    UInt64 nonSyncSamples;
+    UInt64 syncSamples;
+} NonIndexedTrackFindings;
+
+typedef struct {
+    UInt32 accessUnitDuration;
+    bool indexedTrackFound;  //if there is any indexed track
+    bool nonIndexTrackFound;
+    NonIndexedTrackFindings *tracks;
+} NonIndexedSamplesState;
+
+static void nonIndexedSamplesBeginTrack(FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor) {
+    NonIndexedSamplesState *state = (NonIndexedSamplesState *) visitor->state;
+    NonIndexedTrackFindings *track = &state->tracks[cursor->trackIndex];
+
+    memset(track, 0, sizeof (NonIndexedTrackFindings));
+    track->indexed = cursor->tir->leafInfo[0].segmentIndexed;
+    if (!track->indexed)
+        state->nonIndexTrackFound = true;
+}
+
+static void nonIndexedSamplesRun(FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor) {
+    NonIndexedSamplesState *state = (NonIndexedSamplesState *) visitor->state;
+    NonIndexedTrackFindings *track = &state->tracks[cursor->trackIndex];
+    TrunInfoRec *trun = cursor->trun;
+    UInt64 syncSamples = 0;
+
+    for (UInt32 m = 0; m < trun->sample_count; m++)
+        syncSamples += cursor->sapType[m] != 7;
+
+    track->syncSamples += syncSamples;
+    track->nonSyncSamples += trun->sample_count - syncSamples;
 
-    vg.accessUnitDurationNonIndexedTrack = nonIndexTrackFound ? accessUnitDuration : 0; //To store for this represntation in file
+    for (UInt32 m = 0; m < trun->sample_count; m++) {
+        UInt32 sample_duration = trun->sample_duration[m];
 
+        if (state->accessUnitDuration == 0)
+            state->accessUnitDuration = sample_duration;
+
+        if (track->indexed || !state->indexedTrackFound) {
+            if (state->accessUnitDuration != 0)
+                break;
+            continue;
+        }
+
+        if (!track->inequalDurationFound && sample_duration != state->accessUnitDuration) {
+            track->inequalDurationFound = true;
+            track->inequalDurationSample = cursor->firstSample + m;
+            track->inequalDuration = sample_duration;
+            track->inequalAccessUnitDuration = state->accessUnitDuration;
+        }
+
+        if (vg.accessUnitDurationNonIndexedTrack != 0 && !track->inequalControlDurationFound && sample_duration != vg.accessUnitDurationNonIndexedTrack) {
+            track->inequalControlDurationFound = true;
+            track->inequalControlDurationSample = cursor->firstSample + m;
+            track->inequalControlDuration = sample_duration;
+        }
+
+        if (track->inequalDurationFound && (track->inequalControlDurationFound || vg.accessUnitDurationNonIndexedTrack == 0))
+            break;  // nothing more to find in this track
+    }
+}
+
+static void checkNonIndexedLeafSamples(MovieInfoRec *mir) {
     for (int i = 0; i < mir->numTIRs; i++) {
         TrackInfoRec *tir = &(mir->tirList[i]);
 
@@ -565,21 +1132,20 @@ void checkNonIndexedSamples(MovieInfoRec *mir) {
 
                         UInt32 samplesWithLessPresentationTime = 0;
 
-                        for (UInt32 l = leaf->firstMoofIndex; l <= leaf->lastMoofIndex; l++)//Process all moofs in leaf till find a sample of non indexed stream with EPT
+                        for (UInt32 f = TrackFragmentsFind(nonIndexedTir, leaf->firstMoofIndex); f < nonIndexedTir->numTrackFragments && nonIndexedTir->trackFragments[f].moofIndex <= leaf->lastMoofIndex; f++)//Process the non indexed stream's trafs in all moofs of the leaf
                         {
-                            MoofInfoRec *moof = &mir->moofInfo[l];
+                            MoofInfoRec *moof = &mir->moofInfo[nonIndexedTir->trackFragments[f].moofIndex];
+                            UInt32 m = nonIndexedTir->trackFragments[f].trafIndex;
 
-                            for (UInt32 m = 0; m < moof->numTrackFragments; m++) {
-                                if (moof->trafInfo[m].track_ID == nonIndexedTir->trackID && moof->trafInfo[m].numTrun > 0) //Assuming 'trun' cannot be empty, 14496-12 version 4 does not indicate such a possiblity.
-                                {
-                                    for (UInt32 n = 0; n < moof->trafInfo[m].numTrun; n++) {
-                                        for (UInt32 o = 0; o < moof->trafInfo[m].trunInfo[n].sample_count; o++) {
-                                            long double samplePresentationTime = moof->trafInfo[m].trunInfo[n].samplePresentationTime[o];
+                            if (moof->trafInfo[m].numTrun > 0) //Assuming 'trun' cannot be empty, 14496-12 version 4 does not indicate such a possiblity.
+                            {
+                                for (UInt32 n = 0; n < moof->trafInfo[m].numTrun; n++) {
+                                    for (UInt32 o = 0; o < moof->trafInfo[m].trunInfo[n].sample_count; o++) {
+                                        MediaTime samplePresentationTime = MediaTimeMake(moof->trafInfo[m].trunInfo[n].samplePresentationTime[o], nonIndexedTir->mediaTimeScale);
 
-                                            if (samplePresentationTime <= leaf->earliestPresentationTime)
-                                                samplesWithLessPresentationTime++;
+                                        if (MediaTimeCompare(samplePresentationTime, leaf->earliestPresentationTime) <= 0)
+                                            samplesWithLessPresentationTime++;
 
-                                        }
                                     }
                                 }
                             }
@@ -588,7 +1154,7 @@ void checkNonIndexedSamples(MovieInfoRec *mir) {
 
                         if (samplesWithLessPresentationTime != 1)
                             errprint("%d samples of the non-indexed track %d with composition time <= the indexed track %d with EPT %LF found, violating Section 6.3.4.3. of ISO/IEC 23009-1:2012(E): for each Subsegment, every non-indexed stream must contain exactly one access unit within the Subsegment with presentation time less than or equal to the earliest presentation time of the Subsegment\n",
-                                samplesWithLessPresentationTime, nonIndexedTir->trackID, tir->trackID, leaf->earliestPresentationTime);
+                                samplesWithLessPresentationTime, nonIndexedTir->trackID, tir->trackID, MediaTimeSeconds(leaf->earliestPresentationTime));
 
                     }
 
@@ -597,97 +1163,83 @@ void checkNonIndexedSamples(MovieInfoRec *mir) {
 
 
     }
-
 }
 
-void verifyAlignment(MovieInfoRec *mir) {
-    if (vg.checkSegAlignment == false && vg.checkSubSegAlignment == false)
-        return;
-
-    if (vg.numControlTracks != (unsigned int) mir->numTIRs) {
-        errprint("Number of tracks logged %d in alignment control file not equal to the number of indexed tracks %d for this representation\n", vg.numControlTracks, mir->numTIRs);
-        return;
-    }
+static void nonIndexedSamplesReport(FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor) {
+    NonIndexedSamplesState *state = (NonIndexedSamplesState *) visitor->state;
+    MovieInfoRec *mir = cursor->mir;
 
     for (int i = 0; i < mir->numTIRs; i++) {
-        TrackInfoRec *tir = &(mir->tirList[i]);
-
-        if (vg.numControlLeafs[i] != tir->numLeafs) {
-            errprint("Number of leafs %d in alignment control file for track %d not equal to the number of leafs %d for this representation\n", vg.numControlLeafs[i], tir->trackID, tir->numLeafs);
-            continue;
-        }
-
-        for (UInt32 j = 0; j < (tir->numLeafs - 1); j++) {
-            if (vg.checkSubSegAlignment || (vg.checkSegAlignment && vg.controlLeafInfo[i][j + 1].firstInSegment > 0))
-                if (vg.controlLeafInfo[i][j + 1].earliestPresentationTime <= tir->leafInfo[j].lastPresentationTime) {
-                    if (vg.controlLeafInfo[i][j + 1].firstInSegment > 0)
-                        errprint("Overlapping segment: EPT of control leaf %Lf for leaf number %d is <= the latest presentation time %Lf corresponding leaf\n", vg.controlLeafInfo[i][j + 1].earliestPresentationTime, j + 1, tir->leafInfo[j].lastPresentationTime);
-                    else
-                        errprint("Overlapping subsegment: EPT of control leaf %Lf for leaf number %d is <= the latest presentation time %Lf corresponding leaf\n", vg.controlLeafInfo[i][j + 1].earliestPresentationTime, j + 1, tir->leafInfo[j].lastPresentationTime);
-                }
-        }
+        NonIndexedTrackFindings *track = &state->tracks[i];
+        bool controlFirst = track->inequalControlDurationFound && (!track->inequalDurationFound || track->inequalControlDurationSample < track->inequalDurationSample);
 
-    }
-}
+        if (controlFirst)
+            errprint("Control sample duration %u is inequal to the sample duration of this stream (%u) for non-indexed track (%d), violating Section 7.2.2. of ISO/IEC 23009-1:2012(E): non-indexed media streams in all Representations of an Adaptation Set shall have the same access unit duration\n", vg.accessUnitDurationNonIndexedTrack, track->inequalControlDuration, mir->tirList[i].trackID);
 
-void verifyBSS(MovieInfoRec *mir) {
-    if (!vg.bss)
-        return;
+        if (track->inequalDurationFound)
+            errprint("Sample duration (%u) of at least one sample of a non-index track (%d) is inequal to a previously reported duration (%u), violating Section 7.2.2. of ISO/IEC 23009-1:2012(E): non-indexed media streams in all Representations of an Adaptation Set shall have the same access unit duration\n", track->inequalDuration, mir->tirList[i].trackID, track->inequalAccessUnitDuration);
 
-    if (mir->numTIRs != (long) vg.numControlTracks)
-        errprint("Number of tracks %d is not equal to number of tracks (%d) in control info, bitstream switching is not possible.", mir->numTIRs, vg.numControlTracks);
+        if (track->inequalControlDurationFound && !controlFirst)
+            errprint("Control sample duration %u is inequal to the sample duration of this stream (%u) for non-indexed track (%d), violating Section 7.2.2. of ISO/IEC 23009-1:2012(E): non-indexed media streams in all Representations of an Adaptation Set shall have the same access unit duration\n", vg.accessUnitDurationNonIndexedTrack, track->inequalControlDuration, mir->tirList[i].trackID);
 
-    for (int i = 0; i < mir->numTIRs; i++) {
-        TrackInfoRec *tir = &(mir->tirList[i]);
+        if (!track->indexed && state->indexedTrackFound && track->nonSyncSamples > 0)
+            errprint("%lld non-sync samples found out of total %lld samples, for non-indexed track %d, violating Section 6.2.3.2. of ISO/IEC 23009-1:2012(E): every access unit of the non-indexed streams shall be a SAP of type 1.\n", track->nonSyncSamples, track->nonSyncSamples + track->syncSamples, mir->tirList[i].trackID);
+    }
 
-        bool correspondingTrackFound = 0;
+    vg.accessUnitDurationNonIndexedTrack = state->nonIndexTrackFound ? state->accessUnitDuration : 0; //To store for this represntation in file
 
-        for (unsigned int j = 0; j < vg.numControlTracks; j++) {
-            if (vg.trackTypeInfo[j].track_ID == tir->trackID && vg.trackTypeInfo[j].componentSubType == tir->hdlrInfo->componentSubType) {
-                correspondingTrackFound = true;
-                break;
-            }
-        }
+    checkNonIndexedLeafSamples(mir);
+}
 
-        if (!correspondingTrackFound)
-            errprint("No corresponding track found in control info for track ID %lu with type %s, bitstream switching is not possible: Section 7.3.3.2. of ISO/IEC 23009-1:2012(E): The track IDs for the same media content component are identical for each Representation in each Adaptation Set", tir->trackID, ostypetostr(tir->hdlrInfo->componentSubType));
+// The per-sample checks of the indexing information, in the one pass
+OSErr checkFragmentSamples(MovieInfoRec *mir) {
+    OSErr err = noErr;
+    StartWithSAPState startWithSAP;
+    NonIndexedSamplesState nonIndexedSamples;
+    FragmentSampleVisitor visitors[2];
+    int numVisitors = 0;
+
+    if (vg.startWithSAP > 0) {
+        UInt32 segmentStarts = 0;
+
+        // at most one finding per segment start per track
+        for (UInt32 j = 0; j < mir->numFragments; j++)
+            if (mir->moofInfo[j].firstFragmentInSegment)
+                segmentStarts++;
+
+        memset(&startWithSAP, 0, sizeof (startWithSAP));
+        if (segmentStarts > 0 && mir->numTIRs > 0)
+            BAILIFNIL(startWithSAP.findings = (StartWithSAPFinding *) ArenaAlloc(&vg.arena, (UInt64) segmentStarts * mir->numTIRs * sizeof (StartWithSAPFinding)), allocFailedErr);
+
+        initFragmentSampleVisitor(&visitors[numVisitors], "startWithSAP", &startWithSAP);
+        visitors[numVisitors].needs = kFragmentSampleSAPType;
+        visitors[numVisitors].beginTrack = startWithSAPBeginTrack;
+        visitors[numVisitors].beginMoof = startWithSAPBeginMoof;
+        visitors[numVisitors].run = startWithSAPRun;
+        visitors[numVisitors].report = startWithSAPReport;
+        numVisitors++;
     }
 
-}
-
-void checkSegmentStartWithSAP(int startWithSAP, MovieInfoRec *mir) {
-    for (long i = 0; i < mir->numTIRs; i++) {
-        bool segmentStarted = false;
-        int segmentCount = 0;
+    memset(&nonIndexedSamples, 0, sizeof (nonIndexedSamples));
+    for (int i = 0; i < mir->numTIRs; i++)
+        if (mir->tirList[i].leafInfo[0].segmentIndexed) {
+            nonIndexedSamples.indexedTrackFound = true;
+            break;
+        }
+    if (mir->numTIRs > 0)
+        BAILIFNIL(nonIndexedSamples.tracks = (NonIndexedTrackFindings *) ArenaAlloc(&vg.arena, mir->numTIRs * sizeof (NonIndexedTrackFindings)), allocFailedErr);
 
-        for (UInt32 j = 0; j < mir->numFragments; j++) {
-            if (mir->moofInfo[j].firstFragmentInSegment) {
-                segmentStarted = true;
-                segmentCount++;
-            }
+    initFragmentSampleVisitor(&visitors[numVisitors], "non-indexed samples", &nonIndexedSamples);
+    visitors[numVisitors].needs = kFragmentSampleSAPType;
+    visitors[numVisitors].beginTrack = nonIndexedSamplesBeginTrack;
+    visitors[numVisitors].run = nonIndexedSamplesRun;
+    visitors[numVisitors].report = nonIndexedSamplesReport;
+    numVisitors++;
 
-            for (UInt32 k = 0; k < mir->moofInfo[j].numTrackFragments; k++) {
-                if (mir->moofInfo[j].trafInfo[k].track_ID != mir->tirList[i].trackID)
-                    continue;
+    BAILIFERR(walkFragmentSamples(mir, visitors, numVisitors));
 
-                for (UInt32 l = 0; l < mir->moofInfo[j].trafInfo[k].numTrun; l++)
-                    for (UInt32 m = 0; m < mir->moofInfo[j].trafInfo[k].trunInfo[l].sample_count; m++) {
-                        if (segmentStarted) {
-                            bool sample_is_non_sync_sample = ((mir->moofInfo[j].trafInfo[k].trunInfo[l].sample_flags[m] & 0x10000) >> 16) != 0;
-                            int smallestSAPType = !sample_is_non_sync_sample ? 1 : mir->moofInfo[j].trafInfo[k].trunInfo[l].sap3[m] ? 3 : mir->moofInfo[j].trafInfo[k].trunInfo[l].sap4[m] ? 4 : 7;
-                            if (smallestSAPType > startWithSAP) {
-                                if (smallestSAPType == 7)
-                                    errprint("MPD startWithSAP %d, no known SAP type found for track ID %d for segement %d\n", startWithSAP, mir->tirList[i].trackID, segmentCount);
-                                else
-                                    errprint("MPD startWithSAP %d, while SAP type found %d (> @startWithSAP) for track ID %d for segement %d\n", startWithSAP, smallestSAPType, mir->tirList[i].trackID, segmentCount);
-                            }
-                            mir->moofInfo[j].announcedSAP = true;
-                        }
-                        segmentStarted = false;
-                    }
-            }
-        }
-    }
+bail:
+    return err;
 }
 
 OSErr processIndexingInfo(MovieInfoRec *mir) {
@@ -702,46 +1254,85 @@ OSErr processIndexingInfo(MovieInfoRec *mir) {
 
     int firstMediaSegment = vg.initializationSegment ? 1 : 0;
 
+    // segmentOffset only grows, so when the moofs (and each track's sidxs) are in offset order,
+    //   as they are in any well-formed file, cursors replace the scans from the start
+    bool moofsInOrder = true;
+
+    for (UInt32 j = 1; j < mir->numFragments; j++)
+        if (mir->moofInfo[j].offset < mir->moofInfo[j - 1].offset)
+            moofsInOrder = false;
+
     for (long trackIndex = 0; trackIndex < mir->numTIRs; trackIndex++) {
-        for (i = firstMediaSegment; i < (UInt32) vg.segmentInfoSize; i++) {
-            SidxInfoRec *firstSidxOfSegment = NULL;
+        UInt32 trackID = mir->tirList[trackIndex].trackID;
+        SidxInfoRec *firstSidxOfTrack = NULL;
+        bool sidxsInOrder = true;
+        UInt64 lastSidxOffset = 0;
+        UInt32 sidxCursor = 0;
+        UInt32 moofCursor = 0;
+
+        for (UInt32 j = 0; j < mir->numSidx; j++) {
+            if (mir->sidxInfo[j].reference_ID != trackID)
+                continue;
 
-            for (UInt32 j = 0; j < mir->numSidx; j++) {
-                SidxInfoRec *previousSidx = NULL;
+            if (firstSidxOfTrack == NULL) {
+                firstSidxOfTrack = &mir->sidxInfo[j];
+                sidxCursor = j + 1;
+            } else if (mir->sidxInfo[j].offset < lastSidxOffset)
+                sidxsInOrder = false;
+            lastSidxOffset = mir->sidxInfo[j].offset;
+        }
 
-                if (mir->sidxInfo[j].reference_ID != mir->tirList[trackIndex].trackID)
-                    continue;
+        for (i = firstMediaSegment; i < (UInt32) vg.segmentInfoSize; i++) {
+            SidxInfoRec *firstSidxOfSegment = NULL;
 
-                for (int k = (j - 1); k >= 0; k--)
-                    if (mir->sidxInfo[j].reference_ID == mir->sidxInfo[k].reference_ID) {
-                        previousSidx = &mir->sidxInfo[k];
+            // the track's first sidx if it is in this segment or later, otherwise the first later sidx of the track
+            //   at or beyond segmentOffset
+            if (firstSidxOfTrack == NULL)
+                ;
+            else if (firstSidxOfTrack->offset >= segmentOffset)
+                firstSidxOfSegment = firstSidxOfTrack;
+            else {
+                UInt32 j = sidxsInOrder ? sidxCursor : (UInt32) (firstSidxOfTrack - mir->sidxInfo) + 1;
+
+                for (; j < mir->numSidx; j++)
+                    if (mir->sidxInfo[j].reference_ID == trackID && mir->sidxInfo[j].offset >= segmentOffset) {
+                        firstSidxOfSegment = &mir->sidxInfo[j];
+                        break;
                     }
-
-                if (mir->sidxInfo[j].offset >= segmentOffset && (previousSidx == NULL || previousSidx->offset < segmentOffset)) {
-                    firstSidxOfSegment = &mir->sidxInfo[j];
-                    break;
-                }
+                if (sidxsInOrder)
+                    sidxCursor = j;
             }
 
             //Non-indexed segment
             if (firstSidxOfSegment == NULL)
                 continue;
 
-            long double segmentDurationSec = 0;
+            MediaTime segmentDuration = MediaTimeMake(0, mir->tirList[trackIndex].mediaTimeScale);
+            UInt32 j = 0;
+
+            if (moofsInOrder) {
+                while (moofCursor < mir->numFragments && mir->moofInfo[moofCursor].offset < segmentOffset)
+                    moofCursor++;
+                j = moofCursor;
+            }
+
+            for (; j < mir->numFragments; j++) {
+                if (moofsInOrder && mir->moofInfo[j].offset >= firstSidxOfSegment->offset && mir->moofInfo[j].offset >= (segmentOffset + vg.segmentSizes[i]))
+                    break;
 
-            for (UInt32 j = 0; j < mir->numFragments; j++) {
                 if (mir->moofInfo[j].offset >= segmentOffset && mir->moofInfo[j].offset < firstSidxOfSegment->offset)
                     errprint("Section 6.3.4.3. of ISO/IEC 23009-1:2012(E): If 'sidx' is present in a Media Segment, the first 'sidx' box shall be placed before any 'moof' box. Violated for fragment number %d\n", j + 1);
 
                 if (mir->moofInfo[j].samplesToBePresented && mir->moofInfo[j].offset >= segmentOffset && mir->moofInfo[j].offset < (segmentOffset + vg.segmentSizes[i])) {
-                    segmentDurationSec += (mir->moofInfo[j].moofPresentationEndTimePerTrack[trackIndex] - mir->moofInfo[j].moofEarliestPresentationTimePerTrack[trackIndex]);
+                    MediaTimeAdd(&segmentDuration.value, mir->moofInfo[j].moofPresentationEndTimePerTrack[trackIndex]);
+                    MediaTimeAdd(&segmentDuration.value, -mir->moofInfo[j].moofEarliestPresentationTimePerTrack[trackIndex]);
                 }
             }
 
-            long double diff = ABS(segmentDurationSec - firstSidxOfSegment->cumulatedDuration);
-
-            if (diff > (long double) 1.0 / (long double) mir->tirList[trackIndex].mediaTimeScale)
-                errprint("Section 6.3.4.3. of ISO/IEC 23009-1:2012(E): If 'sidx' is present in a Media Segment, the first 'sidx' box ... shall document the entire Segment. Violated for Media Segment %d. Segment duration %Lf, Sidx documents %Lf for track %d, diff %Lf\n", i - firstMediaSegment + 1, segmentDurationSec, firstSidxOfSegment->cumulatedDuration, mir->tirList[trackIndex].trackID, diff);
+            if (MediaTimeApart(segmentDuration, firstSidxOfSegment->cumulatedDuration, mir->tirList[trackIndex].mediaTimeScale)) {
+                long double diff = ABS(MediaTimeSeconds(segmentDuration) - MediaTimeSeconds(firstSidxOfSegment->cumulatedDuration));
+                errprint("Section 6.3.4.3. of ISO/IEC 23009-1:2012(E): If 'sidx' is present in a Media Segment, the first 'sidx' box ... shall document the entire Segment. Violated for Media Segment %d. Segment duration %Lf, Sidx documents %Lf for track %d, diff %Lf\n", i - firstMediaSegment + 1, MediaTimeSeconds(segmentDuration), MediaTimeSeconds(firstSidxOfSegment->cumulatedDuration), mir->tirList[trackIndex].trackID, diff);
+            }
 
             segmentOffset += vg.segmentSizes[i];
         }
@@ -767,20 +1358,18 @@ OSErr processIndexingInfo(MovieInfoRec *mir) {
             MoofInfoRec *moof;
 
             if (mir->sidxInfo[i].references[j].reference_type == 1) {
-                sidx = getSidxByOffset(mir->sidxInfo, mir->numSidx, absoluteOffset);
+                sidx = getSidxByOffset(mir, absoluteOffset);
                 if (sidx == NULL)
                     errprint("Referenced sidx not found for sidx number %d at reference count %d: Offset %lld\n", i + 1, j, absoluteOffset);
 
                 if (mir->sidxInfo[i].reference_ID != sidx->reference_ID)
                     errprint("Referenced sidx reference_ID %d does not match to reference_ID %d for sidx number %d at reference count %d ; Section 8.16.3.3 of ISO/IEC 14496-12 4th edition: if this Segment Index box is referenced from a \"parent\" Segment Index box, the value of reference_ID shall be the same as the value of reference_ID of the \"parent\" Segment Index box\n", sidx->reference_ID, mir->sidxInfo[i].reference_ID, i + 1, j);
 
-                if ((double) referenceEPT / (double) mir->sidxInfo[i].timescale != (double) sidx->earliest_presentation_time / (double) sidx->timescale)
+                if (MediaTimeCompare(MediaTimeMake((SInt64) referenceEPT, mir->sidxInfo[i].timescale), MediaTimeMake((SInt64) sidx->earliest_presentation_time, sidx->timescale)) != 0)
                     errprint("Referenced sidx earliest_presentation_time %lf does not match to reference EPT %lf for sidx number %d at reference count %d\n", (double) sidx->earliest_presentation_time / (double) sidx->timescale, (double) referenceEPT / (double) mir->sidxInfo[i].timescale, i + 1, j);
 
-                long double diff = ABS((double) ((long double) mir->sidxInfo[i].references[j].subsegment_duration / (long double) mir->sidxInfo[i].timescale) - (double) sidx->cumulatedDuration);
-
-                if (diff > (long double) 1.0 / (long double) mir->tirList[trackIndex].mediaTimeScale)
-                    errprint("Referenced sidx duration %Lf does not match to subsegment_duration %Lf for sidx number %d at reference count %d\n", sidx->cumulatedDuration, ((long double) mir->sidxInfo[i].references[j].subsegment_duration / (long double) mir->sidxInfo[i].timescale), i + 1, j);
+                if (MediaTimeApart(MediaTimeMake(mir->sidxInfo[i].references[j].subsegment_duration, mir->sidxInfo[i].timescale), sidx->cumulatedDuration, mir->tirList[trackIndex].mediaTimeScale))
+                    errprint("Referenced sidx duration %Lf does not match to subsegment_duration %Lf for sidx number %d at reference count %d\n", MediaTimeSeconds(sidx->cumulatedDuration), ((long double) mir->sidxInfo[i].references[j].subsegment_duration / (long double) mir->sidxInfo[i].timescale), i + 1, j);
 
                 if (mir->sidxInfo[i].references[j].starts_with_SAP > 0)
                     for (int k = 0; k < sidx->reference_count; k++)
@@ -794,7 +1383,7 @@ OSErr processIndexingInfo(MovieInfoRec *mir) {
                             errprint("Referenced sidx subsegment %d has a SAP_type %d while the SAP_type of this reference (index %d of sidx %d) has a SAP_type %d, violating Section 8.16.3.3 of ISO/IEC 14496-12 4th edition:\n",
                                 k, sidx->references[k].SAP_type, j, i + 1, mir->sidxInfo[i].references[j].SAP_type);
             } else {
-                UInt32 moofIndex = getMoofIndexByOffset(mir->moofInfo, mir->numFragments, absoluteOffset);
+                UInt32 moofIndex = getMoofIndexByOffset(mir, absoluteOffset);
 
                 TrackInfoRec *tir = &(mir->tirList[trackIndex]);
 
@@ -816,10 +1405,10 @@ OSErr processIndexingInfo(MovieInfoRec *mir) {
                     continue;
                 }
 
-                long double leafEPT = moof->moofEarliestPresentationTimePerTrack[trackIndex];
+                MediaTime leafEPT = MediaTimeMake(moof->moofEarliestPresentationTimePerTrack[trackIndex], tir->mediaTimeScale);
 
-                if ((leafsProcessed > 0) && (leafEPT <= lastLeafEPT)) {
-                    warnprint("Warning: A referenced leaf has an EPT %Lf less than a previous (in decode order) leaf EPT %Lf, this is not handled yet! The following operation may be unreliable\n", leafEPT, lastLeafEPT);
+                if ((leafsProcessed > 0) && (MediaTimeCompare(leafEPT, MediaTimeMake((SInt64) lastLeafEPT, 1)) <= 0)) {
+                    warnprint("Warning: A referenced leaf has an EPT %Lf less than a previous (in decode order) leaf EPT %Lf, this is not handled yet! The following operation may be unreliable\n", MediaTimeSeconds(leafEPT), (long double)lastLeafEPT);
                     //lastLeafEPT = leafEPT;
                     //continue;
                 }
@@ -833,25 +1422,25 @@ OSErr processIndexingInfo(MovieInfoRec *mir) {
                 tir->leafInfo[leafsProcessed].firstMoofIndex = moof->index;
 
                 if (leafsProcessed > 0) {
-                    tir->leafInfo[leafsProcessed - 1].lastPresentationTime = mir->moofInfo[moofIndex - 1].moofLastPresentationTimePerTrack[trackIndex];
-                    tir->leafInfo[leafsProcessed - 1].presentationEndTime = mir->moofInfo[moofIndex - 1].moofPresentationEndTimePerTrack[trackIndex];
+                    tir->leafInfo[leafsProcessed - 1].lastPresentationTime = MediaTimeMake(mir->moofInfo[moofIndex - 1].moofLastPresentationTimePerTrack[trackIndex], tir->mediaTimeScale);
+                    tir->leafInfo[leafsProcessed - 1].presentationEndTime = MediaTimeMake(mir->moofInfo[moofIndex - 1].moofPresentationEndTimePerTrack[trackIndex], tir->mediaTimeScale);
                     tir->leafInfo[leafsProcessed - 1].lastMoofIndex = mir->moofInfo[moofIndex - 1].index;
                     tir->leafInfo[leafsProcessed - 1].offset = mir->moofInfo[moofIndex - 1].offset;
                 }
 
                 if (leafsProcessed == (tir->numLeafs - 1)) {
-                    tir->leafInfo[leafsProcessed].lastPresentationTime = mir->moofInfo[mir->numFragments - 1].moofLastPresentationTimePerTrack[trackIndex];
-                    tir->leafInfo[leafsProcessed].presentationEndTime = mir->moofInfo[mir->numFragments - 1].moofPresentationEndTimePerTrack[trackIndex];
+                    tir->leafInfo[leafsProcessed].lastPresentationTime = MediaTimeMake(mir->moofInfo[mir->numFragments - 1].moofLastPresentationTimePerTrack[trackIndex], tir->mediaTimeScale);
+                    tir->leafInfo[leafsProcessed].presentationEndTime = MediaTimeMake(mir->moofInfo[mir->numFragments - 1].moofPresentationEndTimePerTrack[trackIndex], tir->mediaTimeScale);
                     tir->leafInfo[leafsProcessed].lastMoofIndex = mir->moofInfo[mir->numFragments - 1].index;
                     tir->leafInfo[leafsProcessed].offset = mir->moofInfo[mir->numFragments - 1].offset;
                 }
 
                 tir->leafInfo[leafsProcessed].firstInSegment = leafsProcessed > 0 ? checkSegmentBoundry(mir->moofInfo[moofIndex - 1].offset, absoluteOffset) : true;
 
-                tir->leafInfo[leafsProcessed].sidxReportedDuration = (long double) (mir->sidxInfo[i].references[j].subsegment_duration) / (long double) (mir->sidxInfo[i].timescale);
+                tir->leafInfo[leafsProcessed].sidxReportedDuration = MediaTimeMake(mir->sidxInfo[i].references[j].subsegment_duration, mir->sidxInfo[i].timescale);
 
-                if ((long double) referenceEPT / (long double) mir->sidxInfo[i].timescale != leafEPT)
-                    errprint("Referenced moof earliest_presentation_time %Lf does not match to reference EPT %Lf for sidx number %d at reference count %d\n", leafEPT, (long double) referenceEPT / (long double) mir->sidxInfo[i].timescale, i + 1, j);
+                if (MediaTimeCompare(MediaTimeMake((SInt64) referenceEPT, mir->sidxInfo[i].timescale), leafEPT) != 0)
+                    errprint("Referenced moof earliest_presentation_time %Lf does not match to reference EPT %Lf for sidx number %d at reference count %d\n", MediaTimeSeconds(leafEPT), (long double) referenceEPT / (long double) mir->sidxInfo[i].timescale, i + 1, j);
 
                 if (mir->sidxInfo[i].references[j].SAP_type > 4) {
                     warnprint("Warning: Sidx %d, index %d: SAP_type %d: \"For SAPs of type 5 and 6, no specific signalling in the ISO base media file format is supported.\" The following operation may be unreliable\n", i + 1, j, mir->sidxInfo[i].references[j].SAP_type);
@@ -862,36 +1451,38 @@ OSErr processIndexingInfo(MovieInfoRec *mir) {
                     errprint("SAP type %d found for sidx %d, reference %d, violating Section 8.5.3. of ISO/IEC 23009-1:2012(E): At least one SAP of type 1 to 3, inclusive, shall be present for each track in each Subsegment\n", mir->sidxInfo[i].references[j].SAP_type, i + 1, j);
 
                 if (mir->sidxInfo[i].references[j].SAP_type > 0 || mir->sidxInfo[i].references[j].starts_with_SAP > 0) {
-                    long double SAP_time = (long double) (mir->sidxInfo[i].references[j].SAP_delta_time + referenceEPT) / (long double) mir->sidxInfo[i].timescale;
+                    MediaTime SAP_time = MediaTimeMake((SInt64) (mir->sidxInfo[i].references[j].SAP_delta_time + referenceEPT), mir->sidxInfo[i].timescale);
 
-                    long double samplePresentationTime;
+                    MediaTime samplePresentationTime;
                     bool SAPFound = false;
                     bool checkStartWithSAP = true;
 
-                    for (UInt32 k = 0; k < moof->numTrackFragments; k++)
-                        if (moof->trafInfo[k].track_ID == mir->sidxInfo[i].reference_ID && moof->trafInfo[k].numTrun > 0)//Assuming 'trun' cannot be empty, 14496-12 version 4 does not indicate such a possiblity.
+                    for (UInt32 f = TrackFragmentsFind(tir, moofIndex); f < tir->numTrackFragments && tir->trackFragments[f].moofIndex == moofIndex; f++) {
+                        UInt32 k = tir->trackFragments[f].trafIndex;
+
+                        if (moof->trafInfo[k].numTrun > 0)//Assuming 'trun' cannot be empty, 14496-12 version 4 does not indicate such a possiblity.
                         {
                             for (UInt32 l = 0; l < moof->trafInfo[k].numTrun; l++) {
                                 for (UInt32 m = 0; m < moof->trafInfo[k].trunInfo[l].sample_count; m++) {
-                                    samplePresentationTime = moof->trafInfo[k].trunInfo[l].samplePresentationTime[m];
+                                    samplePresentationTime = MediaTimeMake(moof->trafInfo[k].trunInfo[l].samplePresentationTime[m], tir->mediaTimeScale);
 
                                     bool sample_is_non_sync_sample = ((moof->trafInfo[k].trunInfo[l].sample_flags[m] & 0x10000) >> 16) != 0;
                                     UInt8 SAP_type = mir->sidxInfo[i].references[j].SAP_type;
                                     bool sample_is_SAP = mir->sidxInfo[i].references[j].SAP_type > 0 ? ((SAP_type == 1 || SAP_type == 2) && !sample_is_non_sync_sample) || (SAP_type == 3 && moof->trafInfo[k].trunInfo[l].sap3[m]) || (SAP_type == 4 && moof->trafInfo[k].trunInfo[l].sap4[m]) :
                                             !sample_is_non_sync_sample || moof->trafInfo[k].trunInfo[l].sap3[m] || moof->trafInfo[k].trunInfo[l].sap4[m]; //The latter case is with starts_with_SAP > 0 and unknown SAP type (0)
 
-                                    if (samplePresentationTime == SAP_time) {
+                                    if (MediaTimeCompare(samplePresentationTime, SAP_time) == 0) {
                                         if (!sample_is_SAP) {
                                             errprint("SAP_type %d specified but the corresponding sample is not a sync sample, for sidx number %d at reference count %d\n", (int) SAP_type, i + 1, j);
                                         }
 
                                         SAPFound = true;
                                         moof->announcedSAP = true;
-                                        //printf("SAP found with presentation time %Lf \n",samplePresentationTime);
+                                        //printf("SAP found with presentation time %Lf \n",MediaTimeSeconds(samplePresentationTime));
                                     }
 
-                                    if ((samplePresentationTime < SAP_time) && sample_is_SAP)
-                                        errprint("SAP found with presentation time %Lf lesser than the declared SAP time %Lf (SAP_delta_time %Lf), for sidx number %d at reference count %d; first SAP shall be signaled as per Section 8.16.3.3 of ISO/IEC 14496-12 4th edition\n", samplePresentationTime, SAP_time, (long double) (mir->sidxInfo[i].references[j].SAP_delta_time) / (long double) mir->sidxInfo[i].timescale, i + 1, j);
+                                    if ((MediaTimeCompare(samplePresentationTime, SAP_time) < 0) && sample_is_SAP)
+                                        errprint("SAP found with presentation time %Lf lesser than the declared SAP time %Lf (SAP_delta_time %Lf), for sidx number %d at reference count %d; first SAP shall be signaled as per Section 8.16.3.3 of ISO/IEC 14496-12 4th edition\n", MediaTimeSeconds(samplePresentationTime), MediaTimeSeconds(SAP_time), (long double) (mir->sidxInfo[i].references[j].SAP_delta_time) / (long double) mir->sidxInfo[i].timescale, i + 1, j);
 
                                     if (SAPFound == true)
                                         break;
@@ -909,13 +1500,14 @@ OSErr processIndexingInfo(MovieInfoRec *mir) {
                             if (SAPFound == true)
                                 break;
                         }
+                    }
 
                     if (SAPFound != true)
                         errprint("SAP not found at the expected presentation time for sidx number %d at reference count %d\n", i + 1, j);
 
                 }
 
-                lastLeafEPT = leafEPT;
+                lastLeafEPT = (UInt64) MediaTimeSeconds(leafEPT);
 
                 leafsProcessed++;
 
@@ -928,10 +1520,11 @@ OSErr processIndexingInfo(MovieInfoRec *mir) {
 
     }
 
-    if (vg.startWithSAP > 0)
-        checkSegmentStartWithSAP(vg.startWithSAP, mir);
+    OSErr err = checkFragmentSamples(mir);
+
+    if (err)
+        return err;
 
-    checkNonIndexedSamples(mir);
     verifyLeafDurations(mir);
     verifyAlignment(mir);
     verifyBSS(mir);
@@ -946,7 +1539,10 @@ void processBuffering(long cnt, atomOffsetEntry *list, MovieInfoRec *mir) {
     SInt64 offset;
     int rename_result;
     ofstream sample_data;
-    sample_data.open("sample_data.txt");
+    char *sampleDataPath = OutputFilePath("sample_data.txt");
+    if (sampleDataPath)
+        sample_data.open(sampleDataPath);
+    free(sampleDataPath);
     if (sample_data.is_open()) 
     {
         sample_data<<"<?xml version='1.0' encoding='utf-8'?>\n";
@@ -964,8 +1560,8 @@ void processBuffering(long cnt, atomOffsetEntry *list, MovieInfoRec *mir) {
         }
     }
     if (initSize == 0) {
-        errprint("Program could not find initialization information, exiting!!");
-        exit(-1);
+        errprint("Program could not find initialization information, buffering not checked!!");
+        return;
     }
 
         sample_data<<"<MPDInfo minBufferTime='"<<vg.minBufferTime<<"' bandwidth='"<<vg.bandwidth<<"' >\n";
@@ -974,17 +1570,21 @@ void processBuffering(long cnt, atomOffsetEntry *list, MovieInfoRec *mir) {
     for (int i = 0; i < mir->numTIRs; i++) 
     {
         bool trackNonConforming = false; 
-        long double currentBandwidth = (long double) vg.bandwidth; 
-        long double bandwidthIncrement = 100; 
+        UInt64 currentBandwidth = (UInt64) vg.bandwidth; 
+        UInt64 bandwidthIncrement = 100; 
         std::stringstream errStr;
 
         do {
             TrackInfoRec *tir = &(mir->tirList[i]);
-            long double bufferFullness = currentBandwidth * vg.minBufferTime; //bits (not Bytes) 
+            UInt32 timescale = tir->mediaTimeScale ? tir->mediaTimeScale : 1; //A zero mdhd timescale is reported with the mdhd
+            //The buffer holds bufferBits bits (not Bytes) and bufferRemainder / timescale of a bit; a sample of d ticks adds currentBandwidth * d / timescale bits
+            SInt64 minBufferTicks = (SInt64) (vg.minBufferTime * (long double) timescale); 
+            SInt64 bufferBits;
+            MediaTimeRescale(minBufferTicks, timescale, (UInt32) currentBandwidth, &bufferBits);
+            SInt64 bufferRemainder = (SInt64) ((UInt64) (minBufferTicks % timescale) * currentBandwidth % timescale);
+            const SInt64 bufferSizeBits = bufferBits, bufferSizeRemainder = bufferRemainder; //bandwidth * minBufferTime
+            UInt64 bitTicks;
             SInt64 lastOffset = initSize; 
-            SInt64 timeNowInTicks = (SInt64) (vg.minBufferTime * (long double) tir->mediaTimeScale); 
-            long double totalDataRemoved = 0; 
-            long double totalBitsAdded = 0; 
             trackNonConforming = false;
 
             for (UInt32 j = 0; j < mir->numFragments; j++) 
@@ -1000,10 +1600,10 @@ void processBuffering(long cnt, atomOffsetEntry *list, MovieInfoRec *mir) {
                     SAP = 0;
                 sample_data<<"<moof a='"<<SAP<<"'>\n";
                 
-                if (moof->announcedSAP && bufferFullness > currentBandwidth * vg.minBufferTime) //There is no buffer overflow for DASH buffer model, only case is on a SAP, as DASH spec. defines the requiremnt that the playback could be from any SAP and at the SAP, the buffer fullness is bandwidth*minBufferTime
+                if (moof->announcedSAP && (bufferBits > bufferSizeBits || (bufferBits == bufferSizeBits && bufferRemainder > bufferSizeRemainder))) //There is no buffer overflow for DASH buffer model, only case is on a SAP, as DASH spec. defines the requiremnt that the playback could be from any SAP and at the SAP, the buffer fullness is bandwidth*minBufferTime
                 {
-                    totalDataRemoved += ((bufferFullness - currentBandwidth * vg.minBufferTime) / 8.0); //The clipped data, for debug information
-                    bufferFullness = currentBandwidth * vg.minBufferTime;
+                    bufferBits = bufferSizeBits;
+                    bufferRemainder = bufferSizeRemainder;
                 }
 
                 for (UInt32 k = 0; k < moof->numTrackFragments; k++) 
@@ -1028,7 +1628,7 @@ void processBuffering(long cnt, atomOffsetEntry *list, MovieInfoRec *mir) {
                                 //bool sample_is_SAP = !sample_is_non_sync_sample || moof->trafInfo[k].trunInfo[l].sap3[m] || moof->trafInfo[k].trunInfo[l].sap4[m];
 
                                 offset += moof->trafInfo[k].trunInfo[l].sample_size[m];
-                                long double dataSizeToRemove = (long double) (offset - lastOffset);
+                                SInt64 dataSizeToRemove = offset - lastOffset;
                                 
                                 if(m == 0)
                                 {    
@@ -1040,39 +1640,25 @@ void processBuffering(long cnt, atomOffsetEntry *list, MovieInfoRec *mir) {
                                 else
                                     sample_data<<"<s z='"<<dataSizeToRemove<<"' d='"<<moof->trafInfo[k].trunInfo[l].sample_duration[m]<<"'/>\n";
                                 
-                                totalDataRemoved += dataSizeToRemove;
                                 lastOffset = offset;
-                                //fprintf(stderr,"Total bits removed: %Lf, Size to remove: %Lf, Buffer Fullness: %Lf, average input rate: %Lf, duration: %Lf, sample %d, run %d, track fragment %d, fragment %d, track id %d (sample absolute offset %lld, fragment absolute file offset %lld)\n",totalDataRemoved,dataSizeToRemove,bufferFullness/8.0,totalBitsAdded/(((long double)timeNowInTicks/(long double)tir->mediaTimeScale)-0),((long double)moof->trafInfo[k].trunInfo[l].sample_duration[m]/(long double)tir->mediaTimeScale),m+1,l+1,k+1,j+1,tir->trackID,offset - moof->trafInfo[k].trunInfo[l].sample_size[m] + initSize, moof->offset);
 
-
-
-                                if (dataSizeToRemove * 8 > bufferFullness) //Bufferfullness is in bits
+                                if (dataSizeToRemove * 8 > bufferBits) //Whole bits, the remainder is less than one
                                 {
                                     if (!trackNonConforming) {
-                                        if (currentBandwidth == (long double) vg.bandwidth)
+                                        if (currentBandwidth == (UInt64) vg.bandwidth)
                                             errStr << "Buffer underrun conformance error: first (and only one reported here) for sample " << m + 1 << " of run " << l + 1 << " of track fragment " << k + 1 << " of fragment " << j + 1 << " of track id " << tir->trackID << " (sample absolute file offset " << offset - moof->trafInfo[k].trunInfo[l].sample_size[m] + initSize << ", fragment absolute file offset " << moof->offset << ", bandwidth: " << (UInt64) currentBandwidth;
 
                                         trackNonConforming = true;
                                         //break;
                                     }
 
-                                    long double finalBufferFullness = bufferFullness - dataSizeToRemove * 8; //unused
-                                    long double targetBitrate = (long double) (8 * (offset - initSize)) / ((long double) timeNowInTicks / (long double) tir->mediaTimeScale); // unused //Direct bitrate calculation
-
-                                    //fprintf(stderr,"Recalculated: targetBitrate %Lf, byte offset %lld, time %lld: %Lf, total removed %Lf\n",targetBitrate,offset - initSize,timeNowInTicks,((long double)timeNowInTicks/(long double)tir->mediaTimeScale),totalDataRemoved,((long double)offset - initSize)-totalDataRemoved);
-
-                                    if (targetBitrate <= currentBandwidth) {
-                                        ; //fprintf(stderr,"Program error: unexpected: calculated target bitrate %Lf for this non-conforming track (with buffer under-run) is less than or equal to its actual bandwidth %Lf , exiting!\n",targetBitrate,currentBandwidth);
-                                        //exit(-1);
-                                    }
-
                                     //break;
                                 }
 
-                                bufferFullness -= (dataSizeToRemove * 8);
-                                bufferFullness += (currentBandwidth * ((long double) moof->trafInfo[k].trunInfo[l].sample_duration[m] / (long double) tir->mediaTimeScale));
-                                totalBitsAdded += (currentBandwidth * ((long double) moof->trafInfo[k].trunInfo[l].sample_duration[m] / (long double) tir->mediaTimeScale));
-                                timeNowInTicks += moof->trafInfo[k].trunInfo[l].sample_duration[m];
+                                bitTicks = currentBandwidth * moof->trafInfo[k].trunInfo[l].sample_duration[m] + (UInt64) bufferRemainder;
+                                MediaTimeAdd(&bufferBits, -dataSizeToRemove * 8);
+                                MediaTimeAdd(&bufferBits, (SInt64) (bitTicks / timescale));
+                                bufferRemainder = (SInt64) (bitTicks % timescale);
                             }
                             //if (trackNonConforming) break;
                             sample_data<<"</trun>\n";
@@ -1090,7 +1676,7 @@ void processBuffering(long cnt, atomOffsetEntry *list, MovieInfoRec *mir) {
             }
         } while (trackNonConforming && vg.suggestBandwidth);
 
-        if (trackNonConforming || (currentBandwidth != (long double) vg.bandwidth)) //Latter means vg.suggestBandwidth is set and new bw is calculated
+        if (trackNonConforming || (currentBandwidth != (UInt64) vg.bandwidth)) //Latter means vg.suggestBandwidth is set and new bw is calculated
         {
             if (vg.suggestBandwidth)
                 errStr << ", estimated bandwidth: " << (UInt64) currentBandwidth;
@@ -1112,38 +1698,25 @@ void processBuffering(long cnt, atomOffsetEntry *list, MovieInfoRec *mir) {
 void checkCMAFBoxOrder(long cnt, atomOffsetEntry *list, long segmentInfoSize, bool CMAFHeader, UInt64 *segmentSizes)
 {
     UInt64 offset = 0;
-    //In this function,all top level boxes like ftyp, moov , moof etc are checked for order. Other lower level boxes have separate functions.
-    bool ord_err=false;
-    char err_order[50];
-    err_order[0]={'\0'};
+    //In this function, the top level boxes like ftyp, moov , moof etc are checked. The order of the boxes in the header and
+    //inside the other boxes is checked by checkBoxOrder.
     
     if (CMAFHeader) {
         for (int i= 0; i < cnt; i++) {
             if (list[i].offset < segmentSizes[0]) {
-                if (i==0 && list[i].type != 'ftyp')
-                    ord_err=true;
-                else if (i==1 && list[i].type != 'moov') 
-                    ord_err=true;
-                else if(list[i].type == 'udta' || list[i].type == 'meta')
+                if(i > 1 && (list[i].type == 'udta' || list[i].type == 'meta'))
                     errprint("CMAF check violated: Section 7.5.2. \"If UserDataBox or MetaBoxes present, SHALL NOT occur at file level, i.e. they can only be contained in a box.\"");
                     
             }
-        }
-        if(ord_err){
-            strcat(err_order,ostypetostr(list[0].type));
-            for (int z= 1; z < cnt; z++){
-                if (list[z].offset < segmentSizes[0]) {
-                    strcat(err_order, "--");
-                    strcat(err_order,ostypetostr(list[z].type));
-                }
-            }
-                errprint("CMAF check violated (ordinality/nesting) : \"In CMAF Header, the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: ftyp--moov \", but order found is: %s \n", err_order);
         }
          offset += segmentSizes[0];
     }
     
+    int firstBox = 0;   // as in checkDASHBoxOrder
     for (int index = (CMAFHeader ? 1 : 0); index < segmentInfoSize; index++) {
-        for (int i = 0; i < cnt; i++) {
+        while (firstBox < cnt && list[firstBox].offset < offset)
+            firstBox++;
+        for (int i = firstBox; i < cnt; i++) {
             if (list[i].offset >= (offset + segmentSizes[index])) //Segment end
             {
                 break;
@@ -1158,7 +1731,7 @@ void checkCMAFBoxOrder(long cnt, atomOffsetEntry *list, long segmentInfoSize, bo
                 
                 
                 bool cmafFragmentInCMAFSegmentFound = false;
-                for (int j = i; list[j].offset < (offset + segmentSizes[index]); j++) {//For all boxes inside a Media Segment.
+                for (int j = i; (j < cnt) && (list[j].offset < (offset + segmentSizes[index])); j++) {//For all boxes inside a Media Segment.
                      if(list[j].type == 'emsg' && cmafFragmentInCMAFSegmentFound){
                          
                         errprint("CMAF check violated: Section 7.4.5, \"If 'emsg' is present, SHALL precede the first 'moof' in the CMAF Fragment \", in segment %d 'moof' found before 'emsg'\n", index);
@@ -1185,202 +1758,267 @@ void checkCMAFBoxOrder(long cnt, atomOffsetEntry *list, long segmentInfoSize, bo
     }
 }
 
-void checkCMAFBoxOrder_moov(long cnt,atomOffsetEntry *list)
-{
-    bool ord_err=false;
-    char err_order[50];
-    err_order[0]={'\0'};
-    //Check the order of boxes inside 'moov'.
-    for (int i= 0; i < cnt; i++) {
-        if (i==0 && list[i].type != 'mvhd')
-            ord_err=true;
-        else if(i==1 && list[i].type != 'trak')
-            ord_err=true;
-        else if(i==2 && list[i].type != 'mvex')
-           ord_err=true;
-        //pssh box at the end is an optional one and hence not checked.
-    }
-    if(ord_err){
-        strcat(err_order,ostypetostr(list[0].type));
-        for (int j= 1; j < cnt; j++){
-             strcat(err_order, "--");
-            strcat(err_order,ostypetostr(list[j].type));
-        }
-        errprint("CMAF check violated (ordinality/nesting) : \"In 'moov', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: mvhd--trak--mvex--pssh (opt) \", but order found is: %s \n", err_order);
-    }
-        
+//==========================================================================================
+
+// Box order rules. A pattern lists the boxes of a container in the order allowed, one term per box:
+//   a type or types separated by '/', followed by '?' when optional, '+' for one or more or '*' for
+//   any number; "..." takes whatever comes after. Running out of boxes is never a violation here,
+//   the boxes a container must have are checked where it is validated. Each pattern is compiled to a
+//   deterministic automaton over the types it names, so checking a container's boxes against all of
+//   the rules of the enabled profiles is one pass with a table lookup per box and rule. They are all
+//   compiled once, the first time any is needed, and only read after that (validations on other
+//   threads share them).
+//   Rules for the 'file' container order the boxes of the initialization segment.
+//   Only the CMAF order of Section 7.3.1 of ISO/IEC 23000-19 is written as rules so far. The DASH
+//   segment order (checkDASHBoxOrder) and the CMAF order of segments and fragments
+//   (checkCMAFBoxOrder) are still checked by their own code, as before. Another profile moves here
+//   with a kBoxOrder* bit, its rules below and a case in boxOrderProfileEnabled.
+enum {
+    kBoxOrderCMAF = 1 << 0
+};
+
+#define kBoxOrderMaxTerms   16
+#define kBoxOrderMaxTypes   15      // distinct types in a pattern, one more symbol stands for any other
+#define kBoxOrderMaxStates  32
+#define kBoxOrderMaxRules   4       // for one container
+
+typedef struct BoxOrderRule {
+    UInt32      profile;            // kBoxOrder*
+    OSType      container;
+    const char  *pattern;
+    const char  *allowed;           // as printed in the violation
+
+    // the automaton, filled in by compileBoxOrderRule
+    Boolean     usable;
+    UInt32      numTypes;
+    OSType      types[kBoxOrderMaxTypes];
+    UInt32      numStates;
+    SInt8       next[kBoxOrderMaxStates][kBoxOrderMaxTypes + 1];   // from state 0 on; -1 where the box is out of order
+} BoxOrderRule;
+
+static BoxOrderRule boxOrderRules[] = {
+    { kBoxOrderCMAF, 'file', "ftyp moov ...",
+        "In CMAF Header, the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: ftyp--moov " },
+    { kBoxOrderCMAF, 'moov', "mvhd trak mvex ...",
+        "In 'moov', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: mvhd--trak--mvex--pssh (opt) " },
+    { kBoxOrderCMAF, 'trak', "tkhd edts? mdia ...",
+        "In 'trak', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: tkhd--edts (opt)--mdia--udta (opt) " },
+    { kBoxOrderCMAF, 'mdia', "mdhd hdlr elng? minf ...",
+        "In 'mdia', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: mdhd--hdlr--elng (opt)--minf " },
+    { kBoxOrderCMAF, 'minf', "vmhd/smhd/sthd dinf stbl ...",
+        "In 'minf', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: vmhd/smhd/sthd--dinf--stbl " },
+    { kBoxOrderCMAF, 'stbl', "stsd stts stsc stsz/stz2 stco ...",
+        "In 'stbl', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: stsd--stts--stsc--stsz/stz2--stco--sgpd (opt)--stss (opt) " },
+    { kBoxOrderCMAF, 'sinf', "frma schm schi ...",
+        "In 'sinf', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: frma--schm--schi " },
+    { kBoxOrderCMAF, 'moof', "mfhd traf ...",
+        "In 'moof', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: mfhd--traf " },
+    { kBoxOrderCMAF, 'traf', "tfhd tfdt trun ...",
+        "In 'traf', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: tfhd--tfdt--trun--send (opt)--saio (opt)--saiz (opt)--sbgp (opt)--sgpd (opt)--subs (opt) " },
+};
+
+static Boolean boxOrderProfileEnabled(UInt32 profile) {
+    return (profile & kBoxOrderCMAF) && vg.cmaf;
 }
 
-void checkCMAFBoxOrder_trak(long cnt,atomOffsetEntry *list)
-{
-    int edts_flag=0;
-    bool ord_err=false;
-    char err_order[50];
-    err_order[0]={'\0'};
-    //Check the order of boxes inside 'trak'.
-    for (int i= 0; i < cnt; i++) {
-        if (i==0 && list[i].type != 'tkhd') 
-            ord_err=true;
-        else if(i==1 && list[i].type == 'edts')
-            edts_flag=1;
-                                            
-        if((i==1 && !edts_flag) ||  (i==2 && edts_flag)){
-           if(list[i].type != 'mdia')
-             ord_err=true;
-        }
-    }
-     if(ord_err){
-        strcat(err_order,ostypetostr(list[0].type));
-        for (int j= 1; j < cnt; j++){
-             strcat(err_order, "--");
-            strcat(err_order,ostypetostr(list[j].type));
-        }
-        errprint("CMAF check violated (ordinality/nesting) : \"In 'trak', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: tkhd--edts (opt)--mdia--udta (opt) \", but order found is: %s \n", err_order);
-    }
-    
+static const char *boxOrderProfileName(UInt32 profile) {
+#pragma unused(profile)
+    return "CMAF";
 }
 
-void checkCMAFBoxOrder_mdia(long cnt,atomOffsetEntry *list)
-{
-    int elng_flag=0;
-    bool ord_err=false;
-    char err_order[50];
-    err_order[0]={'\0'};
-    for (int i= 0; i < cnt; i++) {
-        if (i==0 && list[i].type != 'mdhd')
-           ord_err=true;
-        else if (i==1 && list[i].type != 'hdlr')
-            ord_err=true;
-        else if (i==2 && list[i].type != 'elng')
-            elng_flag=1;
-        
-        if((i==2 && !elng_flag) ||  (i==3 && elng_flag)){
-            if(list[i].type != 'minf')
-              ord_err=true;
+typedef struct {
+    UInt32 symbols;                 // bit per symbol of the rule the term takes
+    char quantifier;                // 0, '?', '+' or '*'
+} BoxOrderTerm;
+
+// The positions of the pattern that can be reached from those in positions without taking a box
+static UInt32 boxOrderClosure(BoxOrderTerm *terms, UInt32 numTerms, UInt32 positions) {
+    for (UInt32 t = 0; t < numTerms; t++)
+        if ((positions & (1 << t)) && (terms[t].quantifier == '?' || terms[t].quantifier == '*'))
+            positions |= 1 << (t + 1);
+    return positions;
+}
+
+static UInt32 boxOrderSymbol(BoxOrderRule *rule, OSType type) {
+    UInt32 symbol = 0;
+
+    while (symbol < rule->numTypes && rule->types[symbol] != type)
+        symbol++;
+    return symbol;
+}
+
+// Subset construction, with a state for each set of pattern positions the boxes so far can end at.
+//   A rule that does not fit the tables is left out, and reported by checkBoxOrder wherever it
+//   would have applied.
+static void compileBoxOrderRule(BoxOrderRule *rule) {
+    BoxOrderTerm terms[kBoxOrderMaxTerms];
+    UInt32 positions[kBoxOrderMaxStates];
+    UInt32 numTerms = 0;
+    const char *p = rule->pattern;
+
+    rule->usable = false;
+    rule->numTypes = 0;
+    rule->numStates = 0;
+
+    while (*p) {
+        BoxOrderTerm *term = &terms[numTerms];
+
+        if (*p == ' ') {
+            p++;
+            continue;
         }
-    }
-    if(ord_err){
-        strcat(err_order,ostypetostr(list[0].type));
-        for (int j= 1; j < cnt; j++){
-             strcat(err_order, "--");
-            strcat(err_order,ostypetostr(list[j].type));
+        if (numTerms == kBoxOrderMaxTerms)
+            goto bail;
+        numTerms++;
+        term->symbols = 0;
+        term->quantifier = 0;
+
+        if (strncmp(p, "...", 3) == 0) {
+            term->symbols = (1 << (kBoxOrderMaxTypes + 1)) - 1;
+            term->quantifier = '*';
+            p += 3;
+            continue;
         }
-        errprint("CMAF check violated (ordinality/nesting) : \"In 'mdia', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: mdhd--hdlr--elng (opt)--minf \", but order found is: %s \n", err_order);
-    }
-    
-}
-void checkCMAFBoxOrder_minf(long cnt,atomOffsetEntry *list)
-{
-    bool ord_err=false;
-    char err_order[50];
-    err_order[0]={'\0'};
-    for (int i= 0; i < cnt; i++) {
-        if (i==0 && list[i].type != 'vmhd' && list[i].type !='smhd' && list[i].type !='sthd')
-           ord_err=true;
-        else if (i==1 && list[i].type != 'dinf')
-            ord_err=true;
-        else if (i==2 && list[i].type != 'stbl')
-            ord_err=true;
-    }
-    if(ord_err){
-        strcat(err_order,ostypetostr(list[0].type));
-        for (int j= 1; j < cnt; j++){
-             strcat(err_order, "--");
-            strcat(err_order,ostypetostr(list[j].type));
+
+        for (;;) {
+            OSType type;
+            UInt32 symbol;
+
+            if (strlen(p) < 4)
+                goto bail;
+            type = ((OSType) (UInt8) p[0] << 24) | ((OSType) (UInt8) p[1] << 16) | ((OSType) (UInt8) p[2] << 8) | (OSType) (UInt8) p[3];
+            p += 4;
+
+            symbol = boxOrderSymbol(rule, type);
+            if (symbol == rule->numTypes) {
+                if (rule->numTypes == kBoxOrderMaxTypes)
+                    goto bail;
+                rule->types[rule->numTypes++] = type;
+            }
+            term->symbols |= 1 << symbol;
+
+            if (*p != '/')
+                break;
+            p++;
         }
-        errprint("CMAF check violated (ordinality/nesting) : \"In 'minf', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: vmhd/smhd/sthd--dinf--stbl \", but order found is: %s \n", err_order);
-    }
-}
 
-void checkCMAFBoxOrder_stbl(long cnt,atomOffsetEntry *list)
-{
-    bool ord_err=false;
-    char err_order[50];
-    err_order[0]={'\0'};
-    for (int i= 0; i < cnt; i++) {
-        if (i==0 && list[i].type != 'stsd')
-            ord_err=true;
-        else if (i==1 && list[i].type != 'stts')
-            ord_err=true;
-        else if (i==2 && list[i].type != 'stsc')
-            ord_err=true;
-        else if (i==3 && (list[i].type != 'stsz' && list[i].type != 'stz2'))
-            ord_err=true;
-        else if (i==4 && list[i].type != 'stco')
-            ord_err=true;
+        if (*p == '?' || *p == '+' || *p == '*')
+            term->quantifier = *p++;
     }
-    if(ord_err){
-        strcat(err_order,ostypetostr(list[0].type));
-        for (int j= 1; j < cnt; j++){
-             strcat(err_order, "--");
-            strcat(err_order,ostypetostr(list[j].type));
+
+    positions[0] = boxOrderClosure(terms, numTerms, 1);
+    rule->numStates = 1;
+
+    for (UInt32 state = 0; state < rule->numStates; state++) {
+        for (UInt32 symbol = 0; symbol <= rule->numTypes; symbol++) {
+            UInt32 reached = 0;
+            UInt32 target;
+
+            // a symbol past numTypes is any other type, which only "..." takes
+            for (UInt32 t = 0; t < numTerms; t++) {
+                if (!(positions[state] & (1 << t)) || !(terms[t].symbols & (1 << (symbol < rule->numTypes ? symbol : kBoxOrderMaxTypes))))
+                    continue;
+                reached |= 1 << (t + 1);
+                if (terms[t].quantifier == '+' || terms[t].quantifier == '*')
+                    reached |= 1 << t;
+            }
+            reached = boxOrderClosure(terms, numTerms, reached);
+
+            if (reached == 0) {
+                rule->next[state][symbol] = -1;
+                continue;
+            }
+
+            for (target = 0; target < rule->numStates && positions[target] != reached; target++)
+                ;
+            if (target == rule->numStates) {
+                if (rule->numStates == kBoxOrderMaxStates)
+                    goto bail;
+                positions[rule->numStates++] = reached;
+            }
+            rule->next[state][symbol] = (SInt8) target;
         }
-        errprint("CMAF check violated (ordinality/nesting) : \"In 'stbl', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: stsd--stts--stsc--stsz/stz2--stco--sgpd (opt)--stss (opt) \", but order found is: %s \n", err_order);
     }
+
+    rule->usable = true;
+
+bail:
+    return;
 }
 
-void checkCMAFBoxOrder_sinf(long cnt,atomOffsetEntry *list)
-{
-    bool ord_err=false;
-    char err_order[50];
-    err_order[0]={'\0'};
-    for (int i= 0; i < cnt; i++) {
-        if (i==0 && list[i].type != 'frma')
-           ord_err=true;
-        else if (i==1 && list[i].type != 'schm')
-           ord_err=true;
-        else if (i==2 && list[i].type != 'schi')
-           ord_err=true;
-    }
-    if(ord_err){
-        strcat(err_order,ostypetostr(list[0].type));
-        for (int j= 1; j < cnt; j++){
-             strcat(err_order, "--");
-            strcat(err_order,ostypetostr(list[j].type));
-        }
-        errprint("CMAF check violated (ordinality/nesting) : \"In 'sinf', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: frma--schm--schi \", but order found is: %s \n", err_order);
-    }
+static bool compileBoxOrderRules() {
+    for (size_t r = 0; r < sizeof (boxOrderRules) / sizeof (boxOrderRules[0]); r++)
+        compileBoxOrderRule(&boxOrderRules[r]);
+    return true;
 }
-void checkCMAFBoxOrder_moof(long cnt,atomOffsetEntry *list)
-{
-    bool ord_err=false;
-    char err_order[50];
-    err_order[0]={'\0'};
-    for (int i= 0; i < cnt; i++) {
-        if (i==0 && list[i].type != 'mfhd')
-           ord_err=true;
-        else if (i==1 && list[i].type != 'traf')
-           ord_err=true;
-    }
-    if(ord_err){
-        strcat(err_order,ostypetostr(list[0].type));
-        for (int j= 1; j < cnt; j++){
-             strcat(err_order, "--");
-            strcat(err_order,ostypetostr(list[j].type));
+
+// Checks the boxes of the container against all of its rules of the enabled profiles in one pass;
+//   a rule stops at the first box out of order, which is reported with the whole order found
+void checkBoxOrder(OSType container, long cnt, atomOffsetEntry *list) {
+    BoxOrderRule *rules[kBoxOrderMaxRules];
+    int state[kBoxOrderMaxRules];
+    long violation[kBoxOrderMaxRules];
+    int numRules = 0;
+    int live;
+    static const bool compiled = compileBoxOrderRules();     // thread safe initialisation
+
+    (void) compiled;
+    for (size_t r = 0; r < sizeof (boxOrderRules) / sizeof (boxOrderRules[0]) && numRules < kBoxOrderMaxRules; r++) {
+        BoxOrderRule *rule = &boxOrderRules[r];
+
+        if (rule->container != container || !boxOrderProfileEnabled(rule->profile))
+            continue;
+        if (!rule->usable) {
+            char type[5];
+
+            errprint("Box order rule \"%s\" for '%s' is too large, not checked\n", rule->pattern, ostypetostr_r(rule->container, type));
+            continue;
         }
-        errprint("CMAF check violated (ordinality/nesting) : \"In 'moof', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: mfhd--traf \", but order found is: %s \n", err_order);
+
+        rules[numRules] = rule;
+        state[numRules] = 0;
+        violation[numRules] = -1;
+        numRules++;
     }
-}
 
-void checkCMAFBoxOrder_traf(long cnt,atomOffsetEntry *list)
-{
-    bool ord_err=false;
-    char err_order[50];
-    err_order[0]={'\0'};
-    for (int i= 0; i < cnt; i++) {
-        if (i==0 && list[i].type != 'tfhd')
-           ord_err=true;
-        else if (i==1 && list[i].type != 'tfdt')
-           ord_err=true;
-        else if (i==2 && list[i].type != 'trun')
-           ord_err=true;
+    live = numRules;
+    for (long i = 0; i < cnt && live > 0; i++) {
+        for (int k = 0; k < numRules; k++) {
+            if (violation[k] >= 0)
+                continue;
+
+            state[k] = rules[k]->next[state[k]][boxOrderSymbol(rules[k], list[i].type)];
+            if (state[k] < 0) {
+                violation[k] = i;
+                live--;
+            }
+        }
     }
-    if(ord_err){
-        strcat(err_order,ostypetostr(list[0].type));
-        for (int j= 1; j < cnt; j++){
-             strcat(err_order, "--");
-            strcat(err_order,ostypetostr(list[j].type));
+
+    for (int k = 0; k < numRules; k++) {
+        char *order, *end;
+        char type[5];
+
+        if (violation[k] < 0)
+            continue;
+
+        order = (char *) malloc(cnt * 6 + 1);
+        if (order == NULL)
+            continue;
+
+        end = order;
+        *end = 0;
+        for (long i = 0; i < cnt; i++) {
+            if (i > 0) {
+                strcpy(end, "--");
+                end += 2;
+            }
+            strcpy(end, ostypetostr_r(list[i].type, type));
+            end += strlen(end);
         }
-        errprint("CMAF check violated (ordinality/nesting) : \"In 'traf', the allowed box order as per Section 7.3.1. of ISO/IEC 23000-19(E) is: tfhd--tfdt--trun--send (opt)--saio (opt)--saiz (opt)--sbgp (opt)--sgpd (opt)--subs (opt) \", but order found is: %s \n", err_order);
+
+        errprint("%s check violated (ordinality/nesting) : \"%s\", but order found is: %s; the first box out of order is '%s' at position %ld\n",
+                 boxOrderProfileName(rules[k]->profile), rules[k]->allowed, order, ostypetostr_r(list[violation[k]].type, type), violation[k] + 1);
+        free(order);
     }
 }
\ No newline at end of file
@@ -29,29 +29,71 @@ class AudioVisualRollRecoveryEntry
         SInt16 roll_distance;
 };
 
+// The post-processing walks each track's fragment samples once per stage, moof by moof and
+//   run by run in decode order, handing them to each of the visitors registered for the stage.
+//   The cursor carries what the visitors would otherwise each work out for themselves.
+typedef struct FragmentSampleCursor {
+    MovieInfoRec *mir;
+    TrackInfoRec *tir;
+    long        trackIndex;
+    UInt32      moofIndex;
+    MoofInfoRec *moof;
+    UInt32      trafIndex;
+    TrafInfoRec *traf;
+    UInt32      trunIndex;
+    TrunInfoRec *trun;
+    UInt64      firstSample;        // of the run, counting the track's samples from the start of the walk
+    SInt64      *compositionTime;   // per sample of the run, media timescale, from the moof's tfdt
+    UInt8       *sapType;           // per sample of the run, the smallest SAP type the sample is known to have, 7 for none (3 and 4 once processSAP34 has run)
+    UInt32      needs;              // columns filled in for this track
+    UInt32      runCapacity;
+    Boolean     overflow;           // a time of the track did not fit in 64 bits and was clamped; marks tir->timelineOverflow
+} FragmentSampleCursor;
+
+// the derived columns a visitor reads; only those some visitor of the walk needs are filled in
+#define kFragmentSampleCompositionTime  (1<<0)
+#define kFragmentSampleSAPType          (1<<1)
+
+struct FragmentSampleVisitor;
+typedef void (*FragmentSampleVisitorProc)(struct FragmentSampleVisitor *visitor, FragmentSampleCursor *cursor);
+
+// Visitors get the samples a run at a time, which keeps the calls through the table off the
+//   per-sample path; a visitor goes through the run's samples in order itself
+typedef struct FragmentSampleVisitor {
+    const char  *name;
+    void        *state;
+    UInt32      needs;
+    FragmentSampleVisitorProc beginTrack;   // may clear active to sit the track out
+    FragmentSampleVisitorProc beginMoof;    // for every moof, whether or not it has samples of the track
+    FragmentSampleVisitorProc run;
+    FragmentSampleVisitorProc endMoof;
+    FragmentSampleVisitorProc endTrack;
+    FragmentSampleVisitorProc report;       // once all tracks are walked
+    Boolean     active;
+    UInt64      samples;                    // visited
+    UInt64      nanoseconds;                // in the callbacks, with -printtype timing
+} FragmentSampleVisitor;
+
+void initFragmentSampleVisitor(FragmentSampleVisitor *visitor, const char *name, void *state);
+OSErr walkFragmentSamples(MovieInfoRec *mir, FragmentSampleVisitor *visitors, int numVisitors);
+UInt64 postprocessClock();
+void postprocessTiming(const char *name, UInt64 *since);
+
 
 OSErr postprocessFragmentInfo(MovieInfoRec *mir);
 void verifyLeafDurations(MovieInfoRec *mir);
 void initializeLeafInfo(MovieInfoRec *mir, long numMediaSegments);
-void checkNonIndexedSamples(MovieInfoRec *mir);
 void verifyAlignment(MovieInfoRec *mir);
 void verifyBSS(MovieInfoRec *mir);
 void processSAP34(MovieInfoRec *mir);
 OSErr processIndexingInfo(MovieInfoRec *mir);
 void checkDASHBoxOrder(long cnt, atomOffsetEntry *list, long segmentInfoSize, bool initializationSegment, UInt64 *segmentSizes, MovieInfoRec *mir);
-void checkSegmentStartWithSAP(int startWithSAP, MovieInfoRec *mir);
-void estimatePresentationTimes(MovieInfoRec*mir);
+OSErr checkFragmentSamples(MovieInfoRec *mir);
+OSErr estimatePresentationTimes(MovieInfoRec*mir);
 void processBuffering(long cnt, atomOffsetEntry *list, MovieInfoRec *mir);
 //CMAF box order checks' function definitions.
 void checkCMAFBoxOrder(long cnt, atomOffsetEntry *list, long segmentInfoSize, bool CMAFHeader, UInt64 *segmentSizes);
-void checkCMAFBoxOrder_moov(long cnt,atomOffsetEntry *list);
-void checkCMAFBoxOrder_trak(long cnt,atomOffsetEntry *list);
-void checkCMAFBoxOrder_mdia(long cnt,atomOffsetEntry *list);
-void checkCMAFBoxOrder_minf(long cnt,atomOffsetEntry *list);
-void checkCMAFBoxOrder_stbl(long cnt,atomOffsetEntry *list);
-void checkCMAFBoxOrder_sinf(long cnt,atomOffsetEntry *list);
-void checkCMAFBoxOrder_moof(long cnt,atomOffsetEntry *list);
-void checkCMAFBoxOrder_traf(long cnt,atomOffsetEntry *list);
+void checkBoxOrder(OSType container, long cnt, atomOffsetEntry *list);
 
 
 #endif //#define _SRC_POST_PROCESS_DATA_H_
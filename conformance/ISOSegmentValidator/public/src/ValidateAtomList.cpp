@@ -23,108 +23,43 @@ limitations under the License.
 #include "PostprocessData.h"
 
 
-extern ValidateGlobals vg;
 
 	// for use with ostypetostr_r() and int64todstr_r() for example;
     // when you're using one of these routines more than once in the same print statement
-	char   tempStr1[32];
-	char   tempStr2[32];
-	char   tempStr3[32];
-	char   tempStr4[32];
-	char   tempStr5[32];
-	char   tempStr6[32];
-	char   tempStr7[32];
-	char   tempStr8[32];
-	char   tempStr9[32];
-	char   tempStr10[32];
+	VALIDATE_THREAD_LOCAL char   tempStr1[32];
+	VALIDATE_THREAD_LOCAL char   tempStr2[32];
+	VALIDATE_THREAD_LOCAL char   tempStr3[32];
+	VALIDATE_THREAD_LOCAL char   tempStr4[32];
+	VALIDATE_THREAD_LOCAL char   tempStr5[32];
+	VALIDATE_THREAD_LOCAL char   tempStr6[32];
+	VALIDATE_THREAD_LOCAL char   tempStr7[32];
+	VALIDATE_THREAD_LOCAL char   tempStr8[32];
+	VALIDATE_THREAD_LOCAL char   tempStr9[32];
+	VALIDATE_THREAD_LOCAL char   tempStr10[32];
 
 
 //==========================================================================================
 
-OSErr ValidateFileAtoms( atomOffsetEntry *aoe, void *refcon )
+// per-track arrays of one MoofInfoRec, sized for the tracks in the moov
+static OSErr allocateMoofTrackInfo( MoofInfoRec *moofInfo )
 {
-#pragma unused(refcon)
 	OSErr err = noErr;
-	long cnt;
-	atomOffsetEntry *list;
-	long i;
-	OSErr atomerr = noErr;
-	atomOffsetEntry *entry;
-	UInt64 minOffset, maxOffset;
-	
-	minOffset = aoe->offset + aoe->atomStartSize;
-	maxOffset = aoe->offset + aoe->size - aoe->atomStartSize;
-	
-	BAILIFERR( FindAtomOffsets( aoe, minOffset, maxOffset, &cnt, &list ) );
-    	
-	atomprint("<atomlist>\n"); vg.tabcnt++;
-	
-	// Process 'ftyp' atom
-
-	atomerr = ValidateAtomOfType( 'ftyp', kTypeAtomFlagMustHaveOne | kTypeAtomFlagCanHaveAtMostOne | kTypeAtomFlagMustBeFirst, 
-		Validate_ftyp_Atom, cnt, list, nil );
-	if (!err) err = atomerr;
 	
-	// Process 'moov' atoms ; check for more than 1 moov atoms done later
-	vg.mir = NULL; 
-        if(vg.cmaf){
-            atomerr = ValidateAtomOfType( 'moov', kTypeAtomFlagMustHaveOne | kTypeAtomFlagCanHaveAtMostOne, 
-		Validate_moov_Atom, cnt, list, nil );
-            if (!err) err = atomerr;
-        }
-        else{
-            atomerr = ValidateAtomOfType( 'moov', kTypeAtomFlagMustHaveOne, 
-                    Validate_moov_Atom, cnt, list, nil );
-            if (!err) err = atomerr;
-        }
+    BAILIFNIL( moofInfo->compositionInfoMissingPerTrack = (Boolean*)ArenaAlloc(&vg.arena, vg.mir->numTIRs*sizeof(Boolean)), allocFailedErr );
+    BAILIFNIL( moofInfo->moofEarliestPresentationTimePerTrack = (SInt64*)ArenaAlloc(&vg.arena, vg.mir->numTIRs*sizeof(SInt64)), allocFailedErr );
+    BAILIFNIL( moofInfo->moofPresentationEndTimePerTrack = (SInt64*)ArenaAlloc(&vg.arena, vg.mir->numTIRs*sizeof(SInt64)), allocFailedErr );
+    BAILIFNIL( moofInfo->moofLastPresentationTimePerTrack = (SInt64*)ArenaAlloc(&vg.arena, vg.mir->numTIRs*sizeof(SInt64)), allocFailedErr );
+    BAILIFNIL( moofInfo->tfdt = (UInt64*)ArenaAlloc(&vg.arena, vg.mir->numTIRs*sizeof(UInt64)), allocFailedErr );
 	
-	// Process 'meta' atoms
-	atomerr = ValidateAtomOfType( 'meta', kTypeAtomFlagCanHaveAtMostOne, 
-		Validate_meta_Atom, cnt, list, nil );
-	if (!err) err = atomerr;
-    
-	// Count the total fragments and sidx's (if present), and allocate the required memory for that
-	vg.mir->numFragments = 0;
-	vg.mir->numSidx = 0;
-
-	if(vg.mir->fragmented)
-	{
-        for (i = 0; i < cnt; i++)
-        {
-            if (list[i].type == 'sidx')
-                vg.mir->numSidx++;
-            
-            if (list[i].type == 'moof')
-                vg.mir->numFragments++;
-        }
-        
-        vg.mir->moofInfo = (MoofInfoRec *)malloc(vg.mir->numFragments*sizeof(MoofInfoRec));
-        vg.mir->processedFragments = 0;
-
-    	for (i = 0; i < (long)vg.mir->numFragments ; i++)
-    	{
-            vg.mir->moofInfo[i].compositionInfoMissingPerTrack = (Boolean*)malloc(vg.mir->numTIRs*sizeof(Boolean));
-            vg.mir->moofInfo[i].moofEarliestPresentationTimePerTrack = (long double*)malloc(vg.mir->numTIRs*sizeof(long double));
-            vg.mir->moofInfo[i].moofPresentationEndTimePerTrack = (long double*)malloc(vg.mir->numTIRs*sizeof(long double));
-            vg.mir->moofInfo[i].moofLastPresentationTimePerTrack = (long double*)malloc(vg.mir->numTIRs*sizeof(long double));
-            vg.mir->moofInfo[i].tfdt = (UInt64*)malloc(vg.mir->numTIRs*sizeof(UInt64));
-    	}
-
-        vg.mir->sidxInfo = (SidxInfoRec *)malloc(vg.mir->numSidx*sizeof(SidxInfoRec));
-        vg.mir->processedSdixs = 0;
-	}
-    else
-    {
-        vg.mir->moofInfo = NULL;
-        vg.mir->sidxInfo = NULL;
-    }
-
-    int numMoovBoxes;
+bail:
+	return err;
+}
 
-    numMoovBoxes = 0;
-    			
-	for (i = 0; i < cnt; i++) {
-		entry = &list[i];
+// everything at file level other than ftyp/moov/meta; entry i of list, the first cnt entries are valid
+static OSErr validateTopLevelAtom( long i, long cnt, atomOffsetEntry *list, long typeFlags, int *numMoovBoxes )
+{
+	OSErr atomerr = noErr;
+	atomOffsetEntry *entry = &list[i];
 
 		switch (entry->type) {
 			case 'mdat':
@@ -134,30 +69,26 @@ OSErr ValidateFileAtoms( atomOffsetEntry *aoe, void *refcon )
 				break;
 
             case 'styp':
-                atomerr = ValidateAtomOfType( 'styp', 0, 
+                atomerr = ValidateAtomOfType( 'styp', typeFlags, 
                     Validate_styp_Atom, cnt, list, nil );
-                if (!err) err = atomerr;
                 break;
 			
 			case 'uuid':
-					atomerr = ValidateAtomOfType( 'uuid', 0, 
+					atomerr = ValidateAtomOfType( 'uuid', typeFlags, 
 						Validate_uuid_Atom, cnt, list, nil );
-					if (!err) err = atomerr;
 					break;
 					
             case 'emsg':
-                    atomerr = ValidateAtomOfType( 'emsg', 0, 
+                    atomerr = ValidateAtomOfType( 'emsg', typeFlags, 
                         Validate_emsg_Atom, cnt, list, nil );
-                    if (!err) err = atomerr;
                     break;
                     
             case 'moof':
                     if(!vg.mir->fragmented)
                         errprint("'moof' boxes are not to be expected without an 'mvex' in 'moov'\n");
 
-                    atomerr = ValidateAtomOfType( 'moof', 0, 
+                    atomerr = ValidateAtomOfType( 'moof', typeFlags, 
                         Validate_moof_Atom, cnt, list, vg.mir);
-                    if (!err) err = atomerr;
 
                     break;
 
@@ -168,9 +99,8 @@ OSErr ValidateFileAtoms( atomOffsetEntry *aoe, void *refcon )
                     if(!vg.initializationSegment && !vg.dashInFtyp)
                         errprint("'sidx' found for self-initializing media, violating Section 6.3.5.2. of ISO/IEC 23009-1:2012(E): The Indexed Self-Initializing Media Segment ... shall carry 'dash' as a compatible brand. \n");
                     
-                    atomerr = ValidateAtomOfType( 'sidx', 0, 
+                    atomerr = ValidateAtomOfType( 'sidx', typeFlags, 
                         Validate_sidx_Atom, cnt, list, vg.mir);
-                    if (!err) err = atomerr;
                     
                     break;
 
@@ -179,9 +109,9 @@ OSErr ValidateFileAtoms( atomOffsetEntry *aoe, void *refcon )
                     // Don't allow multiple moov boxes except for self-initializing DASH
                     bool dsmsFound;
 
-                    numMoovBoxes++;
+                    (*numMoovBoxes)++;
 
-                    if(numMoovBoxes > 1)
+                    if(*numMoovBoxes > 1)
                     {
                         dsmsFound = false;
         
@@ -200,40 +130,304 @@ OSErr ValidateFileAtoms( atomOffsetEntry *aoe, void *refcon )
 					warnprint("WARNING: In %s - unknown file atom '%s'\n",vg.curatompath, ostypetostr(entry->type));
 				break;
 		}
-		
-		if (!err) err = atomerr;
-	}
-    
+
+	return atomerr;
+}
+
+// the checks that need all of the file's atoms to have been validated
+static void postprocessFileAtoms( long cnt, atomOffsetEntry *list )
+{
+    UInt64 since = postprocessClock();
+
     //Some Processing like: check ordering to some extend (first sidx in segment is checked later while verifying indexing since it comes with
     //the checks for duration
     if(vg.dashSegment)
         checkDASHBoxOrder(cnt,list,vg.segmentInfoSize,vg.initializationSegment,vg.segmentSizes,vg.mir);
     
+    if(vg.initializationSegment) {
+        long headerCnt = 0;
+        
+        while (headerCnt < cnt && list[headerCnt].offset < vg.segmentSizes[0])
+            headerCnt++;
+        checkBoxOrder( 'file', headerCnt, list );
+    }
+    
     if(vg.cmaf)
         checkCMAFBoxOrder(cnt,list,vg.segmentInfoSize, vg.initializationSegment, vg.segmentSizes);
+    postprocessTiming("box order", &since);
 
   if(vg.mir->fragmented)
     postprocessFragmentInfo(vg.mir);
+  postprocessTiming("fragment info", &since);
   
   estimatePresentationTimes(vg.mir);
+  postprocessTiming("estimatePresentationTimes", &since);
 
    if(vg.dashSegment)
    {
         processSAP34(vg.mir);
+        postprocessTiming("processSAP34", &since);
         processIndexingInfo(vg.mir);
-        if(vg.minBufferTime != -1)
+        postprocessTiming("processIndexingInfo", &since);
+        if(vg.minBufferTime != -1) {
             processBuffering(cnt,list,vg.mir);
+            postprocessTiming("processBuffering", &since);
+        }
         logLeafInfo(vg.mir);
+        postprocessTiming("logLeafInfo", &since);
    }
+}
+
+//==========================================================================================
+
+// Streamed input (stdin/pipe/FIFO, see -stream): we can't seek, so instead of finding all the
+//   file-level atoms first and then validating them type by type, we read one atom header at a
+//   time and validate that atom before moving on. Output is therefore in file order.
+//   Once the moov has been seen (or always, for DASH segments, where nothing reads mdat) we let
+//   go of each atom's data as soon as it is validated; before that, an mdat is kept around so the
+//   sample checks in the moov can still get to it.
+static OSErr ValidateStreamedFileAtoms( atomOffsetEntry *aoe )
+{
+	OSErr err = noErr;
+	long cnt = 0;
+	long max = 20;
+	atomOffsetEntry *list = nil;
+	OSErr atomerr = noErr;
+	atomOffsetEntry *entry;
+	UInt64 curOffset, maxOffset;
+	Boolean runsToEnd = false;
+	Boolean moovValidated = false;
+	int numMoovBoxes = 0;
+	
+	curOffset = aoe->offset + aoe->atomStartSize;
+	maxOffset = aoe->offset + aoe->size - aoe->atomStartSize;
+	
+	// in vg.arena like the lists from FindAtomOffsets, so it can be indexed the same way
+	BAILIFNULL( list = (atomOffsetEntry *)ArenaCalloc( &vg.arena, max, sizeof(atomOffsetEntry)), allocFailedErr );
+	
+	atomprint("<atomlist>\n"); vg.tabcnt++;
+	
+	vg.mir = NULL; 
+	
+	while (!runsToEnd && StreamHasData( getAdjustedFileOffset(curOffset) )) {
+		// header reads are exact; let the reads for the atom body run ahead once we know its size
+		StreamSetLimit( getAdjustedFileOffset(curOffset) );
+		atomerr = GetAtomOffsetEntry( aoe, curOffset, maxOffset, &list[cnt], &runsToEnd );
+		if (atomerr) {
+			if (!err) err = atomerr;
+			goto bail;
+		}
+		entry = &list[cnt];
+		cnt++;
+		if (cnt >= max) {
+			BAILIFNULL( list = (atomOffsetEntry *)ArenaGrow( &vg.arena, list, max * sizeof(atomOffsetEntry), 2 * max * sizeof(atomOffsetEntry)), allocFailedErr );
+			memset( &list[max], 0, max * sizeof(atomOffsetEntry) );
+			max *= 2;
+			entry = &list[cnt-1];
+		}
+		StreamSetLimit( getAdjustedFileOffset(entry->offset + entry->size) );
+		
+		switch (entry->type) {
+			case 'ftyp':
+				atomerr = ValidateAtomOfType( 'ftyp', kTypeAtomFlagCanHaveAtMostOne | kTypeAtomFlagMustBeFirst | kTypeAtomFlagCountValidated, 
+					Validate_ftyp_Atom, cnt, list, nil );
+				break;
+			
+			case 'moov':
+				if(vg.cmaf)
+					atomerr = ValidateAtomOfType( 'moov', kTypeAtomFlagCanHaveAtMostOne | kTypeAtomFlagCountValidated, 
+						Validate_moov_Atom, cnt, list, nil );
+				else
+					atomerr = ValidateAtomOfType( 'moov', kTypeAtomFlagCountValidated, 
+						Validate_moov_Atom, cnt, list, nil );
+				if (!err) err = atomerr;
+				moovValidated = (vg.mir != NULL);		// the moov validator callocs it, so there are no fragments or sidx's yet
+				atomerr = validateTopLevelAtom( cnt-1, cnt, list, kTypeAtomFlagCountValidated, &numMoovBoxes );
+				break;
+			
+			case 'meta':
+				atomerr = ValidateAtomOfType( 'meta', kTypeAtomFlagCanHaveAtMostOne | kTypeAtomFlagCountValidated, 
+					Validate_meta_Atom, cnt, list, nil );
+				break;
+			
+			case 'mdat':
+			case 'skip':
+			case 'ssix':
+			case 'free':
+				break;
+			
+			default:
+				if (vg.mir == NULL) {
+					warnprint("WARNING: '%s' atom at offset %s comes before the 'moov' atom and can't be validated on a streamed input\n",
+						ostypetostr(entry->type), int64todstr(entry->offset));
+					break;
+				}
+				
+				// grow the fragment and segment index bookkeeping as they turn up, doubling
+				//   so the copies left behind in the arena stay within the final size
+				if ((entry->type == 'moof') && vg.mir->fragmented) {
+					if (vg.mir->numFragments == vg.mir->moofInfoCapacity) {
+						UInt32 capacity = vg.mir->moofInfoCapacity ? vg.mir->moofInfoCapacity * 2 : 64;
+						
+						BAILIFNULL( vg.mir->moofInfo = (MoofInfoRec *)ArenaGrow(&vg.arena, vg.mir->moofInfo, 
+							vg.mir->moofInfoCapacity*sizeof(MoofInfoRec), capacity*sizeof(MoofInfoRec)), allocFailedErr );
+						vg.mir->moofInfoCapacity = capacity;
+					}
+					BAILIF( allocateMoofTrackInfo( &vg.mir->moofInfo[vg.mir->numFragments] ) != noErr, allocFailedErr );
+					vg.mir->numFragments++;
+				}
+				if ((entry->type == 'sidx') && vg.mir->fragmented) {
+					if (vg.mir->numSidx == vg.mir->sidxInfoCapacity) {
+						UInt32 capacity = vg.mir->sidxInfoCapacity ? vg.mir->sidxInfoCapacity * 2 : 16;
+						
+						BAILIFNULL( vg.mir->sidxInfo = (SidxInfoRec *)ArenaGrow(&vg.arena, vg.mir->sidxInfo, 
+							vg.mir->sidxInfoCapacity*sizeof(SidxInfoRec), capacity*sizeof(SidxInfoRec)), allocFailedErr );
+						vg.mir->sidxInfoCapacity = capacity;
+					}
+					vg.mir->numSidx++;
+				}
+				
+				atomerr = validateTopLevelAtom( cnt-1, cnt, list, kTypeAtomFlagCountValidated, &numMoovBoxes );
+				break;
+		}
+		if (!err) err = atomerr;
+		
+		if (vg.dashSegment || moovValidated)
+			StreamRelease( getAdjustedFileOffset(entry->offset + entry->size) );
+		curOffset = entry->offset + entry->size;
+	}
+	
+	// now we know how big the input is
+	vg.inMaxOffset = inflateOffset( StreamDrain() );
+	if (!vg.dashSegment && (vg.segmentSizes[0] == aoe->size)) {
+		vg.segmentSizes[0] = vg.inMaxOffset;
+		updateSegmentMap();
+	}
+	aoe->size = vg.inMaxOffset;
+	aoe->maxOffset = aoe->offset + aoe->size;
+	if (runsToEnd)
+		list[cnt-1].size = aoe->maxOffset - list[cnt-1].offset;
+	reportprint("<!-- Streamed %s bytes, at most %s of them held in memory -->\n", 
+		int64todstr_r(vg.stream.head, tempStr1), int64todstr_r(vg.stream.peak, tempStr2));
+	
+	// only reports the ones that never turned up
+	atomerr = ValidateAtomOfType( 'ftyp', kTypeAtomFlagMustHaveOne | kTypeAtomFlagCountValidated, 
+		Validate_ftyp_Atom, cnt, list, nil );
+	if (!err) err = atomerr;
+	atomerr = ValidateAtomOfType( 'moov', kTypeAtomFlagMustHaveOne | kTypeAtomFlagCountValidated, 
+		Validate_moov_Atom, cnt, list, nil );
+	if (!err) err = atomerr;
+	
+	if (vg.mir == NULL)
+		goto bail;
+	
+	postprocessFileAtoms( cnt, list );
    
-   --vg.tabcnt; atomprint("</atomlist>\n");
+	--vg.tabcnt; atomprint("</atomlist>\n");
    
  	aoe->aoeflags |= kAtomValidated;
 	
 bail:
-	if ( vg.mir != NULL) {
-		dispose_mir(vg.mir);
+	dispose_mir(vg.mir);
+
+	return err;
+}
+
+//==========================================================================================
+
+OSErr ValidateFileAtoms( atomOffsetEntry *aoe, void *refcon )
+{
+#pragma unused(refcon)
+	OSErr err = noErr;
+	long cnt;
+	atomOffsetEntry *list;
+	long i;
+	OSErr atomerr = noErr;
+	UInt64 minOffset, maxOffset;
+	
+	if (vg.streamInput)
+		return ValidateStreamedFileAtoms( aoe );
+	
+	minOffset = aoe->offset + aoe->atomStartSize;
+	maxOffset = aoe->offset + aoe->size - aoe->atomStartSize;
+	
+	BAILIFERR( FindAtomOffsets( aoe, minOffset, maxOffset, &cnt, &list ) );
+    	
+	atomprint("<atomlist>\n"); vg.tabcnt++;
+	
+	// Process 'ftyp' atom
+
+	atomerr = ValidateAtomOfType( 'ftyp', kTypeAtomFlagMustHaveOne | kTypeAtomFlagCanHaveAtMostOne | kTypeAtomFlagMustBeFirst, 
+		Validate_ftyp_Atom, cnt, list, nil );
+	if (!err) err = atomerr;
+	
+	// Process 'moov' atoms ; check for more than 1 moov atoms done later
+	vg.mir = NULL; 
+        if(vg.cmaf){
+            atomerr = ValidateAtomOfType( 'moov', kTypeAtomFlagMustHaveOne | kTypeAtomFlagCanHaveAtMostOne, 
+		Validate_moov_Atom, cnt, list, nil );
+            if (!err) err = atomerr;
+        }
+        else{
+            atomerr = ValidateAtomOfType( 'moov', kTypeAtomFlagMustHaveOne, 
+                    Validate_moov_Atom, cnt, list, nil );
+            if (!err) err = atomerr;
+        }
+	
+	// Process 'meta' atoms
+	atomerr = ValidateAtomOfType( 'meta', kTypeAtomFlagCanHaveAtMostOne, 
+		Validate_meta_Atom, cnt, list, nil );
+	if (!err) err = atomerr;
+    
+	// Count the total fragments and sidx's (if present), and allocate the required memory for that
+	vg.mir->numFragments = 0;
+	vg.mir->numSidx = 0;
+
+	if(vg.mir->fragmented)
+	{
+        for (i = 0; i < cnt; i++)
+        {
+            if (list[i].type == 'sidx')
+                vg.mir->numSidx++;
+            
+            if (list[i].type == 'moof')
+                vg.mir->numFragments++;
+        }
+        
+        BAILIFNULL( vg.mir->moofInfo = (MoofInfoRec *)ArenaAlloc(&vg.arena, vg.mir->numFragments*sizeof(MoofInfoRec)), allocFailedErr );
+        vg.mir->moofInfoCapacity = vg.mir->numFragments;
+        vg.mir->processedFragments = 0;
+
+    	for (i = 0; i < (long)vg.mir->numFragments ; i++)
+            BAILIF( allocateMoofTrackInfo( &vg.mir->moofInfo[i] ) != noErr, allocFailedErr );
+
+        BAILIFNULL( vg.mir->sidxInfo = (SidxInfoRec *)ArenaAlloc(&vg.arena, vg.mir->numSidx*sizeof(SidxInfoRec)), allocFailedErr );
+        vg.mir->sidxInfoCapacity = vg.mir->numSidx;
+        vg.mir->processedSdixs = 0;
 	}
+    else
+    {
+        vg.mir->moofInfo = NULL;
+        vg.mir->sidxInfo = NULL;
+    }
+
+    int numMoovBoxes;
+
+    numMoovBoxes = 0;
+    			
+	for (i = 0; i < cnt; i++) {
+		atomerr = validateTopLevelAtom( i, cnt, list, 0, &numMoovBoxes );
+		if (!err) err = atomerr;
+	}
+    
+    postprocessFileAtoms( cnt, list );
+   
+   --vg.tabcnt; atomprint("</atomlist>\n");
+   
+ 	aoe->aoeflags |= kAtomValidated;
+	
+bail:
+	dispose_mir(vg.mir);
 
 	return err;
 }
@@ -432,8 +626,7 @@ OSErr Validate_minf_Atom( atomOffsetEntry *aoe, void *refcon )
 		if (!err) err = atomerr;
 	}
 	
-	if(vg.cmaf)
-            checkCMAFBoxOrder_minf(cnt,list);
+	checkBoxOrder( 'minf', cnt, list );
 	
 	aoe->aoeflags |= kAtomValidated;
 bail:
@@ -496,15 +689,14 @@ OSErr Validate_mdia_Atom( atomOffsetEntry *aoe, void *refcon )
 
 		switch (entry->type) {
 			default:
-				warnprint("WARNING: In unknown media atom '%s'\n",vg.curatompath, ostypetostr(entry->type));
+				warnprint("WARNING: In %s - unknown media atom '%s'\n",vg.curatompath, ostypetostr(entry->type));
 				break;
 		}
 		
 		if (!err) err = atomerr;
 	}
 	
-	if(vg.cmaf)
-            checkCMAFBoxOrder_mdia(cnt,list);
+	checkBoxOrder( 'mdia', cnt, list );
 	
 	aoe->aoeflags |= kAtomValidated;
 bail:
@@ -555,6 +747,93 @@ bail:
 
 //==========================================================================================
 
+// With -threads, the video and sound samples are validated on worker threads a run at a time, just as
+//   the loops in Validate_trak_Atom validate them one at a time. The reader's view of a sample does
+//   not last, so the sample is copied into the run, with the bitParsingSlop bytes that follow it.
+#define kSampleTaskSize			(256*1024)
+#define kSampleTaskMaxSamples	64
+
+typedef struct SampleTask {
+	ValidateBitstreamProcPtr validateProc;
+	TrackInfoRec *tir;
+	long numSamples;
+	struct {
+		long sampleNum;
+		UInt64 offset;
+		UInt32 size;
+		size_t dataOffset;
+	} samples[kSampleTaskMaxSamples];
+	char *data;
+	size_t dataSize;
+	size_t dataAllocated;
+} SampleTask;
+
+static void RunSampleTask( void *taskData )
+{
+	SampleTask *task = (SampleTask *)taskData;
+	BitBuffer bb;
+	long i;
+	
+	for (i = 0; i < task->numSamples; i++) {
+		sampleprint("<sample num=\"%ld\" offset=\"%s\" size=\"%d\" />\n",task->samples[i].sampleNum,int64toxstr(task->samples[i].offset),task->samples[i].size); vg.tabcnt++;
+		
+		BitBuffer_Init(&bb, (UInt8 *)(task->data + task->samples[i].dataOffset), task->samples[i].size);
+		
+		task->validateProc( &bb, task->tir );
+		--vg.tabcnt; sampleprint("</sample>\n");
+	}
+	free( task->data );
+	free( task );
+}
+
+// Adds the sample to the run in *taskP, submitting that first if the sample does not fit;
+//   false if we could not allocate a run for it
+static Boolean AddSampleTask( ValidateTaskQueue *queue, SampleTask **taskP, ValidateBitstreamProcPtr validateProc,
+								TrackInfoRec *tir, long sampleNum, UInt64 sampleOffset, UInt32 sampleSize, Ptr dataP )
+{
+	SampleTask *task = *taskP;
+	size_t size = (size_t)sampleSize + bitParsingSlop;
+	long n;
+	
+	if (task && ((task->numSamples == kSampleTaskMaxSamples) || (size > task->dataAllocated - task->dataSize))) {
+		ValidateTaskQueue_Submit( queue, RunSampleTask, task );
+		*taskP = task = nil;
+	}
+	if (task == nil) {
+		task = (SampleTask *)calloc( 1, sizeof(SampleTask) );
+		if (task == nil)
+			return false;
+		task->dataAllocated = (size > kSampleTaskSize) ? size : kSampleTaskSize;
+		task->data = (char *)malloc( task->dataAllocated );
+		if (task->data == nil) {
+			free( task );
+			return false;
+		}
+		task->validateProc = validateProc;
+		task->tir = tir;
+		*taskP = task;
+	}
+	
+	n = task->numSamples++;
+	task->samples[n].sampleNum = sampleNum;
+	task->samples[n].offset = sampleOffset;
+	task->samples[n].size = sampleSize;
+	task->samples[n].dataOffset = task->dataSize;
+	memcpy( task->data + task->dataSize, dataP, size );
+	task->dataSize += size;
+	return true;
+}
+
+// Waits for the runs, passing their output on, and stops the workers
+static void EndSampleTasks( ValidateTaskQueue *queue, SampleTask *task )
+{
+	if (task)
+		ValidateTaskQueue_Submit( queue, RunSampleTask, task );
+	DisposeValidateTaskQueue( queue );
+}
+
+//==========================================================================================
+
 OSErr Validate_trak_Atom( atomOffsetEntry *aoe, void *refcon )
 {
 	OSErr err = noErr;
@@ -565,7 +844,9 @@ OSErr Validate_trak_Atom( atomOffsetEntry *aoe, void *refcon )
 	atomOffsetEntry *entry;
 	UInt64 minOffset, maxOffset;
 	TrackInfoRec	*tir = (TrackInfoRec*)refcon;
+	SampleReader	sr;
 	
+	SampleReader_Init( &sr, tir );
 	atomprintnotab(">\n"); 
 			
 	minOffset = aoe->offset + aoe->atomStartSize;
@@ -638,25 +919,48 @@ OSErr Validate_trak_Atom( atomOffsetEntry *aoe, void *refcon )
 			if (vg.checklevel >= checklevel_samples && !vg.dashSegment) {
 				UInt64 sampleOffset;
 				UInt32 sampleSize;
-				UInt32 sampleDescriptionIndex;
 				Ptr dataP = nil;
 				BitBuffer bb;
+				ValidateTaskQueue *queue = nil;
+				SampleTask *task = nil;
+				
+				// the atomxml file is written directly, so only one thread can write it
+				if ((vg.numThreads > 1) && !vg.atomxml)
+					queue = NewValidateTaskQueue( vg.numThreads );
 				
 				sampleprint("<vide_SAMPLE_DATA>\n"); vg.tabcnt++;
 					for (i = 1; i <= (long)tir->sampleSizeEntryCnt; i++) {
 						if ((vg.samplenumber==0) || (vg.samplenumber==i)) {
-							err = GetSampleOffsetSize( tir, i, &sampleOffset, &sampleSize, &sampleDescriptionIndex );
-							sampleprint("<sample num=\"%d\" offset=\"%s\" size=\"%d\" />\n",i,int64toxstr(sampleOffset),sampleSize); vg.tabcnt++;
-							BAILIFNIL( dataP = (Ptr)malloc(sampleSize), allocFailedErr );
-							err = GetFileData( vg.fileaoe, dataP, sampleOffset, sampleSize, nil );
+							if (queue) {
+								// anything the read prints goes after the samples before it
+								ValidateTaskQueue_BeginHere( queue );
+								err = SampleReader_GetSample( &sr, i, &sampleOffset, &sampleSize, &dataP );
+								ValidateTaskQueue_EndHere( queue );
+								if (!err && dataP && AddSampleTask( queue, &task, Validate_vide_sample_Bitstream, tir, i, sampleOffset, sampleSize, dataP ))
+									continue;
+								// carry on here, once the samples before this one are out
+								EndSampleTasks( queue, task );
+								queue = nil;
+								task = nil;
+							} else
+								err = SampleReader_GetSample( &sr, i, &sampleOffset, &sampleSize, &dataP );
+							if (err) {
+								// a short read hands out zeros, which are no sample to validate
+								errprint("Sample %ld could not be read (err %d); the track's remaining samples are not validated\n", i, err);
+								break;
+							}
+							sampleprint("<sample num=\"%ld\" offset=\"%s\" size=\"%d\" />\n",i,int64toxstr(sampleOffset),sampleSize); vg.tabcnt++;
+							BAILIFNIL( dataP, allocFailedErr );
 							
 							BitBuffer_Init(&bb, (UInt8 *)((void *)dataP), sampleSize);
 
 							Validate_vide_sample_Bitstream( &bb, tir );
-							free( dataP );
 							--vg.tabcnt; sampleprint("</sample>\n");
 						}
 					}
+				if (queue)
+					EndSampleTasks( queue, task );
+				SampleReader_PrintStats( &sr );
 				--vg.tabcnt; sampleprint("</vide_SAMPLE_DATA>\n");
 			}
 			break;
@@ -669,25 +973,45 @@ OSErr Validate_trak_Atom( atomOffsetEntry *aoe, void *refcon )
 			if (vg.checklevel >= checklevel_samples && !vg.dashSegment) {
 				UInt64 sampleOffset;
 				UInt32 sampleSize;
-				UInt32 sampleDescriptionIndex;
 				Ptr dataP = nil;
 				BitBuffer bb;
+				ValidateTaskQueue *queue = nil;
+				SampleTask *task = nil;
+				
+				if ((vg.numThreads > 1) && !vg.atomxml)
+					queue = NewValidateTaskQueue( vg.numThreads );
 				
 				sampleprint("<audi_SAMPLE_DATA>\n"); vg.tabcnt++;
 					for (i = 1; i <= (long)tir->sampleSizeEntryCnt; i++) {
 						if ((vg.samplenumber==0) || (vg.samplenumber==i)) {
-							err = GetSampleOffsetSize( tir, i, &sampleOffset, &sampleSize, &sampleDescriptionIndex );
-							sampleprint("<sample num=\"%d\" offset=\"%s\" size=\"%d\" />\n",i,int64toxstr(sampleOffset),sampleSize); vg.tabcnt++;
-							BAILIFNIL( dataP = (Ptr)malloc(sampleSize), allocFailedErr );
-							err = GetFileData( vg.fileaoe, dataP, sampleOffset, sampleSize, nil );
+							if (queue) {
+								ValidateTaskQueue_BeginHere( queue );
+								err = SampleReader_GetSample( &sr, i, &sampleOffset, &sampleSize, &dataP );
+								ValidateTaskQueue_EndHere( queue );
+								if (!err && dataP && AddSampleTask( queue, &task, Validate_soun_sample_Bitstream, tir, i, sampleOffset, sampleSize, dataP ))
+									continue;
+								EndSampleTasks( queue, task );
+								queue = nil;
+								task = nil;
+							} else
+								err = SampleReader_GetSample( &sr, i, &sampleOffset, &sampleSize, &dataP );
+							if (err) {
+								// a short read hands out zeros, which are no sample to validate
+								errprint("Sample %ld could not be read (err %d); the track's remaining samples are not validated\n", i, err);
+								break;
+							}
+							sampleprint("<sample num=\"%ld\" offset=\"%s\" size=\"%d\" />\n",i,int64toxstr(sampleOffset),sampleSize); vg.tabcnt++;
+							BAILIFNIL( dataP, allocFailedErr );
 							
 							BitBuffer_Init(&bb, (UInt8 *)dataP, sampleSize);
 
 							Validate_soun_sample_Bitstream( &bb, tir );
-							free( dataP );
 							--vg.tabcnt; sampleprint("</sample>\n");
 						}
 					}
+				if (queue)
+					EndSampleTasks( queue, task );
+				SampleReader_PrintStats( &sr );
 				--vg.tabcnt; sampleprint("</audi_SAMPLE_DATA>\n");
 			}
 			break;
@@ -700,25 +1024,27 @@ OSErr Validate_trak_Atom( atomOffsetEntry *aoe, void *refcon )
 			if (vg.checklevel >= checklevel_samples && !vg.dashSegment) {
 				UInt64 sampleOffset;
 				UInt32 sampleSize;
-				UInt32 sampleDescriptionIndex;
 				Ptr dataP = nil;
 				BitBuffer bb;
 				
 				sampleprint("<odsm_SAMPLE_DATA>\n"); vg.tabcnt++;
 				for (i = 1; i <= (long)tir->sampleSizeEntryCnt; i++) {
 					if ((vg.samplenumber==0) || (vg.samplenumber==i)) {
-						err = GetSampleOffsetSize( tir, i, &sampleOffset, &sampleSize, &sampleDescriptionIndex );
+						err = SampleReader_GetSample( &sr, i, &sampleOffset, &sampleSize, &dataP );
+						if (err) {
+							errprint("Sample %ld could not be read (err %d); the track's remaining samples are not validated\n", i, err);
+							break;
+						}
 						sampleprint("<sample num=\"%d\" offset=\"%s\" size=\"%d\" />\n",1,int64toxstr(sampleOffset),sampleSize); vg.tabcnt++;
-							BAILIFNIL( dataP = (Ptr)malloc(sampleSize), allocFailedErr );
-							err = GetFileData( vg.fileaoe, dataP, sampleOffset, sampleSize, nil );
+							BAILIFNIL( dataP, allocFailedErr );
 							
 							BitBuffer_Init(&bb, (UInt8 *)dataP, sampleSize);
 
 							Validate_odsm_sample_Bitstream( &bb, tir );
-							free( dataP );
 						--vg.tabcnt; sampleprint("</sample>\n");
 					}
 				}
+				SampleReader_PrintStats( &sr );
 				--vg.tabcnt; sampleprint("</odsm_SAMPLE_DATA>\n");
 			}
 			break;
@@ -731,24 +1057,26 @@ OSErr Validate_trak_Atom( atomOffsetEntry *aoe, void *refcon )
 			if (vg.checklevel >= checklevel_samples && !vg.dashSegment) {
 				UInt64 sampleOffset;
 				UInt32 sampleSize;
-				UInt32 sampleDescriptionIndex;
 				Ptr dataP = nil;
 				BitBuffer bb;
 				sampleprint("<sdsm_SAMPLE_DATA>\n"); vg.tabcnt++;
 				for (i = 1; i <= (long)tir->sampleSizeEntryCnt; i++) {
 					if ((vg.samplenumber==0) || (vg.samplenumber==i)) {
-						err = GetSampleOffsetSize( tir, i, &sampleOffset, &sampleSize, &sampleDescriptionIndex );
+						err = SampleReader_GetSample( &sr, i, &sampleOffset, &sampleSize, &dataP );
+						if (err) {
+							errprint("Sample %ld could not be read (err %d); the track's remaining samples are not validated\n", i, err);
+							break;
+						}
 						sampleprint("<sample num=\"%d\" offset=\"%s\" size=\"%d\" />\n",1,int64toxstr(sampleOffset),sampleSize); vg.tabcnt++;
-							BAILIFNIL( dataP = (Ptr)malloc(sampleSize), allocFailedErr );
-							err = GetFileData( vg.fileaoe, dataP, sampleOffset, sampleSize, nil );
+							BAILIFNIL( dataP, allocFailedErr );
 							
 							BitBuffer_Init(&bb, (UInt8 *)dataP, sampleSize);
 
 							Validate_sdsm_sample_Bitstream( &bb, tir);
-							free( dataP );
 						--vg.tabcnt; sampleprint("</sample>\n");
 					}
 				}
+				SampleReader_PrintStats( &sr );
 				--vg.tabcnt; sampleprint("</sdsm_SAMPLE_DATA>\n");
 			}
 			break;
@@ -765,11 +1093,11 @@ OSErr Validate_trak_Atom( atomOffsetEntry *aoe, void *refcon )
 			break;
 	}
 	
-	if(vg.cmaf)
-            checkCMAFBoxOrder_trak(cnt,list);
+	checkBoxOrder( 'trak', cnt, list );
 	
 	aoe->aoeflags |= kAtomValidated;
 bail:
+	SampleReader_Dispose( &sr );
 	return err;
 }
 //==========================================================================================
@@ -925,8 +1253,10 @@ OSErr Validate_stbl_Atom( atomOffsetEntry *aoe, void *refcon )
 		    warnprint("WARNING: STSC empty; with an empty STSC atom, chunk mapping is not verifiable\n");
 	}
 	
-	if(vg.cmaf)
-            checkCMAFBoxOrder_stbl(cnt,list);
+	atomerr = BuildSampleIndex( tir );
+	if (!err) err = atomerr;
+	
+	checkBoxOrder( 'stbl', cnt, list );
 
 	aoe->aoeflags |= kAtomValidated;
 bail:
@@ -1001,7 +1331,7 @@ OSErr Validate_mvex_Atom( atomOffsetEntry *aoe, void *refcon )
     for(i = 0 ; i < vg.mir->numTIRs ; i++)
 	{
     	if(tir[i].default_sample_flags == 0xFFFFFFFF)
-            errprint("'mxvex' found but 'trex' box missing for track %d\n",i);
+            errprint("'mxvex' found but 'trex' box missing for track %ld\n",i);
 	}
 
 	//
@@ -1041,16 +1371,32 @@ OSErr ValidateAtomOfType( OSType theType, long flags, ValidateAtomTypeProcPtr va
 	Boolean cursampleprint;
 	Boolean traf_exists = false;
 	long traf_cnt = 0;
+	AtomTypeIndex *index;
+	UInt32 b = 0;
 	
 	cstr[0] = (theType >> 24) & 0xff;
 	cstr[1] = (theType >> 16) & 0xff;
 	cstr[2] = (theType >>  8) & 0xff;
 	cstr[3] = (theType >>  0) & 0xff;
 	
-	for (i = 0; i < cnt; i++) {
+	// with an index, start at the first atom of the type not yet seen validated, counting the ones ahead of it
+	i = 0;
+	index = AtomTypeIndexFor( list, cnt );
+	if (index) {
+		b = KeyIndexFind( &index->types, theType, index->numBuckets );
+		i = (b < index->numBuckets) ? index->buckets[b].pending : -1;
+		if ((b < index->numBuckets) && (flags & kTypeAtomFlagCountValidated))
+			typeCnt = index->buckets[b].settled;
+	}
+	
+	for (; (i >= 0) && (i < cnt); i = index ? index->next[i] : i + 1) {
 		entry = &list[i];
 		
-		if (entry->aoeflags & kAtomValidated) continue;
+		if (entry->aoeflags & kAtomValidated) {
+			if ((flags & kTypeAtomFlagCountValidated) && (entry->type == theType))
+				typeCnt++;
+			continue;
+		}
 		
 		if ((entry->type == theType) && ((entry->aoeflags & kAtomSkipThisAtom) == 0)) {
 			if ((flags & kTypeAtomFlagCanHaveAtMostOne) && (typeCnt > 1)) {
@@ -1059,12 +1405,12 @@ OSErr ValidateAtomOfType( OSType theType, long flags, ValidateAtomTypeProcPtr va
 			if ((flags & kTypeAtomFlagMustBeFirst) && (i>0)) {
                                 if(vg.cmaf){
                                     if(theType=='ftyp')
-                                        errprint("CMAF check violated: Section 7.3.1. \"The CMAF Header SHALL start with a FileTypeBox.\", but actually found at position %d", i+1);
+                                        errprint("CMAF check violated: Section 7.3.1. \"The CMAF Header SHALL start with a FileTypeBox.\", but actually found at position %ld", i+1);
                                     if(theType =='mvhd')
-                                        errprint("CMAF check violated: Section 7.3.1. \"The MovieBox SHALL start with a MovieHeaderBox.\", but actually found at position %d", i+1);
+                                        errprint("CMAF check violated: Section 7.3.1. \"The MovieBox SHALL start with a MovieHeaderBox.\", but actually found at position %ld", i+1);
                                 }
 				if (i==1) warnprint("Warning: atom %s before ftyp atom MUST be a signature\n",ostypetostr((&list[0])->type));
-				else errprint("Atom %s must be first and is actually at position %d\n",ostypetostr(theType),i+1);
+				else errprint("Atom %s must be first and is actually at position %ld\n",ostypetostr(theType),i+1);
 			}			
 			typeCnt++;
 			
@@ -1077,13 +1423,13 @@ OSErr ValidateAtomOfType( OSType theType, long flags, ValidateAtomTypeProcPtr va
 					if(typeCnt - traf_cnt == 0)
 						traf_exists = false;
 					else
-						errprint("CMAF check violated: Section 7.5.16. \"Every Track Fragment Box SHALL contain a Track Fragment Decode Time Box\", but 'traf' at position %d has none.\n", i);
+						errprint("CMAF check violated: Section 7.5.16. \"Every Track Fragment Box SHALL contain a Track Fragment Decode Time Box\", but 'traf' at position %ld has none.\n", i);
 				}
 			}
 			  
 			addAtomToPath( vg.curatompath, theType, typeCnt, curatompath );
 			if (vg.print_atompath) {
-				fprintf(stdout,"%s\n", vg.curatompath);
+				reportprint("%s\n", vg.curatompath);
 			}
 			curatomprint = vg.printatom;
 			cursampleprint = vg.printsample;
@@ -1095,7 +1441,7 @@ OSErr ValidateAtomOfType( OSType theType, long flags, ValidateAtomTypeProcPtr va
 			}
 			atomprint("<%s",cstr); vg.tabcnt++;
 				atomerr = CallValidateAtomTypeProc(validateProc, entry, 
-											entry->refconOverride?((void*) (entry->refconOverride)):refcon);
+											entry->refconOverride?entry->refconOverride:refcon);
 			--vg.tabcnt; atomprint("</%s>\n",cstr);
 			vg.printatom = curatomprint;
 			vg.printsample = cursampleprint;
@@ -1103,6 +1449,15 @@ OSErr ValidateAtomOfType( OSType theType, long flags, ValidateAtomTypeProcPtr va
 			if (!err) err = atomerr;
 		}
 	}
+	
+	if (index && (b < index->numBuckets)) {
+		AtomTypeBucket *bucket = &index->buckets[b];
+		
+		while ((bucket->pending >= 0) && (bucket->pending < cnt) && (list[bucket->pending].aoeflags & kAtomValidated)) {
+			bucket->settled++;
+			bucket->pending = index->next[bucket->pending];
+		}
+	}
 
 	// 
 	if ((flags & kTypeAtomFlagMustHaveOne)  && (typeCnt == 0)) {
@@ -1114,49 +1469,49 @@ OSErr ValidateAtomOfType( OSType theType, long flags, ValidateAtomTypeProcPtr va
 		
 		if( vg.cmaf){
                     if(theType =='moov')
-			errprint("CMAF check violated: Section 7.3.1. \"CMAF Header SHALL include one MovieBox.\", found %d 'moov' box\n", typeCnt);
+			errprint("CMAF check violated: Section 7.3.1. \"CMAF Header SHALL include one MovieBox.\", found %ld 'moov' box\n", typeCnt);
                     if(theType =='trex')
-			errprint("CMAF check violated: Section 7.5.14. \"Track Extends Boxes SHALL be present in a CMAF Track\", found %d\n", typeCnt);
+			errprint("CMAF check violated: Section 7.5.14. \"Track Extends Boxes SHALL be present in a CMAF Track\", found %ld\n", typeCnt);
                     if(theType =='trak')
-			errprint("CMAF check violated: Section 7.3.1. \"The MovieBox SHALL contain exactly one track containing media data.\", found %d\n", typeCnt);
+			errprint("CMAF check violated: Section 7.3.1. \"The MovieBox SHALL contain exactly one track containing media data.\", found %ld\n", typeCnt);
                     if(theType =='mfhd')
-                        errprint("CMAF check violated: Section 7.3.2.4. \"Each CMAF Fragment SHALL contain a MovieFragmentHeaderBox.\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.2.4. \"Each CMAF Fragment SHALL contain a MovieFragmentHeaderBox.\", found %ld\n", typeCnt);
                     if(theType =='mvex')
-                        errprint("CMAF check violated: Section 7.3.1. \"The MovieBox SHALL contain a MovieExtendsBox.\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.1. \"The MovieBox SHALL contain a MovieExtendsBox.\", found %ld\n", typeCnt);
                     if(theType =='tenc')
-                        errprint("CMAF check violated: Section 7.3.1. \"The SchemeInformationbox SHALL contain a TrackEncryptionBox.\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.1. \"The SchemeInformationbox SHALL contain a TrackEncryptionBox.\", found %ld\n", typeCnt);
                     if(theType =='dref')
-                        errprint("CMAF check violated: Section 7.3.1. \"There SHALL be a Data Reference Box in Data Information Box.\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.1. \"There SHALL be a Data Reference Box in Data Information Box.\", found %ld\n", typeCnt);
                     if(theType =='vmhd')
-                        errprint("CMAF check violated: Section 7.3.1. \"The Media Information Box SHALL contain a Video Media Header for media type video\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.1. \"The Media Information Box SHALL contain a Video Media Header for media type video\", found %ld\n", typeCnt);
                     if(theType =='smhd')
-                        errprint("CMAF check violated: Section 7.3.1. \"The Media Information Box SHALL contain a Sound Media Header for media type audio\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.1. \"The Media Information Box SHALL contain a Sound Media Header for media type audio\", found %ld\n", typeCnt);
                     if(theType =='sthd')
-                        errprint("CMAF check violated: Section 7.3.1. \"The Media Information Box SHALL contain a Subtitle Media Header for media type subtitle\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.1. \"The Media Information Box SHALL contain a Subtitle Media Header for media type subtitle\", found %ld\n", typeCnt);
                     if(theType =='saio')
-                        errprint("CMAF check violated: Section 8.2.2.1. \"For encrypted CMAF Fragments that contain Sample Auxiliary Information, each TrackFragmentBox SHALL contain a 'saio'\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 8.2.2.1. \"For encrypted CMAF Fragments that contain Sample Auxiliary Information, each TrackFragmentBox SHALL contain a 'saio'\", found %ld\n", typeCnt);
                     
 		}
 	} else if ((flags & kTypeAtomFlagCanHaveAtMostOne) && (typeCnt > 1)) {
                 if(vg.cmaf){
                     if(theType =='moov')
-			errprint("CMAF check violated: Section 7.3.1. \"CMAF Header SHALL include one MovieBox.\", found %d 'moov' box\n", typeCnt);
+			errprint("CMAF check violated: Section 7.3.1. \"CMAF Header SHALL include one MovieBox.\", found %ld 'moov' box\n", typeCnt);
                     if(theType =='trak')
-                        errprint("CMAF check violated: Section 7.3.1. \"The MovieBox SHALL contain exactly one track containing media data.\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.1. \"The MovieBox SHALL contain exactly one track containing media data.\", found %ld\n", typeCnt);
                     if(theType =='mfhd')
-                        errprint("CMAF check violated: Section 7.3.2.3. \"Each CMAF Chunk/Fragment SHALL contain a MovieFragmentHeaderBox.\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.2.3. \"Each CMAF Chunk/Fragment SHALL contain a MovieFragmentHeaderBox.\", found %ld\n", typeCnt);
                     if(theType =='mvex')
-                        errprint("CMAF check violated: Section 7.3.1 \"The MovieBox SHALL contain a MovieExtendsBox.\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.1 \"The MovieBox SHALL contain a MovieExtendsBox.\", found %ld\n", typeCnt);
                     if(theType =='tenc')
-                        errprint("CMAF check violated: Section 7.3.1. \"The SchemeInformationbox SHALL contain a TrackEncryptionBox.\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.1. \"The SchemeInformationbox SHALL contain a TrackEncryptionBox.\", found %ld\n", typeCnt);
                     if(theType =='dref')
-                        errprint("CMAF check violated: Section 7.3.1. \"There SHALL be a Data Reference Box in Data Information Box.\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.1. \"There SHALL be a Data Reference Box in Data Information Box.\", found %ld\n", typeCnt);
                     if(theType =='vmhd')
-                        errprint("CMAF check violated: Section 7.3.1. \"The Media Information Box SHALL contain a Video Media Header for media type video\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.1. \"The Media Information Box SHALL contain a Video Media Header for media type video\", found %ld\n", typeCnt);
                     if(theType =='smhd')
-                        errprint("CMAF check violated: Section 7.3.1. \"The Media Information Box SHALL contain a Sound Media Header for media type audio\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.1. \"The Media Information Box SHALL contain a Sound Media Header for media type audio\", found %ld\n", typeCnt);
                     if(theType =='sthd')
-                        errprint("CMAF check violated: Section 7.3.1. \"The Media Information Box SHALL contain a Subtitle Media Header for media type subtitle\", found %d\n", typeCnt);
+                        errprint("CMAF check violated: Section 7.3.1. \"The Media Information Box SHALL contain a Subtitle Media Header for media type subtitle\", found %ld\n", typeCnt);
                 }
 		errprint("Multiple '%s' atoms not allowed\n",cstr);
 	}
@@ -1196,14 +1551,14 @@ OSErr Validate_ftyp_Atom( atomOffsetEntry *aoe, void *refcon )
 	
 	if(vg.cmaf){
             if(majorBrand=='cmfc' && version != 0)
-                errprint("CMAF Check violated : Section 7.2. \"If 'cmfc' is the major_brand, the minor_version SHALL be 0.\", found %ld\n",version);
+                errprint("CMAF Check violated : Section 7.2. \"If 'cmfc' is the major_brand, the minor_version SHALL be 0.\", found %d\n",version);
         }
 	
 	compatBrandListSize = (aoe->size - 8 - aoe->atomStartSize);
 	numCompatibleBrands = compatBrandListSize / sizeof(OSType);
 	
 	if (0 != (compatBrandListSize % sizeof(OSType))) {
-		errprint("FileType compatible brands array has leftover %d bytes\n", compatBrandListSize % sizeof(OSType));
+		errprint("FileType compatible brands array has leftover %ld bytes\n", compatBrandListSize % sizeof(OSType));
 	}
 	if (numCompatibleBrands <= 0) {
 		// must have at least one compatible brand, it must be the major brand
@@ -1294,7 +1649,7 @@ OSErr Validate_styp_Atom( atomOffsetEntry *aoe, void *refcon )
 	numCompatibleBrands = compatBrandListSize / sizeof(OSType);
 	
 	if (0 != (compatBrandListSize % sizeof(OSType))) {
-		errprint("FileType compatible brands array has leftover %d bytes\n", compatBrandListSize % sizeof(OSType));
+		errprint("FileType compatible brands array has leftover %ld bytes\n", compatBrandListSize % sizeof(OSType));
 	}
 	if (numCompatibleBrands <= 0) {
 		// must have at least one compatible brand, it must be the major brand
@@ -1309,19 +1664,11 @@ OSErr Validate_styp_Atom( atomOffsetEntry *aoe, void *refcon )
         bool msixFound = false;
 
         //Which segment is it?
-        int segmentNum;
-        bool segmentFound = false;
-        UInt64 offset = 0;
-        for(segmentNum = 0 ; segmentNum < vg.segmentInfoSize ; segmentNum++)
-        {       
-            if(aoe->offset == offset)
-            {
-                segmentFound = true;
-                break;
-            }
-            
-            offset += vg.segmentSizes[segmentNum];
-        }
+        int segmentNum = getSegmentNumberStartingAt(aoe->offset);
+        bool segmentFound = (segmentNum < vg.segmentInfoSize);
+        // the brands are in the styp itself; segmentEnds is no guide to where it is (and for streamed
+        //   input without -infofile the one segment ends at kStreamUnknownFileSize)
+        UInt64 offset = aoe->offset;
 
         if(segmentFound)
             vg.simsInStyp[segmentNum] = false;
@@ -1359,8 +1706,8 @@ OSErr Validate_styp_Atom( atomOffsetEntry *aoe, void *refcon )
             else if(currentBrand == 'lmsg') {
 				vg.dashSegment = true;
 				lmsgFoundInCompatibleBrands = true;
-				if(segmentFound && segmentNum != (vg.segmentInfoSize-1))
-                    errprint("Brand 'lmsg' found as a compatible brand for segment number %d (not the last segment %d); violates Section 7.3.1. of ISO/IEC 23009-1:2012(E): In all cases for which a Representation contains more than one Media Segment ... If the Media Segment is not the last Media Segment in the Representation, the 'lmsg' compatibility brand shall not be present.\n",segmentNum+1,vg.segmentInfoSize);
+				if(segmentFound && (segmentNum != (vg.segmentInfoSize-1) || vg.rangeCutsEnd))
+                    errprint("Brand 'lmsg' found as a compatible brand for segment number %d (not the last segment %ld); violates Section 7.3.1. of ISO/IEC 23009-1:2012(E): In all cases for which a Representation contains more than one Media Segment ... If the Media Segment is not the last Media Segment in the Representation, the 'lmsg' compatibility brand shall not be present.\n",segmentNum+1,vg.segmentInfoSize);
 			}
             else if(currentBrand == 'cmfc'){
                                 vg.dashSegment = true; // Equivalent to CMAF Fragment. Can be directly used in CMAF Fragment conformances.
@@ -1383,7 +1730,7 @@ OSErr Validate_styp_Atom( atomOffsetEntry *aoe, void *refcon )
 						     ostypetostr_r(majorBrand,tempstr2));
 			}
 
-		if (segmentFound && (segmentNum == (vg.segmentInfoSize - 1)) && (vg.dash264base || vg.dashifbase) && (vg.dynamic || vg.isoLive) && !lmsgFoundInCompatibleBrands) {
+		if (segmentFound && (segmentNum == (vg.segmentInfoSize - 1)) && !vg.rangeCutsEnd && (vg.dash264base || vg.dashifbase) && (vg.dynamic || vg.isoLive) && !lmsgFoundInCompatibleBrands) {
 			if (segmentFound && segmentNum != vg.segmentInfoSize)
 				warnprint("Warning: Brand 'lmsg' not found as a compatible brand for the last segment (number %d); violates Section 3.2.3. of Interoperability Point DASH264: If the MPD@type is equal to \"dynamic\" or if it includes MPD@profile attribute in-cludes \"urn:mpeg:dash:profile:isoff-live:2011\", then: if the Media Segment is the last Media Segment in the Representation, this Me-dia Segment shall carry the 'lmsg' compatibility brand\n", segmentNum + 1);
 		}
@@ -1464,7 +1811,7 @@ OSErr Validate_moov_Atom( atomOffsetEntry *aoe, void *refcon )
 		i = 0;
 	}
 
-	BAILIFNIL( vg.mir = (MovieInfoRec	*)calloc(1, sizeof(MovieInfoRec) + i), allocFailedErr );
+	BAILIFNIL( vg.mir = (MovieInfoRec	*)ArenaCalloc(&vg.arena, 1, sizeof(MovieInfoRec) + i), allocFailedErr );
 	mir = vg.mir;
     mir->fragmented = false; //unless 'mvex' is found in 'moov'
     
@@ -1489,7 +1836,7 @@ OSErr Validate_moov_Atom( atomOffsetEntry *aoe, void *refcon )
 		if (entry->type == 'trak') {
 			++(mir->numTIRs);
 			atomerr = Get_trak_Type(entry, &(mir->tirList[thisTrakIndex]));
-			entry->refconOverride = (long)&(mir->tirList[thisTrakIndex]);
+			entry->refconOverride = &(mir->tirList[thisTrakIndex]);
 			++thisTrakIndex;
 		}
 	}
@@ -1618,7 +1965,7 @@ OSErr Validate_moov_Atom( atomOffsetEntry *aoe, void *refcon )
 					if (tir->sampleToChunk[j].samplesPerChunk > 1) 
 						{ all_single = 0; break; }
 				}
-				if (all_single == 1) warnprint("Warning: track %d has %d chunks all containing 1 sample only\n",
+				if (all_single == 1) warnprint("Warning: track %ld has %d chunks all containing 1 sample only\n",
 												i,tir->chunkOffsetEntryCnt );
 			}
 		}
@@ -1643,7 +1990,7 @@ OSErr Validate_moov_Atom( atomOffsetEntry *aoe, void *refcon )
 		
 		trk_cnt = mir->numTIRs;
 		
-		BAILIFNULL( trk = (track_track *)calloc(trk_cnt,sizeof(track_track)), allocFailedErr );
+		BAILIFNULL( trk = (track_track *)ArenaCalloc(&vg.arena, trk_cnt,sizeof(track_track)), allocFailedErr );
 
 		for (i=0; i<(long)trk_cnt; ++i) {
 			// find the chunk counts for each track and setup structures
@@ -1654,11 +2001,12 @@ OSErr Validate_moov_Atom( atomOffsetEntry *aoe, void *refcon )
 			trk[i].chunk_num = 1;	// the next chunk to work on for each track
 			
 		}
-		BAILIFNULL( corp = (chunkOverlapRec *)calloc(totalChunks,sizeof(chunkOverlapRec)), allocFailedErr );
+		BAILIFNULL( corp = (chunkOverlapRec *)ArenaCalloc(&vg.arena, totalChunks,sizeof(chunkOverlapRec)), allocFailedErr );
 		
 		highwatermark = 0;		// the highest chunk end seen
 
-		do { // until we have processed all chunks of all tracks
+		// a fragmented movie may have no chunks at all in the movie box
+		if (totalChunks > 0) do { // until we have processed all chunks of all tracks
 			UInt32 lowest;
 			UInt64 low_offset = 0;
 			UInt64 chunkOffset, chunkStop;
@@ -1679,8 +2027,11 @@ OSErr Validate_moov_Atom( atomOffsetEntry *aoe, void *refcon )
 					}
 				}
 			}
-			if (lowest == (UInt32)-1) 
+			if (lowest == (UInt32)-1) {
 				errprint("aargh: program error!!!\n");
+				err = badAtomErr;
+				goto bail;
+			}
 						
 			tir = &(mir->tirList[lowest]);
 			BAILIFERR( GetChunkOffsetSize(tir, trk[lowest].chunk_num, &chunkOffset, &chunkSize, nil) );
@@ -1695,10 +2046,10 @@ OSErr Validate_moov_Atom( atomOffsetEntry *aoe, void *refcon )
 			
 			if (chunkOffset >= (UInt64)vg.inMaxOffset) 
 			{
-				errprint("Chunk offset %s is at or beyond file size  0x%lx\n", int64toxstr(chunkOffset), vg.inMaxOffset);
+				errprint("Chunk offset %s is at or beyond file size  %s\n", int64toxstr_r(chunkOffset, tempStr1), int64toxstr_r(vg.inMaxOffset, tempStr2));
 			} else if (chunkStop > (UInt64)vg.inMaxOffset) 
 			{
-				errprint("Chunk end %s is beyond file size  0x%lx\n", int64toxstr(chunkStop), vg.inMaxOffset);
+				errprint("Chunk end %s is beyond file size  %s\n", int64toxstr_r(chunkStop, tempStr1), int64toxstr_r(vg.inMaxOffset, tempStr2));
 			}
 			
 			if (chunkOffset >= highwatermark)
@@ -1782,8 +2133,7 @@ OSErr Validate_moov_Atom( atomOffsetEntry *aoe, void *refcon )
 		// until we have processed all chunks of all tracks
 	}
 		
-        if(vg.cmaf)
-            checkCMAFBoxOrder_moov(cnt,list);
+        checkBoxOrder( 'moov', cnt, list );
             
 	aoe->aoeflags |= kAtomValidated;
 bail:
@@ -1816,6 +2166,7 @@ OSErr Validate_moof_Atom( atomOffsetEntry *aoe, void *refcon )
 	maxOffset = aoe->offset + aoe->size - aoe->atomStartSize;
 
     moofInfo->offset = aoe->offset;
+    BAILIFERR( KeyIndexInsert( &mir->moofByOffset, moofInfo->offset, mir->processedFragments ) );
 	
 	BAILIFERR( FindAtomOffsets( aoe, minOffset, maxOffset, &cnt, &list ) );
 
@@ -1845,17 +2196,20 @@ OSErr Validate_moof_Atom( atomOffsetEntry *aoe, void *refcon )
 		if (list[i].type == 'traf')
             moofInfo->numTrackFragments++;
         
-		if (list[i].type == 'pssh') {
-			vg.psshFoundInSegment[getSegmentNumberByOffset(moofInfo->offset)] = true;
-		}
-        
-		if (list[i].type == 'tenc') {
-			vg.tencFoundInSegment[getSegmentNumberByOffset(moofInfo->offset)] = true;
+		if (list[i].type == 'pssh' || list[i].type == 'tenc') {
+			int segmentNum = getSegmentNumberByOffset(moofInfo->offset);
+
+			if (segmentNum < vg.segmentInfoSize) {
+				if (list[i].type == 'pssh')
+					vg.psshFoundInSegment[segmentNum] = true;
+				else
+					vg.tencFoundInSegment[segmentNum] = true;
+			}
 		}
 	}
 
     if(moofInfo->numTrackFragments > 0)
-        moofInfo->trafInfo = (TrafInfoRec *)malloc(moofInfo->numTrackFragments*sizeof(TrafInfoRec));
+        BAILIFNIL( moofInfo->trafInfo = (TrafInfoRec *)ArenaAlloc(&vg.arena, moofInfo->numTrackFragments*sizeof(TrafInfoRec)), allocFailedErr );
     else
         moofInfo->trafInfo = NULL;
 
@@ -1892,8 +2246,7 @@ OSErr Validate_moof_Atom( atomOffsetEntry *aoe, void *refcon )
     
     mir->processedFragments++;
     
-        if(vg.cmaf)
-            checkCMAFBoxOrder_moof(cnt,list);
+        checkBoxOrder( 'moof', cnt, list );
 
 	aoe->aoeflags |= kAtomValidated;
 bail:
@@ -1930,10 +2283,13 @@ OSErr Validate_traf_Atom( atomOffsetEntry *aoe, void *refcon )
         Validate_tfhd_Atom, cnt, list, trafInfo );
     if (!err) err = atomerr;
     
+    BAILIFERR( TrackFragmentsAppend( vg.mir, moofInfo->index, (UInt32)(trafInfo - moofInfo->trafInfo), trafInfo->track_ID ) );
+    
     trafInfo->numTrun = 0;
     trafInfo->processedTrun = 0;
     trafInfo->numSgpd = 0;
     trafInfo->processedSgpd = 0;
+    memset(&trafInfo->sgpdByGroupingType, 0, sizeof(KeyIndex));
     trafInfo->numSbgp = 0;
     trafInfo->processedSbgp = 0;
     trafInfo->tfdtFound = false;
@@ -1957,17 +2313,17 @@ OSErr Validate_traf_Atom( atomOffsetEntry *aoe, void *refcon )
         errprint("If the duration-is-empty flag is set in the tf_flags, there are no track runs.");
 
     if(trafInfo->numTrun > 0)
-        trafInfo->trunInfo = (TrunInfoRec *)malloc(trafInfo->numTrun*sizeof(TrunInfoRec));
+        BAILIFNIL( trafInfo->trunInfo = (TrunInfoRec *)ArenaAlloc(&vg.arena, trafInfo->numTrun*sizeof(TrunInfoRec)), allocFailedErr );
     else
         trafInfo->trunInfo = NULL;
     
     if(trafInfo->numSgpd > 0)
-        trafInfo->sgpdInfo = (SgpdInfoRec *)malloc(trafInfo->numSgpd*sizeof(SgpdInfoRec));
+        BAILIFNIL( trafInfo->sgpdInfo = (SgpdInfoRec *)ArenaAlloc(&vg.arena, trafInfo->numSgpd*sizeof(SgpdInfoRec)), allocFailedErr );
     else
         trafInfo->sgpdInfo = NULL;
     
     if(trafInfo->numSbgp > 0)
-        trafInfo->sbgpInfo = (SbgpInfoRec *)malloc(trafInfo->numSbgp*sizeof(SbgpInfoRec));
+        BAILIFNIL( trafInfo->sbgpInfo = (SbgpInfoRec *)ArenaAlloc(&vg.arena, trafInfo->numSbgp*sizeof(SbgpInfoRec)), allocFailedErr );
     else
         trafInfo->sbgpInfo = NULL;
     
@@ -2009,6 +2365,10 @@ OSErr Validate_traf_Atom( atomOffsetEntry *aoe, void *refcon )
             atomerr = ValidateAtomOfType( 'saio', kTypeAtomFlagMustHaveOne, 
                 Validate_saio_Atom, cnt, list, trafInfo );
             if (!err) err = atomerr;
+
+            atomerr = ValidateAtomOfType( 'saiz', kTypeAtomFlagCanHaveAtMostOne, 
+                Validate_saiz_Atom, cnt, list, trafInfo );
+            if (!err) err = atomerr;
         }
     
     }
@@ -2057,126 +2417,25 @@ OSErr Validate_traf_Atom( atomOffsetEntry *aoe, void *refcon )
 
     moofInfo->compositionInfoMissingPerTrack[index] = moofInfo->compositionInfoMissingPerTrack[index] || trafInfo->compositionInfoMissing;
 
-        if(vg.cmaf)
-            checkCMAFBoxOrder_traf(cnt,list);
+        checkBoxOrder( 'traf', cnt, list );
         
 	aoe->aoeflags |= kAtomValidated;
 bail:
 	return err;
 }
 
+// mir and everything hanging off it live in vg.arena, as does whatever else was parsed on the way
 void dispose_mir( MovieInfoRec *mir )
 {
-    
-    if(mir->moofInfo)
-    {
-        UInt32 i;
-
-        for(i = 0 ; i < mir->numFragments ; i++)
-        {
-
-            //printf("Fragment number %d / %d\n",i,mir->numFragments);
-
-            if(mir->moofInfo[i].trafInfo != NULL)
-            {
-                    UInt32 j;
-                    
-                    for(j = 0 ; j < mir->moofInfo[i].numTrackFragments ; j++)
-                    {
-                        //printf("Track Fragment number %d / %d, ptr %x\n",j,mir->moofInfo[i].numTrackFragments,&(mir->moofInfo[i].trafInfo[j]));
-                        
-                        if(mir->moofInfo[i].trafInfo[j].trunInfo != NULL)
-                        {
-                            UInt32 k;
-
-                            for(k = 0 ; k < mir->moofInfo[i].trafInfo[j].numTrun ; k++)
-                            {
-                                if(mir->moofInfo[i].trafInfo[j].trunInfo[k].sample_duration != NULL)
-                                    free(mir->moofInfo[i].trafInfo[j].trunInfo[k].sample_duration);
-                                
-                                if(mir->moofInfo[i].trafInfo[j].trunInfo[k].sample_size != NULL)
-                                    free(mir->moofInfo[i].trafInfo[j].trunInfo[k].sample_size);
-                                
-                                if(mir->moofInfo[i].trafInfo[j].trunInfo[k].sample_flags != NULL)
-                                    free(mir->moofInfo[i].trafInfo[j].trunInfo[k].sample_flags);
-                                
-                                if(mir->moofInfo[i].trafInfo[j].trunInfo[k].sample_composition_time_offset != NULL)
-                                    free(mir->moofInfo[i].trafInfo[j].trunInfo[k].sample_composition_time_offset);
-
-                                if(mir->moofInfo[i].trafInfo[j].trunInfo[k].samplePresentationTime != NULL)
-                                    free(mir->moofInfo[i].trafInfo[j].trunInfo[k].samplePresentationTime);
-                                
-                                if(mir->moofInfo[i].trafInfo[j].trunInfo[k].sampleToBePresented != NULL)
-                                    free(mir->moofInfo[i].trafInfo[j].trunInfo[k].sampleToBePresented);
-                                
-                                if(mir->moofInfo[i].trafInfo[j].trunInfo[k].sap3 != NULL)
-                                    free(mir->moofInfo[i].trafInfo[j].trunInfo[k].sap3);
-                                
-                                if(mir->moofInfo[i].trafInfo[j].trunInfo[k].sap4 != NULL)
-                                    free(mir->moofInfo[i].trafInfo[j].trunInfo[k].sap4);
-                            }
-
-                            if(mir->moofInfo[i].trafInfo[j].trunInfo != NULL)
-                                free(mir->moofInfo[i].trafInfo[j].trunInfo);
-
-                            if(mir->moofInfo[i].trafInfo[j].sbgpInfo != NULL)
-                            {
-                                for(k = 0 ; k < mir->moofInfo[i].trafInfo[j].numSbgp ; k++)
-                                {                                    
-                                    free(mir->moofInfo[i].trafInfo[j].sbgpInfo[k].sample_count);
-                                    free(mir->moofInfo[i].trafInfo[j].sbgpInfo[k].group_description_index);
-                                }
-                                
-                                free(mir->moofInfo[i].trafInfo[j].sbgpInfo);
-                            }
-                            
-                            if(mir->moofInfo[i].trafInfo[j].sgpdInfo != NULL)
-                            {
-                                for(k = 0 ; k < mir->moofInfo[i].trafInfo[j].numSgpd ; k++)
-                                {                                    
-                                    for(UInt32 l = 0 ; l < mir->moofInfo[i].trafInfo[j].sgpdInfo[k].entry_count ; l++)
-                                        free(mir->moofInfo[i].trafInfo[j].sgpdInfo[k].SampleGroupDescriptionEntry[l]);
-
-                                    free(mir->moofInfo[i].trafInfo[j].sgpdInfo[k].SampleGroupDescriptionEntry);
-                                    free(mir->moofInfo[i].trafInfo[j].sgpdInfo[k].description_length);
-                                }
-                                
-                                free(mir->moofInfo[i].trafInfo[j].sgpdInfo);
-                            }
-                        }
-                    }
-                        
-                free(mir->moofInfo[i].trafInfo);
-                free(mir->moofInfo[i].compositionInfoMissingPerTrack);
-                free(mir->moofInfo[i].moofEarliestPresentationTimePerTrack);
-                free(mir->moofInfo[i].moofPresentationEndTimePerTrack);
-                free(mir->moofInfo[i].moofLastPresentationTimePerTrack);
-                free(mir->moofInfo[i].tfdt);
-            }
-        }
-        
-        free(mir->moofInfo);
-    }
-
-    for(int i = 0 ; i < mir->numTIRs ; i++)
-        if(mir->tirList[i].leafInfo)
-            free(mir->tirList[i].leafInfo);
-
-    
-    if(mir->sidxInfo)
-    {
-        UInt32 i;
-
-        for(i = 0 ; i < mir->numSidx ; i++)
-        {
-            free(mir->sidxInfo[i].references);
-        }
-
-        free(mir->sidxInfo);
-    }
-
-	// for each track, get rid of the stuff in it
-	free( mir );
+#pragma unused(mir)
+	if (vg.print_memory)
+		ArenaPrintStats( &vg.arena, "movie state" );
+	ArenaRelease( &vg.arena );
+	vg.mir = NULL;
+	memset( &vg.atomTypeIndexByList, 0, sizeof(KeyIndex) );
+	vg.atomTypeIndexes = NULL;
+	vg.numAtomTypeIndexes = 0;
+	vg.atomTypeIndexCapacity = 0;
 }
 
 //==========================================================================================
@@ -2325,7 +2584,7 @@ static OSErr Validate_rtp_Atom( atomOffsetEntry *aoe, void *refcon )
     
     atomprintnotab(">\n"); 
 
-	BAILIFNIL( rtpDataP = (Ptr)malloc((UInt32)aoe->size), allocFailedErr );
+	BAILIFNIL( rtpDataP = (Ptr)ArenaAlloc(&vg.arena, (UInt32)aoe->size), allocFailedErr );
 
     dataSize = aoe->size - aoe->atomStartSize;
 	BAILIFERR( GetFileData(aoe, rtpDataP, aoe->offset + aoe->atomStartSize, dataSize, &temp64) );
@@ -2338,7 +2597,7 @@ static OSErr Validate_rtp_Atom( atomOffsetEntry *aoe, void *refcon )
 		// we found the sdp data
 		// make a copy and null terminate it
 		dataSize -= 4; // subtract the subtype field from the length 
-		BAILIFNIL( sdpDataP = (Ptr)malloc(dataSize+1), allocFailedErr );
+		BAILIFNIL( sdpDataP = (Ptr)ArenaAlloc(&vg.arena, dataSize+1), allocFailedErr );
 		memcpy(sdpDataP, current, dataSize);
 		sdpDataP[dataSize] = '\0';
 		
@@ -2443,8 +2702,7 @@ OSErr Validate_sinf_Atom( atomOffsetEntry *aoe, void *refcon, UInt32 flags )
 		if (!err) err = atomerr;
 	}
 	
-	if(vg.cmaf)
-            checkCMAFBoxOrder_sinf(cnt,list);
+	checkBoxOrder( 'sinf', cnt, list );
 	
 	aoe->aoeflags |= kAtomValidated;
 bail:
@@ -24,7 +24,6 @@ limitations under the License.
 #include "stdio.h"
 #include "stdlib.h"
 
-extern ValidateGlobals vg;
 
 //===============================================
 
@@ -76,7 +75,7 @@ OSErr Validate_iods_Atom( atomOffsetEntry *aoe, void *refcon )
 	UInt32 flags;
 	UInt64 offset;
 	Ptr odDataP = nil;
-	unsigned long odSize;
+	UInt32 odSize;
 	
 	// Get version/flags
 	BAILIFERR( GetFullAtomVersionFlags( aoe, &version, &flags, &offset ) );
@@ -92,8 +91,7 @@ OSErr Validate_iods_Atom( atomOffsetEntry *aoe, void *refcon )
 	aoe->aoeflags |= kAtomValidated;
 	
 bail:
-	if (odDataP)
-		free(odDataP);
+	ReleaseFileDataView(odDataP);
 
 	return err;
 }
@@ -106,8 +104,8 @@ typedef struct MovieHeaderCommonRecord {
     SInt16                          preferredVolume;           	// must be 1.0 for mp4
     short                           reserved1;					// must be 0
 
-    long                            preferredLong1;				// must be 0 for mp4
-    long                            preferredLong2;				// must be 0 for mp4
+    SInt32                          preferredLong1;				// must be 0 for mp4
+    SInt32                          preferredLong2;				// must be 0 for mp4
 
     MatrixRecord                    matrix;						// must be identity for mp4
 
@@ -120,7 +118,7 @@ typedef struct MovieHeaderCommonRecord {
     TimeValue                       selectionDuration;  		// must be 0 for mp4
     TimeValue                       currentTime;          		// must be 0 for mp4
 
-    long                            nextTrackID;
+    SInt32                          nextTrackID;
 } MovieHeaderCommonRecord;
 
 typedef struct MovieHeaderVers0Record {
@@ -191,13 +189,13 @@ OSErr Validate_mvhd_Atom( atomOffsetEntry *aoe, void *refcon )
 	
 	if(vg.cmaf){
 		if(mvhdHeadCommon.preferredRate != 0x00010000){
-			errprint("CMAF check violated: Section 7.5.1. \"The field rate SHALL be set to its default value\", found 0x%lx\n", mvhdHeadCommon.preferredRate);
+			errprint("CMAF check violated: Section 7.5.1. \"The field rate SHALL be set to its default value\", found 0x%x\n", mvhdHeadCommon.preferredRate);
 		}
 		if(mvhdHeadCommon.preferredVolume != 0x0100){
-			errprint("CMAF check violated: Section 7.5.1. \"The field volume SHALL be set to its default value\", found 0x%lx\n", mvhdHeadCommon.preferredVolume);
+			errprint("CMAF check violated: Section 7.5.1. \"The field volume SHALL be set to its default value\", found 0x%x\n", mvhdHeadCommon.preferredVolume);
 		}
 		if(mvhdHeadCommon.matrix[0][0] != 0 && mvhdHeadCommon.matrix[1][1] != 0 && mvhdHeadCommon.matrix[2][2] != 0x40000000){
-			errprint("CMAF check violated: Section 7.5.1. \"The field matrix SHALL be set to its default value\", found (0x%lx, 0x%lx, 0x%lx)\n", mvhdHeadCommon.matrix[0][0], mvhdHeadCommon.matrix[1][1], mvhdHeadCommon.matrix[2][2]);
+			errprint("CMAF check violated: Section 7.5.1. \"The field matrix SHALL be set to its default value\", found (0x%x, 0x%x, 0x%x)\n", mvhdHeadCommon.matrix[0][0], mvhdHeadCommon.matrix[1][1], mvhdHeadCommon.matrix[2][2]);
 		}
 	}
     
@@ -207,14 +205,14 @@ OSErr Validate_mvhd_Atom( atomOffsetEntry *aoe, void *refcon )
 	atomprint("modificationTime=\"%s\"\n", int64toxstr(mvhdHead.modificationTime));
 	atomprint("timeScale=\"%s\"\n", int64todstr(mvhdHead.timeScale));
 	atomprint("duration=\"%s\"\n", int64todstr(mvhdHead.duration));
-	atomprint("nextTrackID=\"%ld\"\n", mvhdHeadCommon.nextTrackID);
+	atomprint("nextTrackID=\"%d\"\n", mvhdHeadCommon.nextTrackID);
 	atomprint(">\n"); 
 
 	mir->mvhd_timescale = mvhdHead.timeScale;    //Used for edit lists
 
 	// Check required field values
-	FieldMustBe( mvhdHeadCommon.preferredRate, 0x00010000, "'mvhd' preferredRate must be 0x%lx not 0x%lx" );
-	FieldMustBe( mvhdHeadCommon.preferredVolume, 0x0100, "'mvhd' preferredVolume must be 0x%lx not 0x%lx" );
+	FieldMustBe( mvhdHeadCommon.preferredRate, 0x00010000, "'mvhd' preferredRate must be 0x%x not 0x%x" );
+	FieldMustBe( mvhdHeadCommon.preferredVolume, 0x0100, "'mvhd' preferredVolume must be 0x%x not 0x%x" );
 	FieldMustBe( mvhdHeadCommon.reserved1, 0, "'mvhd' has a non-zero reserved field, should be %d is %d" );
 	FieldMustBe( mvhdHeadCommon.reserved1, 0, "'mvhd' has a non-zero reserved field, should be %d is %d" );
 	FieldMustBe( mvhdHeadCommon.preferredLong1, 0, "'mvhd' has a non-zero reserved field, should be %d is %d" );
@@ -325,7 +323,7 @@ OSErr Validate_tkhd_Atom( atomOffsetEntry *aoe, void *refcon )
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
 	atomprint("creationTime=\"%s\"\n", int64toxstr(tkhdHead.creationTime));
 	atomprint("modificationTime=\"%s\"\n", int64toxstr(tkhdHead.modificationTime));
-	atomprint("trackID=\"%ld\"\n", tkhdHead.trackID);
+	atomprint("trackID=\"%d\"\n", tkhdHead.trackID);
 	atomprint("duration=\"%s\"\n", int64todstr(tkhdHead.duration));
 	atomprint("volume=\"%s\"\n", fixed16str(tkhdHeadCommon.volume));
 	atomprint("width=\"%s\"\n", fixedU32str(tkhdHeadCommon.trackWidth));
@@ -335,8 +333,8 @@ OSErr Validate_tkhd_Atom( atomOffsetEntry *aoe, void *refcon )
 	// Check required field values
 	// else FieldMustBe( flags, 1, "'tkhd' flags must be 1" );
 	if ((flags & 7) != flags) errprint("Tkhd flags 0x%X other than 1,2 or 4 set\n", flags);
-	if (flags == 0) warnprint( "WARNING: 'tkhd' flags == 0 (OK in a hint track)\n", flags );
-	if (tkhdHead.duration == 0 && !vg.dashSegment) warnprint( "WARNING: 'tkhd' duration == 0, track may be considered empty\n", flags );
+	if (flags == 0) warnprint( "WARNING: 'tkhd' flags == 0 (OK in a hint track)\n" );
+	if (tkhdHead.duration == 0 && !vg.dashSegment) warnprint( "WARNING: 'tkhd' duration == 0, track may be considered empty\n" );
 
 
 	FieldMustBe( tkhdHeadCommon.movieTimeOffset, 0, "'tkhd' movieTimeOffset must be %d not %d" );
@@ -360,7 +358,7 @@ OSErr Validate_tkhd_Atom( atomOffsetEntry *aoe, void *refcon )
 		}
 	
 		if((tkhdHeadCommon.matrix[0][0] != 0 && tkhdHeadCommon.matrix[1][1] != 0 && tkhdHeadCommon.matrix[2][2] != 0x40000000) || (tkhdHeadCommon.matrix[0][0] != 0x00010000 && tkhdHeadCommon.matrix[1][1] != 0x00010000 && tkhdHeadCommon.matrix[2][2] != 0x40000000)){
-			errprint("CMAF check violated: Section 7.5.4. \"The field matrix SHALL be set their default values\", found (0x%lx, 0x%lx, 0x%lx)\n", tkhdHeadCommon.matrix[0][0], tkhdHeadCommon.matrix[1][1], tkhdHeadCommon.matrix[2][2]);
+			errprint("CMAF check violated: Section 7.5.4. \"The field matrix SHALL be set their default values\", found (0x%x, 0x%x, 0x%x)\n", tkhdHeadCommon.matrix[0][0], tkhdHeadCommon.matrix[1][1], tkhdHeadCommon.matrix[2][2]);
 		}
 	
 		if(tir->mediaType == 'soun'){
@@ -374,6 +372,7 @@ OSErr Validate_tkhd_Atom( atomOffsetEntry *aoe, void *refcon )
 		tir->trackID = tkhdHead.trackID;
 		tir->trackWidth = tkhdHeadCommon.trackWidth;
 		tir->trackHeight = tkhdHeadCommon.trackHeight;
+		BAILIFERR( KeyIndexInsert( &vg.mir->trakByID, tir->trackID, (UInt32)(tir - vg.mir->tirList) ) );
 	}
 	else errprint("Internal error -- Track ID %d not recorded\n",tkhdHead.trackID);
 
@@ -502,8 +501,8 @@ OSErr Validate_mdia_hdlr_Atom( atomOffsetEntry *aoe, void *refcon )
 	UInt32 version;
 	UInt32 flags;
 	UInt64 offset;
-	HandlerInfoRecord	*hdlrInfo = (HandlerInfoRecord *)malloc(sizeof(HandlerInfoRecord));
-	char *nameP;
+	HandlerInfoRecord	*hdlrInfo = (HandlerInfoRecord *)ArenaAlloc(&vg.arena, sizeof(HandlerInfoRecord));
+	char *nameP = nil;
 
 	// Get version/flags
 	BAILIFERR( GetFullAtomVersionFlags( aoe, &version, &flags, &offset ) );
@@ -522,7 +521,7 @@ OSErr Validate_mdia_hdlr_Atom( atomOffsetEntry *aoe, void *refcon )
 
 	// Remember info in the refcon
 	if (vg.print_atompath) {
-		fprintf(stdout,"\t\tHandler subtype = '%s'\n", ostypetostr(hdlrInfo->componentSubType));
+		reportprint("\t\tHandler subtype = '%s'\n", ostypetostr(hdlrInfo->componentSubType));
 	}
 	tir->mediaType = hdlrInfo->componentSubType;
 	atomprint("handler_type=\"%s\"\n", ostypetostr(hdlrInfo->componentSubType));
@@ -532,10 +531,10 @@ OSErr Validate_mdia_hdlr_Atom( atomOffsetEntry *aoe, void *refcon )
 	//atomprint("name=\"%s\"\n", nameP);
 
 	// Check required field values
-	FieldMustBe( hdlrInfo->componentType, 0, "'hdlr' componentType (reserved in mp4) must be %d not 0x%lx" );
-	FieldMustBe( hdlrInfo->componentManufacturer, 0, "'hdlr' componentManufacturer (reserved in mp4) must be %d not 0x%lx" );
-	FieldMustBe( hdlrInfo->componentFlags, 0, "'hdlr' componentFlags (reserved in mp4) must be %d not 0x%lx" );
-	FieldMustBe( hdlrInfo->componentFlagsMask, 0, "'hdlr' componentFlagsMask (reserved in mp4) must be %d not 0x%lx" );
+	FieldMustBe( hdlrInfo->componentType, 0, "'hdlr' componentType (reserved in mp4) must be %d not 0x%x" );
+	FieldMustBe( hdlrInfo->componentManufacturer, 0, "'hdlr' componentManufacturer (reserved in mp4) must be %d not 0x%x" );
+	FieldMustBe( hdlrInfo->componentFlags, 0, "'hdlr' componentFlags (reserved in mp4) must be %d not 0x%x" );
+	FieldMustBe( hdlrInfo->componentFlagsMask, 0, "'hdlr' componentFlagsMask (reserved in mp4) must be %d not 0x%x" );
 
 		FieldMustBeOneOf11( hdlrInfo->componentSubType, OSType, 
 			"'hdlr' handler type must be be one of ", 
@@ -551,6 +550,7 @@ OSErr Validate_mdia_hdlr_Atom( atomOffsetEntry *aoe, void *refcon )
 	aoe->aoeflags |= kAtomValidated;
 
 bail:
+	free(nameP);
 	return err;
 }
 
@@ -560,8 +560,8 @@ OSErr Validate_hdlr_Atom( atomOffsetEntry *aoe, void *refcon )
 	UInt32 version;
 	UInt32 flags;
 	UInt64 offset;
-	HandlerInfoRecord	*hdlrInfo = (HandlerInfoRecord *)malloc(sizeof(HandlerInfoRecord));
-	char *nameP;
+	HandlerInfoRecord	*hdlrInfo = (HandlerInfoRecord *)ArenaAlloc(&vg.arena, sizeof(HandlerInfoRecord));
+	char *nameP = nil;
 
 	// Get version/flags
 	BAILIFERR( GetFullAtomVersionFlags( aoe, &version, &flags, &offset ) );
@@ -580,7 +580,7 @@ OSErr Validate_hdlr_Atom( atomOffsetEntry *aoe, void *refcon )
 
 	// Remember info in the refcon
 	if (vg.print_atompath) {
-		fprintf(stdout,"\t\tHandler subtype = '%s'\n", ostypetostr(hdlrInfo->componentSubType));
+		reportprint("\t\tHandler subtype = '%s'\n", ostypetostr(hdlrInfo->componentSubType));
 	}
 	atomprint("handler_type=\"%s\"\n", ostypetostr(hdlrInfo->componentSubType));
 	
@@ -589,16 +589,17 @@ OSErr Validate_hdlr_Atom( atomOffsetEntry *aoe, void *refcon )
 	atomprint("name=\"%s\"\n", nameP);
 
 	// Check required field values
-	FieldMustBe( hdlrInfo->componentType, 0, "'hdlr' componentType (reserved in mp4) must be %d not 0x%lx" );
-	FieldMustBe( hdlrInfo->componentManufacturer, 0, "'hdlr' componentManufacturer (reserved in mp4) must be %d not 0x%lx" );
-	FieldMustBe( hdlrInfo->componentFlags, 0, "'hdlr' componentFlags (reserved in mp4) must be %d not 0x%lx" );
-	FieldMustBe( hdlrInfo->componentFlagsMask, 0, "'hdlr' componentFlagsMask (reserved in mp4) must be %d not 0x%lx" );
+	FieldMustBe( hdlrInfo->componentType, 0, "'hdlr' componentType (reserved in mp4) must be %d not 0x%x" );
+	FieldMustBe( hdlrInfo->componentManufacturer, 0, "'hdlr' componentManufacturer (reserved in mp4) must be %d not 0x%x" );
+	FieldMustBe( hdlrInfo->componentFlags, 0, "'hdlr' componentFlags (reserved in mp4) must be %d not 0x%x" );
+	FieldMustBe( hdlrInfo->componentFlagsMask, 0, "'hdlr' componentFlagsMask (reserved in mp4) must be %d not 0x%x" );
 	
 	// All done
 	atomprint(">\n");
 	aoe->aoeflags |= kAtomValidated;
 
 bail:
+	free(nameP);
 	return err;
 }
 
@@ -670,17 +671,17 @@ OSErr Validate_vmhd_Atom( atomOffsetEntry *aoe, void *refcon )
 			errprint("CMAF check violated: Section 7.5.6. \"The following field SHALL be set to its default value: graphicsmode=0\", found %d\n",vmhdInfo.graphicsMode);
 		}
 		if(vmhdInfo.opColorRed != 0 && vmhdInfo.opColorGreen != 0 && vmhdInfo.opColorBlue != 0){
-			errprint("CMAF check violated: Section 7.5.6. \"The following field SHALL be set to its default value: opcolor={0, 0, 0}\", found {0x%lx, 0x%lx, 0x%lx}\n",vmhdInfo.opColorRed, vmhdInfo.opColorGreen, vmhdInfo.opColorBlue);
+			errprint("CMAF check violated: Section 7.5.6. \"The following field SHALL be set to its default value: opcolor={0, 0, 0}\", found {0x%x, 0x%x, 0x%x}\n",vmhdInfo.opColorRed, vmhdInfo.opColorGreen, vmhdInfo.opColorBlue);
 		}
 	}
 	
 	// Check required field values
 	FieldMustBe( version, 0, "'vmhd' version must be %d not %d" );
-	FieldMustBe( flags, 1, "'vmhd' flags must be %d not 0x%lx" );
-	FieldMustBe( vmhdInfo.graphicsMode, 0, "'vmhd' graphicsMode (reserved in mp4) must be %d not 0x%lx" );
-	FieldMustBe( vmhdInfo.opColorRed,   0, "'vmhd' opColorRed   (reserved in mp4) must be %d not 0x%lx" );
-	FieldMustBe( vmhdInfo.opColorGreen, 0, "'vmhd' opColorGreen (reserved in mp4) must be %d not 0x%lx" );
-	FieldMustBe( vmhdInfo.opColorBlue,  0, "'vmhd' opColorBlue  (reserved in mp4) must be %d not 0x%lx" );
+	FieldMustBe( flags, 1, "'vmhd' flags must be %d not 0x%x" );
+	FieldMustBe( vmhdInfo.graphicsMode, 0, "'vmhd' graphicsMode (reserved in mp4) must be %d not 0x%x" );
+	FieldMustBe( vmhdInfo.opColorRed,   0, "'vmhd' opColorRed   (reserved in mp4) must be %d not 0x%x" );
+	FieldMustBe( vmhdInfo.opColorGreen, 0, "'vmhd' opColorGreen (reserved in mp4) must be %d not 0x%x" );
+	FieldMustBe( vmhdInfo.opColorBlue,  0, "'vmhd' opColorBlue  (reserved in mp4) must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -719,9 +720,9 @@ OSErr Validate_smhd_Atom( atomOffsetEntry *aoe, void *refcon )
 	atomprint(">\n"); 
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'smhd' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'smhd' flags must be %d not 0x%x" );
 	FieldMustBe( smhdInfo.balance, 0, "'smhd' balance (reserved in mp4) must be %d not %d" );
-	FieldMustBe( smhdInfo.rsrvd,   0, "'smhd' rsrvd must be %d not 0x%lx" );
+	FieldMustBe( smhdInfo.rsrvd,   0, "'smhd' rsrvd must be %d not 0x%x" );
 
         if(vg.cmaf && smhdInfo.balance !=0)
             errprint("CMAF check violated: Section 7.5.7. \"The balance field in SoundMediaHeaderBox SHALL be set to its default value 0\", found %d\n",smhdInfo.balance);
@@ -766,15 +767,15 @@ OSErr Validate_hmhd_Atom( atomOffsetEntry *aoe, void *refcon )
 	
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("maxPDUsize=\"%ld\"\n", hmhdInfo.maxPDUsize);
-	atomprint("avgPDUsize=\"%ld\"\n", hmhdInfo.avgPDUsize);
-	atomprint("maxbitrate=\"%ld\"\n", hmhdInfo.maxbitrate);
-	atomprint("avgbitrate=\"%ld\"\n", hmhdInfo.avgbitrate);
-	atomprint("slidingavgbitrate=\"%ld\"\n", hmhdInfo.slidingavgbitrate);
+	atomprint("maxPDUsize=\"%d\"\n", hmhdInfo.maxPDUsize);
+	atomprint("avgPDUsize=\"%d\"\n", hmhdInfo.avgPDUsize);
+	atomprint("maxbitrate=\"%d\"\n", hmhdInfo.maxbitrate);
+	atomprint("avgbitrate=\"%d\"\n", hmhdInfo.avgbitrate);
+	atomprint("slidingavgbitrate=\"%d\"\n", hmhdInfo.slidingavgbitrate);
 	atomprint(">\n"); 
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'hmdh' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'hmdh' flags must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -801,7 +802,7 @@ OSErr Validate_sthd_Atom( atomOffsetEntry *aoe, void *refcon )
         atomprint(">\n"); 
         
         // Check required field values
-        FieldMustBe( flags, 0, "'sthd' flags must be %d not 0x%lx" );
+        FieldMustBe( flags, 0, "'sthd' flags must be %d not 0x%x" );
         
         // All done
         aoe->aoeflags |= kAtomValidated;
@@ -832,7 +833,7 @@ OSErr Validate_nmhd_Atom( atomOffsetEntry *aoe, void *refcon )
 //����� need to check for underrun
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'nmhd' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'nmhd' flags must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -863,7 +864,7 @@ OSErr Validate_mp4s_Atom( atomOffsetEntry *aoe, void *refcon )
 	atomprint("/>\n"); 
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'mp4s' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'mp4s' flags must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -909,7 +910,7 @@ OSErr Validate_url_Entry( atomOffsetEntry *aoe, void *refcon )
 //���	FieldMustBe( flags, 0, "'mp4s' flags must be 0" );
 //���   need to check that the atom has ended.
         if(vg.cmaf && flags != 0x000001){
-		errprint("CMAF check violated: Section 7.5.9. \"The Data Reference Box ('dref') SHALL contain a single entry with the entry_flags set to 0x000001 \", found 0x%lx\n", flags); //Single entry has been checked in 'dref' validation.
+		errprint("CMAF check violated: Section 7.5.9. \"The Data Reference Box ('dref') SHALL contain a single entry with the entry_flags set to 0x000001 \", found 0x%x\n", flags); //Single entry has been checked in 'dref' validation.
 	}
 	
 	// All done
@@ -956,13 +957,15 @@ OSErr Validate_urn_Entry( atomOffsetEntry *aoe, void *refcon )
 //���	FieldMustBe( flags, 0, "'mp4s' flags must be 0" );
 //���   need to check that the atom has ended.
         if(vg.cmaf && flags != 0x000001){
-		errprint("CMAF check violated: Section 7.5.9. \"The Data Reference Box ('dref') SHALL contain a single entry with the entry_flags set to 0x000001 \", found 0x%lx\n", flags); //Single entry has been checked in 'dref' validation.
+		errprint("CMAF check violated: Section 7.5.9. \"The Data Reference Box ('dref') SHALL contain a single entry with the entry_flags set to 0x000001 \", found 0x%x\n", flags); //Single entry has been checked in 'dref' validation.
 	}
 	
 	// All done
 	aoe->aoeflags |= kAtomValidated;
 
 bail:
+	free(nameP);
+	free(locationP);
 	return err;
 }
 
@@ -986,16 +989,16 @@ OSErr Validate_dref_Atom( atomOffsetEntry *aoe, void *refcon )
 	BAILIFERR( GetFileDataN32( aoe, &entryCount, offset, &offset ) );
 	
 	if(vg.cmaf && entryCount != 1){
-		errprint("CMAF check violated: Section 7.5.9. \"The Data Reference Box ('dref') SHALL contain a single entry \", found %ld\n", entryCount);
+		errprint("CMAF check violated: Section 7.5.9. \"The Data Reference Box ('dref') SHALL contain a single entry \", found %d\n", entryCount);
 	}
 	
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 	atomprint(">\n"); //vg.tabcnt++; 
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'dref' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'dref' flags must be %d not 0x%x" );
 
 	//need to validate url urn
 	{
@@ -1071,17 +1074,13 @@ OSErr Validate_stts_Atom( atomOffsetEntry *aoe, void *refcon )
 	BAILIFERR( GetFileDataN32( aoe, &entryCount, offset, &offset ) );
 		//  adding 1 to entryCount to make this 1 based array
 	listSize = entryCount * sizeof(TimeToSampleNum);
-	BAILIFNULL( listP = (TimeToSampleNum *)malloc(listSize + sizeof(TimeToSampleNum)), allocFailedErr );
-	BAILIFERR( GetFileData( aoe, &listP[1], offset, listSize, &offset ) );
+	BAILIFNULL( listP = (TimeToSampleNum *)ArenaAlloc(&vg.arena, listSize + sizeof(TimeToSampleNum)), allocFailedErr );
+	BAILIFERR( GetFileDataN32Array( aoe, (UInt32 *)&listP[1], (UInt64)entryCount * 2, offset, &offset ) );
 	listP[0].sampleCount = 0; listP[0].sampleDuration = 0;
-	for ( i = 1; i <= entryCount; i++ ) {
-		listP[i].sampleCount = EndianS32_BtoN(listP[i].sampleCount);
-		listP[i].sampleDuration = EndianS32_BtoN(listP[i].sampleDuration);
-	}
 
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 	atomprint(">\n");
 	vg.tabcnt++;
 
@@ -1108,7 +1107,7 @@ OSErr Validate_stts_Atom( atomOffsetEntry *aoe, void *refcon )
 	--vg.tabcnt;
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'stts' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'stts' flags must be %d not 0x%x" );
 
 	if (lastSampleDurationIsZero) {
 		if ((tir->mediaDuration) && (totalDuration > tir->mediaDuration)) {
@@ -1140,7 +1139,7 @@ bail:
 
 
 typedef struct CompositionTimeToSampleNum {
-    long             sampleCount;
+    SInt32           sampleCount;
     TimeValue        sampleOffset;
 } CompositionTimeToSampleNum;
 
@@ -1164,16 +1163,12 @@ OSErr Validate_ctts_Atom( atomOffsetEntry *aoe, void *refcon )
 	// Get data 
 	BAILIFERR( GetFileDataN32( aoe, &entryCount, offset, &offset ) );
 	listSize = entryCount * sizeof(TimeToSampleNum);
-	BAILIFNIL( listP = (CompositionTimeToSampleNum *)malloc(listSize), allocFailedErr );
-	BAILIFERR( GetFileData( aoe, listP, offset, listSize, &offset ) );
-	for ( i = 0; i < entryCount; i++ ) {
-		listP[i].sampleCount = EndianS32_BtoN(listP[i].sampleCount);
-		listP[i].sampleOffset = EndianS32_BtoN(listP[i].sampleOffset);
-	}
+	BAILIFNIL( listP = (CompositionTimeToSampleNum *)ArenaAlloc(&vg.arena, listSize), allocFailedErr );
+	BAILIFERR( GetFileDataN32Array( aoe, (UInt32 *)listP, (UInt64)entryCount * 2, offset, &offset ) );
 	
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 	atomprint(">\n");
 	vg.tabcnt++;
 	
@@ -1193,7 +1188,7 @@ OSErr Validate_ctts_Atom( atomOffsetEntry *aoe, void *refcon )
 	--vg.tabcnt;
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'ctts' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'ctts' flags must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -1227,11 +1222,8 @@ OSErr Validate_stsz_Atom( atomOffsetEntry *aoe, void *refcon )
 	if ((sampleSize == 0) && entryCount) {
 		listSize = entryCount * sizeof(SampleSizeRecord);
 			// 1 based array
-		BAILIFNIL( listP = (SampleSizeRecord *)malloc(listSize + sizeof(SampleSizeRecord)), allocFailedErr );
-		BAILIFERR( GetFileData( aoe, &listP[1], offset, listSize, &offset ) );
-		for ( i = 1; i <= entryCount; i++ ) {
-			listP[i].sampleSize = EndianS32_BtoN(listP[i].sampleSize);
-		}
+		BAILIFNIL( listP = (SampleSizeRecord *)ArenaAlloc(&vg.arena, listSize + sizeof(SampleSizeRecord)), allocFailedErr );
+		BAILIFERR( GetFileDataN32Array( aoe, (UInt32 *)&listP[1], entryCount, offset, &offset ) );
 	}
 	
 	if(vg.cmaf){
@@ -1242,8 +1234,8 @@ OSErr Validate_stsz_Atom( atomOffsetEntry *aoe, void *refcon )
 	
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("sampleSize=\"%ld\"\n", sampleSize);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("sampleSize=\"%d\"\n", sampleSize);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 	atomprint(">\n");
 	if ((sampleSize == 0) && entryCount) {
 		vg.tabcnt++;
@@ -1258,7 +1250,7 @@ OSErr Validate_stsz_Atom( atomOffsetEntry *aoe, void *refcon )
 	}
 	
 	// Check required field values
-	FieldMustBe( flags, 0, "'stsz' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'stsz' flags must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -1282,6 +1274,7 @@ OSErr Validate_stz2_Atom( atomOffsetEntry *aoe, void *refcon )
 	UInt8 fieldSize;
 	SampleSizeRecord *listP;
 	UInt32 listSize;
+	UInt8 *packedP = NULL;
 	UInt32 i;
 	
 	// Get version/flags
@@ -1293,7 +1286,7 @@ OSErr Validate_stz2_Atom( atomOffsetEntry *aoe, void *refcon )
 	BAILIFERR( GetFileDataN32( aoe, &entryCount, offset, &offset ) );
 	listSize = entryCount * sizeof(SampleSizeRecord);
 		// 1 based array + room for one over for the 4-bit case loop
-	BAILIFNIL( listP = (SampleSizeRecord *)malloc(listSize + sizeof(SampleSizeRecord) + sizeof(SampleSizeRecord)), allocFailedErr );
+	BAILIFNIL( listP = (SampleSizeRecord *)ArenaAlloc(&vg.arena, listSize + sizeof(SampleSizeRecord) + sizeof(SampleSizeRecord)), allocFailedErr );
 	
 	if(vg.cmaf && entryCount != 0){
 		errprint("CMAF check violated: Section 7.5.12. \"All boxes in SampleTableBox SHALL have or compute a sample count of 0\", found %d\n", entryCount);
@@ -1301,25 +1294,25 @@ OSErr Validate_stz2_Atom( atomOffsetEntry *aoe, void *refcon )
 	
 	if (entryCount) switch (fieldSize) {
 		case 4:
+			BAILIFNIL( packedP = (UInt8 *)malloc((entryCount+1)/2), allocFailedErr );
+			BAILIFERR( GetFileData( aoe, packedP, offset, (entryCount+1)/2, &offset ) );
 			for (i=0; i<((entryCount+1)/2); i++) {
-				UInt8 theSize;
-				BAILIFERR( GetFileData( aoe, &theSize, offset, 1, &offset ) );
-				listP[i*2 + 1].sampleSize = theSize >> 4;
-				listP[i*2 + 2].sampleSize = theSize & 0x0F;
+				listP[i*2 + 1].sampleSize = packedP[i] >> 4;
+				listP[i*2 + 2].sampleSize = packedP[i] & 0x0F;
 			}
 			break;
 		case 8:
+			BAILIFNIL( packedP = (UInt8 *)malloc(entryCount), allocFailedErr );
+			BAILIFERR( GetFileData( aoe, packedP, offset, entryCount, &offset ) );
 			for (i=1; i<=entryCount; i++) {
-				UInt8 theSize;
-				BAILIFERR( GetFileData( aoe, &theSize, offset, 1, &offset ) );
-				listP[i].sampleSize = theSize;
+				listP[i].sampleSize = packedP[i-1];
 			}
 			break;
 		case 16:
+			BAILIFNIL( packedP = (UInt8 *)malloc(entryCount * sizeof(UInt16)), allocFailedErr );
+			BAILIFERR( GetFileDataN16Array( aoe, (UInt16 *)packedP, entryCount, offset, &offset ) );
 			for (i=1; i<=entryCount; i++) {
-				UInt16 theSize;
-				BAILIFERR( GetFileDataN16( aoe, &theSize, offset, &offset ) );
-				listP[i].sampleSize = theSize;
+				listP[i].sampleSize = ((UInt16 *)packedP)[i-1];
 			}
 			break;
 		default: errprint("You can't have a field size of %d in stz2\n", fieldSize);
@@ -1327,8 +1320,8 @@ OSErr Validate_stz2_Atom( atomOffsetEntry *aoe, void *refcon )
 	
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("fieldSize=\"%ld\"\n", fieldSize);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("fieldSize=\"%d\"\n", fieldSize);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 	atomprint("/>\n");
 	if (entryCount) {
 		vg.tabcnt++;
@@ -1343,7 +1336,7 @@ OSErr Validate_stz2_Atom( atomOffsetEntry *aoe, void *refcon )
 	}
 	
 	// Check required field values
-	FieldMustBe( flags, 0, "'stz2' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'stz2' flags must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -1352,6 +1345,7 @@ OSErr Validate_stz2_Atom( atomOffsetEntry *aoe, void *refcon )
 	tir->sampleSize = listP;
 	
 bail:
+	if (packedP) free(packedP);
 	return err;
 }
 
@@ -1383,22 +1377,17 @@ OSErr Validate_stsc_Atom( atomOffsetEntry *aoe, void *refcon )
 	
 	listSize = entryCount * sizeof(SampleToChunk);
 			// 1 based array
-	BAILIFNIL( listP = (SampleToChunk *)malloc(listSize + sizeof(SampleToChunk)), allocFailedErr );
-	BAILIFERR( GetFileData( aoe, &listP[1], offset, listSize, &offset ) );
-	for ( i = 1; i <= entryCount; i++ ) {
-		listP[i].firstChunk = EndianU32_BtoN(listP[i].firstChunk);
-		listP[i].samplesPerChunk = EndianU32_BtoN(listP[i].samplesPerChunk);
-		listP[i].sampleDescriptionIndex = EndianU32_BtoN(listP[i].sampleDescriptionIndex);
-		if (i > 1) {
-			sampleToChunkSampleSubTotal += 
-				( listP[i].firstChunk - listP[i-1].firstChunk )
-					* ( listP[i-1].samplesPerChunk );
-		}
+	BAILIFNIL( listP = (SampleToChunk *)ArenaAlloc(&vg.arena, listSize + sizeof(SampleToChunk)), allocFailedErr );
+	BAILIFERR( GetFileDataN32Array( aoe, (UInt32 *)&listP[1], (UInt64)entryCount * 3, offset, &offset ) );
+	for ( i = 2; i <= entryCount; i++ ) {
+		sampleToChunkSampleSubTotal += 
+			( listP[i].firstChunk - listP[i-1].firstChunk )
+				* ( listP[i-1].samplesPerChunk );
 	}
 
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 	atomprint(">\n");
 	vg.tabcnt++;
 	
@@ -1415,7 +1404,7 @@ OSErr Validate_stsc_Atom( atomOffsetEntry *aoe, void *refcon )
 	--vg.tabcnt;
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'stsc' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'stsc' flags must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -1452,11 +1441,8 @@ OSErr Validate_stco_Atom( atomOffsetEntry *aoe, void *refcon )
 			// 1 based array
 	BAILIFNIL( listP = (ChunkOffsetRecord *)malloc(listSize + sizeof(ChunkOffsetRecord)), allocFailedErr );
 			// 1 based array
-	BAILIFNIL( list64P = (ChunkOffset64Record *)malloc((entryCount + 1) * sizeof(ChunkOffset64Record)), allocFailedErr );
-	BAILIFERR( GetFileData( aoe, &listP[1], offset, listSize, &offset ) );
-	for ( i = 1; i <= entryCount; i++ ) {
-		listP[i].chunkOffset = EndianU32_BtoN(listP[i].chunkOffset);
-	}
+	BAILIFNIL( list64P = (ChunkOffset64Record *)ArenaAlloc(&vg.arena, ((UInt64)entryCount + 1) * sizeof(ChunkOffset64Record)), allocFailedErr );
+	BAILIFERR( GetFileDataN32Array( aoe, (UInt32 *)&listP[1], entryCount, offset, &offset ) );
 	
 	if(vg.cmaf && entryCount != 0){
 		errprint("CMAF check violated: Section 7.5.12. \"All boxes in SampleTableBox SHALL have or compute a sample count of 0\", found %d\n", entryCount);
@@ -1464,7 +1450,7 @@ OSErr Validate_stco_Atom( atomOffsetEntry *aoe, void *refcon )
 	
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 
     if(vg.dashSegment && entryCount != 0)
         errprint("stco atom, entry_count %d, violating\nSection 6.3.3. of ISO/IEC 23009-1:2012(E): The tracks in the \"moov\" box shall contain no samples \n(i.e. the entry_count in the \"stts\", \"stsc\", and \"stco\" boxes shall be set to 0)\n",entryCount);
@@ -1473,7 +1459,7 @@ OSErr Validate_stco_Atom( atomOffsetEntry *aoe, void *refcon )
 	vg.tabcnt++;
 	list64P[0].chunkOffset = listP[0].chunkOffset = 0;
 	for ( i = 1; i <= entryCount; i++ ) {
-		atomprintdetailed("<stcoEntry chunkOffset=\"%ld\" />\n", listP[i].chunkOffset);
+		atomprintdetailed("<stcoEntry chunkOffset=\"%d\" />\n", listP[i].chunkOffset);
 		if (listP[i].chunkOffset == 0) {
 			errprint("You can't have a zero sample size in stco\n");
 		}
@@ -1482,7 +1468,7 @@ OSErr Validate_stco_Atom( atomOffsetEntry *aoe, void *refcon )
 	--vg.tabcnt;
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'stco' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'stco' flags must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -1515,15 +1501,12 @@ OSErr Validate_co64_Atom( atomOffsetEntry *aoe, void *refcon )
 	BAILIFERR( GetFileDataN32( aoe, &entryCount, offset, &offset ) );
 	listSize = entryCount * sizeof(ChunkOffset64Record);
 		// 1 based table
-	BAILIFNIL( listP = (ChunkOffset64Record *)malloc(listSize + sizeof(ChunkOffset64Record)), allocFailedErr );
-	BAILIFERR( GetFileData( aoe, &listP[1], offset, listSize, &offset ) );
-	for ( i = 1; i <= entryCount; i++ ) {
-		listP[i].chunkOffset = EndianU64_BtoN(listP[i].chunkOffset);
-	}
+	BAILIFNIL( listP = (ChunkOffset64Record *)ArenaAlloc(&vg.arena, listSize + sizeof(ChunkOffset64Record)), allocFailedErr );
+	BAILIFERR( GetFileDataN64Array( aoe, (UInt64 *)&listP[1], entryCount, offset, &offset ) );
 	
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 	atomprint("/>\n");
 	vg.tabcnt++;
 	listP[0].chunkOffset = 0;
@@ -1536,7 +1519,7 @@ OSErr Validate_co64_Atom( atomOffsetEntry *aoe, void *refcon )
 	--vg.tabcnt;
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'stco' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'stco' flags must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -1572,15 +1555,12 @@ OSErr Validate_stss_Atom( atomOffsetEntry *aoe, void *refcon )
 	// Get data 
 	BAILIFERR( GetFileDataN32( aoe, &entryCount, offset, &offset ) );
 	listSize = entryCount * sizeof(SyncSampleRecord);
-	BAILIFNIL( listP = (SyncSampleRecord *)malloc(listSize), allocFailedErr );
-	BAILIFERR( GetFileData( aoe, listP, offset, listSize, &offset ) );
-	for ( i = 0; i < entryCount; i++ ) {
-		listP[i].sampleNum = EndianU32_BtoN(listP[i].sampleNum);
-	}
+	BAILIFNIL( listP = (SyncSampleRecord *)ArenaAlloc(&vg.arena, listSize), allocFailedErr );
+	BAILIFERR( GetFileDataN32Array( aoe, (UInt32 *)listP, entryCount, offset, &offset ) );
 	
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 	atomprint(">\n");
 	vg.tabcnt++;
 	
@@ -1597,7 +1577,7 @@ OSErr Validate_stss_Atom( atomOffsetEntry *aoe, void *refcon )
 	--vg.tabcnt;
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'stss' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'stss' flags must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -1631,16 +1611,12 @@ OSErr Validate_stsh_Atom( atomOffsetEntry *aoe, void *refcon )
 	// Get data 
 	BAILIFERR( GetFileDataN32( aoe, &entryCount, offset, &offset ) );
 	listSize = entryCount * sizeof(ShadowSyncEntry);
-	BAILIFNIL( listP = (ShadowSyncEntry *)malloc(listSize), allocFailedErr );
-	BAILIFERR( GetFileData( aoe, listP, offset, listSize, &offset ) );
-	for ( i = 0; i < entryCount; i++ ) {
-		listP[i].shadowSyncNumber = EndianU32_BtoN(listP[i].shadowSyncNumber);
-		listP[i].syncSampleNumber = EndianU32_BtoN(listP[i].syncSampleNumber);
-	}
+	BAILIFNIL( listP = (ShadowSyncEntry *)ArenaAlloc(&vg.arena, listSize), allocFailedErr );
+	BAILIFERR( GetFileDataN32Array( aoe, (UInt32 *)listP, (UInt64)entryCount * 2, offset, &offset ) );
 	
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 	atomprint("/>\n");
 	vg.tabcnt++;
 	for ( i = 0; i < entryCount; i++ ) {
@@ -1653,7 +1629,7 @@ OSErr Validate_stsh_Atom( atomOffsetEntry *aoe, void *refcon )
 	--vg.tabcnt;
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'stsh' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'stsh' flags must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -1695,15 +1671,12 @@ OSErr Validate_stdp_Atom( atomOffsetEntry *aoe, void *refcon )
 	}
 	
 	listSize = entryCount * sizeof(DegradationPriority);
-	BAILIFNIL( listP = (DegradationPriority *)malloc(listSize), allocFailedErr );
-	BAILIFERR( GetFileData( aoe, listP, offset, listSize, &offset ) );
-	for ( i = 0; i < entryCount; i++ ) {
-		listP[i].priority = EndianU16_BtoN(listP[i].priority);
-	}
+	BAILIFNIL( listP = (DegradationPriority *)ArenaAlloc(&vg.arena, listSize), allocFailedErr );
+	BAILIFERR( GetFileDataN16Array( aoe, (UInt16 *)listP, entryCount, offset, &offset ) );
 	
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 	atomprint("/>\n");
 	vg.tabcnt++;
 	for ( i = 0; i < entryCount; i++ ) {
@@ -1715,7 +1688,7 @@ OSErr Validate_stdp_Atom( atomOffsetEntry *aoe, void *refcon )
 	--vg.tabcnt;
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'stdp' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'stdp' flags must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -1768,12 +1741,12 @@ OSErr Validate_sdtp_Atom( atomOffsetEntry *aoe, void *refcon )
 	}
 	
 	listSize = entryCount * sizeof(UInt8);
-	BAILIFNIL( listP = (UInt8 *)malloc(listSize), allocFailedErr );
+	BAILIFNIL( listP = (UInt8 *)ArenaAlloc(&vg.arena, listSize), allocFailedErr );
 	BAILIFERR( GetFileData( aoe, listP, offset, listSize, &offset ) );
 	
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 	atomprint("/>\n");
 	vg.tabcnt++;
 	for ( i = 0; i < entryCount; i++ ) {
@@ -1795,7 +1768,7 @@ OSErr Validate_sdtp_Atom( atomOffsetEntry *aoe, void *refcon )
 	--vg.tabcnt;
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'sdtp' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'sdtp' flags must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -1825,7 +1798,7 @@ OSErr Validate_padb_Atom( atomOffsetEntry *aoe, void *refcon )
 
 	listSize = entryCount * sizeof(UInt8);
 		// 1 based array + room for one over for the 4-bit case loop
-	BAILIFNIL( listP = (UInt8 *)malloc(listSize + sizeof(UInt8) + sizeof(UInt8)), allocFailedErr );
+	BAILIFNIL( listP = (UInt8 *)ArenaAlloc(&vg.arena, listSize + sizeof(UInt8) + sizeof(UInt8)), allocFailedErr );
 
 	for (i=0; i<((entryCount+1)/2); i++) {
 		UInt8 thePads;
@@ -1837,7 +1810,7 @@ OSErr Validate_padb_Atom( atomOffsetEntry *aoe, void *refcon )
 
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 	atomprint("/>\n");
 	vg.tabcnt++;
 	for ( i = 1; i <= entryCount; i++ ) {
@@ -1848,7 +1821,7 @@ OSErr Validate_padb_Atom( atomOffsetEntry *aoe, void *refcon )
 	--vg.tabcnt;
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'padb' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'padb' flags must be %d not 0x%x" );
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -1889,14 +1862,14 @@ OSErr Validate_elst_Atom( atomOffsetEntry *aoe, void *refcon )
     
 
 		listSize = entryCount * sizeof(EditListEntryVers1Record);
-		BAILIFNIL( listP = (EditListEntryVers1Record *)malloc(listSize), allocFailedErr );
+		BAILIFNIL( listP = (EditListEntryVers1Record *)ArenaAlloc(&vg.arena, listSize), allocFailedErr );
 
 		if (version == 0) {
 			UInt32 list0Size;
 			EditListEntryVers0Record *list0P;
 		
 			list0Size = entryCount * sizeof(EditListEntryVers0Record);
-			BAILIFNIL( list0P = (EditListEntryVers0Record *)malloc(list0Size), allocFailedErr );
+			BAILIFNIL( list0P = (EditListEntryVers0Record *)ArenaAlloc(&vg.arena, list0Size), allocFailedErr );
 			BAILIFERR( GetFileData( aoe, list0P, offset, list0Size, &offset ) );
 			for ( i = 0; i < entryCount; i++ ) {
 				listP[i].duration = EndianU32_BtoN(list0P[i].duration);
@@ -1925,12 +1898,12 @@ OSErr Validate_elst_Atom( atomOffsetEntry *aoe, void *refcon )
 	
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 	atomprint(">\n");
         if(vg.cmaf)
         {
             if(entryCount!=1)
-                errprint("CMAF check violated: Section 7.5.13. \"An offset edit list SHALL be a single EditListBox in an EditBox, i.e., entryCount SHALL be 1\", found %ld\n", entryCount);
+                errprint("CMAF check violated: Section 7.5.13. \"An offset edit list SHALL be a single EditListBox in an EditBox, i.e., entryCount SHALL be 1\", found %d\n", entryCount);
         }
         
 	vg.tabcnt++;
@@ -2004,10 +1977,9 @@ OSErr Validate_tref_type_Atom( atomOffsetEntry *aoe, void *refcon, OSType trefTy
 	offset = aoe->offset + aoe->atomStartSize;
 	listSize = (UInt32)(aoe->size - aoe->atomStartSize);
 	entryCount = listSize / sizeof(UInt32);
-	BAILIFNIL( listP = (UInt32 *)malloc(listSize), allocFailedErr );
-	BAILIFERR( GetFileData( aoe, listP, offset, listSize, &offset ) );
+	BAILIFNIL( listP = (UInt32 *)ArenaAlloc(&vg.arena, listSize), allocFailedErr );
+	BAILIFERR( GetFileDataN32Array( aoe, listP, entryCount, offset, &offset ) );
 	for ( i = 0; i < entryCount; i++ ) {
-		listP[i] = EndianU32_BtoN(listP[i]);
 		check_track( listP[i] );
 	}
 
@@ -2015,7 +1987,7 @@ OSErr Validate_tref_type_Atom( atomOffsetEntry *aoe, void *refcon, OSType trefTy
 	atomprintnotab(">\n");
 	//vg.tabcnt++;
 	for ( i = 0; i < entryCount; i++ ) {
-		atomprint("<tref%sEntry trackID=\"%ld\" />\n", ostypetostr(trefType), listP[i]);
+		atomprint("<tref%sEntry trackID=\"%d\" />\n", ostypetostr(trefType), listP[i]);
 	}
 	//--vg.tabcnt;
 
@@ -2083,8 +2055,8 @@ OSErr Validate_stsd_Atom( atomOffsetEntry *aoe, void *refcon )
 	// Get data 
 	BAILIFERR( GetFileDataN32( aoe, &entryCount, offset, &offset ) );
 		// 1 based table
-	BAILIFNULL( sampleDescriptionPtrArray = (SampleDescriptionPtr *)calloc((entryCount + 1), sizeof(SampleDescriptionPtr)), allocFailedErr );
-	BAILIFNULL( validatedSampleDescriptionRefCons = (UInt32 *)calloc((entryCount + 1), sizeof(UInt32)), allocFailedErr );
+	BAILIFNULL( sampleDescriptionPtrArray = (SampleDescriptionPtr *)ArenaCalloc(&vg.arena, ((UInt64)entryCount + 1), sizeof(SampleDescriptionPtr)), allocFailedErr );
+	BAILIFNULL( validatedSampleDescriptionRefCons = (UInt32 *)ArenaCalloc(&vg.arena, ((UInt64)entryCount + 1), sizeof(UInt32)), allocFailedErr );
 	
 	if(vg.cmaf){
 		if(version != 0){
@@ -2098,11 +2070,11 @@ OSErr Validate_stsd_Atom( atomOffsetEntry *aoe, void *refcon )
 	
 	// Print atom contents non-required fields
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("entryCount=\"%ld\"\n", entryCount);
+	atomprint("entryCount=\"%d\"\n", entryCount);
 	atomprint(">\n"); //vg.tabcnt++; 
 
 	// Check required field values
-	FieldMustBe( flags, 0, "'dref' flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "'dref' flags must be %d not 0x%x" );
 
 	//need to validate sample descriptions
 	tir->sampleDescriptionCnt = entryCount;
@@ -2131,7 +2103,7 @@ OSErr Validate_stsd_Atom( atomOffsetEntry *aoe, void *refcon )
 
 			{  // stash the sample description
 				SampleDescriptionPtr sdp;
-				sdp = (SampleDescriptionPtr)malloc( entry->size );
+				sdp = (SampleDescriptionPtr)ArenaAlloc( &vg.arena, entry->size );
 				err = GetFileData( entry, (void*)sdp, entry->offset, entry->size, nil );
 				sampleDescriptionPtrArray[i+1] = sdp;
 			}
@@ -2211,7 +2183,7 @@ OSErr Validate_vide_SD_Entry( atomOffsetEntry *aoe, void *refcon )
 	vsdi.width = EndianS16_BtoN(vsdi.width);
 	vsdi.height = EndianS16_BtoN(vsdi.height);
 	
-	char vsdi_name[strlen(vsdi.name)];
+	char vsdi_name[sizeof(vsdi.name)+1];
 	
 	tir->sampleDescWidth = vsdi.width; tir->sampleDescHeight = vsdi.height;
 	/*if ((tir->trackWidth>>16) != vsdi.width) {
@@ -2236,12 +2208,13 @@ OSErr Validate_vide_SD_Entry( atomOffsetEntry *aoe, void *refcon )
 	vsdi.vRes = EndianU32_BtoN(vsdi.vRes);
 	vsdi.dataSize = EndianU32_BtoN(vsdi.dataSize);
 	vsdi.frameCount = EndianS16_BtoN(vsdi.frameCount);
-	strcpy(vsdi_name, vsdi.name);
+	memcpy(vsdi_name, vsdi.name, sizeof(vsdi.name));		// not necessarily terminated
+	vsdi_name[sizeof(vsdi.name)] = 0;
 	vsdi.depth = EndianS16_BtoN(vsdi.depth);
 	vsdi.clutID = EndianS16_BtoN(vsdi.clutID);
 	// Print atom contents non-required fields
 	atomprint("sdType=\"%s\"\n", ostypetostr(sdh.sdType));
-	atomprint("dataRefIndex=\"%ld\"\n", sdh.dataRefIndex);
+	atomprint("dataRefIndex=\"%d\"\n", sdh.dataRefIndex);
 	// atomprint(">\n"); //vg.tabcnt++; 
 
 	if(vsdi_name[0] == '\v' || vsdi_name[0]== '\017')	//to make the vsdi.name be acceptable by xml
@@ -2250,13 +2223,13 @@ OSErr Validate_vide_SD_Entry( atomOffsetEntry *aoe, void *refcon )
 	atomprint("version=\"%hd\"\n", vsdi.version);
 	atomprint("revisionLevel=\"%hd\"\n", vsdi.revisionLevel);
 	atomprint("vendor=\"%s\"\n", ostypetostr(vsdi.vendor));
-	atomprint("temporalQuality=\"%ld\"\n", vsdi.temporalQuality);
-	atomprint("spatialQuality=\"%ld\"\n", vsdi.spatialQuality);
+	atomprint("temporalQuality=\"%d\"\n", vsdi.temporalQuality);
+	atomprint("spatialQuality=\"%d\"\n", vsdi.spatialQuality);
 	atomprint("width=\"%hd\"\n", vsdi.width);
 	atomprint("height=\"%hd\"\n", vsdi.height);
 	atomprint("hRes=\"%s\"\n", fixedU32str(vsdi.hRes));
 	atomprint("vRes=\"%s\"\n", fixedU32str(vsdi.vRes));
-	atomprint("dataSize=\"%ld\"\n", vsdi.dataSize);
+	atomprint("dataSize=\"%d\"\n", vsdi.dataSize);
 	atomprint("frameCount=\"%hd\"\n", vsdi.frameCount);
 	//atomprint("name=\"%s\"\n", vsdi_name);//This creates problems in xml printing and crashes Rep processing.
 	atomprint("depth=\"%hd\"\n", vsdi.depth);
@@ -2270,7 +2243,7 @@ OSErr Validate_vide_SD_Entry( atomOffsetEntry *aoe, void *refcon )
 
 	FieldMustBe( vsdi.version, 0, "ImageDescription version must be %d not %d" );
 	FieldMustBe( vsdi.revisionLevel, 0, "ImageDescription revisionLevel must be %d not %d" );
-	FieldMustBe( vsdi.vendor, 0, "ImageDescription vendor must be %d not 0x%lx" );
+	FieldMustBe( vsdi.vendor, 0, "ImageDescription vendor must be %d not 0x%x" );
 	FieldMustBe( vsdi.temporalQuality, 0, "ImageDescription temporalQuality must be %d not %d" );
 	FieldMustBe( vsdi.spatialQuality, 0, "ImageDescription spatialQuality must be %d not %d" );
 	if( vg.majorBrand == brandtype_mp41 ){
@@ -2278,8 +2251,8 @@ OSErr Validate_vide_SD_Entry( atomOffsetEntry *aoe, void *refcon )
 		if (vsdi.height != 240) warnprint("Warning: You signal brand MP4v1 and there ImageDescription height must be 240 not %d\n", vsdi.height );
 	}
 
-	FieldMustBe( vsdi.hRes, 72L<<16, "ImageDescription hRes must be 72.0 (0x%lx) not 0x%lx" );
-	FieldMustBe( vsdi.vRes, 72L<<16, "ImageDescription vRes must be 72.0 (0x%lx) not 0x%lx" );
+	FieldMustBe( vsdi.hRes, 72L<<16, "ImageDescription hRes must be 72.0 (0x%lx) not 0x%x" );
+	FieldMustBe( vsdi.vRes, 72L<<16, "ImageDescription vRes must be 72.0 (0x%lx) not 0x%x" );
 	FieldMustBe( vsdi.dataSize, 0, "ImageDescription dataSize must be %d not %d" );
 	FieldMustBe( vsdi.frameCount, 1, "ImageDescription frameCount must be %d not %d" );
 	// should check the whole string
@@ -2444,11 +2417,11 @@ OSErr Validate_trex_Atom( atomOffsetEntry *aoe, void *refcon )
 	BAILIFERR( GetFileDataN32( aoe, &tir->default_sample_flags, offset, &offset ) );
 	
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("trackID=\"%ld\"\n", track_ID);
-	atomprint("sampleDescriptionIndex=\"%ld\"\n", tir->default_sample_description_index);
-	atomprint("sampleDuration=\"%ld\"\n", tir->default_sample_duration);
-	atomprint("sampleSize=\"%ld\"\n", EndianU32_BtoN(tir->default_sample_size));
-	atomprint("sampleFlags=\"%ld\"\n", EndianU32_BtoN(tir->default_sample_flags));
+	atomprint("trackID=\"%d\"\n", track_ID);
+	atomprint("sampleDescriptionIndex=\"%d\"\n", tir->default_sample_description_index);
+	atomprint("sampleDuration=\"%d\"\n", tir->default_sample_duration);
+	atomprint("sampleSize=\"%d\"\n", EndianU32_BtoN(tir->default_sample_size));
+	atomprint("sampleFlags=\"%d\"\n", EndianU32_BtoN(tir->default_sample_flags));
 	atomprint(">\n");
 
 	// All done
@@ -2490,7 +2463,7 @@ OSErr Validate_mehd_Atom( atomOffsetEntry *aoe, void *refcon )
         
         if(vg.cmaf && mir->fragment_duration <=0)
             errprint("CMAF checks violated: Section 7.3.2.1. \"If 'mehd' is present, SHALL provide the overall duration of a fragmented movie. If duration \
-            is unknown, this box SHALL be omitted.\", but duration found as %d",mir->fragment_duration);
+            is unknown, this box SHALL be omitted.\", but duration found as %lld",mir->fragment_duration);
 
 	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -2517,7 +2490,7 @@ OSErr Validate_trep_Atom( atomOffsetEntry *aoe, void *refcon )
         BAILIFERR( GetFileDataN32( aoe, &track_id, offset, &offset ) );
         
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("track_id=\"%lld\"\n", track_id);
+	atomprint("track_id=\"%d\"\n", track_id);
 	atomprint(">\n");
         
 	// All done
@@ -2531,22 +2504,22 @@ bail:
 
 //==========================================================================================
 
+static const BoxField mfhdFields[] = {
+	BOX_UINT( 4, MoofInfoRec, sequence_number ),
+};
+static const BoxLayout mfhdLayout = BOX_LAYOUT( mfhdFields, MoofInfoRec );
+
 OSErr Validate_mfhd_Atom( atomOffsetEntry *aoe, void *refcon )
 {
 	OSErr err = noErr;
 	UInt32 version;
 	UInt32 flags;
-	UInt64 offset;
     MoofInfoRec *moofInfo = (MoofInfoRec *)refcon;
     
-	// Get version/flags
-	BAILIFERR( GetFullAtomVersionFlags( aoe, &version, &flags, &offset ) );
-    
-	// Get data 
-	BAILIFERR( GetFileDataN32( aoe, &moofInfo->sequence_number, offset, &offset ) );
+	BAILIFERR( DecodeFullBox( aoe, &mfhdLayout, moofInfo, &version, &flags ) );
 	
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-	atomprint("sequenceNumber=\"%ld\"\n", moofInfo->sequence_number);
+	atomprint("sequenceNumber=\"%d\"\n", moofInfo->sequence_number);
 	atomprint(">\n");
 
 	// All done
@@ -2560,21 +2533,26 @@ bail:
 
 //==========================================================================================
 
+static const BoxField tfhdFields[] = {
+	BOX_UINT( 4, TrafInfoRec, track_ID ),
+	BOX_UINT_IF( 8, TrafInfoRec, base_data_offset, kBoxFieldIfFlags, 0x000001 ),
+	BOX_UINT_IF( 4, TrafInfoRec, sample_description_index, kBoxFieldIfFlags, 0x000002 ),
+	BOX_UINT_IF( 4, TrafInfoRec, default_sample_duration, kBoxFieldIfFlags, 0x000008 ),
+	BOX_UINT_IF( 4, TrafInfoRec, default_sample_size, kBoxFieldIfFlags, 0x000010 ),
+	BOX_UINT_IF( 4, TrafInfoRec, default_sample_flags, kBoxFieldIfFlags, 0x000020 ),
+};
+static const BoxLayout tfhdLayout = BOX_LAYOUT( tfhdFields, TrafInfoRec );
+
 OSErr Validate_tfhd_Atom( atomOffsetEntry *aoe, void *refcon )
 {
 	OSErr err = noErr;
 	UInt32 version;
 	UInt32 tf_flags;
-	UInt64 offset;
     TrafInfoRec *trafInfo = (TrafInfoRec *)refcon;
     
-	// Get version/flags
-	BAILIFERR( GetFullAtomVersionFlags( aoe, &version, &tf_flags, &offset ) );
+	BAILIFERR( DecodeFullBox( aoe, &tfhdLayout, trafInfo, &version, &tf_flags ) );
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, tf_flags);
-    
-	// Get data 
-	BAILIFERR( GetFileDataN32( aoe, &trafInfo->track_ID, offset, &offset ) );
-	atomprint("trackID=\"%ld\"\n", trafInfo->track_ID);
+	atomprint("trackID=\"%d\"\n", trafInfo->track_ID);
 
     TrackInfoRec *tir;
 	tir = check_track(trafInfo->track_ID);
@@ -2596,34 +2574,23 @@ OSErr Validate_tfhd_Atom( atomOffsetEntry *aoe, void *refcon )
     if(vg.dashSegment && trafInfo->base_data_offset_present)
         errprint("base-data-offset-present is set, violating Section 6.3.4.2. of ISO/IEC 23009-1:2012(E): ... base-data-offset-present shall not be used\n");
     
-    if(trafInfo->base_data_offset_present)
-        BAILIFERR( GetFileDataN64( aoe, &trafInfo->base_data_offset, offset, &offset ) );
-    
-    if(trafInfo->sample_description_index_present)
-        BAILIFERR( GetFileDataN32( aoe, &trafInfo->sample_description_index, offset, &offset ) );
-    else{
+    if(!trafInfo->sample_description_index_present){
         if(vg.cmaf)
             errprint("CMAF check violated: Section 7.5.14. \"Default values or per sample values SHALL be stored in each CMAF chunk's TrackFragmentBoxHeader and/or TrackRunBox\", 'sample_description_index' not found.\n");
     }
     
-    if(trafInfo->default_sample_duration_present)
-        BAILIFERR( GetFileDataN32( aoe, &trafInfo->default_sample_duration, offset, &offset ) );
-    else
+    if(!trafInfo->default_sample_duration_present)
         trafInfo->default_sample_duration = tir->default_sample_duration;   //"Effective" default in that case
     
-    if(trafInfo->default_sample_size_present)
-        BAILIFERR( GetFileDataN32( aoe, &trafInfo->default_sample_size, offset, &offset ) );
-    else
+    if(!trafInfo->default_sample_size_present)
         trafInfo->default_sample_size = tir->default_sample_size;   //"Effective" default in that case
     
-    if(trafInfo->default_sample_flags_present)
-        BAILIFERR( GetFileDataN32( aoe, &trafInfo->default_sample_flags, offset, &offset ) );
-	else
-            trafInfo->default_sample_flags = tir->default_sample_flags;
+    if(!trafInfo->default_sample_flags_present)
+        trafInfo->default_sample_flags = tir->default_sample_flags;
     
     if(vg.cmaf){
  	if(trafInfo->track_ID != tir->trackID){
- 		errprint("CMAF check violated: Section 7.5.16. \"The track_ID field SHALL contain the same value as the track_ID in the matching CMAF Header\", found %ld\n", trafInfo->track_ID);
+ 		errprint("CMAF check violated: Section 7.5.16. \"The track_ID field SHALL contain the same value as the track_ID in the matching CMAF Header\", found %d\n", trafInfo->track_ID);
  	}
 	if(trafInfo->base_data_offset_present != 0){
 		errprint("CMAF check violated: Section 7.5.16. \"The base-data-offset-present flag SHALL be set to zero\", found %d\n", trafInfo->base_data_offset_present);
@@ -2633,11 +2600,11 @@ OSErr Validate_tfhd_Atom( atomOffsetEntry *aoe, void *refcon )
 	}
     }
 	
-    atomprint("baseDataOffset=\"%ld\"\n", EndianU64_BtoN(trafInfo->base_data_offset));
-    atomprint("sampleDescriptionIndex=\"%ld\"\n", trafInfo->sample_description_index);
-    atomprint("defaultSampleDuration=\"%ld\"\n", trafInfo->default_sample_duration);
-    atomprint("defaultSampleSize=\"%ld\"\n", EndianU32_BtoN(trafInfo->default_sample_size));
-    atomprint("defaultSampleFlags=\"%ld\"\n", EndianU32_BtoN(trafInfo->default_sample_flags));
+    atomprint("baseDataOffset=\"%lld\"\n", EndianU64_BtoN(trafInfo->base_data_offset));
+    atomprint("sampleDescriptionIndex=\"%d\"\n", trafInfo->sample_description_index);
+    atomprint("defaultSampleDuration=\"%d\"\n", trafInfo->default_sample_duration);
+    atomprint("defaultSampleSize=\"%d\"\n", EndianU32_BtoN(trafInfo->default_sample_size));
+    atomprint("defaultSampleFlags=\"%d\"\n", EndianU32_BtoN(trafInfo->default_sample_flags));
     atomprint(">\n");
     
     // All done
@@ -2649,21 +2616,60 @@ bail:
 
 //==========================================================================================
 
+// The per-sample fields of a 'trun' are read as one table and split into their columns here.
+//   There is one decoder per table width (1 to 4 fields per sample), so the stride is a constant
+//   and the compiler can turn each column into a vectorised gather and byte swap.
+#define DEFINE_TRUN_COLUMN_DECODER( fieldsPerSample ) \
+static void DecodeTrunColumn##fieldsPerSample( UInt32 *dst, const UInt8 *table, UInt32 column, UInt32 sampleCount ) \
+{ \
+	const UInt8 *src = table + column * sizeof(UInt32); \
+	UInt32 i; \
+	for (i = 0; i < sampleCount; i++) { \
+		UInt32 value; \
+		memcpy( &value, src + i * (fieldsPerSample) * sizeof(UInt32), sizeof(value) ); \
+		dst[i] = EndianU32_BtoN(value); \
+	} \
+}
+
+DEFINE_TRUN_COLUMN_DECODER(1)
+DEFINE_TRUN_COLUMN_DECODER(2)
+DEFINE_TRUN_COLUMN_DECODER(3)
+DEFINE_TRUN_COLUMN_DECODER(4)
+
+typedef void (*TrunColumnDecoder)( UInt32 *dst, const UInt8 *table, UInt32 column, UInt32 sampleCount );
+static const TrunColumnDecoder trunColumnDecoders[5] = { nil, DecodeTrunColumn1, DecodeTrunColumn2, DecodeTrunColumn3, DecodeTrunColumn4 };
+
+// The per-sample table follows these and is left to the column decoders
+static const BoxField trunFields[] = {
+	BOX_UINT( 4, TrunInfoRec, sample_count ),
+	BOX_UINT_IF( 4, TrunInfoRec, data_offset, kBoxFieldIfFlags, 0x000001 ),
+	BOX_UINT_IF( 4, TrunInfoRec, first_sample_flags, kBoxFieldIfFlags, 0x000004 ),
+};
+static const BoxLayout trunLayout = BOX_LAYOUT( trunFields, TrunInfoRec );
+
 OSErr Validate_trun_Atom( atomOffsetEntry *aoe, void *refcon )
 {
 	OSErr err = noErr;
 	UInt32 tr_flags;
-	UInt64 offset;
+	BoxBody body;
     UInt32 i;
+    UInt32 fieldsPerSample;
     UInt64 prevTrunCummulatedSampleDuration = 0;
     TrafInfoRec *trafInfo = (TrafInfoRec *) refcon;
+    TrackInfoRec *tir;
     
     TrunInfoRec *trunInfo = &trafInfo->trunInfo[trafInfo->processedTrun];
 
     trunInfo->cummulatedSampleDuration = 0;
+    trunInfo->sample_count = 0;
+    body.view = nil;
     
-	// Get version/flags
-	BAILIFERR( GetFullAtomVersionFlags( aoe, &trunInfo->version, &tr_flags, &offset ) );
+    BAILIFNIL( tir = check_track(trafInfo->track_ID), badAtomErr );
+    
+	BAILIFERR( OpenBoxBody( aoe, true, &body ) );
+	BAILIFERR( DecodeBoxFields( &body, &trunLayout, trunInfo ) );
+	trunInfo->version = body.version;
+	tr_flags = body.flags;
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", trunInfo->version, tr_flags);
 
     trunInfo->data_offset_present = (tr_flags & 0x000001)!=0;
@@ -2673,50 +2679,34 @@ OSErr Validate_trun_Atom( atomOffsetEntry *aoe, void *refcon )
     trunInfo->sample_flags_present = (tr_flags & 0x000400)!=0;
     trunInfo->sample_composition_time_offsets_present = (tr_flags & 0x000800)!=0;
 
-	BAILIFERR( GetFileDataN32( aoe, &trunInfo->sample_count, offset, &offset ) );
-	atomprint("sampleCount=\"%ld\"\n", trunInfo->sample_count);
+	atomprint("sampleCount=\"%d\"\n", trunInfo->sample_count);
 
-    if(trunInfo->data_offset_present)
-	    BAILIFERR( GetFileDataN32( aoe, &trunInfo->data_offset, offset, &offset ) );
+    // the per-sample table has to be all there before room is made for it; a short one leaves
+    //   the run empty for the later stages, which walk every trun of the traf
+    fieldsPerSample = trunInfo->sample_duration_present + trunInfo->sample_size_present + trunInfo->sample_flags_present + trunInfo->sample_composition_time_offsets_present;
+    if ((UInt64)(body.end - body.cur) < (UInt64)trunInfo->sample_count * fieldsPerSample * sizeof(UInt32)) {
+        trunInfo->sample_count = 0;
+        err = outOfDataErr;
+        goto bail;
+    }
 
-    if(trunInfo->first_sample_flags_present)
-        BAILIFERR( GetFileDataN32( aoe, &trunInfo->first_sample_flags, offset, &offset ) );
+    // the sample arrays are views into the track's column store, presented and without SAP 3/4 by default
+    BAILIFERR( FragmentSamplesAllocate( &tir->fragmentSamples, trunInfo ) );
 
-    if(trunInfo->sample_count > 0)
+    // split the per-sample table that follows into the sample arrays
+    if(trunInfo->sample_count > 0 && fieldsPerSample > 0)
     {
-        //if(trunInfo->sample_duration_present)
-            trunInfo->sample_duration = (UInt32 *)malloc(trunInfo->sample_count*sizeof(UInt32));
-        //else  //use defaults then
-        //    trunInfo->sample_duration = NULL;
-
-        //if(trunInfo->sample_size_present)
-            trunInfo->sample_size = (UInt32 *)malloc(trunInfo->sample_count*sizeof(UInt32));
-        //else  //use defaults then
-        //    trunInfo->sample_size = NULL;
-
-        //if(trunInfo->sample_flags_present)
-            trunInfo->sample_flags = (UInt32 *)malloc(trunInfo->sample_count*sizeof(UInt32));
-        //else  //use defaults then
-        //    trunInfo->sample_flags = NULL;
-
-        //if(trunInfo->sample_composition_time_offsets_present)
-        {
-            trunInfo->sample_composition_time_offset = (UInt32 *)malloc(trunInfo->sample_count*sizeof(UInt32));
-            trunInfo->samplePresentationTime = (long double *)malloc(trunInfo->sample_count*sizeof(long double));   //For later use after applying edits
-            trunInfo->sampleToBePresented = (Boolean *)malloc(trunInfo->sample_count*sizeof(Boolean));   //For later use after applying edits
-            trunInfo->sap3 = (Boolean *)malloc(trunInfo->sample_count*sizeof(Boolean));
-            trunInfo->sap4 = (Boolean *)malloc(trunInfo->sample_count*sizeof(Boolean));
-            
-            for(i = 0 ; i < trunInfo->sample_count ; i++)
-            {
-                trunInfo->samplePresentationTime[i] = 0.0;
-                trunInfo->sampleToBePresented[i] = true;    //By default true, unless edit lists decide elsewise
-                trunInfo->sap3[i] = false;
-                trunInfo->sap4[i] = false;
-            }
-        }
-        //else
-        //    trunInfo->sample_composition_time_offset = NULL;
+        TrunColumnDecoder decode = trunColumnDecoders[fieldsPerSample];
+        UInt32 column = 0;
+
+        if(trunInfo->sample_duration_present)
+            decode( trunInfo->sample_duration, body.cur, column++, trunInfo->sample_count );
+        if(trunInfo->sample_size_present)
+            decode( trunInfo->sample_size, body.cur, column++, trunInfo->sample_count );
+        if(trunInfo->sample_flags_present)
+            decode( trunInfo->sample_flags, body.cur, column++, trunInfo->sample_count );
+        if(trunInfo->sample_composition_time_offsets_present)
+            decode( trunInfo->sample_composition_time_offset, body.cur, column++, trunInfo->sample_count );
     }
 
     for(i = 0 ; i < trafInfo->processedTrun ; i++)
@@ -2728,10 +2718,7 @@ OSErr Validate_trun_Atom( atomOffsetEntry *aoe, void *refcon )
          UInt32 currentSampleDecodeDelta;
         
         if(trunInfo->sample_duration_present)
-        {
-            BAILIFERR( GetFileDataN32( aoe, &trunInfo->sample_duration[i], offset, &offset ) );
             currentSampleDecodeDelta = trunInfo->sample_duration[i];
-        }
         else
         {
             trunInfo->sample_duration[i] = trafInfo->default_sample_duration;
@@ -2742,17 +2729,14 @@ OSErr Validate_trun_Atom( atomOffsetEntry *aoe, void *refcon )
 
         trunInfo->cummulatedSampleDuration += currentSampleDecodeDelta;
         
-        if(trunInfo->sample_size_present)
-            BAILIFERR( GetFileDataN32( aoe, &trunInfo->sample_size[i], offset, &offset ) );
-		else{
+        if(!trunInfo->sample_size_present)
+		{
 			trunInfo->sample_size[i] = trafInfo->default_sample_size;
                         if(vg.cmaf && !trafInfo->default_sample_size_present)
                             errprint("CMAF check violated: Section 7.5.14. \"Default values or per sample values SHALL be stored in each CMAF chunk's TrackFragmentBoxHeader and/or TrackRunBox\", 'size' not found in any of them. \n");
                 }
 
-        if(trunInfo->sample_flags_present)
-            BAILIFERR( GetFileDataN32( aoe, &trunInfo->sample_flags[i], offset, &offset ) );
-		else
+        if(!trunInfo->sample_flags_present)
 		{
 		    if(trunInfo->first_sample_flags_present && (i == 0))
                 trunInfo->sample_flags[0] = trunInfo->first_sample_flags;
@@ -2764,14 +2748,12 @@ OSErr Validate_trun_Atom( atomOffsetEntry *aoe, void *refcon )
                 }
        
         //Use it as a signed int when version is non-zero
-        if(trunInfo->sample_composition_time_offsets_present)
-        {
-            BAILIFERR( GetFileDataN32( aoe, &trunInfo->sample_composition_time_offset[i], offset, &offset ) );
-        }
-        else
+        if(!trunInfo->sample_composition_time_offsets_present)
             trunInfo->sample_composition_time_offset[i] = 0;    // Will be checked later; it must be that CTTS is missing ==> composition time == decode times (Section 8.6.1.1.)
 
-        UInt64 compositionTimeInTrackFragment = savedCummulatedSampleDuration + prevTrunCummulatedSampleDuration + (trunInfo->version != 0 ? (Int32)trunInfo->sample_composition_time_offset[i] : (UInt32)trunInfo->sample_composition_time_offset[i]);
+        trunInfo->sampleDecodeTime[i] = prevTrunCummulatedSampleDuration + savedCummulatedSampleDuration;
+
+        UInt64 compositionTimeInTrackFragment = trunInfo->sampleDecodeTime[i] + (trunInfo->version != 0 ? (Int32)trunInfo->sample_composition_time_offset[i] : (UInt32)trunInfo->sample_composition_time_offset[i]);
 
         if(compositionTimeInTrackFragment < trafInfo->earliestCompositionTimeInTrackFragment)
             trafInfo->earliestCompositionTimeInTrackFragment = compositionTimeInTrackFragment;
@@ -2792,23 +2774,24 @@ OSErr Validate_trun_Atom( atomOffsetEntry *aoe, void *refcon )
     
     vg.tabcnt++;
     for(int i=0; i<trunInfo->sample_count; i++){
-	sampleprint("<sampleInfo sampleDuration=\"%ld\"", trunInfo->sample_duration[i]);
-	sampleprintnotab(" sampleSize=\"%ld\"", trunInfo->sample_size[i]);
-	sampleprintnotab(" sampleFlags=\"%ld\"", EndianU32_BtoN(trunInfo->sample_flags[i]));
-	sampleprintnotab(" sampleCompositionTimeOffset=\"%ld\"/>\n", trunInfo->sample_composition_time_offset[i]);
+	sampleprint("<sampleInfo sampleDuration=\"%d\"", trunInfo->sample_duration[i]);
+	sampleprintnotab(" sampleSize=\"%d\"", trunInfo->sample_size[i]);
+	sampleprintnotab(" sampleFlags=\"%d\"", EndianU32_BtoN(trunInfo->sample_flags[i]));
+	sampleprintnotab(" sampleCompositionTimeOffset=\"%d\"/>\n", trunInfo->sample_composition_time_offset[i]);
     }
     --vg.tabcnt;
   
     trafInfo->processedTrun++;
     
     atomprint("cummulatedSampleDuration=\"%lld\"\n", trunInfo->cummulatedSampleDuration);
-    atomprint("earliestCompositionTime=\"%ld\"\n", trafInfo->earliestCompositionTimeInTrackFragment);
-    atomprint("data_offset=\"%ld\"\n", trunInfo->data_offset);
+    atomprint("earliestCompositionTime=\"%lld\"\n", trafInfo->earliestCompositionTimeInTrackFragment);
+    atomprint("data_offset=\"%d\"\n", trunInfo->data_offset);
     atomprint(">\n");
     
     // All done
 	aoe->aoeflags |= kAtomValidated;
 bail:
+	CloseBoxBody( &body );
 	return err;
 
 
@@ -2816,48 +2799,49 @@ bail:
 
 //==========================================================================================
 
+static const BoxField sbgpEntryFields[] = {
+	BOX_UINT( 4, SbgpEntry, sample_count ),
+	BOX_UINT( 4, SbgpEntry, group_description_index ),
+};
+static const BoxLayout sbgpEntryLayout = BOX_LAYOUT( sbgpEntryFields, SbgpEntry );
+
+static const BoxField sbgpFields[] = {
+	BOX_UINT( 4, SbgpInfoRec, grouping_type ),
+	BOX_UINT_IF( 4, SbgpInfoRec, grouping_type_parameter, kBoxFieldIfVersion, 1 ),
+	BOX_UINT( 4, SbgpInfoRec, entry_count ),
+	BOX_ARRAY( 2, sbgpEntryLayout, SbgpInfoRec, entries ),
+};
+static const BoxLayout sbgpLayout = BOX_LAYOUT( sbgpFields, SbgpInfoRec );
+
 OSErr Validate_sbgp_Atom( atomOffsetEntry *aoe, void *refcon )
 {
 	OSErr err = noErr;
 	UInt32 flags;
-	UInt64 offset;
 
     TrafInfoRec *trafInfo = (TrafInfoRec *) refcon;
     
     SbgpInfoRec *sbgpInfo = &trafInfo->sbgpInfo[trafInfo->processedSbgp];
     
-	// Get version/flags
-	BAILIFERR( GetFullAtomVersionFlags( aoe, &sbgpInfo->version, &flags, &offset ) );
-
-    BAILIFERR( GetFileDataN32( aoe, &sbgpInfo->grouping_type, offset, &offset ));
-
-    if(sbgpInfo->version == 1)
-        BAILIFERR( GetFileDataN32( aoe, &sbgpInfo->grouping_type_parameter, offset, &offset ) );
-    
-    BAILIFERR( GetFileDataN32( aoe, &sbgpInfo->entry_count, offset, &offset ));
-
-    sbgpInfo->sample_count = (UInt32 *)malloc(sbgpInfo->entry_count*sizeof(UInt32));
-    sbgpInfo->group_description_index = (UInt32 *)malloc(sbgpInfo->entry_count*sizeof(UInt32));
-
-    for(UInt32 i = 0 ;  i < sbgpInfo->entry_count ; i++)
-    {
-        BAILIFERR( GetFileDataN32( aoe, &sbgpInfo->sample_count[i], offset, &offset ));
-        BAILIFERR( GetFileDataN32( aoe, &sbgpInfo->group_description_index[i], offset, &offset ));
-    }
+    sbgpInfo->entries = nil;
+	err = DecodeFullBox( aoe, &sbgpLayout, sbgpInfo, &sbgpInfo->version, &flags );
+	if (err) {
+		sbgpInfo->entry_count = 0;		// postprocessing walks every 'sbgp' in the 'traf'
+		goto bail;
+	}
 
     trafInfo->processedSbgp++;
     
     // Print data
     atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", sbgpInfo->version, flags);
-    atomprint("groupingType=\"%ld\"\n", EndianU32_BtoN(sbgpInfo->grouping_type));
-    atomprint("groupingTypeParameter=\"%ld\"\n", EndianU32_BtoN(sbgpInfo->grouping_type_parameter));
-    atomprint("entryCount=\"%ld\"\n", sbgpInfo->entry_count);
+    atomprint("groupingType=\"%d\"\n", EndianU32_BtoN(sbgpInfo->grouping_type));
+    atomprint("groupingTypeParameter=\"%d\"\n", EndianU32_BtoN(sbgpInfo->grouping_type_parameter));
+    atomprint("entryCount=\"%d\"\n", sbgpInfo->entry_count);
     atomprint(">\n");
     vg.tabcnt++;
     
     for ( UInt32 i = 0; i < sbgpInfo->entry_count; i++ ) {
-	sampleprint("<sampleInfo sampleCount=\"%ld\"", EndianU32_BtoN(sbgpInfo->sample_count[i]));
-	sampleprintnotab(" group_description_index=\"%ld\"/>\n", EndianU32_BtoN(sbgpInfo->group_description_index[i]));
+	sampleprint("<sampleInfo sampleCount=\"%d\"", EndianU32_BtoN(sbgpInfo->entries[i].sample_count));
+	sampleprintnotab(" group_description_index=\"%d\"/>\n", EndianU32_BtoN(sbgpInfo->entries[i].group_description_index));
     }
     
     --vg.tabcnt;
@@ -2873,53 +2857,68 @@ bail:
 
 //==========================================================================================
 
+// The entries follow these; what is in them depends on the grouping type, so they are kept as raw
+//   bytes behind their length
+static const BoxField sgpdFields[] = {
+	BOX_UINT( 4, SgpdInfoRec, grouping_type ),
+	BOX_UINT_IF( 4, SgpdInfoRec, default_length, kBoxFieldIfVersion, 1 ),
+	BOX_UINT( 4, SgpdInfoRec, entry_count ),
+};
+static const BoxLayout sgpdLayout = BOX_LAYOUT( sgpdFields, SgpdInfoRec );
+
 OSErr Validate_sgpd_Atom( atomOffsetEntry *aoe, void *refcon )
 {
 	OSErr err = noErr;
 	UInt32 flags;
-	UInt64 offset;
+	BoxBody body;
 
     TrafInfoRec *trafInfo = (TrafInfoRec *) refcon;
     
     SgpdInfoRec *sgpdInfo = &trafInfo->sgpdInfo[trafInfo->processedSgpd];
     
-	// Get version/flags
-	BAILIFERR( GetFullAtomVersionFlags( aoe, &sgpdInfo->version, &flags, &offset ) );
-
-    BAILIFERR( GetFileDataN32( aoe, &sgpdInfo->grouping_type, offset, &offset ));
-
-    if(sgpdInfo->version == 1)
-        BAILIFERR( GetFileDataN32( aoe, &sgpdInfo->default_length, offset, &offset ) );
-    
-    BAILIFERR( GetFileDataN32( aoe, &sgpdInfo->entry_count, offset, &offset ));
+	BAILIFERR( OpenBoxBody( aoe, true, &body ) );
+	sgpdInfo->version = body.version;
+	flags = body.flags;
+	BAILIFERR( DecodeBoxFields( &body, &sgpdLayout, sgpdInfo ) );
+    BAILIFERR( KeyIndexInsert( &trafInfo->sgpdByGroupingType, sgpdInfo->grouping_type, trafInfo->processedSgpd ) );
 
-    sgpdInfo->description_length = (UInt32 *)malloc(sgpdInfo->entry_count*sizeof(UInt32));
-    sgpdInfo->SampleGroupDescriptionEntry = (UInt32 **)malloc(sgpdInfo->entry_count*sizeof(UInt32 *));
+    BAILIFNIL( sgpdInfo->description_length = (UInt32 *)ArenaAlloc(&vg.arena, sgpdInfo->entry_count*sizeof(UInt32)), allocFailedErr );
+    BAILIFNIL( sgpdInfo->SampleGroupDescriptionEntry = (UInt32 **)ArenaAlloc(&vg.arena, sgpdInfo->entry_count*sizeof(UInt32 *)), allocFailedErr );
 
     for(UInt32 i = 0 ;  i < sgpdInfo->entry_count ; i++)
     {
+        UInt32 length = 0;
+
         if(sgpdInfo->version == 1)
         {
             if(sgpdInfo->default_length == 0)
-                BAILIFERR( GetFileDataN32( aoe, &sgpdInfo->description_length[i], offset, &offset ));
-
-            sgpdInfo->SampleGroupDescriptionEntry[i] = (UInt32 *)malloc((sgpdInfo->default_length == 0 ? sgpdInfo->description_length[i] : sgpdInfo->default_length)*sizeof(UInt32));
+            {
+                BAILIF( body.end - body.cur < 4, outOfDataErr );
+                length = ((UInt32)body.cur[0] << 24) | ((UInt32)body.cur[1] << 16) | ((UInt32)body.cur[2] << 8) | body.cur[3];
+                body.cur += 4;
+            }
+            else
+                length = sgpdInfo->default_length;
         }
 
-        BAILIFERR(GetFileData(aoe,sgpdInfo->SampleGroupDescriptionEntry[i],offset,sgpdInfo->description_length[i],&offset));
+        BAILIF( (UInt64)(body.end - body.cur) < length, outOfDataErr );
+        sgpdInfo->description_length[i] = length;
+        BAILIFNIL( sgpdInfo->SampleGroupDescriptionEntry[i] = (UInt32 *)ArenaCalloc(&vg.arena, length/sizeof(UInt32) + 1, sizeof(UInt32)), allocFailedErr );
+        memcpy( sgpdInfo->SampleGroupDescriptionEntry[i], body.cur, length );
+        body.cur += length;
     }
 
     trafInfo->processedSgpd++;
     
     atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", sgpdInfo->version, flags);
-    atomprint("groupingType=\"%ld\"\n", EndianU32_BtoN(sgpdInfo->grouping_type));
-    atomprint("entryCount=\"%ld\"\n", sgpdInfo->entry_count);
+    atomprint("groupingType=\"%d\"\n", EndianU32_BtoN(sgpdInfo->grouping_type));
+    atomprint("entryCount=\"%d\"\n", sgpdInfo->entry_count);
     atomprint(">\n");
     vg.tabcnt++;
     
     for(UInt32 i=0; i<sgpdInfo->entry_count; i++){
-	sampleprint("<sgpdEntry descriptionLength=\"%ld\"", EndianU32_BtoN(sgpdInfo->description_length[i]));
-	sampleprintnotab(" sampleGroupDescriptionEntry=\"%ld\"/>\n", EndianU32_BtoN(sgpdInfo->SampleGroupDescriptionEntry[i]));
+	sampleprint("<sgpdEntry descriptionLength=\"%d\"", EndianU32_BtoN(sgpdInfo->description_length[i]));
+	sampleprintnotab(" sampleGroupDescriptionEntry=\"%d\"/>\n", EndianU32_BtoN(sgpdInfo->SampleGroupDescriptionEntry[i][0]));
     }
     
     --vg.tabcnt;
@@ -2927,6 +2926,7 @@ OSErr Validate_sgpd_Atom( atomOffsetEntry *aoe, void *refcon )
     // All done
 	aoe->aoeflags |= kAtomValidated;
 bail:
+	CloseBoxBody( &body );
 	return err;
 
 
@@ -2971,7 +2971,7 @@ OSErr Validate_subs_Atom( atomOffsetEntry *aoe, void *refcon )
         }
         
         atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-        atomprint("entryCount=\"%ld\"\n", entry_count);
+        atomprint("entryCount=\"%d\"\n", entry_count);
         
         //CMAF check
         if(vg.cmaf && entry_count != 1){
@@ -2986,23 +2986,39 @@ bail:
 
 //==========================================================================================
 
+// Section 5.10.3.3 of ISO/IEC 23009-1:2013(E); message_data is the rest of the body
+typedef struct {
+    char   *scheme_id_uri;
+    char   *value;
+    UInt32  timescale;
+    UInt32  presentation_time_delta;
+    UInt32  event_duration;
+    UInt32  id;
+} EmsgInfoRec;
+
+static const BoxField emsgFields[] = {
+	BOX_CSTRING( EmsgInfoRec, scheme_id_uri ),
+	BOX_CSTRING( EmsgInfoRec, value ),
+	BOX_UINT( 4, EmsgInfoRec, timescale ),
+	BOX_UINT( 4, EmsgInfoRec, presentation_time_delta ),
+	BOX_UINT( 4, EmsgInfoRec, event_duration ),
+	BOX_UINT( 4, EmsgInfoRec, id ),
+};
+static const BoxLayout emsgLayout = BOX_LAYOUT( emsgFields, EmsgInfoRec );
+
 OSErr Validate_emsg_Atom( atomOffsetEntry *aoe, void *refcon )
 {
 	OSErr err = noErr;
 	UInt32 version;
 	UInt32 flags;
-	UInt64 offset;
-	char *scheme_id_uri = nil;
-	char *value = nil;
+	BoxBody body;
+    EmsgInfoRec emsg = { nil };
     UInt32  timescale;
-    UInt32  presentation_time_delta;
-    UInt32  event_duration;
-    UInt32  id;
-    UInt8  *message_data;    
     //TrafInfoRec *trafInfo = (TrafInfoRec *)refcon;
     
-	// Get version/flags
-	BAILIFERR( GetFullAtomVersionFlags( aoe, &version, &flags, &offset ) );
+	BAILIFERR( OpenBoxBody( aoe, true, &body ) );
+	version = body.version;
+	flags = body.flags;
     
     if(version != 0)
         errprint("version = 0 for emsg box according to Section 5.10.3.3.3 of ISO/IEC 23009-1:2013(E)\n");
@@ -3010,36 +3026,24 @@ OSErr Validate_emsg_Atom( atomOffsetEntry *aoe, void *refcon )
     if(flags != 0)
         errprint("flags = 0 for emsg box according to Section 5.10.3.3.3 of ISO/IEC 23009-1:2013(E)\n");
 
-    BAILIFERR( GetFileCString( aoe, &scheme_id_uri, offset, aoe->maxOffset - offset, &offset ) );
-    
-    BAILIFERR( GetFileCString( aoe, &value, offset, aoe->maxOffset - offset, &offset ) );
-
-	// Get data 
-	BAILIFERR( GetFileDataN32( aoe, &timescale, offset, &offset ) );
-	
-	BAILIFERR( GetFileDataN32( aoe, &presentation_time_delta, offset, &offset ) );
-	
-	BAILIFERR( GetFileDataN32( aoe, &event_duration, offset, &offset ) );
-	
-	BAILIFERR( GetFileDataN32( aoe, &id, offset, &offset ) );
-
-	message_data = new UInt8[aoe->maxOffset - offset];
-	BAILIFERR( GetFileData( aoe,message_data, offset, aoe->maxOffset - offset , &offset ) );
+	BAILIFERR( DecodeBoxFields( &body, &emsgLayout, &emsg ) );
+	timescale = emsg.timescale;
     
      atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-     atomprint("timeScale=\"%ld\"\n", EndianU32_BtoN(timescale));
-     atomprint("presentationTimeDelta=\"%ld\"\n", EndianU32_BtoN(presentation_time_delta));
-     atomprint("eventDuration=\"%ld\"\n", EndianU32_BtoN(event_duration));
-     atomprint("id=\"%ld\"\n", EndianU32_BtoN(id));
+     atomprint("timeScale=\"%d\"\n", EndianU32_BtoN(timescale));
+     atomprint("presentationTimeDelta=\"%d\"\n", EndianU32_BtoN(emsg.presentation_time_delta));
+     atomprint("eventDuration=\"%d\"\n", EndianU32_BtoN(emsg.event_duration));
+     atomprint("id=\"%d\"\n", EndianU32_BtoN(emsg.id));
      atomprint(">\n");
 	
      if(vg.cmaf){
          if(EndianU32_BtoN(timescale) !=vg.mediaHeaderTimescale)
-             errprint("CMAF check violated: Section 7.4.5. \"The DASHEventMessageBox in a CMAF Track SHALL contain its timescale field value equal to the timescale in the MediaHeaderBox of CMAF Track that contains it. \", found timescale as %ld instead of %ld \n",timescale, vg.mediaHeaderTimescale);
+             errprint("CMAF check violated: Section 7.4.5. \"The DASHEventMessageBox in a CMAF Track SHALL contain its timescale field value equal to the timescale in the MediaHeaderBox of CMAF Track that contains it. \", found timescale as %d instead of %d \n",timescale, vg.mediaHeaderTimescale);
     }
     // All done
 	aoe->aoeflags |= kAtomValidated;
 bail:
+	CloseBoxBody( &body );
 	return err;
 
 }
@@ -3047,25 +3051,20 @@ bail:
 //==========================================================================================
 
 
+static const BoxField tfdtFields[] = {
+	BOX_UINT_IF( 8, TrafInfoRec, baseMediaDecodeTime, kBoxFieldIfVersion, 1 ),
+	BOX_UINT_IF( 4, TrafInfoRec, baseMediaDecodeTime, kBoxFieldIfNotVersion, 1 ),
+};
+static const BoxLayout tfdtLayout = BOX_LAYOUT( tfdtFields, TrafInfoRec );
+
 OSErr Validate_tfdt_Atom( atomOffsetEntry *aoe, void *refcon )
 {
 	OSErr err = noErr;
 	UInt32 version;
-	UInt32 flags, temp;
-	UInt64 offset;
+	UInt32 flags;
     TrafInfoRec *trafInfo = (TrafInfoRec *)refcon;
     
-	// Get version/flags
-	BAILIFERR( GetFullAtomVersionFlags( aoe, &version, &flags, &offset ) );
-    
-	// Get data 
-	if(version == 1)
-	    BAILIFERR( GetFileDataN64( aoe, &trafInfo->baseMediaDecodeTime, offset, &offset ) );
-    else
-    {
-        BAILIFERR( GetFileDataN32( aoe, &temp, offset, &offset ) );
-        trafInfo->baseMediaDecodeTime = temp;
-    }
+	BAILIFERR( DecodeFullBox( aoe, &tfdtLayout, trafInfo, &version, &flags ) );
 
     trafInfo->tfdtFound = true;
     
@@ -3100,7 +3099,7 @@ OSErr Validate_pssh_Atom( atomOffsetEntry *aoe, void *refcon )
     
 	UInt8 *Data;
     
-    Data = (UInt8 *)malloc(DataSize*sizeof(UInt8)); 
+    Data = (UInt8 *)calloc(DataSize + 1, sizeof(UInt8));	// printed with %s below
     BAILIFERR( GetFileData( aoe,Data, offset, DataSize , &offset ) );
     
     
@@ -3116,14 +3115,14 @@ OSErr Validate_pssh_Atom( atomOffsetEntry *aoe, void *refcon )
     }
 
     atomprint("systemID=\"%s\"\n", print_SysID);
-    atomprint("dataSize=\"%ld\"\n", EndianU32_BtoN(DataSize));
+    atomprint("dataSize=\"%d\"\n", EndianU32_BtoN(DataSize));
     atomprint(">\n");
     //Compare pssh box contents with the cenc:pssh element of MPD
     
-    char *pssh_contents;
+    char pssh_contents[1024];
     if(vg.pssh_count > 0)
     {
-      sprintf(pssh_contents, "%lu %lu %s %lu %s",version, flags, SystemID, DataSize, Data);
+      snprintf(pssh_contents, sizeof(pssh_contents), "%u %u %s %u %s",version, flags, SystemID, DataSize, Data);
     
       //Get pssh mentioned in MPD from a saved file
       char *pssh_file_contents;
@@ -3134,22 +3133,21 @@ OSErr Validate_pssh_Atom( atomOffsetEntry *aoe, void *refcon )
 	char pssh_file_name[300];
 	strcpy(pssh_file_name,vg.psshfile[i]);
 	
-	if(pssh_file_name != '\0'){
+	if(pssh_file_name[0] != '\0'){
 	FILE *pssh_file = fopen(vg.psshfile[i], "rb");
 	
 	  fseek(pssh_file, 0, SEEK_END);
 	  pssh_file_size = ftell(pssh_file);
 	  rewind(pssh_file);
-	  pssh_file_contents = (char *)malloc(pssh_file_size * (sizeof(char)));
+	  pssh_file_contents = (char *)calloc(pssh_file_size + 1, sizeof(char));
 	  fread(pssh_file_contents, sizeof(char), pssh_file_size, pssh_file);
 	
 	  fclose(pssh_file);
 	     
-	  int rc = 0;
 	  int bufferlen = 128;
-	  char encodedoutput[] = "";
+	  char encodedoutput[128 + 1] = "";	// encodeblock may write one past bufferlen
 	  //Convert box contents to base64
-	  rc = Base64Encode(pssh_contents, encodedoutput, bufferlen);
+	  Base64Encode(pssh_contents, encodedoutput, bufferlen);
 	  
 	  if(strcmp(encodedoutput, pssh_file_contents)!=0)
 	  {
@@ -3174,13 +3172,34 @@ bail:
 }
 
 
+static const BoxField sidxReferenceFields[] = {
+	BOX_BITFIELD( 4, 31, 1, Reference, reference_type ),
+	BOX_BITS( 0, 31, Reference, referenced_size ),
+	BOX_UINT( 4, Reference, subsegment_duration ),
+	BOX_BITFIELD( 4, 31, 1, Reference, starts_with_SAP ),
+	BOX_BITS( 28, 3, Reference, SAP_type ),
+	BOX_BITS( 0, 28, Reference, SAP_delta_time ),
+};
+static const BoxLayout sidxReferenceLayout = BOX_LAYOUT( sidxReferenceFields, Reference );
+
+static const BoxField sidxFields[] = {
+	BOX_UINT( 4, SidxInfoRec, reference_ID ),
+	BOX_UINT( 4, SidxInfoRec, timescale ),
+	BOX_UINT_IF( 4, SidxInfoRec, earliest_presentation_time, kBoxFieldIfVersion, 0 ),
+	BOX_UINT_IF( 4, SidxInfoRec, first_offset, kBoxFieldIfVersion, 0 ),
+	BOX_UINT_IF( 8, SidxInfoRec, earliest_presentation_time, kBoxFieldIfNotVersion, 0 ),
+	BOX_UINT_IF( 8, SidxInfoRec, first_offset, kBoxFieldIfNotVersion, 0 ),
+	BOX_BITFIELD( 4, 0, 16, SidxInfoRec, reference_count ),		// after 16 reserved bits
+	BOX_ARRAY( 6, sidxReferenceLayout, SidxInfoRec, references ),
+};
+static const BoxLayout sidxLayout = BOX_LAYOUT( sidxFields, SidxInfoRec );
+
 OSErr Validate_sidx_Atom( atomOffsetEntry *aoe, void *refcon )
 {
 	OSErr err = noErr;
     int i;
 	UInt32 version;
-	UInt32 flags, temp;
-	UInt64 offset;
+	UInt32 flags;
     
     MovieInfoRec *mir = (MovieInfoRec *)refcon;
 
@@ -3211,10 +3230,7 @@ OSErr Validate_sidx_Atom( atomOffsetEntry *aoe, void *refcon )
         }
     }
     
-    // Get version/flags
-    BAILIFERR( GetFullAtomVersionFlags( aoe, &version, &flags, &offset ) );
-    
-    BAILIFERR( GetFileDataN32( aoe, &sidxInfo->reference_ID, offset, &offset ) );
+    BAILIFERR( DecodeFullBox( aoe, &sidxLayout, sidxInfo, &version, &flags ) );
 
     TrackInfoRec *tir;
 
@@ -3227,75 +3243,41 @@ OSErr Validate_sidx_Atom( atomOffsetEntry *aoe, void *refcon )
     
     
     atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-    atomprint("referenceID=\"%ld\"\n", sidxInfo->reference_ID);
+    atomprint("referenceID=\"%d\"\n", sidxInfo->reference_ID);
     
-    
-    BAILIFERR( GetFileDataN32( aoe, &sidxInfo->timescale, offset, &offset ) );
-    atomprint("timeScale=\"%ld\"\n", sidxInfo->timescale);
+    atomprint("timeScale=\"%d\"\n", sidxInfo->timescale);
     
 
     if(tir->mediaTimeScale != sidxInfo->timescale)
         warnprint("Warning: sidx timescale %d != track timescale %d for track ID %d, Section 8.16.3.3 of ISO/IEC 14496-12 4th edition: it is recommended that this match the timescale of the reference stream or track\n",sidxInfo->timescale,tir->mediaTimeScale,sidxInfo->reference_ID);
         
-	// Get data 
-	if(version == 0)
-	{
-	    BAILIFERR( GetFileDataN32( aoe, &temp, offset, &offset ) );
-        sidxInfo->earliest_presentation_time = temp;
-        
-	    BAILIFERR( GetFileDataN32( aoe, &temp, offset, &offset ) );
-        sidxInfo->first_offset = temp;
-	}
-    else
-    {
-	    BAILIFERR( GetFileDataN64( aoe, &sidxInfo->earliest_presentation_time, offset, &offset ) );
-	    BAILIFERR( GetFileDataN64( aoe, &sidxInfo->first_offset, offset, &offset ) );
-    }
-    
     atomprint("earliestPresentationTime=\"%lld\"\n",sidxInfo->earliest_presentation_time); //int64todstr(EndianU64_BtoN(sidxInfo->earliest_presentation_time)));
     atomprint("firstOffset=\"%lld\"\n", (EndianU64_BtoN(sidxInfo->first_offset)));
 
-    BAILIFERR( GetFileDataN32( aoe, &temp, offset, &offset ) );
-    sidxInfo->reference_count = (UInt16)(temp & 0xFFFF);
-    
-    atomprint("referenceCount=\"%ld\"\n", sidxInfo->reference_count);
-
-    sidxInfo->references = (Reference *)malloc(((UInt32)sidxInfo->reference_count)*sizeof(Reference));
+    atomprint("referenceCount=\"%d\"\n", sidxInfo->reference_count);
 
-    sidxInfo->cumulatedDuration = 0;
+    sidxInfo->cumulatedDuration = MediaTimeMake(0, sidxInfo->timescale);
 
     for(i=0; i < sidxInfo->reference_count; i++)
     { 
-        BAILIFERR( GetFileDataN32( aoe, &temp, offset, &offset ) );
-        sidxInfo->references[i].reference_type = (UInt8)(temp >> 31);
-            
         atomprint("reference_type_%d=\"%d\"\n", i+1, sidxInfo->references[i].reference_type);
         if(sidxInfo->references[i].reference_type == 0)
             tir->numLeafs++;
             
-        sidxInfo->references[i].referenced_size = temp & 0x7FFFFFFF;
-        
-        BAILIFERR( GetFileDataN32( aoe, &sidxInfo->references[i].subsegment_duration, offset, &offset ) );
-
-        sidxInfo->cumulatedDuration+=((long double)sidxInfo->references[i].subsegment_duration/(long double)sidxInfo->timescale);
-
-        BAILIFERR( GetFileDataN32( aoe, &temp, offset, &offset ) );
-        sidxInfo->references[i].starts_with_SAP = (UInt8)(temp >> 31);
-        sidxInfo->references[i].SAP_type = (UInt8)((temp & 0x70000000) >> 28);
-        sidxInfo->references[i].SAP_delta_time = temp & 0xFFFFFFF;
-
+        sidxInfo->cumulatedDuration.value += sidxInfo->references[i].subsegment_duration;    //At most 65535 32-bit durations, no overflow
     }
 
+    BAILIFERR( KeyIndexInsert( &mir->sidxByOffset, sidxInfo->offset, mir->processedSdixs ) );
     mir->processedSdixs++;
     
-    atomprint("cumulatedDuration=\"%Lf\"\n", sidxInfo->cumulatedDuration);
+    atomprint("cumulatedDuration=\"%Lf\"\n", MediaTimeSeconds(sidxInfo->cumulatedDuration));
     //atomprint(">\n");
     vg.tabcnt++;
 	for ( i = 0; i < sidxInfo->reference_count; i++ ) {
-	    sampleprint("<subsegment subsegment_duration=\"%ld\"", sidxInfo->references[i].subsegment_duration);
+	    sampleprint("<subsegment subsegment_duration=\"%d\"", sidxInfo->references[i].subsegment_duration);
 	    sampleprintnotab(" starts_with_SAP=\"%d\"", sidxInfo->references[i].starts_with_SAP);
 	    sampleprintnotab(" SAP_type=\"%d\"", sidxInfo->references[i].SAP_type);
-	    sampleprintnotab(" SAP_delta_time=\"%ld\" />\n", sidxInfo->references[i].SAP_delta_time);
+	    sampleprintnotab(" SAP_delta_time=\"%d\" />\n", sidxInfo->references[i].SAP_delta_time);
 	}
     --vg.tabcnt;
     
@@ -3349,7 +3331,7 @@ OSErr Validate_soun_SD_Entry( atomOffsetEntry *aoe, void *refcon )
 	
 	// Print atom contents non-required fields
 	atomprint("sdType=\"%s\"\n", ostypetostr(sdh.sdType));
-	atomprint("dataRefIndex=\"%ld\"\n", sdh.dataRefIndex);
+	atomprint("dataRefIndex=\"%d\"\n", sdh.dataRefIndex);
 	atomprint("sampleRate=\"%s\"\n", fixedU32str(ssdi.sampleRate));
 	
 	sampleratelo = (ssdi.sampleRate) & 0xFFFF;
@@ -3370,11 +3352,11 @@ OSErr Validate_soun_SD_Entry( atomOffsetEntry *aoe, void *refcon )
 			// goto bail;
 	}  
 		
-	FieldMustBe( sdh.resvd1, 0, "SampleDescription resvd1 must be %d not 0x%lx" );
-	FieldMustBe( sdh.resvdA, 0, "SampleDescription resvd1 must be %d not 0x%lx" );
+	FieldMustBe( sdh.resvd1, 0, "SampleDescription resvd1 must be %d not 0x%x" );
+	FieldMustBe( sdh.resvdA, 0, "SampleDescription resvd1 must be %d not 0x%x" );
 	FieldMustBe( ssdi.version, 0, "SoundDescription version must be %d not %d" );
 	FieldMustBe( ssdi.revisionLevel, 0, "SoundDescription revisionLevel must be %d not %d" );
-	FieldMustBe( ssdi.vendor, 0, "SoundDescription vendor must be %d not 0x%lx" );
+	FieldMustBe( ssdi.vendor, 0, "SoundDescription vendor must be %d not 0x%x" );
 	FieldMustBe( ssdi.numChannels, 2, "SoundDescription numChannels must be %d not %d" );
 	FieldMustBe( ssdi.sampleSize, 16, "SoundDescription sampleSize must be %d not %d" );
 	FieldMustBe( ssdi.compressionID, 0, "SoundDescription compressionID must be %d not %d" );
@@ -3382,7 +3364,7 @@ OSErr Validate_soun_SD_Entry( atomOffsetEntry *aoe, void *refcon )
 	// sample rate must be time-scale of track << 16 for mp4
 
 
-	FieldMustBe( ssdi.sampleRate & 0x0000ffff, 0, "SoundDescription sampleRate's low long must be %d not 0x%lx" );
+	FieldMustBe( ssdi.sampleRate & 0x0000ffff, 0, "SoundDescription sampleRate's low long must be %d not 0x%x" );
 	
 	// Now we have the Sample Extensions
 
@@ -3459,7 +3441,7 @@ OSErr Validate_hint_SD_Entry( atomOffsetEntry *aoe, void *refcon )
 	
 	// Print atom contents non-required fields
 	atomprint("sdType=\"%s\"\n", ostypetostr(sdh.sdType));
-	atomprint("dataRefIndex=\"%ld\"\n", sdh.dataRefIndex);
+	atomprint("dataRefIndex=\"%d\"\n", sdh.dataRefIndex);
 	atomprint(">\n"); //vg.tabcnt++; 
 
 	if(vg.cmaf && ((sdh.sdType == 'drmi' ) || (( (sdh.sdType & 0xFFFFFF00) | ' ') == 'enc ' )) && aoe->type != 'sinf'){
@@ -3471,8 +3453,8 @@ OSErr Validate_hint_SD_Entry( atomOffsetEntry *aoe, void *refcon )
 		errprint("CMAF check violated: Section 7.5.10. \"Sample Entries for encrypted tracks SHALL encapsulate the existing sample entry with a Protection Scheme Information Box ('sinf')\", found %s\n", entry_type_name);
 	}
 	// Check required field values
-	FieldMustBe( sdh.resvd1, 0, "SampleDescription resvd1 must be %d not 0x%lx" );
-	FieldMustBe( sdh.resvdA, 0, "SampleDescription resvd1 must be %d not 0x%lx" );
+	FieldMustBe( sdh.resvd1, 0, "SampleDescription resvd1 must be %d not 0x%x" );
+	FieldMustBe( sdh.resvdA, 0, "SampleDescription resvd1 must be %d not 0x%x" );
 	
 //��� hint data
 	
@@ -3498,7 +3480,7 @@ OSErr Validate_subt_SD_Entry( atomOffsetEntry *aoe, void *refcon )
     EndianSampleDescriptionHead_BtoN( &sdh );
     
     atomprint("sdType=\"%s\"\n", ostypetostr(sdh.sdType));
-    atomprint("dataRefIndex=\"%ld\"\n", sdh.dataRefIndex);
+    atomprint("dataRefIndex=\"%d\"\n", sdh.dataRefIndex);
     atomprint(">\n"); //vg.tabcnt++; 
     
     {
@@ -3549,14 +3531,17 @@ OSErr Validate_mp4_SD_Entry( atomOffsetEntry *aoe, void *refcon, ValidateBitstre
 	
 	// Print atom contents non-required fields
 	atomprint("sdType=\"%s\"\n", ostypetostr(sdh.sdType));
-	atomprint("dataRefIndex=\"%ld\"\n", sdh.dataRefIndex);
+	atomprint("dataRefIndex=\"%d\"\n", sdh.dataRefIndex);
 	atomprint(">\n"); //vg.tabcnt++; 
 
 
 
-	FieldMustBe( sdh.sdType, 'mp4s', "SampleDescription sdType must be 'mp4s'" );
-	FieldMustBe( sdh.resvd1, 0, "SampleDescription resvd1 must be %d not 0x%lx" );
-	FieldMustBe( sdh.resvdA, 0, "SampleDescription resvd1 must be %d not 0x%lx" );
+	if (sdh.sdType != 'mp4s') {
+		err = badAtomErr;
+		warnprint("SampleDescription sdType must be 'mp4s' not '%s'\n", ostypetostr(sdh.sdType));
+	}
+	FieldMustBe( sdh.resvd1, 0, "SampleDescription resvd1 must be %d not 0x%x" );
+	FieldMustBe( sdh.resvdA, 0, "SampleDescription resvd1 must be %d not 0x%x" );
 	
 	// Now we have the Sample Extensions
 	{
@@ -3639,8 +3624,8 @@ OSErr Validate_mhaC_Atom( atomOffsetEntry *aoe, void *refcon)
 	atomprint("configurationVersion=\"%d\"\n", mhaDecoderConfigurationRecord.configurationVersion);
 	atomprint("mpegh3daProfileLevelIndication=\"%d\"\n", mhaDecoderConfigurationRecord.mpegh3daProfileLevelIndication);
 	atomprint("referenceChannelLayout=\"%d\"\n", mhaDecoderConfigurationRecord.referenceChannelLayout);
-	atomprint("mpegh3daConfigLength=\"%ld\"\n", EndianU16_BtoN(mhaDecoderConfigurationRecord.mpegh3daConfigLength));
-	atomprint("mpegh3daConfig=\"%ld\"\n", EndianU32_BtoN(mhaDecoderConfigurationRecord.mpegh3daConfig));
+	atomprint("mpegh3daConfigLength=\"%d\"\n", EndianU16_BtoN(mhaDecoderConfigurationRecord.mpegh3daConfigLength));
+	atomprint("mpegh3daConfig=\"%d\"\n", EndianU32_BtoN(mhaDecoderConfigurationRecord.mpegh3daConfig));
 	atomprint(">\n");
 	
         FieldMustBe( mhaDecoderConfigurationRecord.configurationVersion , 1, "ConfigurationVersion must be %d not %d" );
@@ -3670,7 +3655,7 @@ OSErr Validate_ESDAtom( atomOffsetEntry *aoe, void *refcon, ValidateBitstreamPro
 	UInt32 flags;
 	UInt64 offset;
 	Ptr esDataP = nil;
-	unsigned long esSize;
+	UInt32 esSize;
 	BitBuffer bb;
 	
 	atomprint("<ESD"); vg.tabcnt++;
@@ -3679,7 +3664,7 @@ OSErr Validate_ESDAtom( atomOffsetEntry *aoe, void *refcon, ValidateBitstreamPro
 	BAILIFERR( GetFullAtomVersionFlags( aoe, &version, &flags, &offset ) );
 	
 
-		FieldMustBe( flags, 0, "'ESDAtom' flags must be %d not 0x%lx" );
+		FieldMustBe( flags, 0, "'ESDAtom' flags must be %d not 0x%x" );
 		FieldMustBe( version, 0, "ESDAtom version must be %d not 0x%2x" );
 
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags); 
@@ -3705,8 +3690,7 @@ OSErr Validate_ESDAtom( atomOffsetEntry *aoe, void *refcon, ValidateBitstreamPro
 	
 bail:
         --vg.tabcnt; atomprint("</ESD>\n");
-	if (esDataP)
-		free(esDataP);
+	ReleaseFileDataView(esDataP);
 
 	return err;
 }
@@ -3818,7 +3802,7 @@ OSErr Validate_avcC_Atom( atomOffsetEntry *aoe, void *refcon, char *esname )
 	OSErr err = noErr;
 	UInt64 offset;
 	AvcConfigInfo avcHeader;
-	void* bsDataP;
+	void* bsDataP = nil;
 	BitBuffer bb;
 	
 	atomprint("<%s", esname); vg.tabcnt++;
@@ -3837,13 +3821,11 @@ OSErr Validate_avcC_Atom( atomOffsetEntry *aoe, void *refcon, char *esname )
 	BAILIFERR( Validate_AVCConfigRecord( &bb, refcon ) );		
 	//--vg.tabcnt; atomprint("</%s>\n", esname);
 
-
-	free( bsDataP );
-
 	// All done
 	aoe->aoeflags |= kAtomValidated;
 	
 bail:
+	free( bsDataP );
 	--vg.tabcnt; atomprint("</%s>\n", esname);
 	return err;
 }
@@ -3875,7 +3857,7 @@ OSErr Validate_btrt_Atom( atomOffsetEntry *aoe, void *refcon, char *esName )
 	
 	if( sizeof( AvcBtrtInfo ) != bitrHeader.start.atomSize ){
 		err = badAtomSize;
-		errprint( "atom size for 'btrt' atom (%d) != sizeof( AvcBtrtInfo )(%d) \n", bitrHeader.start.atomSize, sizeof( AvcBtrtInfo ) );
+		errprint( "atom size for 'btrt' atom (%d) != sizeof( AvcBtrtInfo )(%ld) \n", bitrHeader.start.atomSize, sizeof( AvcBtrtInfo ) );
 		goto bail;
 	}
 		
@@ -3893,7 +3875,7 @@ OSErr Validate_m4ds_Atom( atomOffsetEntry *aoe, void *refcon, char *esName )
 	OSErr err = noErr;
 	UInt64 offset;
 	Ptr esDataP = nil;
-	unsigned long esSize;
+	UInt32 esSize;
 	BitBuffer bb;
 	
 	atomprint("<m4ds>\n"); vg.tabcnt++;
@@ -3913,8 +3895,7 @@ OSErr Validate_m4ds_Atom( atomOffsetEntry *aoe, void *refcon, char *esName )
 	--vg.tabcnt; atomprint("</m4ds>\n");
 	
 bail:
-	if (esDataP)
-		free(esDataP);
+	ReleaseFileDataView(esDataP);
 
 	return err;
 }
@@ -3925,7 +3906,6 @@ OSErr Validate_stpp_Atom( atomOffsetEntry *aoe, void *refcon, char *esname )
 {
     OSErr err = noErr;
     UInt64 offset;
-    unsigned long esSize;
     char *name_space;
     char *schema_location;
     char *auxiliary_mime_types;
@@ -3972,12 +3952,12 @@ OSErr Validate_cprt_Atom( atomOffsetEntry *aoe, void *refcon )
 	// Get version/flags
 	BAILIFERR( GetFullAtomVersionFlags( aoe, &version, &flags, &offset ) );
 	FieldMustBe( version, 0, "cprt version must be %d not %d" );
-	FieldMustBe( flags, 0, "cprt flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "cprt flags must be %d not 0x%x" );
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
 	
 	// Get data
 	BAILIFERR( GetFileDataN16( aoe, &language, offset, &offset ) );
-	FieldMustBe( (language & 0x8000), 0, "cprt language's high bit must be 0" );
+	FieldMustBe( (language & 0x8000), 0, "cprt language's high bit must be 0x%x not 0x%x" );
 	atomprint("language=\"%s\"\n", langtodstr(language));
 	if (language==0) warnprint("WARNING: Copyright language code of 0 not strictly legit -- 'und' preferred\n");
 
@@ -4103,12 +4083,12 @@ OSErr Validate_loci_Atom( atomOffsetEntry *aoe, void *refcon )
 	// Get version/flags
 	BAILIFERR( GetFullAtomVersionFlags( aoe, &version, &flags, &offset ) );
 	FieldMustBe( version, 0, "loci version must be %d not %d" );
-	FieldMustBe( flags, 0, "loci flags must be %d not 0x%lx" );
+	FieldMustBe( flags, 0, "loci flags must be %d not 0x%x" );
 	atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
 	
 	// Get data
 	BAILIFERR( GetFileDataN16( aoe, &language, offset, &offset ) );
-	FieldMustBe( (language & 0x8000), 0, "loci language's high bit must be 0" );
+	FieldMustBe( (language & 0x8000), 0, "loci language's high bit must be 0x%x not 0x%x" );
 	atomprint("language=\"%s\"\n", langtodstr(language));
 	if (language==0) warnprint("WARNING: Location language code of 0 not strictly legit -- 'und' preferred\n");
 	
@@ -4176,7 +4156,7 @@ OSErr Validate_frma_Atom( atomOffsetEntry *aoe, void *refcon )
 	
 	if( ahdr.atomSize != (sizeof(UInt32) + sizeof(AtomSizeType)) ){
 		err = badAtomSize;
-		errprint( "wrong atom size for 'frma' atom (%d) should be %d \n", ahdr.atomSize, (sizeof(UInt32) + sizeof(AtomSizeType)) );
+		errprint( "wrong atom size for 'frma' atom (%d) should be %ld \n", ahdr.atomSize, (sizeof(UInt32) + sizeof(AtomSizeType)) );
 		goto bail;
 	}
 		
@@ -4250,7 +4230,7 @@ OSErr Validate_schi_Atom( atomOffsetEntry *aoe, void *refcon )
 	maxOffset = aoe->offset + aoe->size - aoe->atomStartSize;
 	
 	BAILIFERR( FindAtomOffsets( aoe, minOffset, maxOffset, &cnt, &list ) );
-	atomprint(" comment=\"%d contained atoms\" >\n",cnt);
+	atomprint(" comment=\"%ld contained atoms\" >\n",cnt);
 
     // Process 'tenc' atoms
         if(vg.cmaf){
@@ -4280,7 +4260,7 @@ OSErr Validate_schi_Atom( atomOffsetEntry *aoe, void *refcon )
             break;
             
 			default:
-				warnprint("WARNING: In %s - unknown schi atom '%s' length %ld\n",vg.curatompath, ostypetostr(entry->type), entry->size);
+				warnprint("WARNING: In %s - unknown schi atom '%s' length %lld\n",vg.curatompath, ostypetostr(entry->type), entry->size);
 				break;
 		}
 
@@ -4341,7 +4321,7 @@ OSErr Validate_tenc_Atom( atomOffsetEntry *aoe, void *refcon )
     vg.tencInInit=true;// As the 'tenc' box is present in moov box (initialization segment).
     
     if(vg.cmaf && default_IsEncrypted!=1){
-        errprint("CMAF Check violated : Section 8.2.3.2. \"In an encrypted Track, the isProtected flag in the TrackEncryptionBox SHALL be set to 1.\",found %ld \n",default_IsEncrypted);
+        errprint("CMAF Check violated : Section 8.2.3.2. \"In an encrypted Track, the isProtected flag in the TrackEncryptionBox SHALL be set to 1.\",found %d \n",default_IsEncrypted);
     }
     
     //Check the default_KID is matching with the one mentioned in the MPD
@@ -4545,7 +4525,7 @@ OSErr Validate_pitm_Atom( atomOffsetEntry *aoe, void *refcon )
 	
 	if( ahdr.atomSize != (6 + sizeof(AtomSizeType)) ){
 		err = badAtomSize;
-		errprint( "wrong atom size for 'pitm' atom (%d) should be %d \n", ahdr.atomSize, (6 + sizeof(AtomSizeType)) );
+		errprint( "wrong atom size for 'pitm' atom (%d) should be %ld \n", ahdr.atomSize, (6 + sizeof(AtomSizeType)) );
 		goto bail;
 	}
 		
@@ -4592,7 +4572,7 @@ OSErr Validate_ipro_Atom( atomOffsetEntry *aoe, void *refcon )
 		
 		BAILIFERR( FindAtomOffsets( aoe, minOffset, maxOffset, &cnt, &list ) );
 		
-		if (cnt != prot_count) errprint("Found %d atoms but expected %d\n", cnt, prot_count);
+		if (cnt != prot_count) errprint("Found %ld atoms but expected %d\n", cnt, prot_count);
 		
 		for (i = 0; i < cnt; i++) {
 			entry = &list[i];
@@ -4659,6 +4639,9 @@ OSErr Validate_infe_Atom( atomOffsetEntry *aoe, void *refcon )
 	aoe->aoeflags |= kAtomValidated;
 	
 bail:
+	free(nameP);
+	free(typeP);
+	free(encodP);
 	return err;
 }
 
@@ -4698,7 +4681,7 @@ OSErr Validate_iinf_Atom( atomOffsetEntry *aoe, void *refcon )
 		
 		BAILIFERR( FindAtomOffsets( aoe, minOffset, maxOffset, &cnt, &list ) );
 		
-		if (cnt != inf_count) errprint("Found %d atoms but expected %d\n", cnt, inf_count);
+		if (cnt != inf_count) errprint("Found %ld atoms but expected %d\n", cnt, inf_count);
 		
 		for (i = 0; i < cnt; i++) {
 			entry = &list[i];
@@ -4725,21 +4708,29 @@ bail:
 	return err;
 }
 
+// The per-sample IVs and subsample maps that follow depend on the IV size in 'tenc'
+typedef struct {
+        UInt32 sample_count;
+} SencInfoRec;
+
+static const BoxField sencFields[] = {
+	BOX_UINT( 4, SencInfoRec, sample_count ),
+};
+static const BoxLayout sencLayout = BOX_LAYOUT( sencFields, SencInfoRec );
+
 OSErr Validate_senc_Atom( atomOffsetEntry *aoe, void *refcon )
 {
         OSErr err = noErr;
         UInt32 version;
         UInt32 flags;
-        UInt64 offset;
+        SencInfoRec senc;
+        UInt32   sample_count;
         
-        // Get version/flags
-        BAILIFERR( GetFullAtomVersionFlags( aoe, &version, &flags, &offset ) );
+        BAILIFERR( DecodeFullBox( aoe, &sencLayout, &senc, &version, &flags ) );
         atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
-        atomprint("offset=\"%ld\"\n", aoe->offset);
+        atomprint("offset=\"%lld\"\n", aoe->offset);
         
-        UInt32   sample_count;
-        BAILIFERR( GetFileData( aoe,&sample_count, offset, 4 , &offset ) );
-        sample_count=EndianU32_BtoN(sample_count);
+        sample_count = senc.sample_count;
         
         UInt8   initializationVector;
         UInt16 subsample_count;
@@ -4747,7 +4738,7 @@ OSErr Validate_senc_Atom( atomOffsetEntry *aoe, void *refcon )
         UInt32 BytesOfProtectedData;
         //TODO Allocate resources to above members according to sample and subsample counts.
         
-        atomprint("sample_count=\"%ld\"\n", sample_count);
+        atomprint("sample_count=\"%d\"\n", sample_count);
         atomprint(">\n");
         
         vg.sencFound= true;
@@ -4758,62 +4749,64 @@ bail:
 	return err;
 }
 
+// Section 8.7.9. of ISO/IEC 14496-12 4th edition
+typedef struct {
+        UInt64 offset;
+} SaioEntry;
+
+typedef struct {
+        UInt32 aux_info_type;
+        UInt32 aux_info_type_parameter;
+        UInt32 entry_count;
+        SaioEntry *entries;
+} SaioInfoRec;
+
+static const BoxField saioEntryFields[] = {
+	BOX_UINT_IF( 4, SaioEntry, offset, kBoxFieldIfVersion, 0 ),
+	BOX_UINT_IF( 8, SaioEntry, offset, kBoxFieldIfNotVersion, 0 ),
+};
+static const BoxLayout saioEntryLayout = BOX_LAYOUT( saioEntryFields, SaioEntry );
+
+static const BoxField saioFields[] = {
+	BOX_UINT_IF( 4, SaioInfoRec, aux_info_type, kBoxFieldIfFlags, 1 ),
+	BOX_UINT_IF( 4, SaioInfoRec, aux_info_type_parameter, kBoxFieldIfFlags, 1 ),
+	BOX_UINT( 4, SaioInfoRec, entry_count ),
+	BOX_ARRAY( 2, saioEntryLayout, SaioInfoRec, entries ),
+};
+static const BoxLayout saioLayout = BOX_LAYOUT( saioFields, SaioInfoRec );
+
 OSErr Validate_saio_Atom( atomOffsetEntry *aoe, void *refcon )
 {
         OSErr err = noErr;
         UInt32 version;
         UInt32 flags;
-        UInt64 offset,temp1;
+        SaioInfoRec saio = { 0 };
+        UInt32 entry_count;
         
-        // Get version/flags
-        BAILIFERR( GetFullAtomVersionFlags( aoe, &version, &flags, &offset ) );
+        BAILIFERR( DecodeFullBox( aoe, &saioLayout, &saio, &version, &flags ) );
         atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
         
-        UInt32 aux_info_typ;
-        UInt32 aux_info_type_parameter;
-        UInt32 entry_count, temp;
-        
         if(flags & 1){
-            BAILIFERR( GetFileData( aoe, &aux_info_typ,  offset, sizeof( UInt32 ), &offset ) );
-	    aux_info_typ= EndianU32_BtoN(aux_info_typ);
-            BAILIFERR( GetFileData( aoe, &aux_info_type_parameter,  offset, sizeof( UInt32 ), &offset ) );
-            if(vg.cmaf && aux_info_typ!='cenc')
-                errprint("CMAF check violated: Section 8.2.2.1: \"For encrypted Fragments that contain Sample Auxiliary Informantion, 'saio' SHALL be present with aux_info_type value of 'cenc'\", but found %s\n",ostypetostr(aux_info_typ));
+            if(vg.cmaf && saio.aux_info_type!='cenc')
+                errprint("CMAF check violated: Section 8.2.2.1: \"For encrypted Fragments that contain Sample Auxiliary Informantion, 'saio' SHALL be present with aux_info_type value of 'cenc'\", but found %s\n",ostypetostr(saio.aux_info_type));
         }
         
-        BAILIFERR( GetFileData( aoe, &entry_count,  offset, sizeof( UInt32 ), &offset ) );
-        entry_count = EndianU32_BtoN(entry_count);
-        atomprint("entry_count=\"%ld\"\n", entry_count);
-        //atomprint("aux_info_typ=\"%s\"\n", ostypetostr(aux_info_typ));
+        entry_count = saio.entry_count;
+        atomprint("entry_count=\"%d\"\n", entry_count);
+        //atomprint("aux_info_typ=\"%s\"\n", ostypetostr(saio.aux_info_type));
         
-        //TODO Allocate saio_offset based on entry_count.
-        if(version ==0)
-        {
-            UInt32 saio_offset[entry_count];
-            for(int i=0;i<entry_count;i++)
-            {
-                BAILIFERR( GetFileData( aoe, &temp,  offset, sizeof( UInt32 ), &offset ) );
-                saio_offset[i] = EndianU32_BtoN(temp);
-                atomprint("saio_offset_%d=\"%ld\"\n", i, saio_offset[i]);
-            }
-            
-        }
-        else
+        for(UInt32 i=0;i<entry_count;i++)
         {
-            UInt64 saio_offset[entry_count];
-            for(int i=0;i<entry_count;i++)
-            {
-                BAILIFERR( GetFileData( aoe, &temp1,  offset, sizeof( UInt64 ), &offset ) );
-                saio_offset[i] = EndianU64_BtoN(temp1);
-                atomprint("saio_offset_%d=\"%ld\"\n", i, saio_offset[i]);
-            }
+            if(version ==0)
+                atomprint("saio_offset_%d=\"%d\"\n", i, (UInt32)saio.entries[i].offset);
+            else
+                atomprint("saio_offset_%d=\"%lld\"\n", i, saio.entries[i].offset);
         }
-        
       
         atomprint(">\n");
         
         if(vg.cmaf && entry_count!=1)
-            errprint("CMAF check violated: Section 8.2.2.1: \"The entry_count field of the SampleAuxiliaryInformationOffsetsBox SHALL equal 1\", but found %ld\n",entry_count);
+            errprint("CMAF check violated: Section 8.2.2.1: \"The entry_count field of the SampleAuxiliaryInformationOffsetsBox SHALL equal 1\", but found %d\n",entry_count);
         
     	// All done
 	aoe->aoeflags |= kAtomValidated;
@@ -4821,6 +4814,58 @@ OSErr Validate_saio_Atom( atomOffsetEntry *aoe, void *refcon )
 bail:
 	return err;
 }
+// Section 8.7.8. of ISO/IEC 14496-12 4th edition
+typedef struct {
+        UInt8 sample_info_size;
+} SaizEntry;
+
+typedef struct {
+        UInt32 aux_info_type;
+        UInt32 aux_info_type_parameter;
+        UInt8  default_sample_info_size;
+        UInt32 sample_count;
+        SaizEntry *entries;     // only when default_sample_info_size is 0
+} SaizInfoRec;
+
+static const BoxField saizEntryFields[] = {
+	BOX_UINT( 1, SaizEntry, sample_info_size ),
+};
+static const BoxLayout saizEntryLayout = BOX_LAYOUT( saizEntryFields, SaizEntry );
+
+static const BoxField saizFields[] = {
+	BOX_UINT_IF( 4, SaizInfoRec, aux_info_type, kBoxFieldIfFlags, 1 ),
+	BOX_UINT_IF( 4, SaizInfoRec, aux_info_type_parameter, kBoxFieldIfFlags, 1 ),
+	BOX_UINT( 1, SaizInfoRec, default_sample_info_size ),
+	BOX_UINT( 4, SaizInfoRec, sample_count ),
+	BOX_ARRAY_IF( 3, saizEntryLayout, SaizInfoRec, entries, kBoxFieldIfZero, 2 ),
+};
+static const BoxLayout saizLayout = BOX_LAYOUT( saizFields, SaizInfoRec );
+
+OSErr Validate_saiz_Atom( atomOffsetEntry *aoe, void *refcon )
+{
+        OSErr err = noErr;
+        UInt32 version;
+        UInt32 flags;
+        SaizInfoRec saiz = { 0 };
+        
+        BAILIFERR( DecodeFullBox( aoe, &saizLayout, &saiz, &version, &flags ) );
+        atomprintnotab("\tversion=\"%d\" flags=\"%d\"\n", version, flags);
+        atomprint("default_sample_info_size=\"%d\"\n", saiz.default_sample_info_size);
+        atomprint("sample_count=\"%d\"\n", saiz.sample_count);
+        atomprint(">\n");
+        
+        vg.tabcnt++;
+        for(UInt32 i=0; saiz.entries && i<saiz.sample_count; i++)
+            sampleprint("<sampleInfo sampleInfoSize=\"%d\"/>\n", saiz.entries[i].sample_info_size);
+        --vg.tabcnt;
+        
+    	// All done
+	aoe->aoeflags |= kAtomValidated;
+	
+bail:
+	return err;
+}
+
 // Validate function for HEVC atom and ConfigRecord.
 OSErr Validate_hvcC_Atom( atomOffsetEntry *aoe, void *refcon, char *esname )
 {
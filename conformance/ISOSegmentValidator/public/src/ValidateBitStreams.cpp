@@ -22,7 +22,6 @@ limitations under the License.
 #include "math.h"
 
 	// JRM
-extern ValidateGlobals vg;
 
 OSErr Validate_ES_INC_Descriptor(BitBuffer *bb);
 OSErr Validate_ES_REF_Descriptor(BitBuffer *bb);
@@ -76,7 +75,7 @@ OSErr CheckValuesInContext( UInt32 bufferSize, UInt32 maxBitrate, UInt32 avgBitr
 
 //==========================================================================================
 
-OSErr Validate_iods_OD_Bits( Ptr odDataP, unsigned long odSize, Boolean fileForm )
+OSErr Validate_iods_OD_Bits( Ptr odDataP, UInt32 odSize, Boolean fileForm )
 {
 	OSErr err;
 	BitBuffer thebb;
@@ -104,9 +103,9 @@ OSErr Validate_iods_OD_Bits( Ptr odDataP, unsigned long odSize, Boolean fileForm
 	BAILIFERR( GetDescriptorTagAndSize(bb, &iodTag, &iodSize) );
 	atomprintnotab("\ttag=\"0x%2.2x\" size=\"%d\"\n", iodTag, iodSize);
     if (fileForm) {
-        FieldMustBe(iodTag, Class_MP4_IOD_Tag, "ValidateIODSAtom: objectDescriptorTag != Class_MP4_IOD_Tag" );
+        FieldMustBe(iodTag, Class_MP4_IOD_Tag, "ValidateIODSAtom: objectDescriptorTag must be Class_MP4_IOD_Tag (0x%x) not 0x%x" );
     } else {
-        FieldMustBe(iodTag, Class_InitialObjectDescTag, "ValidateIODSAtom: objectDescriptorTag != Class_InitialObjectDescTag" );
+        FieldMustBe(iodTag, Class_InitialObjectDescTag, "ValidateIODSAtom: objectDescriptorTag must be Class_InitialObjectDescTag (0x%x) not 0x%x" );
 
     }
 	
@@ -301,7 +300,7 @@ OSErr Validate_ES_INC_Descriptor(BitBuffer *bb)
 	atomprintnotab("\ttag=\"0x%2.2x\" size=\"%d\"\n", tag, size);
 	FieldMustBe( size, 4, "Validate_ES_INC_Descriptor: size should be %d bytes not %d bytes\n" );
 	
-	VALIDATE_FIELD( "%ld", ES_ID, 32);
+	VALIDATE_FIELD( "%d", ES_ID, 32);
 	/* !dws ES_ID should be the trackID of an existing OD or BIFS track */
 	
 	--vg.tabcnt; atomprint("/>\n");
@@ -333,7 +332,7 @@ OSErr Validate_ES_REF_Descriptor(BitBuffer *bb)
 	atomprintnotab("\ttag=\"0x%2.2x\" size=\"%d\"\n", tag, size);
 	FieldMustBe( size, 2, "Validate_ES_REF_Descriptor: size should be %d bytes not %d bytes\n" );
 	
-	VALIDATE_FIELD( "%ld", Trk_ref, 16);
+	VALIDATE_FIELD( "%d", Trk_ref, 16);
 	/* !dws trk_ref index ought to be in range */
 	
 	--vg.tabcnt; atomprint("/>\n");
@@ -377,7 +376,7 @@ OSErr Validate_Dec_conf_Descriptor(BitBuffer *inbb, UInt8 Expect_ObjectType, UIn
 
 	BAILIFERR( GetDescriptorTagAndSize(bb, &tag, &size) );
 	atomprintnotab("\ttag=\"0x%2.2x\" size=\"%d\"\n", tag, size);
-	FieldMustBe( tag, Class_DecoderConfigDescTag, "Validate_Dec_conf_Descriptor: Tag != Class_DecoderConfigDescTag\n" );
+	FieldMustBe( tag, Class_DecoderConfigDescTag, "Validate_Dec_conf_Descriptor: Tag must be Class_DecoderConfigDescTag (0x%x) not 0x%x\n" );
 
 	newbb= *inbb;
 	bb = &newbb;
@@ -386,12 +385,12 @@ OSErr Validate_Dec_conf_Descriptor(BitBuffer *inbb, UInt8 Expect_ObjectType, UIn
 	
 	VALIDATE_FIELD("0x%02x",  ObjectType, 8 );
 	if (Expect_ObjectType!=0) {
-		FieldMustBe( ObjectType, Expect_ObjectType, "Validate_Dec_conf_Descriptor: expected ObjectType = 0x%lx, not 0x%lx\n" );
+		FieldMustBe( ObjectType, Expect_ObjectType, "Validate_Dec_conf_Descriptor: expected ObjectType = 0x%x, not 0x%x\n" );
 	}
 	
 	VALIDATE_FIELD("0x%02x",  StreamType, 6 );	
 	if (Expect_StreamType != 0) {
-		FieldMustBe( StreamType, Expect_StreamType, "Validate_Dec_conf_Descriptor: expected StreamType = 0x%lx, not 0x%lx\n" );
+		FieldMustBe( StreamType, Expect_StreamType, "Validate_Dec_conf_Descriptor: expected StreamType = 0x%x, not 0x%x\n" );
 	}
 	
 	VALIDATE_FIELD_V("%d",  UpStream, 1, 0, "Dec_conf_Descriptor" );	
@@ -457,7 +456,7 @@ OSErr Validate_ES_Descriptor(BitBuffer *inbb, UInt8 Expect_ObjectType, UInt8 Exp
 	BAILIFERR( GetDescriptorTagAndSize(bb, &tag, &size) );
 	atomprintnotab("\ttag=\"0x%2.2x\" size=\"%d\"\n", tag, size);
 
-		FieldMustBe( tag, Class_ES_DescrTag, "Validate_ES_Descriptor: Tag != Class_ES_DescrTag\n" );
+		FieldMustBe( tag, Class_ES_DescrTag, "Validate_ES_Descriptor: Tag must be Class_ES_DescrTag (0x%x) not 0x%x\n" );
 	
 	newbb= *inbb;
 	bb = &newbb;
@@ -706,8 +705,8 @@ OSErr Validate_SLconf_Descriptor( BitBuffer *inbb, Boolean fileForm)
 		VALIDATE_FIELD("%d",  useIdleFlag, 1);
 		VALIDATE_FIELD("%d",  durationFlag, 1);
 		
-		VALIDATE_FIELD("%ld", timeStampResolution, 32);
-		VALIDATE_FIELD("%ld", OCRResolution, 32);
+		VALIDATE_FIELD("%d", timeStampResolution, 32);
+		VALIDATE_FIELD("%d", OCRResolution, 32);
 		
 		VALIDATE_FIELD("%d",  timeStampLength, 8);
 		if (timeStampLength>64) errprint("Validate_SLconf_Descriptor: timeStampLength %d out of bounds\n",timeStampLength);
@@ -739,15 +738,15 @@ OSErr Validate_SLconf_Descriptor( BitBuffer *inbb, Boolean fileForm)
 	if (durationFlag) {
 		UInt32 timeScale;
 		UInt16 accessUnitDuration, compositionUnitDuration;
-		VALIDATE_FIELD("%ld", timeScale, 32);
+		VALIDATE_FIELD("%d", timeScale, 32);
 		VALIDATE_FIELD("%d",  accessUnitDuration, 16);
 		VALIDATE_FIELD("%d",  compositionUnitDuration, 16);
 	}
 	if (!useTimeStampsFlag) {
 		UInt32 startDecodingTimeStamp;
 		UInt32 startCompositionTimeStamp;
-		VALIDATE_FIELD("0x%lx", startDecodingTimeStamp, timeStampLength);
-		VALIDATE_FIELD("0x%lx", startCompositionTimeStamp, timeStampLength);
+		VALIDATE_FIELD("0x%x", startDecodingTimeStamp, timeStampLength);
+		VALIDATE_FIELD("0x%x", startCompositionTimeStamp, timeStampLength);
 	}
 	
 	--vg.tabcnt; atomprint("/>\n");
@@ -856,17 +855,17 @@ OSErr Validate_SoundSpecificInfo(  BitBuffer *bb )
 	VALIDATE_FIELD("0x%02x",  audioObjectType, 5);
 	
 	if (audioObjectType<28) {
-		atomprint("comment%ld=\"audio is %s\"\n", counter++, audiotype[audioObjectType]);
+		atomprint("comment%d=\"audio is %s\"\n", counter++, audiotype[audioObjectType]);
 	}
 	VALIDATE_FIELD("0x%1x",  samplingFreqIndex, 4);
 	if (samplingFreqIndex==0x0f) {
 		VALIDATE_FIELD("%d",  samplingFreq, 24);
 	}
-	else atomprint("comment%ld=\"freq is %s\"\n", counter++, freqs[samplingFreqIndex]);
+	else atomprint("comment%d=\"freq is %s\"\n", counter++, freqs[samplingFreqIndex]);
 	
 	VALIDATE_FIELD("0x%1x",  channelConfig, 4);
 	if ((channelConfig>0) && (channelConfig<8)) {
-		atomprint("comment%ld=\"config is %s\"\n", counter++, configs[channelConfig]);
+		atomprint("comment%d=\"config is %s\"\n", counter++, configs[channelConfig]);
 	}
 	
 	if (audioObjectType == 5) {
@@ -876,11 +875,11 @@ OSErr Validate_SoundSpecificInfo(  BitBuffer *bb )
 		if (ext_samplingFreqIndex==0x0f) {
 			VALIDATE_FIELD("%d",  ext_samplingFreq, 24);
 		}
-		else atomprint("comment%ld=\"freq is %s\"\n", counter++, freqs[ext_samplingFreqIndex]);
+		else atomprint("comment%d=\"freq is %s\"\n", counter++, freqs[ext_samplingFreqIndex]);
 		VALIDATE_FIELD("0x%02x",  temp_audioObjectType, 5);
                 audioObjectType=temp_audioObjectType;
 		if (audioObjectType<28) {
-			atomprint("comment%ld=\"audio is %s\"\n", counter++, audiotype[audioObjectType]);
+			atomprint("comment%d=\"audio is %s\"\n", counter++, audiotype[audioObjectType]);
 		}
 	}
 
@@ -894,7 +893,7 @@ OSErr Validate_SoundSpecificInfo(  BitBuffer *bb )
 				UInt32 codeCoderdelay;
 				UInt8 extFlag;
 				VALIDATE_FIELD("%d",  frameLengthFlag, 1);
-				atomprint("comment%ld=\"length is %d\"\n", counter++, (frameLengthFlag==0 ? 1024 : 960) ); /* !dws check with audio guys */
+				atomprint("comment%d=\"length is %d\"\n", counter++, (frameLengthFlag==0 ? 1024 : 960) ); /* !dws check with audio guys */
 				VALIDATE_FIELD("%d",  dependsOnCoreCoder, 1);
 				if (dependsOnCoreCoder==1) {
 					VALIDATE_FIELD("%d",  codeCoderdelay, 14);
@@ -917,9 +916,9 @@ OSErr Validate_SoundSpecificInfo(  BitBuffer *bb )
 					/* atomprint("  comment=\"GA custom config here\"\n"); */
 					VALIDATE_FIELD("%d",  element_instance_tag, 4);
 					VALIDATE_FIELD("%d",  object_type, 2);
-						atomprint("comment%ld=\"object is %s\"\n", counter++, aactypes[object_type]);
+						atomprint("comment%d=\"object is %s\"\n", counter++, aactypes[object_type]);
 					VALIDATE_FIELD("0x%1x",  samplingFreqIndex_progConfigElement, 4);
-						atomprint("comment%ld=\"freq is %s\"\n", counter++, freqs[samplingFreqIndex_progConfigElement]);
+						atomprint("comment%d=\"freq is %s\"\n", counter++, freqs[samplingFreqIndex_progConfigElement]);
 
 					VALIDATE_FIELD("%d",  num_front_channel_elements, 4);
 					VALIDATE_FIELD("%d",  num_side_channel_elements, 4);
@@ -1008,9 +1007,9 @@ OSErr Validate_SoundSpecificInfo(  BitBuffer *bb )
 				VALIDATE_FIELD("%d",  is_base_layer, 1);
 				if (is_base_layer == 1) {
 					VALIDATE_FIELD("%d",  excit_Mode, 1);
-					atomprint("comment%ld=\"mode is %s\"\n", counter++, (excit_Mode==0 ? "MPE" : "RPE") ); 
+					atomprint("comment%d=\"mode is %s\"\n", counter++, (excit_Mode==0 ? "MPE" : "RPE") ); 
 					VALIDATE_FIELD("%d",  sampleRateMode, 1);
-					atomprint("comment%ld=\"mode is %s\"\n", counter++, (sampleRateMode==0 ? "8kHz" : "16kHz") );
+					atomprint("comment%d=\"mode is %s\"\n", counter++, (sampleRateMode==0 ? "8kHz" : "16kHz") );
 					VALIDATE_FIELD("%d",  fineRateControl, 1);
 					if (excit_Mode==1) /* RPE */ {
 						VALIDATE_FIELD("%d",  rpe_conf, 3);
@@ -1128,7 +1127,7 @@ OSErr Validate_SoundSpecificInfo(  BitBuffer *bb )
 		if (syncExtensionType == 0x2b7) {
 			VALIDATE_FIELD("0x%02x",  ext_audioObjectType, 5);
 			if (ext_audioObjectType<28) {
-				atomprint("comment%ld=\"audio is %s\"\n", counter++, audiotype[ext_audioObjectType]);
+				atomprint("comment%d=\"audio is %s\"\n", counter++, audiotype[ext_audioObjectType]);
 			}
 			if ( ext_audioObjectType == 5 ) {
 				VALIDATE_FIELD("%d",  sbr_present, 1);
@@ -1137,7 +1136,7 @@ OSErr Validate_SoundSpecificInfo(  BitBuffer *bb )
 					if (ext_samplingFreqIndex==0x0f) {
 						VALIDATE_FIELD("%d",  ext_samplingFreq, 24);
 					}
-					else atomprint("comment%ld=\"freq is %s\"\n", counter++, freqs[ext_samplingFreqIndex]);
+					else atomprint("comment%d=\"freq is %s\"\n", counter++, freqs[ext_samplingFreqIndex]);
 				}
 			}
 		}
@@ -1264,7 +1263,7 @@ OSErr Validate_VideoSpecificInfo(  BitBuffer *bb, UInt32 expect_startcode, UInt8
 	
 	VALIDATE_FIELD("0x%04x",  startcode, 32);
 	if ((expect_startcode!=0) && (startcode!=expect_startcode))
-		errprint("Validate_VideoSpecificInfo: expected 0x%lx startcode, got 0x%lx\n",expect_startcode,startcode);
+		errprint("Validate_VideoSpecificInfo: expected 0x%x startcode, got 0x%x\n",expect_startcode,startcode);
 	
 	if (startcode == VSC_VO_Sequence) {		
 		profileLevelInd = GetBits(bb, 8, &err); if (err) goto bail;
@@ -1324,7 +1323,7 @@ OSErr Validate_VideoSpecificInfo(  BitBuffer *bb, UInt32 expect_startcode, UInt8
 					"MAC", "Unspecified", "Reserved", "Reserved" };
 
 				VALIDATE_FIELD("%d",  vFormat, 3);
-				atomprint("comment%ld=\"format is %s\"\n", counter++, formats[vFormat]);
+				atomprint("comment%d=\"format is %s\"\n", counter++, formats[vFormat]);
 				VALIDATE_FIELD("%d",  vRange, 1);
 				VALIDATE_FIELD("%d",  colourDesc, 1);
 				if (colourDesc==1) {
@@ -1333,9 +1332,9 @@ OSErr Validate_VideoSpecificInfo(  BitBuffer *bb, UInt32 expect_startcode, UInt8
 						"Log 100:1", "Log 316.22777:1"};
 						
 					VALIDATE_FIELD("%d",  colourPrimaries, 8);
-					if (colourPrimaries<9) atomprint("comment%ld=\"primaries are %s\"\n", counter++, primaries[colourPrimaries]);
+					if (colourPrimaries<9) atomprint("comment%d=\"primaries are %s\"\n", counter++, primaries[colourPrimaries]);
 					VALIDATE_FIELD("%d",  transferChars, 8);
-					if (transferChars<11) atomprint("comment%ld=\"transfer chars are %s\"\n", counter++, primaries[transferChars]);
+					if (transferChars<11) atomprint("comment%d=\"transfer chars are %s\"\n", counter++, primaries[transferChars]);
 					VALIDATE_FIELD("%d",  matrixCoeffs, 8);
 				}
 			}
@@ -1350,7 +1349,7 @@ OSErr Validate_VideoSpecificInfo(  BitBuffer *bb, UInt32 expect_startcode, UInt8
 				OSErr err = noErr;
 				startcode = PeekBits(bb,32,&err);
 				if (err == outOfDataErr) {
-					atomprint("comment%ld=\"short headers\"\n", counter++);
+					atomprint("comment%d=\"short headers\"\n", counter++);
 				}
 				else if ((startcode >= 0x120) && (startcode <=  0x12F)) 
 					{ err = Validate_VideoSpecificInfo(bb,0,voVerID, p_sc); }
@@ -1387,7 +1386,7 @@ OSErr Validate_VideoSpecificInfo(  BitBuffer *bb, UInt32 expect_startcode, UInt8
 		
 		VALIDATE_FIELD("%d",  randomAccessibleVol, 1);
 		VALIDATE_FIELD("0x%02x",  voTypeIndic, 8);
-		if (voTypeIndic<10) atomprint("comment%ld=\"type is %s\"\n", counter++, vol_types[voTypeIndic] );
+		if (voTypeIndic<10) atomprint("comment%d=\"type is %s\"\n", counter++, vol_types[voTypeIndic] );
 		if (voTypeIndic == 0x12) {	/* "Fine Granularity Scalable" */
 			UInt8 fgs_layer_type, vol_prio, fgs_ref_layer_id, quarter_sample, fgs_rs_mk_dis, interlaced;
 			UInt16 volWidth, volHeight;
@@ -1401,7 +1400,7 @@ OSErr Validate_VideoSpecificInfo(  BitBuffer *bb, UInt32 expect_startcode, UInt8
 				VALIDATE_FIELD("%d",  parWidth, 8);
 				VALIDATE_FIELD("%d",  parHeight, 8);
 			}
-			else if (aspectRatioInfo<6) atomprint("comment%ld=\"aspect ratio is %s\"\n", counter++, ratios[aspectRatioInfo]);
+			else if (aspectRatioInfo<6) atomprint("comment%d=\"aspect ratio is %s\"\n", counter++, ratios[aspectRatioInfo]);
 			VALIDATE_FIELD("%d",  volControlParams, 1);
 			if (volControlParams==1) {
 				UInt8 chromaFormat;
@@ -1485,7 +1484,7 @@ OSErr Validate_VideoSpecificInfo(  BitBuffer *bb, UInt32 expect_startcode, UInt8
 				VALIDATE_FIELD("%d",  parWidth, 8);
 				VALIDATE_FIELD("%d",  parHeight, 8);
 			}
-			else if (aspectRatioInfo<6) atomprint("comment%ld=\"aspect ratio is %s\"\n", counter++, ratios[aspectRatioInfo]);
+			else if (aspectRatioInfo<6) atomprint("comment%d=\"aspect ratio is %s\"\n", counter++, ratios[aspectRatioInfo]);
 			VALIDATE_FIELD("%d",  volControlParams, 1);
 			if (volControlParams==1) {
 				UInt8 chromaFormat;
@@ -1507,7 +1506,7 @@ OSErr Validate_VideoSpecificInfo(  BitBuffer *bb, UInt32 expect_startcode, UInt8
 				}
 			}
 			VALIDATE_FIELD("%d",  volShape, 2); 
-			atomprint("comment%ld=\"shape is %s\"\n", counter++, shapes[volShape]);
+			atomprint("comment%d=\"shape is %s\"\n", counter++, shapes[volShape]);
 			if (volShape == 3 /* "grayscale" */
 			    && voVerID != 1)
 				VALIDATE_FIELD("%d",  volShapeExt, 4);
@@ -1716,26 +1715,26 @@ OSErr Validate_level_IDC( UInt8 profile, UInt8 level, UInt8 constraint_set3_flag
 	if ( ((profile == 66) || (profile == 77) || (profile == 88)) && 
 		 (level==11) && 
 		 (constraint_set3_flag==1)) 
-	{ atomprint("Comment%ld=\"level 1b\"\n", counter++); } 
+	{ atomprint("Comment%d=\"level 1b\"\n", counter++); } 
 	else 
 	{
 		if (level>9) { 
 			float x;
 			x = level;
 			x = x/10;
-			atomprint("Comment%ld=\"level %3.1f\"\n", counter++, x);
+			atomprint("Comment%d=\"level %3.1f\"\n", counter++, x);
 		}
-		else { atomprint("Comment%ld=\"unknown level\"\n", counter++); }
+		else { atomprint("Comment%d=\"unknown level\"\n", counter++); }
 	
 		if ( ((profile == 100) || (profile == 110)  ) && (constraint_set3_flag==1))
-		{ atomprint("Comment%ld=\"High 10 Intra profile compatible\"\n", counter++); }
+		{ atomprint("Comment%d=\"High 10 Intra profile compatible\"\n", counter++); }
 		else if ( (profile == 122) && (constraint_set3_flag==1))
-		{ atomprint("Comment%ld=\"High 4:2:2 Intra profile compatible\"\n", counter++); }
+		{ atomprint("Comment%d=\"High 4:2:2 Intra profile compatible\"\n", counter++); }
 		else if (profile == 44) {
 			if (constraint_set3_flag != 1) errprint("Error: constraint_set3_flag must be 1 when profile_idc is 44\n");
 		}
 		else if ( (profile == 244) && (constraint_set3_flag==1))
-		{ atomprint("Comment%ld=\"High 4:4:4 Intra profile compatible\"\n", counter++); }
+		{ atomprint("Comment%d=\"High 4:4:4 Intra profile compatible\"\n", counter++); }
 
 		else if (constraint_set3_flag == 1) 
 				  warnprint("Warning: constraint_set3_flag==1 when it seems to be reserved to zero\n");
@@ -1775,10 +1774,10 @@ OSErr Validate_AVCConfigRecord( BitBuffer *bb, void *refcon )
 	
 	VALIDATE_FIELD  ("%d", constraint_set0_flag, 1);
 		if ((avcHeader.profile==66) && (constraint_set0_flag==0))
-			warnprint("Warning: Validate_AVCConfig: Baseline profile signalled but constraint_set0_flag not set\n",avcHeader.profile);
+			warnprint("Warning: Validate_AVCConfig: Baseline profile signalled but constraint_set0_flag not set\n");
 	VALIDATE_FIELD  ("%d", constraint_set1_flag, 1);
 		if ((avcHeader.profile==77) && (constraint_set1_flag==0))
-			warnprint("Warning: Validate_AVCConfig: Main profile signalled but constraint_set1_flag not set\n",avcHeader.profile);
+			warnprint("Warning: Validate_AVCConfig: Main profile signalled but constraint_set1_flag not set\n");
 	VALIDATE_FIELD  ("%d", constraint_set2_flag, 1);
 	VALIDATE_FIELD  ("%d", constraint_set3_flag, 1);
 	VALIDATE_FIELD_V("0x%02x", reserved, 4, 0, "Validate_AVCConfig");
@@ -1865,7 +1864,7 @@ OSErr Validate_AVCConfigRecord( BitBuffer *bb, void *refcon )
 		}
 	} 
 	
-	if (bb->bits_left != 0) errprint("Validate AVC Config record didn't use %ld bits\n", bb->bits_left);
+	if (bb->bits_left != 0) errprint("Validate AVC Config record didn't use %d bits\n", bb->bits_left);
 
 
 
@@ -2018,6 +2017,18 @@ OSErr Validate_NAL_Unit(  BitBuffer *inbb, UInt8 expect_type, UInt32 nal_length
 	int counter = 0;
 	atomprint("<NALUnit length=\"%d (0x%x)\"\n",nal_length,nal_length); vg.tabcnt++;
 	
+	// the length comes from the stream, so it need not fit in what is left of it
+	if (nal_length == 0) {
+		errprint("Validate_NAL_Unit: NAL unit length is zero\n");
+		err = outOfDataErr;
+		goto bail;
+	}
+	if (nal_length > inbb->bits_left / 8) {
+		errprint("Validate_NAL_Unit: NAL unit length %u is more than the %u bytes left\n", nal_length, inbb->bits_left / 8);
+		err = outOfDataErr;
+		goto bail;
+	}
+	
 	mybb = *inbb;
 	mybb.bits_left = nal_length * 8;
 	mybb.prevent_emulation = 1;
@@ -2036,7 +2047,7 @@ OSErr Validate_NAL_Unit(  BitBuffer *inbb, UInt8 expect_type, UInt32 nal_length
 	} else {
 		VALIDATE_FIELD  ("0x%02x", nal_type, 5);
 	}
-	atomprint("comment%ld=\"%s\"\n",counter++,naltypes[nal_type]);
+	atomprint("comment%d=\"%s\"\n",counter++,naltypes[nal_type]);
 	
 	switch (nal_type) {
 		case nal_SPS:
@@ -2065,10 +2076,10 @@ OSErr Validate_NAL_Unit(  BitBuffer *inbb, UInt8 expect_type, UInt32 nal_length
 			}
 			VALIDATE_FIELD  ("%d", constraint_set0_flag, 1);
 				if ((profile_idc==66) && (constraint_set0_flag==0))
-					warnprint("Warning: Validate_NAL_Unit (SPS): Baseline profile signalled but constraint_set0_flag not set\n",profile_idc);
+					warnprint("Warning: Validate_NAL_Unit (SPS): Baseline profile signalled but constraint_set0_flag not set\n");
 			VALIDATE_FIELD  ("%d", constraint_set1_flag, 1);
 				if ((profile_idc==77) && (constraint_set1_flag==0))
-					warnprint("Warning: Validate_NAL_Unit (SPS): Main profile signalled but constraint_set1_flag not set\n",profile_idc);
+					warnprint("Warning: Validate_NAL_Unit (SPS): Main profile signalled but constraint_set1_flag not set\n");
 			VALIDATE_FIELD  ("%d", constraint_set2_flag, 1);
 			VALIDATE_FIELD  ("%d", constraint_set3_flag, 1);
 			VALIDATE_FIELD_V("0x%02x", reserved, 4, 0, "Validate_NALU");
@@ -2137,9 +2148,9 @@ OSErr Validate_NAL_Unit(  BitBuffer *inbb, UInt8 expect_type, UInt32 nal_length
 			VALIDATE_UEV    ( "%d", num_ref_frames);
 			VALIDATE_FIELD  ("0x%01x", gaps_in_frame_num_value_allowed_flag, 1);
 			VALIDATE_UEV    ( "%d", pic_width_in_mbs_minus1);
-				atomprint("Comment%ld=\"width (PW + 1)*16 = %d\"\n", counter++,(pic_width_in_mbs_minus1+1)*16);
+				atomprint("Comment%d=\"width (PW + 1)*16 = %d\"\n", counter++,(pic_width_in_mbs_minus1+1)*16);
 			VALIDATE_UEV    ( "%d", pic_height_in_map_units_minus1);
-				atomprint("Comment%ld=\"height (PH + 1)*16 = %d\"\n",counter++,(pic_height_in_map_units_minus1+1)*16);
+				atomprint("Comment%d=\"height (PH + 1)*16 = %d\"\n",counter++,(pic_height_in_map_units_minus1+1)*16);
 			
 			VALIDATE_FIELD  ("%d", frame_mbs_only_flag, 1);
 			
@@ -2178,7 +2189,7 @@ OSErr Validate_NAL_Unit(  BitBuffer *inbb, UInt8 expect_type, UInt32 nal_length
 						VALIDATE_FIELD  ("%d", sar_height, 16);
 					} else if (aspect_ratio_idc<=13)
 					{
-						atomprint("Comment%ld=\"aspect ratio is %s\"\n",counter++,aspect_types[aspect_ratio_idc]);
+						atomprint("Comment%d=\"aspect ratio is %s\"\n",counter++,aspect_types[aspect_ratio_idc]);
 					}
 				}
 				VALIDATE_FIELD  ("0x%01x", overscan_info_present_flag, 1);
@@ -2199,20 +2210,20 @@ OSErr Validate_NAL_Unit(  BitBuffer *inbb, UInt8 expect_type, UInt32 nal_length
 						"BT.470-2 System B,G", "SMPTE 170M", "SMPTE 240M" };
 
 					VALIDATE_FIELD  ("0x%01x", video_format, 3);
-					if (video_format<6) atomprint("COMMENT%ld=\"video format is %s\"\n",counter++,video_types[video_format]);
+					if (video_format<6) atomprint("COMMENT%d=\"video format is %s\"\n",counter++,video_types[video_format]);
 					
 					VALIDATE_FIELD  ("0x%01x", video_full_range_flag, 1);
 					VALIDATE_FIELD  ("0x%01x", colour_description_present_flag, 1);
 					if( colour_description_present_flag ) {
 						VALIDATE_FIELD  ("0x%01x", colour_primaries, 8);
 						if (colour_primaries<9) 
-							atomprint("COMMENT%ld=\"primaries are %s\"\n",counter++,primaries[colour_primaries]);
+							atomprint("COMMENT%d=\"primaries are %s\"\n",counter++,primaries[colour_primaries]);
 						VALIDATE_FIELD  ("0x%01x", transfer_characteristics, 8);
 						if (transfer_characteristics<11) 
-							atomprint("COMMENT%ld=\"transfer characteristics are %s\"\n",counter++,primaries[transfer_characteristics]);
+							atomprint("COMMENT%d=\"transfer characteristics are %s\"\n",counter++,primaries[transfer_characteristics]);
 						VALIDATE_FIELD  ("0x%01x", matrix_coefficients, 8);
 						if (matrix_coefficients<8) 
-							atomprint("COMMENT%ld=\"matrix coefficients are %s\"\n",counter++,matrices[matrix_coefficients]);
+							atomprint("COMMENT%d=\"matrix coefficients are %s\"\n",counter++,matrices[matrix_coefficients]);
 					}
 				}
 				VALIDATE_FIELD  ("0x%01x", chroma_loc_info_present_flag, 1);
@@ -2415,7 +2426,7 @@ OSErr Validate_NAL_Unit(  BitBuffer *inbb, UInt8 expect_type, UInt32 nal_length
 			
 			VALIDATE_UEV( "%d", first_mb_in_slice);
 			VALIDATE_UEV( "%d", slice_type);
-				if (slice_type<10) atomprint("COMMENT%ld=\"slice type is %s\"\n",counter++,slice_types[slice_type]);
+				if (slice_type<10) atomprint("COMMENT%d=\"slice type is %s\"\n",counter++,slice_types[slice_type]);
 			VALIDATE_UEV( "%d", pic_parameter_set_id);
 			/* now we have to find log2_max_frame_num_minus4, and frame_mbs only from the SPS linked to the PPS of this ID.  ugh */
 			VALIDATE_FIELD( "%d", frame_num, 7);		/* 7 == #bits from SPS log2_max_frame_num_minus4 + 4 */
@@ -2449,7 +2460,7 @@ OSErr Validate_NAL_Unit(  BitBuffer *inbb, UInt8 expect_type, UInt32 nal_length
 			// errprint("\tUnknown NAL Unit %d",nal_type);
 			break;
 	}
-	if (bb->bits_left != 0) errprint("Validate NAL Unit didn't use %ld bits\n", bb->bits_left);
+	if (bb->bits_left != 0) errprint("Validate NAL Unit didn't use %d bits\n", bb->bits_left);
 
 bail:
 	--vg.tabcnt; atomprint("</NALUnit>\n");
@@ -2497,6 +2508,18 @@ OSErr Validate_NAL_Unit_HEVC(  BitBuffer *inbb, UInt8 expect_type, UInt32 nal_le
 	int counter = 0;
 	atomprint("<NALUnit length=\"%d (0x%x)\"\n",nal_length,nal_length); vg.tabcnt++;
 	
+	// the length comes from the stream, so it need not fit in what is left of it
+	if (nal_length == 0) {
+		errprint("Validate_NAL_Unit_HEVC: NAL unit length is zero\n");
+		err = outOfDataErr;
+		goto bail;
+	}
+	if (nal_length > inbb->bits_left / 8) {
+		errprint("Validate_NAL_Unit_HEVC: NAL unit length %u is more than the %u bytes left\n", nal_length, inbb->bits_left / 8);
+		err = outOfDataErr;
+		goto bail;
+	}
+	
 	mybb = *inbb;
 	mybb.bits_left = nal_length * 8;
 	mybb.prevent_emulation = 1;
@@ -2515,7 +2538,7 @@ OSErr Validate_NAL_Unit_HEVC(  BitBuffer *inbb, UInt8 expect_type, UInt32 nal_le
 	} else {
 		VALIDATE_FIELD  ("%d", nal_unit_type, 6);
 	}
-	atomprint("comment%ld=\"%s\"\n",counter++,naltypes[nal_unit_type]);
+	atomprint("comment%d=\"%s\"\n",counter++,naltypes[nal_unit_type]);
 	
         VALIDATE_FIELD  ("%d", nuh_layer_id, 6);
         VALIDATE_FIELD  ("%d", nuh_temporal_id_plus1, 3);
@@ -2584,12 +2607,12 @@ OSErr Validate_NAL_Unit_HEVC(  BitBuffer *inbb, UInt8 expect_type, UInt32 nal_le
                                     gen_profile_idc == 10 || gen_profile_compatibility_flag[10]){
                                         
                                     VALIDATE_FIELD  ("%d", general_max_14bit_constraint_flag, 1);
-                                    VALIDATE_FIELD  ("%d", general_reserved_zero_33bits, 33);
+                                    VALIDATE_FIELD  ("%llu", general_reserved_zero_33bits, 33);
                                 }else{
-                                    VALIDATE_FIELD  ("%d", general_reserved_zero_34bits, 34);
+                                    VALIDATE_FIELD  ("%llu", general_reserved_zero_34bits, 34);
                                 }
                             }else{
-                                VALIDATE_FIELD  ("%d", general_reserved_zero_43bits, 43);
+                                VALIDATE_FIELD  ("%llu", general_reserved_zero_43bits, 43);
                             }
                             
                             if((gen_profile_idc >= 1 && gen_profile_idc <=5)|| gen_profile_idc ==9 ||
@@ -2689,7 +2712,7 @@ OSErr Validate_NAL_Unit_HEVC(  BitBuffer *inbb, UInt8 expect_type, UInt32 nal_le
                                 VALIDATE_UEV( "%d", conf_win_bottom_offset);
                             }
                             
-                            VALIDATE_UEV( "%lu", bit_depth_luma_minus8);
+                            VALIDATE_UEV( "%u", bit_depth_luma_minus8);
                             VALIDATE_UEV( "%d", bit_depth_chroma_minus8);
                             VALIDATE_UEV( "%d", log2_max_pic_order_cnt_lsb_minus4);
                             VALIDATE_FIELD  ("%d", sps_sub_layer_ordering_info_present_flag, 1);
@@ -2847,8 +2870,8 @@ OSErr Validate_NAL_Unit_HEVC(  BitBuffer *inbb, UInt8 expect_type, UInt32 nal_le
                                 }
                                 VALIDATE_FIELD  ("%d", vui_timing_info_present_flag, 1);
                                 if(vui_timing_info_present_flag){
-                                    VALIDATE_FIELD  ("%lu", vui_num_units_in_tick, 32);
-                                    VALIDATE_FIELD  ("%ld", vui_time_scale, 32);
+                                    VALIDATE_FIELD  ("%u", vui_num_units_in_tick, 32);
+                                    VALIDATE_FIELD  ("%d", vui_time_scale, 32);
                                     if(vg.dvb || vg.hbbtv){
                                         float framerate = ((float)vui_time_scale)/((float)(vui_num_units_in_tick));
                                         if(vg.framerate != framerate){
@@ -3210,7 +3233,7 @@ OSErr Validate_NAL_Unit_HEVC(  BitBuffer *inbb, UInt8 expect_type, UInt32 nal_le
 			// errprint("\tUnknown NAL Unit %d",nal_type);
 			break;
 	}
-	if (bb->bits_left != 0) errprint("Validate HEVC NAL Unit didn't use %ld bits\n", bb->bits_left);
+	if (bb->bits_left != 0) errprint("Validate HEVC NAL Unit didn't use %d bits\n", bb->bits_left);
 
 bail:
 	//--vg.tabcnt; atomprint("</NALUnit>\n");
@@ -3285,7 +3308,7 @@ OSErr Validate_DecSpecific_Descriptor( BitBuffer *inbb, UInt8 ObjectType, UInt8
 
 	BAILIFERR( GetDescriptorTagAndSize(bb, &tag, &size) );
 	atomprintnotab("\ttag=\"0x%2.2x\" size=\"%d\"\n", tag, size);
-	FieldMustBe( tag, Class_DecSpecificInfoTag, "Validate_DecSpecific_Descriptor: Tag != Class_DecSpecificInfoTag\n" );
+	FieldMustBe( tag, Class_DecSpecificInfoTag, "Validate_DecSpecific_Descriptor: Tag must be Class_DecSpecificInfoTag (0x%x) not 0x%x\n" );
 	
 	newbb = *inbb;
 	bb = &newbb;
@@ -3321,7 +3344,7 @@ OSErr Validate_DecSpecific_Descriptor( BitBuffer *inbb, UInt8 ObjectType, UInt8
 			break;
 	}
 	
-	if (bb->bits_left != 0) warnprint("Warning: Validate DecoderSpecificInfo didn't use %ld bits\n", bb->bits_left);
+	if (bb->bits_left != 0) warnprint("Warning: Validate DecoderSpecificInfo didn't use %d bits\n", bb->bits_left);
 
 	err = SkipBytes(inbb, size); if (err) goto bail;
 	
@@ -3697,11 +3720,13 @@ OSErr Validate_vide_sample_Bitstream( BitBuffer *bb, void *refcon )
 		
 	codec_specific = &((tir->validatedSampleDescriptionRefCons)[tir->currentSampleDescriptionIndex - 1]);
 	
+	// the sample description is stashed as it is in the file
 	sampleDescription = tir->sampleDescriptions[tir->currentSampleDescriptionIndex];
-	if (sampleDescription->head.sdType == 'avc1') {
+	if (EndianU32_BtoN(sampleDescription->head.sdType) == 'avc1') {
 	   while (bb->bits_left > 0) {
 			UInt32 nsize, size_field;
-			size_field = codec_specific[0];
+			// NAL unit length size from the avcC (Validate_AVCConfigRecord), 4 if it had none
+			size_field = codec_specific[0] ? codec_specific[0] : 4;
 			nsize = GetBits(bb, size_field * 8, &err); if (err) goto bail;	
 			Validate_NAL_Unit(bb,0,nsize);
 			err = SkipBytes(bb, nsize); if (err) goto bail;
@@ -3826,10 +3851,10 @@ OSErr CheckValuesInContext( UInt32 bufferSize, UInt32 maxBitrate, UInt32 avgBitr
     break;
 
   default:
-    sprintf(profString,"WARNING: unknown visual profile= %lu\n",p_vsc->profileLevelInd);
+    sprintf(profString,"WARNING: unknown visual profile= %u\n",p_vsc->profileLevelInd);
     if( p_vsc->profileLevelInd == 255 ){
       err = 1;
-      errprint("invalid visual profile= %lu\n",p_vsc->profileLevelInd);
+      errprint("invalid visual profile= %u\n",p_vsc->profileLevelInd);
     }
     else
       warnprint("%s",profString);
@@ -3839,11 +3864,11 @@ OSErr CheckValuesInContext( UInt32 bufferSize, UInt32 maxBitrate, UInt32 avgBitr
 
   if( maxBitrate > (UInt32)limitBitrate || bufferSize > (UInt32)limitBufferSize){
     err = 2;
-    errprint("CheckValuesInContext: video profile limitations exceeded .. profile is %s  max bitrate is= %lu (limit is %lu)  buffer size is= %lu (limit is %lu) \n",
+    errprint("CheckValuesInContext: video profile limitations exceeded .. profile is %s  max bitrate is= %u (limit is %u)  buffer size is= %u (limit is %u) \n",
              profString, maxBitrate, limitBitrate, bufferSize, limitBufferSize);
   }
   else{
-    warnprint("NOTE: using volHeight= %lu  volWidth= %lu  VideoProfileLevelID= %s -> the max. allowed average framerate is %.2f fps\n",
+    warnprint("NOTE: using volHeight= %u  volWidth= %u  VideoProfileLevelID= %s -> the max. allowed average framerate is %.2f fps\n",
               p_vsc->volHeight, p_vsc->volWidth, profString, fps_max );
   }
 
@@ -3884,7 +3909,7 @@ OSErr Validate_HEVCConfigRecord( BitBuffer *bb, void *refcon )
         }
         
         hevcHeader.constraint_indicator_flags      = GetBits(bb, 48, &err); if (err) goto bail;
-        atomprint("constraint_indicator_flags=\"%d\"\n",hevcHeader.constraint_indicator_flags);
+        atomprint("constraint_indicator_flags=\"%lld\"\n",hevcHeader.constraint_indicator_flags);
         
        
             
@@ -299,6 +299,9 @@ UInt32 strip_trailing_zero_bits(BitBuffer *bb, OSErr *errout)
 	UInt8* byte_ptr;
 	UInt32 trailing = 0, bits;
 	
+	// nothing past the current byte, and the bits of that byte may all be wanted
+	if (bb->bits_left <= (UInt32)bb->curbits) goto bail;
+	
 	bits = bb->bits_left;
 	byte_ptr = bb->cptr;
 	
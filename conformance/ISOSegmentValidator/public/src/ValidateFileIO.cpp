@@ -20,23 +20,86 @@ limitations under the License.
 
 #include "ValidateMP4.h"
 
+#if !defined(_MSC_VER)
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+#endif
+
+// -offsetinfo: the input is a partial file with byte ranges removed, and offsetEntries lists
+//   them (sorted, in the offsets of the complete file). loadOffsetInfo fills in removedBefore and
+//   physicalOffset, so that both directions of the translation are a binary search over the
+//   entries; reads are mostly sequential, so we first try the entry we found last time.
+
+// first entry whose range does not start before offset64 (numOffsetEntries if there is none)
+static unsigned int FindLogicalOffsetEntry(UInt64 offset64)
+{
+	OffsetInfo *entries = vg.offsetEntries;
+	unsigned int n = vg.numOffsetEntries;
+	unsigned int index, lo, hi;
+
+	// the entry we found last time, or the next one
+	for (index = vg.lastLogicalOffsetEntry; (index <= n) && (index <= vg.lastLogicalOffsetEntry + 1); index++) {
+		if (((index == 0) || (entries[index - 1].offset < offset64)) && ((index == n) || (offset64 <= entries[index].offset)))
+			return vg.lastLogicalOffsetEntry = index;
+	}
+
+	lo = 0; hi = n;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (entries[mid].offset < offset64)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return vg.lastLogicalOffsetEntry = lo;
+}
+
+// first entry whose range would start after offset64 in the partial file (numOffsetEntries if there is none)
+static unsigned int FindPhysicalOffsetEntry(UInt64 offset64)
+{
+	OffsetInfo *entries = vg.offsetEntries;
+	unsigned int n = vg.numOffsetEntries;
+	unsigned int index, lo, hi;
+
+	// the entry we found last time, or the next one
+	for (index = vg.lastPhysicalOffsetEntry; (index <= n) && (index <= vg.lastPhysicalOffsetEntry + 1); index++) {
+		if (((index == 0) || (entries[index - 1].physicalOffset <= offset64)) && ((index == n) || (offset64 < entries[index].physicalOffset)))
+			return vg.lastPhysicalOffsetEntry = index;
+	}
+
+	lo = 0; hi = n;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (entries[mid].physicalOffset <= offset64)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return vg.lastPhysicalOffsetEntry = lo;
+}
+
 UInt64 getAdjustedFileOffset(UInt64 offset64)
 {
 	UInt64 adjustedOffset = offset64;
 
 	if (vg.numOffsetEntries > 0)
 	{
-		unsigned int index = 0;
-		for (index = 0; offset64 > vg.offsetEntries[index].offset; index++)
-		{
-			adjustedOffset -= vg.offsetEntries[index].sizeRemoved;
-		}
+		unsigned int index = FindLogicalOffsetEntry(offset64);
+
 		if (index > 0)
-			if (offset64 <= (vg.offsetEntries[index - 1].offset + vg.offsetEntries[index - 1].sizeRemoved-1))
+		{
+			OffsetInfo *entry = &vg.offsetEntries[index - 1];
+
+			adjustedOffset -= entry->removedBefore + entry->sizeRemoved;
+			if (offset64 <= (entry->offset + entry->sizeRemoved-1))
 			{
-			fprintf(stderr, "Program error! Requested infomration is at offset %llu, which is in a removed region at index %d (offset: %llu, removed size: %llu), exiting!", offset64, index, vg.offsetEntries[index - 1].offset, vg.offsetEntries[index - 1].sizeRemoved);
-			exit(-1);
+			messageprint("Program error! Requested infomration is at offset %llu, which is in a removed region at index %d (offset: %llu, removed size: %llu), not reading it\n", offset64, index, entry->offset, entry->sizeRemoved);
+			return kRemovedFileOffset;
 			}
+		}
 	}
 
 	return adjustedOffset;
@@ -48,37 +111,1034 @@ UInt64 inflateOffset(UInt64 offset64)
 
 	if (vg.numOffsetEntries > 0)
 	{
-		unsigned int index = 0;
+		unsigned int index = FindPhysicalOffsetEntry(offset64);
 
-		for (index = 0; adjustedOffset >= vg.offsetEntries[index].offset; index++)
-		{
-                    if(index == vg.numOffsetEntries)
-                        break; 
-                    adjustedOffset += vg.offsetEntries[index].sizeRemoved;
-		}
+		if (index > 0)
+			adjustedOffset += vg.offsetEntries[index - 1].removedBefore + vg.offsetEntries[index - 1].sizeRemoved;
 	}
 
 	return adjustedOffset;
 }
 //==========================================================================================
 
+//==========================================================================================
+
+// -mmap: the input file is mapped once and the GetFileData family reads from the mapping
+//   instead of doing an fseek/fread per field. If the file cannot be mapped (not a regular file,
+//   or no mmap on this platform) we stay on stdio.
+int MapInputFile( FILE *inFile )
+{
+	int err = noErr;
+#if defined(_MSC_VER)
+#pragma unused(inFile)
+	err = noCanDoErr;
+#else
+	struct stat st;
+	void *mapP;
+	int fd = fileno(inFile);
+
+	// (a 32-bit build can't map a file bigger than its address space)
+	if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode) || (st.st_size <= 0) || ((UInt64)st.st_size > (size_t)-1)) {
+		err = noCanDoErr;
+		goto bail;
+	}
+
+	// private and writable, so a validator scribbling on a borrowed view only touches its own copy
+	mapP = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (mapP == MAP_FAILED) {
+		err = noCanDoErr;
+		goto bail;
+	}
+	madvise(mapP, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	vg.inMap = (UInt8 *)mapP;
+	vg.inMapSize = st.st_size;
+
+bail:
+#endif
+	return err;
+}
+
+void UnmapInputFile( void )
+{
+#if !defined(_MSC_VER)
+	if (vg.inMap)
+		munmap(vg.inMap, (size_t)vg.inMapSize);
+#endif
+	vg.inMap = nil;
+	vg.inMapSize = 0;
+}
+
+//==========================================================================================
+
+// Streamed input (stdin, pipes, FIFOs): we can only read forward, so we keep one contiguous
+//   window [base, head) of the input. head moves forward as data is asked for, base moves forward
+//   when the caller releases data it is done with (see ValidateStreamedFileAtoms). Reads ahead of
+//   what was asked for are bounded by kStreamReadAhead and by the limit, which the top-level walk
+//   sets to the end of the atom it is working on, so we never block on data nobody needs yet.
+
+#define kStreamReadAhead	(64*1024)
+#define kStreamMaxWindow	((UInt64)((size_t)-1 / 2))
+
+static int StreamFill( UInt64 upTo )
+{
+	int err = noErr;
+	StreamWindow *sw = &vg.stream;
+	UInt64 want, newCapacity;
+	UInt8 *newBuf;
+	size_t amtRead;
+	
+	if ((upTo <= sw->head) || sw->eof)
+		goto bail;
+	
+	want = upTo;
+	if (sw->limit > want)
+		want = (sw->limit - want > kStreamReadAhead) ? want + kStreamReadAhead : sw->limit;
+	
+	if (want - sw->base > sw->capacity) {
+		if (want - sw->base > kStreamMaxWindow) {
+			messageprint("stream input: cannot hold %llu bytes of input at once\n", want - sw->base);
+			err = allocFailedErr;
+			goto bail;
+		}
+		newCapacity = sw->capacity ? sw->capacity : kStreamReadAhead;
+		while (newCapacity < want - sw->base)
+			newCapacity = (newCapacity > kStreamMaxWindow / 2) ? kStreamMaxWindow : newCapacity * 2;
+		BAILIFNIL( newBuf = (UInt8 *)realloc(sw->buf, (size_t)newCapacity), allocFailedErr );
+		sw->buf = newBuf;
+		sw->capacity = newCapacity;
+	}
+	
+	amtRead = fread( sw->buf + (sw->head - sw->base), 1, (size_t)(want - sw->head), vg.inFile );
+	sw->head += amtRead;
+	if (sw->head < want)
+		sw->eof = true;
+	if (sw->head - sw->base > sw->peak)
+		sw->peak = sw->head - sw->base;
+
+bail:
+	return err;
+}
+
+// copy out [offset, offset+size); *amtReadOut is short if the input ends first
+int StreamGetData( void *dataP, UInt64 offset, UInt64 size, UInt64 *amtReadOut )
+{
+	int err = noErr;
+	StreamWindow *sw = &vg.stream;
+	UInt64 amtRead = 0;
+	
+	if (offset < sw->base) {
+		messageprint("stream input: data at offset %llu was already released (window starts at %llu)\n", offset, sw->base);
+		err = noCanDoErr;
+		goto bail;
+	}
+	// the size of streamed input is not known up front (kStreamUnknownFileSize), so nothing
+	//   should ask for data out there; a request that reaches it is an offset computed from it
+	if ((offset >= kStreamUnknownFileSize) || (size > kStreamUnknownFileSize - offset)) {
+		messageprint("stream input: data at offset %llu is beyond any input that can be read\n", offset);
+		err = noCanDoErr;
+		goto bail;
+	}
+	
+	BAILIFERR( StreamFill( offset + size ) );
+	
+	if (offset < sw->head)
+		amtRead = (offset + size <= sw->head) ? size : sw->head - offset;
+	if (amtRead > 0)
+		memcpy( dataP, sw->buf + (offset - sw->base), amtRead );
+
+bail:
+	*amtReadOut = amtRead;
+	return err;
+}
+
+// true if there is at least one more byte of input at offset
+Boolean StreamHasData( UInt64 offset )
+{
+	if (offset < vg.stream.head)
+		return true;
+	if (offset >= kStreamUnknownFileSize)
+		return false;
+	StreamFill( offset + 1 );
+	return (offset < vg.stream.head);
+}
+
+void StreamSetLimit( UInt64 limit )
+{
+	vg.stream.limit = limit;
+}
+
+// we will not ask for anything before offset again; if that is beyond what we have read,
+//   the bytes in between are read and thrown away without being kept
+void StreamRelease( UInt64 offset )
+{
+	StreamWindow *sw = &vg.stream;
+	UInt8 scratch[4096];
+	
+	if (offset <= sw->base)
+		return;
+	
+	if (offset < sw->head) {
+		memmove( sw->buf, sw->buf + (offset - sw->base), sw->head - offset );
+	} else {
+		while ((sw->head < offset) && !sw->eof) {
+			UInt64 amt = offset - sw->head;
+			size_t amtRead;
+			
+			if (amt > sizeof(scratch))
+				amt = sizeof(scratch);
+			amtRead = fread( scratch, 1, (size_t)amt, vg.inFile );
+			sw->head += amtRead;
+			if (amtRead < amt)
+				sw->eof = true;
+		}
+		if (sw->head < offset)
+			offset = sw->head;
+	}
+	sw->base = offset;
+}
+
+// consume the rest of the input; returns its total size
+UInt64 StreamDrain( void )
+{
+	StreamRelease( (UInt64)-1 );
+	return vg.stream.head;
+}
+
+void StreamClose( void )
+{
+	if (vg.stream.buf)
+		free(vg.stream.buf);
+	memset(&vg.stream, 0, sizeof(vg.stream));
+}
+
+//==========================================================================================
+
+// The files we write besides the report go into vg.outputDir when there is one, so that
+//   validations running side by side don't write over each other's. The path is malloc'd.
+char *OutputFilePath( const char *name )
+{
+	char *path;
+	
+	if ((vg.outputDir == nil) || (vg.outputDir[0] == 0))
+		return strdup(name);
+	
+	path = (char *)malloc(strlen(vg.outputDir) + strlen(name) + 2);
+	if (path)
+		sprintf(path, "%s/%s", vg.outputDir, name);
+	return path;
+}
+
+FILE *OpenOutputFile( const char *name, const char *mode )
+{
+	char *path = OutputFilePath(name);
+	FILE *fp;
+	
+	if (path == nil)
+		return nil;
+	fp = fopen(path, mode);
+	free(path);
+	return fp;
+}
+
+//==========================================================================================
+
+// Segmented input: a representation given as its init segment and media segments in separate
+//   files is read as if they had been concatenated (which is what Assemble used to do on disk).
+//   Offsets everywhere else are offsets into that virtual file; here we find the segment file that
+//   holds them. Only a handful of the segment files are kept open at a time, as a long
+//   representation can have many more segments than we have file handles. Buffers handed to
+//   ValidateMP4Buffers are read the same way, with a memcpy in place of the fread; we never hand
+//   out views into them, as a validator may scribble on its view (see MapInputFile).
+
+int OpenInputSegments( char **paths, long count )
+{
+	int err = noErr;
+	long i;
+	UInt64 offset = 0;
+	
+	BAILIFNIL( vg.inSegments = (InputSegment *)calloc(count, sizeof(InputSegment)), allocFailedErr );
+	vg.numInSegments = count;
+	vg.curInSegment = 0;
+	
+	for (i = 0; i < count; i++) {
+		FILE *fp = fopen(paths[i], "rb");
+		SInt64 size;
+		
+		if (!fp) {
+			messageprint( "Could not open segment file \"%s\"\n", paths[i] );
+			err = noCanDoErr;
+			goto bail;
+		}
+		err = fseek64(fp, 0, SEEK_END);
+		size = ftell64(fp);
+		fclose(fp);
+		if (err || (size < 0)) {
+			messageprint( "Could not get the size of segment file \"%s\"\n", paths[i] );
+			err = noCanDoErr;
+			goto bail;
+		}
+		
+		BAILIFNIL( vg.inSegments[i].path = strdup(paths[i]), allocFailedErr );
+		vg.inSegments[i].fileOffset = 0;
+		vg.inSegments[i].offset = offset;
+		vg.inSegments[i].size = size;
+		offset += size;
+	}
+
+bail:
+	return err;
+}
+
+int OpenInputBuffers( const ValidateMP4Buffer *buffers, long count )
+{
+	int err = noErr;
+	long i;
+	UInt64 offset = 0;
+	
+	BAILIFNIL( vg.inSegments = (InputSegment *)calloc(count, sizeof(InputSegment)), allocFailedErr );
+	vg.numInSegments = count;
+	vg.curInSegment = 0;
+	
+	for (i = 0; i < count; i++) {
+		BAILIF( (buffers[i].data == nil) && (buffers[i].size > 0), paramErr );
+		vg.inSegments[i].data = (const UInt8 *)buffers[i].data;
+		vg.inSegments[i].fileOffset = 0;
+		vg.inSegments[i].offset = offset;
+		vg.inSegments[i].size = buffers[i].size;
+		offset += buffers[i].size;
+	}
+
+bail:
+	return err;
+}
+
+// index of the segment holding offset (the last one if offset is past the end)
+static long FindInputSegment( UInt64 offset )
+{
+	InputSegment *cur = &vg.inSegments[vg.curInSegment];
+	long lo = 0, hi = vg.numInSegments - 1;
+	
+	// nearly all reads are in the same segment as the last one
+	if ((offset >= cur->offset) && (offset - cur->offset < cur->size))
+		return vg.curInSegment;
+	
+	while (lo < hi) {
+		long mid = (lo + hi + 1) / 2;
+		
+		if (vg.inSegments[mid].offset <= offset)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+static FILE *GetInputSegmentFile( long index )
+{
+	InputSegment *seg = &vg.inSegments[index];
+	
+	if (seg->fp == nil) {
+		if (vg.numOpenInputSegments == kMaxOpenInputSegments) {
+			InputSegment *victim = &vg.inSegments[vg.openInputSegments[vg.nextOpenInputSegmentSlot]];
+			
+			fclose(victim->fp);
+			victim->fp = nil;
+		} else
+			vg.numOpenInputSegments++;
+		
+		seg->fp = fopen(seg->path, "rb");
+		if (seg->fp == nil) {
+			messageprint( "Could not reopen segment file \"%s\"\n", seg->path );
+			vg.numOpenInputSegments--;
+			return nil;
+		}
+		vg.openInputSegments[vg.nextOpenInputSegmentSlot] = index;
+		vg.nextOpenInputSegmentSlot = (vg.nextOpenInputSegmentSlot + 1) % kMaxOpenInputSegments;
+	}
+	return seg->fp;
+}
+
+// copy out [offset, offset+size), crossing from one segment file into the next as needed;
+//   *amtReadOut is short if the input ends first
+int SegmentsGetData( void *dataP, UInt64 offset, UInt64 size, UInt64 *amtReadOut )
+{
+	int err = noErr;
+	UInt64 amtRead = 0;
+	long index = FindInputSegment( offset );
+	
+	while (amtRead < size) {
+		InputSegment *seg;
+		UInt64 amt;
+		FILE *fp;
+		
+		while ((index < vg.numInSegments) && (offset >= vg.inSegments[index].offset + vg.inSegments[index].size))
+			index++;
+		if (index >= vg.numInSegments)
+			break;
+		
+		seg = &vg.inSegments[index];
+		vg.curInSegment = index;
+		amt = seg->offset + seg->size - offset;
+		if (amt > size - amtRead)
+			amt = size - amtRead;
+		
+		if (seg->data)
+			memcpy( (char *)dataP + amtRead, seg->data + seg->fileOffset + (offset - seg->offset), (size_t)amt );
+		else {
+			BAILIFNIL( fp = GetInputSegmentFile( index ), noCanDoErr );
+			BAILIFERR( fseek64(fp, seg->fileOffset + (offset - seg->offset), SEEK_SET) );
+			amt = fread( (char *)dataP + amtRead, 1, (size_t)amt, fp );
+			if (amt == 0)
+				break;		// the file shrank under us
+		}
+		amtRead += amt;
+		offset += amt;
+	}
+
+bail:
+	*amtReadOut = amtRead;
+	return err;
+}
+
+// whether segment index has a top-level atom of atomType (we only walk the atom headers)
+Boolean InputSegmentHasAtom( long index, OSType atomType )
+{
+	InputSegment *seg = &vg.inSegments[index];
+	UInt64 offset = seg->offset;
+	UInt64 amtRead;
+	
+	while (offset + 8 <= seg->offset + seg->size) {
+		UInt32 header[4];
+		UInt64 atomSize;
+		
+		if (SegmentsGetData( header, offset, 8, &amtRead ) || (amtRead != 8))
+			break;
+		if (EndianU32_BtoN(header[1]) == atomType)
+			return true;
+		
+		atomSize = EndianU32_BtoN(header[0]);
+		if (atomSize == 1) {
+			UInt64 largeSize;
+			
+			if (SegmentsGetData( &largeSize, offset + 8, 8, &amtRead ) || (amtRead != 8))
+				break;
+			atomSize = EndianU64_BtoN(largeSize);
+		}
+		if ((atomSize < 8) || (atomSize > seg->offset + seg->size - offset))
+			break;		// size 0 (to the end) or garbage; either way we have seen all the headers we can
+		offset += atomSize;
+	}
+	return false;
+}
+
+void CloseInputSegments( void )
+{
+	long i;
+	
+	for (i = 0; i < vg.numInSegments; i++) {
+		if (vg.inSegments[i].fp)
+			fclose(vg.inSegments[i].fp);
+		free(vg.inSegments[i].path);
+	}
+	free(vg.inSegments);
+	vg.inSegments = nil;
+	vg.numInSegments = 0;
+	vg.curInSegment = 0;
+	vg.numOpenInputSegments = 0;
+	vg.nextOpenInputSegmentSlot = 0;
+}
+
+//==========================================================================================
+
+// -range: validate only the part of the input that covers a window of media time (or a run of
+//   media segments), plus the initialization segment. The input is first opened as a segmented
+//   input; we split it into units (its segments if we know them, else the subsegments of a
+//   top-level 'sidx', else its movie fragments), pick the units that overlap the window and
+//   replace the input with just those, laid end to end. Media times come from the 'sidx'
+//   references or from the first 'tfdt' in each unit, which we only read for the units the
+//   bisection visits. A unit ends where the next one starts; the last one ends after the
+//   sample durations of its track fragments (or its sidx subsegment_duration).
+
+typedef struct {
+	UInt64 start;			// offsets in the input as it was before the range was applied
+	UInt64 end;
+	double time;			// media time in seconds of the unit's start, once timeKnown
+	double endTime;			// and of its end, once endTimeKnown
+	Boolean timeKnown;
+	Boolean endTimeKnown;
+} RangeUnit;
+
+// the header of the box at offset; size 0 (runs to end) is resolved against end
+static Boolean RangeReadBoxHeader( UInt64 offset, UInt64 end, OSType *typeOut, UInt64 *sizeOut, UInt32 *headerSizeOut )
+{
+	UInt32 header[2];
+	UInt64 size;
+	UInt32 headerSize = 8;
+	UInt64 amtRead;
+	
+	if ((offset + 8 > end) || SegmentsGetData( header, offset, 8, &amtRead ) || (amtRead != 8))
+		return false;
+	size = EndianU32_BtoN(header[0]);
+	if (size == 1) {
+		UInt64 largeSize;
+		
+		if (SegmentsGetData( &largeSize, offset + 8, 8, &amtRead ) || (amtRead != 8))
+			return false;
+		size = EndianU64_BtoN(largeSize);
+		headerSize = 16;
+	} else if (size == 0)
+		size = end - offset;
+	if ((size < headerSize) || (size > end - offset))
+		return false;
+	
+	*typeOut = EndianU32_BtoN(header[1]);
+	*sizeOut = size;
+	*headerSizeOut = headerSize;
+	return true;
+}
+
+// the payload of the first child box of type in [start, end)
+static Boolean RangeFindBox( UInt64 start, UInt64 end, OSType type, UInt64 *payloadOut, UInt64 *payloadEndOut )
+{
+	OSType boxType;
+	UInt64 size;
+	UInt32 headerSize;
+	
+	while (RangeReadBoxHeader( start, end, &boxType, &size, &headerSize )) {
+		if (boxType == type) {
+			*payloadOut = start + headerSize;
+			*payloadEndOut = start + size;
+			return true;
+		}
+		start += size;
+	}
+	return false;
+}
+
+static Boolean RangeGetN32( UInt64 offset, UInt32 *valueOut )
+{
+	UInt64 amtRead;
+	
+	if (SegmentsGetData( valueOut, offset, 4, &amtRead ) || (amtRead != 4))
+		return false;
+	*valueOut = EndianU32_BtoN(*valueOut);
+	return true;
+}
+
+static Boolean RangeGetN64( UInt64 offset, UInt64 *valueOut )
+{
+	UInt64 amtRead;
+	
+	if (SegmentsGetData( valueOut, offset, 8, &amtRead ) || (amtRead != 8))
+		return false;
+	*valueOut = EndianU64_BtoN(*valueOut);
+	return true;
+}
+
+// the mdhd timescale of trackID, from the moov payload [moov, moovEnd)
+static UInt32 RangeTrackTimescale( UInt64 moov, UInt64 moovEnd, UInt32 trackID )
+{
+	OSType boxType;
+	UInt64 size;
+	UInt32 headerSize;
+	
+	while (RangeReadBoxHeader( moov, moovEnd, &boxType, &size, &headerSize )) {
+		UInt64 trak = moov + headerSize, trakEnd = moov + size;
+		UInt64 box, boxEnd, mdia, mdiaEnd;
+		UInt32 versionFlags, id, timescale;
+		
+		moov += size;
+		if (boxType != 'trak')
+			continue;
+		if (!RangeFindBox( trak, trakEnd, 'tkhd', &box, &boxEnd ) || !RangeGetN32( box, &versionFlags )
+				|| !RangeGetN32( box + ((versionFlags >> 24) == 1 ? 20 : 12), &id ) || (id != trackID))
+			continue;
+		if (RangeFindBox( trak, trakEnd, 'mdia', &mdia, &mdiaEnd ) && RangeFindBox( mdia, mdiaEnd, 'mdhd', &box, &boxEnd )
+				&& RangeGetN32( box, &versionFlags ) && RangeGetN32( box + ((versionFlags >> 24) == 1 ? 20 : 12), &timescale ))
+			return timescale;
+	}
+	return 0;
+}
+
+// media time of a unit: the tfdt of the first traf of its first moof
+static Boolean RangeUnitTime( RangeUnit *unit, UInt64 moov, UInt64 moovEnd )
+{
+	UInt64 moof, moofEnd, traf, trafEnd, box, boxEnd;
+	UInt32 versionFlags, trackID, timescale;
+	UInt64 decodeTime;
+	
+	if (unit->timeKnown)
+		return true;
+	if (!RangeFindBox( unit->start, unit->end, 'moof', &moof, &moofEnd ) || !RangeFindBox( moof, moofEnd, 'traf', &traf, &trafEnd )
+			|| !RangeFindBox( traf, trafEnd, 'tfhd', &box, &boxEnd ) || !RangeGetN32( box + 4, &trackID )
+			|| !RangeFindBox( traf, trafEnd, 'tfdt', &box, &boxEnd ) || !RangeGetN32( box, &versionFlags ))
+		return false;
+	if ((versionFlags >> 24) == 1) {
+		if (!RangeGetN64( box + 4, &decodeTime ))
+			return false;
+	} else {
+		UInt32 decodeTime32;
+		
+		if (!RangeGetN32( box + 4, &decodeTime32 ))
+			return false;
+		decodeTime = decodeTime32;
+	}
+	timescale = RangeTrackTimescale( moov, moovEnd, trackID );
+	if (timescale == 0)
+		return false;
+	
+	unit->time = (double)decodeTime / timescale;
+	unit->timeKnown = true;
+	return true;
+}
+
+// the trex default_sample_duration of trackID, from the moov payload [moov, moovEnd)
+static UInt32 RangeTrackDefaultDuration( UInt64 moov, UInt64 moovEnd, UInt32 trackID )
+{
+	UInt64 mvex, mvexEnd;
+	OSType boxType;
+	UInt64 size;
+	UInt32 headerSize, id, duration;
+	
+	if (!RangeFindBox( moov, moovEnd, 'mvex', &mvex, &mvexEnd ))
+		return 0;
+	while (RangeReadBoxHeader( mvex, mvexEnd, &boxType, &size, &headerSize )) {
+		if ((boxType == 'trex') && RangeGetN32( mvex + headerSize + 4, &id ) && (id == trackID)
+				&& RangeGetN32( mvex + headerSize + 12, &duration ))
+			return duration;
+		mvex += size;
+	}
+	return 0;
+}
+
+// media time of the end of the last unit: its start plus the durations of the samples in
+//   the track fragments of the track its time comes from
+static Boolean RangeLastUnitEnd( RangeUnit *unit, UInt64 moov, UInt64 moovEnd )
+{
+	UInt64 offset = unit->start, moof, moofEnd, traf, trafEnd, box, boxEnd;
+	OSType boxType;
+	UInt64 size, ticks = 0;
+	UInt32 headerSize, versionFlags, trackID = 0, firstTrackID = 0, timescale, defaultDuration;
+	
+	if (!RangeUnitTime( unit, moov, moovEnd ))
+		return false;
+	while (RangeReadBoxHeader( offset, unit->end, &boxType, &size, &headerSize )) {
+		moof = offset + headerSize;
+		moofEnd = offset + size;
+		offset += size;
+		if (boxType != 'moof')
+			continue;
+		while (RangeReadBoxHeader( moof, moofEnd, &boxType, &size, &headerSize )) {
+			traf = moof + headerSize;
+			trafEnd = moof + size;
+			moof += size;
+			if ((boxType != 'traf') || !RangeFindBox( traf, trafEnd, 'tfhd', &box, &boxEnd )
+					|| !RangeGetN32( box, &versionFlags ) || !RangeGetN32( box + 4, &trackID ))
+				continue;
+			if (firstTrackID == 0)
+				firstTrackID = trackID;
+			if (trackID != firstTrackID)
+				continue;
+			
+			// tfhd: base_data_offset, sample_description_index, then default_sample_duration
+			if (!(versionFlags & 0x08) || !RangeGetN32( box + 8 + ((versionFlags & 0x01) ? 8 : 0) + ((versionFlags & 0x02) ? 4 : 0), &defaultDuration ))
+				defaultDuration = RangeTrackDefaultDuration( moov, moovEnd, trackID );
+			
+			while (RangeReadBoxHeader( traf, trafEnd, &boxType, &size, &headerSize )) {
+				UInt64 trun = traf + headerSize;
+				UInt32 sampleCount, fieldsPerSample, i;
+				
+				traf += size;
+				if ((boxType != 'trun') || !RangeGetN32( trun, &versionFlags ) || !RangeGetN32( trun + 4, &sampleCount ))
+					continue;
+				if (!(versionFlags & 0x100)) {
+					ticks += (UInt64)sampleCount * defaultDuration;
+					continue;
+				}
+				fieldsPerSample = ((versionFlags & 0x100) ? 1 : 0) + ((versionFlags & 0x200) ? 1 : 0)
+									+ ((versionFlags & 0x400) ? 1 : 0) + ((versionFlags & 0x800) ? 1 : 0);
+				trun += 8 + ((versionFlags & 0x01) ? 4 : 0) + ((versionFlags & 0x04) ? 4 : 0);
+				for (i = 0; i < sampleCount; i++) {
+					UInt32 duration;
+					
+					if (!RangeGetN32( trun + (UInt64)i * fieldsPerSample * 4, &duration ))
+						return false;
+					ticks += duration;
+				}
+			}
+		}
+	}
+	timescale = firstTrackID ? RangeTrackTimescale( moov, moovEnd, firstTrackID ) : 0;
+	if (timescale == 0)
+		return false;
+	
+	unit->endTime = unit->time + (double)ticks / timescale;
+	unit->endTimeKnown = true;
+	return true;
+}
+
+// media time of the end of unit i
+static Boolean RangeUnitEndTime( RangeUnit *units, long i, long numUnits, UInt64 moov, UInt64 moovEnd )
+{
+	if (units[i].endTimeKnown)
+		return true;
+	if (i == numUnits - 1)
+		return RangeLastUnitEnd( &units[i], moov, moovEnd );
+	if (!RangeUnitTime( &units[i + 1], moov, moovEnd ))
+		return false;
+	units[i].endTime = units[i + 1].time;
+	units[i].endTimeKnown = true;
+	return true;
+}
+
+// the references of a top-level sidx (payload at sidx, box ends at sidxEnd) as units
+static int RangeUnitsFromSidx( UInt64 sidx, UInt64 sidxEnd, RangeUnit **unitsOut, long *countOut )
+{
+	int err = noErr;
+	UInt32 versionFlags, timescale, counts;
+	UInt64 earliestTime, firstOffset, offset;
+	RangeUnit *units = nil;
+	long i, count;
+	
+	BAILIF( !RangeGetN32( sidx, &versionFlags ) || !RangeGetN32( sidx + 8, &timescale ) || (timescale == 0), badAtomErr );
+	if ((versionFlags >> 24) == 0) {
+		UInt32 temp1, temp2;
+		
+		BAILIF( !RangeGetN32( sidx + 12, &temp1 ) || !RangeGetN32( sidx + 16, &temp2 ), badAtomErr );
+		earliestTime = temp1;
+		firstOffset = temp2;
+		offset = sidx + 20;
+	} else {
+		BAILIF( !RangeGetN64( sidx + 12, &earliestTime ) || !RangeGetN64( sidx + 20, &firstOffset ), badAtomErr );
+		offset = sidx + 28;
+	}
+	BAILIF( !RangeGetN32( offset, &counts ), badAtomErr );		// reserved, reference_count
+	count = counts & 0xFFFF;
+	offset += 4;
+	BAILIF( count == 0, badAtomErr );
+	
+	BAILIFNIL( units = (RangeUnit *)calloc(count, sizeof(RangeUnit)), allocFailedErr );
+	firstOffset += sidxEnd;
+	for (i = 0; i < count; i++) {
+		UInt32 typeSize, duration;
+		
+		BAILIF( !RangeGetN32( offset, &typeSize ) || !RangeGetN32( offset + 4, &duration ), badAtomErr );
+		units[i].start = firstOffset;
+		units[i].end = firstOffset += (typeSize & 0x7FFFFFFF);
+		units[i].time = (double)earliestTime / timescale;
+		units[i].timeKnown = true;
+		earliestTime += duration;
+		units[i].endTime = (double)earliestTime / timescale;
+		units[i].endTimeKnown = true;
+		offset += 12;
+	}
+	
+bail:
+	if (err) {
+		free(units);
+		units = nil;
+		count = 0;
+	}
+	*unitsOut = units;
+	*countOut = count;
+	return err;
+}
+
+int SelectInputRange( void )
+{
+	int err = noErr;
+	InputSegment *inSegments = nil;
+	RangeUnit *units = nil;
+	RangeUnit init = {0};
+	long numUnits = 0, maxUnits = 0;
+	long numSegments = 0;
+	long first, last, i;
+	UInt64 inputEnd, offset, moov = 0, moovEnd = 0;
+	OSType boxType;
+	UInt64 size;
+	UInt32 headerSize;
+	const char *unitName;
+	
+	inputEnd = vg.inSegments[vg.numInSegments - 1].offset + vg.inSegments[vg.numInSegments - 1].size;
+	
+	// the moov (for the track timescales) and where the initialization data ends
+	offset = 0;
+	while (RangeReadBoxHeader( offset, inputEnd, &boxType, &size, &headerSize )) {
+		if ((boxType == 'moof') || (boxType == 'styp') || (boxType == 'sidx') || (boxType == 'emsg') || (boxType == 'prft'))
+			break;
+		if (boxType == 'moov') {
+			moov = offset + headerSize;
+			moovEnd = offset + size;
+		}
+		offset += size;
+	}
+	
+	if (vg.dashSegment) {
+		// the segments we were given
+		unitName = "segments";
+		offset = 0;
+		for (i = 0; i < vg.segmentInfoSize; i++) {
+			if ((i > 0) || !vg.initializationSegment) {
+				if (numUnits == maxUnits) {
+					maxUnits = maxUnits ? 2*maxUnits : 64;
+					BAILIFNIL( units = (RangeUnit *)realloc(units, maxUnits*sizeof(RangeUnit)), allocFailedErr );
+				}
+				units[numUnits].start = offset;
+				units[numUnits].end = offset + vg.segmentSizes[i];
+				units[numUnits].timeKnown = false;
+				units[numUnits].endTimeKnown = false;
+				numUnits++;
+			} else
+				init.end = vg.segmentSizes[0];
+			offset += vg.segmentSizes[i];
+		}
+	} else {
+		init.end = offset;
+		if (RangeReadBoxHeader( offset, inputEnd, &boxType, &size, &headerSize ) && (boxType == 'sidx')) {
+			unitName = "subsegments";
+			err = RangeUnitsFromSidx( offset + headerSize, offset + size, &units, &numUnits );
+			if (err) {
+				messageprint( "-range: could not read the 'sidx' at offset %llu\n", offset );
+				goto bail;
+			}
+		} else {
+			// a unit per movie fragment, starting with any styp/sidx/emsg/prft boxes that lead into it
+			Boolean gotMoof = false;
+			
+			unitName = "fragments";
+			while (RangeReadBoxHeader( offset, inputEnd, &boxType, &size, &headerSize )) {
+				if ((numUnits == 0) || (gotMoof && ((boxType == 'moof') || (boxType == 'styp') || (boxType == 'sidx') || (boxType == 'emsg') || (boxType == 'prft')))) {
+					if (numUnits == maxUnits) {
+						maxUnits = maxUnits ? 2*maxUnits : 64;
+						BAILIFNIL( units = (RangeUnit *)realloc(units, maxUnits*sizeof(RangeUnit)), allocFailedErr );
+					}
+					units[numUnits].start = offset;
+					units[numUnits].timeKnown = false;
+					units[numUnits].endTimeKnown = false;
+					numUnits++;
+					gotMoof = false;
+				}
+				if (boxType == 'moof')
+					gotMoof = true;
+				offset += size;
+				units[numUnits - 1].end = offset;
+			}
+		}
+	}
+	if (numUnits == 0) {
+		messageprint( "-range: there are no media %s in the input to choose from\n", unitName );
+		err = noCanDoErr;
+		goto bail;
+	}
+	
+	if (vg.rangeBySegment) {
+		first = (long)vg.rangeStart - 1;
+		last = (long)vg.rangeEnd - 1;
+		if (last >= numUnits)
+			last = numUnits - 1;
+		if ((first < 0) || (first > last)) {
+			messageprint( "-range: there are only %ld media %s\n", numUnits, unitName );
+			err = noCanDoErr;
+			goto bail;
+		}
+	} else {
+		long lo, hi;
+		
+		// the units overlapping [rangeStart, rangeEnd), or holding rangeStart if the window is a
+		//   single time: bisect for the first that ends after the start, then for the first that
+		//   starts at or after the end
+		lo = 0; hi = numUnits;
+		while (lo < hi) {
+			long mid = (lo + hi) / 2;
+			
+			if (!RangeUnitEndTime( units, mid, numUnits, moov, moovEnd )) {
+				messageprint( "-range: could not find the media time of the end of media %s number %ld\n", unitName, mid + 1 );
+				err = noCanDoErr;
+				goto bail;
+			}
+			if (units[mid].endTime > vg.rangeStart)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		first = lo;
+		hi = numUnits;
+		while (lo < hi) {
+			long mid = (lo + hi) / 2;
+			
+			if (!RangeUnitTime( &units[mid], moov, moovEnd )) {
+				messageprint( "-range: could not find the media time of media %s number %ld\n", unitName, mid + 1 );
+				err = noCanDoErr;
+				goto bail;
+			}
+			if ((units[mid].time < vg.rangeEnd) || ((vg.rangeEnd == vg.rangeStart) && (units[mid].time <= vg.rangeStart)))
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		last = lo - 1;
+		
+		if (last < first) {
+			messageprint( "-range: no media in range %g-%g (none of the %ld media %s overlap it)\n", vg.rangeStart, vg.rangeEnd, numUnits, unitName );
+			err = noCanDoErr;
+			goto bail;
+		}
+	}
+	
+	// the new input: the initialization data and then the chosen units
+	BAILIFNIL( inSegments = (InputSegment *)calloc(last - first + 2, sizeof(InputSegment)), allocFailedErr );
+	offset = 0;
+	for (i = first - 1; i <= last; i++) {
+		RangeUnit *unit = (i < first) ? &init : &units[i];
+		long index = FindInputSegment( unit->start );
+		InputSegment *from = &vg.inSegments[index];
+		InputSegment *to = &inSegments[numSegments];
+		
+		if (unit->end == unit->start)
+			continue;
+		if (from->path)
+			BAILIFNIL( to->path = strdup(from->path), allocFailedErr );
+		to->data = from->data;
+		to->fileOffset = from->fileOffset + (unit->start - from->offset);
+		to->offset = offset;
+		to->size = unit->end - unit->start;
+		offset += to->size;
+		numSegments++;
+	}
+	vg.rangeCutsStart = (first > 0);
+	vg.rangeCutsEnd = (last < numUnits - 1);
+	
+	reportprint("<!-- Range: validating media %s %ld to %ld of %ld (%llu bytes from offset %llu)%s; offsets below are into just those bytes -->\n",
+		unitName, first + 1, last + 1, numUnits, units[last].end - units[first].start, units[first].start,
+		(init.end > init.start) ? " and the initialization data" : "");
+	
+	CloseInputSegments();
+	vg.inSegments = inSegments;
+	vg.numInSegments = numSegments;
+	inSegments = nil;
+
+bail:
+	if (inSegments) {
+		for (i = 0; i < numSegments; i++)
+			free(inSegments[i].path);
+		free(inSegments);
+		numSegments = 0;
+	}
+	free(units);
+	return err;
+}
+
+//==========================================================================================
+
+// -headeronly: the payload of every 'mdat' is off limits. GetAtomOffsetEntry registers them as it
+//   finds them, which is before anything could refer into them, and the reads below refuse to
+//   touch them; so a header-only run reads the box structure and nothing else.
+
+int AddPayloadRange( UInt64 start, UInt64 end )
+{
+	long i = vg.numPayloadRanges;
+	ByteRange *ranges;
+	
+	if ((i > 0) && (vg.payloadRanges[i - 1].start == start))
+		return noErr;		// seen it already
+	
+	ranges = (ByteRange *)realloc(vg.payloadRanges, (i + 1) * sizeof(ByteRange));
+	if (ranges == nil) {
+		messageprint("Could not allocate the header-only bookkeeping\n");
+		return allocFailedErr;
+	}
+	vg.payloadRanges = ranges;
+	
+	// they nearly always turn up in order
+	while ((i > 0) && (vg.payloadRanges[i - 1].start > start)) {
+		vg.payloadRanges[i] = vg.payloadRanges[i - 1];
+		i--;
+	}
+	vg.payloadRanges[i].start = start;
+	vg.payloadRanges[i].end = end;
+	vg.numPayloadRanges++;
+	return noErr;
+}
+
+static Boolean IsInPayload( UInt64 offset64, UInt64 size64 )
+{
+	long lo = 0, hi = vg.numPayloadRanges;
+	
+	// the last range starting before offset64 + size64 is the only one it can overlap
+	while (lo < hi) {
+		long mid = lo + (hi - lo) / 2;
+		
+		if (vg.payloadRanges[mid].start < offset64 + size64)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo > 0) && (offset64 < vg.payloadRanges[lo - 1].end);
+}
+
+static int CheckHeaderOnlyRead( UInt64 offset64, UInt64 size64 )
+{
+	if (vg.headerOnly && (size64 > 0) && IsInPayload( offset64, size64 )) {
+		messageprint("-headeronly: not reading %llu bytes of media data at offset %llu\n", size64, offset64);
+		return noCanDoErr;
+	}
+	vg.bytesRead += size64;
+	return noErr;
+}
+
 int GetFileData( atomOffsetEntry *aoe, void *dataP, UInt64 offset64, UInt64 size64, UInt64 *newoffset64 )
 {
 #pragma unused(aoe)
 	int err = 0;
-	long amtRead = 0;
-	long size = size64;
+	UInt64 amtRead = 0;
+	UInt64 size = size64;
 	
-	if (offset64 > 0x7FFFFFFFL) {
-		fprintf(stderr,"sorry - can't handle file offsets > 31-bits\n");
-		err = noCanDoErr;
+	BAILIFERR( CheckHeaderOnlyRead( offset64, size64 ) );
+	
+	if (vg.streamInput) {
+		BAILIFERR( StreamGetData( dataP, getAdjustedFileOffset(offset64), size64, &amtRead ) );
+		if (amtRead != size) {
+			err = outOfDataErr;
+			goto bail;
+		}
+		
+		if (newoffset64) *newoffset64 = offset64 + size;
+		goto bail;
+	}
+
+	if (vg.numInSegments) {
+		BAILIFERR( SegmentsGetData( dataP, getAdjustedFileOffset(offset64), size64, &amtRead ) );
+		if (amtRead != size) {
+			err = outOfDataErr;
+			goto bail;
+		}
+		
+		if (newoffset64) *newoffset64 = offset64 + size;
+		goto bail;
+	}
+
+	if (vg.inMap) {
+		// same semantics as the fread below: copy whatever is there, complain if it was short
+		UInt64 mapOffset = getAdjustedFileOffset(offset64);
+		
+		if (mapOffset < vg.inMapSize)
+			amtRead = (size64 < vg.inMapSize - mapOffset) ? size : vg.inMapSize - mapOffset;
+		if (amtRead > 0)
+			memcpy( dataP, vg.inMap + mapOffset, amtRead );
+		if (amtRead != size) {
+			err = outOfDataErr;
+			goto bail;
+		}
+		
+		if (newoffset64) *newoffset64 = offset64 + size;
 		goto bail;
 	}
     
-	err = fseek(vg.inFile, getAdjustedFileOffset(offset64), SEEK_SET);
+	err = fseek64(vg.inFile, getAdjustedFileOffset(offset64), SEEK_SET);
 	if (err) goto bail;
 	
-	amtRead = fread( dataP, 1, size, vg.inFile );
+	amtRead = fread( dataP, 1, (size_t)size, vg.inFile );
 	if (amtRead != size) {
 		err = outOfDataErr;
 		goto bail;
@@ -122,47 +1182,126 @@ int GetFileData( atomOffsetEntry *aoe, void *dataP, UInt64 offset64, UInt64 size
         first = 0;
     }*/
 
-bail:
-	return err;
+bail:
+	return err;
+}
+
+
+int GetFileDataN64( atomOffsetEntry *aoe, void *dataP, UInt64 offset64, UInt64 *newoffset64 )
+{
+	int err;
+	UInt64 temp;
+
+	err = GetFileData( aoe, &temp, offset64, sizeof(temp), newoffset64 );
+	if (!err) {
+		*(UInt64*)dataP = EndianU64_BtoN(temp);
+	}
+	
+	return err;
+}
+
+int GetFileDataN32( atomOffsetEntry *aoe, void *dataP, UInt64 offset64, UInt64 *newoffset64 )
+{
+	int err;
+	UInt32 temp;
+
+	err = GetFileData( aoe, &temp, offset64, sizeof(temp), newoffset64 );
+	if (!err) {
+		*(UInt32*)dataP = EndianU32_BtoN(temp);
+	}
+	
+	return err;
+}
+
+int GetFileDataN16( atomOffsetEntry *aoe, void *dataP, UInt64 offset64, UInt64 *newoffset64 )
+{
+	int err;
+	UInt16 temp;
+
+	err = GetFileData( aoe, &temp, offset64, sizeof(temp), newoffset64 );
+	if (!err) {
+		*(UInt16*)dataP = EndianU16_BtoN(temp);
+	}
+	
+	return err;
+}
+
+//==========================================================================================
+
+// Bulk big-endian decode for the sample tables (stts, ctts, stsc, stco, co64, stsz, stz2,
+//   stss, stsh). The kernels are plain loops over a byte swap that the compiler turns into
+//   vector shuffles (SSSE3/AVX2 on x86, NEON on ARM); on x86-64 with gcc we also let the
+//   loader pick the widest variant the CPU supports at run time (not under the thread
+//   sanitizer, whose instrumentation in the resolvers would run before it is set up).
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__) && !defined(__SANITIZE_THREAD__)
+	#define ENDIAN_ARRAY_KERNEL	__attribute__((target_clones("avx2","ssse3","default"), optimize("tree-vectorize")))
+#elif defined(__GNUC__) && !defined(__clang__)
+	#define ENDIAN_ARRAY_KERNEL	__attribute__((optimize("tree-vectorize")))
+#else
+	#define ENDIAN_ARRAY_KERNEL
+#endif
+
+ENDIAN_ARRAY_KERNEL
+void EndianU64Array_BtoN( UInt64 *values, UInt64 count )
+{
+	UInt64 i;
+
+	for (i = 0; i < count; i++)
+		values[i] = EndianU64_BtoN(values[i]);
+}
+
+ENDIAN_ARRAY_KERNEL
+void EndianU32Array_BtoN( UInt32 *values, UInt64 count )
+{
+	UInt64 i;
+
+	for (i = 0; i < count; i++)
+		values[i] = EndianU32_BtoN(values[i]);
 }
 
+ENDIAN_ARRAY_KERNEL
+void EndianU16Array_BtoN( UInt16 *values, UInt64 count )
+{
+	UInt64 i;
 
-int GetFileDataN64( atomOffsetEntry *aoe, void *dataP, UInt64 offset64, UInt64 *newoffset64 )
+	for (i = 0; i < count; i++)
+		values[i] = EndianU16_BtoN(values[i]);
+}
+
+// Read count big-endian values in one go and leave them in native order
+int GetFileDataN64Array( atomOffsetEntry *aoe, UInt64 *dataP, UInt64 count, UInt64 offset64, UInt64 *newoffset64 )
 {
 	int err;
-	UInt64 temp;
 
-	err = GetFileData( aoe, &temp, offset64, sizeof(temp), newoffset64 );
+	err = GetFileData( aoe, dataP, offset64, count * sizeof(UInt64), newoffset64 );
 	if (!err) {
-		*(UInt64*)dataP = EndianU64_BtoN(temp);
+		EndianU64Array_BtoN( dataP, count );
 	}
-	
+
 	return err;
 }
 
-int GetFileDataN32( atomOffsetEntry *aoe, void *dataP, UInt64 offset64, UInt64 *newoffset64 )
+int GetFileDataN32Array( atomOffsetEntry *aoe, UInt32 *dataP, UInt64 count, UInt64 offset64, UInt64 *newoffset64 )
 {
 	int err;
-	UInt32 temp;
 
-	err = GetFileData( aoe, &temp, offset64, sizeof(temp), newoffset64 );
+	err = GetFileData( aoe, dataP, offset64, count * sizeof(UInt32), newoffset64 );
 	if (!err) {
-		*(UInt32*)dataP = EndianU32_BtoN(temp);
+		EndianU32Array_BtoN( dataP, count );
 	}
-	
+
 	return err;
 }
 
-int GetFileDataN16( atomOffsetEntry *aoe, void *dataP, UInt64 offset64, UInt64 *newoffset64 )
+int GetFileDataN16Array( atomOffsetEntry *aoe, UInt16 *dataP, UInt64 count, UInt64 offset64, UInt64 *newoffset64 )
 {
 	int err;
-	UInt16 temp;
 
-	err = GetFileData( aoe, &temp, offset64, sizeof(temp), newoffset64 );
+	err = GetFileData( aoe, dataP, offset64, count * sizeof(UInt16), newoffset64 );
 	if (!err) {
-		*(UInt16*)dataP = EndianU16_BtoN(temp);
+		EndianU16Array_BtoN( dataP, count );
 	}
-	
+
 	return err;
 }
 
@@ -254,6 +1393,217 @@ bail:
 	return err;
 }
 
+// Hand out size64 bytes at offset64 for read-only parsing. With a mapped input this is a borrowed
+//   view straight into the mapping (as long as slop bytes past the end are mapped too, for the bit
+//   parsers); otherwise it is a calloc'd copy. Either way, give it back with ReleaseFileDataView.
+//   *dataPout is only nil if we could not allocate; a short read still returns the buffer.
+int GetFileDataView( atomOffsetEntry *aoe, Ptr *dataPout, UInt64 offset64, UInt64 size64, UInt32 slop, UInt64 *newoffset64 )
+{
+	int err = noErr;
+	Ptr dataP = nil;
+
+	if (vg.inMap) {
+		UInt64 mapOffset = getAdjustedFileOffset(offset64);
+		
+		if ((mapOffset <= vg.inMapSize) && (size64 + slop <= vg.inMapSize - mapOffset)) {
+			BAILIFERR( CheckHeaderOnlyRead( offset64, size64 ) );
+			dataP = (Ptr)(vg.inMap + mapOffset);
+			if (newoffset64) *newoffset64 = offset64 + size64;
+			goto bail;
+		}
+	}
+
+	BAILIFNIL( dataP = (Ptr)calloc(size64 + slop, 1), allocFailedErr );
+	err = GetFileData( aoe, dataP, offset64, size64, newoffset64 );
+
+bail:
+	*dataPout = dataP;
+	return err;
+}
+
+void ReleaseFileDataView( Ptr dataP )
+{
+	if (dataP == nil)
+		return;
+	if (vg.inMap && ((UInt8 *)dataP >= vg.inMap) && ((UInt8 *)dataP < vg.inMap + vg.inMapSize))
+		return;		// borrowed from the mapping
+	free(dataP);
+}
+
+//==========================================================================================
+
+// Take the body of a box (after the version/flags of a full box) as one view to decode from
+int OpenBoxBody( atomOffsetEntry *aoe, Boolean fullBox, BoxBody *body )
+{
+	int err = noErr;
+	UInt64 offset = aoe->offset + aoe->atomStartSize;
+	UInt64 size = (aoe->size > aoe->atomStartSize) ? aoe->size - aoe->atomStartSize : 0;
+
+	body->view = nil;
+	body->cur = body->end = nil;
+	body->version = body->flags = 0;
+	if (!vg.inMap && (size <= kBoxBodyLocalSize)) {
+		BAILIFERR( GetFileData( aoe, body->local, offset, size, nil ) );
+		body->cur = body->local;
+	} else {
+		BAILIFERR( GetFileDataView( aoe, &body->view, offset, size, 0, nil ) );
+		body->cur = (const UInt8 *)body->view;
+	}
+	body->end = body->cur + size;
+	body->offset = offset;
+
+	if (fullBox) {
+		UInt32 versFlags;
+
+		BAILIF( size < 4, outOfDataErr );
+		versFlags = ((UInt32)body->cur[0] << 24) | ((UInt32)body->cur[1] << 16) | ((UInt32)body->cur[2] << 8) | body->cur[3];
+		body->version = (versFlags >> 24) & 0xFF;
+		body->flags   =  versFlags & 0x00ffffff;
+		body->cur += 4;
+		body->offset += 4;
+	}
+
+bail:
+	return err;
+}
+
+void CloseBoxBody( BoxBody *body )
+{
+	ReleaseFileDataView( body->view );
+	body->view = nil;
+	body->cur = body->end = nil;
+}
+
+static void StoreBoxField( void *record, const BoxField *field, UInt64 value )
+{
+	char *dest = (char *)record + field->dest;
+
+	switch (field->destSize) {
+		case 1: *(UInt8 *)dest  = (UInt8)value;		break;
+		case 2: *(UInt16 *)dest = (UInt16)value;	break;
+		case 4: *(UInt32 *)dest = (UInt32)value;	break;
+		case 8: *(UInt64 *)dest = value;			break;
+	}
+}
+
+// Fields are decoded in order; one that does not fit in what is left of the body stops the
+//   decode with outOfDataErr, leaving the fields before it in the record (but an array that
+//   did not decode in full is nil, with a count of zero). A field the box does not have
+//   reads as zero (nil), whatever the record held before.
+int DecodeBoxFields( BoxBody *body, const BoxLayout *layout, void *record )
+{
+	int err = noErr;
+	UInt64 values[kBoxLayoutMaxFields];
+	UInt64 word = 0;
+	UInt32 i, j;
+
+	// up front, as the two versions of a field can share its member
+	for (i = 0; i < layout->numFields; i++) {
+		const BoxField *field = &layout->fields[i];
+
+		if (field->when == kBoxFieldAlways)
+			continue;
+		if ((field->kind == kBoxFieldCString) || (field->kind == kBoxFieldArray))
+			*(void **)((char *)record + field->dest) = nil;
+		else
+			StoreBoxField( record, field, 0 );
+	}
+
+	for (i = 0; i < layout->numFields; i++) {
+		const BoxField *field = &layout->fields[i];
+		UInt64 remaining = body->end - body->cur;
+		UInt64 value = 0;
+		Boolean present;
+
+		values[i] = 0;
+		switch (field->when) {
+			case kBoxFieldIfVersion:	present = (body->version == field->arg);	break;
+			case kBoxFieldIfNotVersion:	present = (body->version != field->arg);	break;
+			case kBoxFieldIfFlags:		present = ((body->flags & field->arg) != 0);	break;
+			case kBoxFieldIfZero:		present = (values[field->arg] == 0);		break;
+			default:					present = true;								break;
+		}
+		if (!present)
+			continue;
+
+		switch (field->kind) {
+			case kBoxFieldUInt:
+				BAILIF( remaining < field->width, outOfDataErr );
+				for (word = 0, j = 0; j < field->width; j++)
+					word = (word << 8) | body->cur[j];
+				body->cur += field->width;
+				body->offset += field->width;
+				// fall through
+			case kBoxFieldBits:
+				value = field->bits ? (word >> field->shift) & ((1ULL << field->bits) - 1) : word;
+				StoreBoxField( record, field, value );
+				break;
+
+			case kBoxFieldCString:
+			{
+				const UInt8 *nul = (const UInt8 *)memchr( body->cur, 0, remaining );
+				UInt64 length = nul ? (UInt64)(nul - body->cur) : remaining;
+				char *str;
+
+				if (nul == nil)
+					warnprint( "\nWARNING: C string not terminated\n" );
+				BAILIFNIL( str = (char *)ArenaAlloc( &vg.arena, length + 1 ), allocFailedErr );
+				memcpy( str, body->cur, length );
+				str[length] = '\0';
+				*(char **)((char *)record + field->dest) = str;
+
+				length += (nul != nil);
+				body->cur += length;
+				body->offset += length;
+				break;
+			}
+
+			case kBoxFieldArray:
+			{
+				const BoxLayout *element = field->element;
+				UInt64 count = values[field->count];
+				char *records = nil;
+
+				// the record says there are no elements until they have all decoded, so a caller that
+				//   carries on after an error does not read a half-filled array
+				*(char **)((char *)record + field->dest) = nil;
+				StoreBoxField( record, &layout->fields[field->count], 0 );
+
+				// every element takes at least a byte, so a count past the end of the body is bad data
+				BAILIF( count > remaining, outOfDataErr );
+				if (count > 0)
+					BAILIFNIL( records = (char *)ArenaCalloc( &vg.arena, count, element->recordSize ), allocFailedErr );
+				for (j = 0; j < count; j++)
+					BAILIFERR( DecodeBoxFields( body, element, records + (UInt64)j * element->recordSize ) );
+				*(char **)((char *)record + field->dest) = records;
+				StoreBoxField( record, &layout->fields[field->count], count );
+				value = count;
+				break;
+			}
+		}
+		values[i] = value;
+	}
+
+bail:
+	return err;
+}
+
+// Decode a whole full box in one go, for layouts that describe all of it
+int DecodeFullBox( atomOffsetEntry *aoe, const BoxLayout *layout, void *record, UInt32 *version, UInt32 *flags )
+{
+	int err;
+	BoxBody body;
+
+	err = OpenBoxBody( aoe, true, &body );
+	if (!err)
+		err = DecodeBoxFields( &body, layout, record );
+	if (version) *version = body.version;
+	if (flags) *flags = body.flags;
+	CloseBoxBody( &body );
+
+	return err;
+}
+
 int GetFileBitStreamDataToEndOfAtom( atomOffsetEntry *aoe, Ptr *bsDataPout, UInt32 *bsSizeout, UInt64 offset64, UInt64 *newoffset64 )
 {
 	int err = noErr;
@@ -261,8 +1611,7 @@ int GetFileBitStreamDataToEndOfAtom( atomOffsetEntry *aoe, Ptr *bsDataPout, UInt
 	Ptr bsDataP = nil;
 
 	bsSize = aoe->size - (offset64 - aoe->offset);
-	BAILIFNIL( bsDataP = (Ptr)calloc(bsSize + bitParsingSlop, 1), allocFailedErr );
-	BAILIFERR( GetFileData( aoe, bsDataP, offset64, bsSize, newoffset64 ) );
+	BAILIFERR( GetFileDataView( aoe, &bsDataP, offset64, bsSize, bitParsingSlop, newoffset64 ) );
 
 bail:
 	if (bsDataPout) *bsDataPout = bsDataP;
@@ -273,24 +1622,102 @@ bail:
 
 //=================================================================
 
-int GetSampleOffsetSize( TrackInfoRec *tir, UInt32 sampleNum, UInt64 *offsetOut, UInt32 *sizeOut, UInt32 *sampleDescriptionIndexOut )
+// The sample index holds, for each sample, its file offset and chunk, and for each chunk its first
+//   sample and sampleToChunk entry, so the lookups below are O(1).  It is only built when the
+//   sampleToChunk table maps every chunk and exactly sampleSizeEntryCnt samples; otherwise the
+//   lookups fall back to walking the tables as they always have.  Like the tables, it lives in vg.arena.
+
+#define SampleIndexSize(tir, n)	((tir)->singleSampleSize ? (tir)->singleSampleSize : (tir)->sampleSize[n].sampleSize)
+
+int BuildSampleIndex( TrackInfoRec *tir )
 {
 	int err = noErr;
+	SampleIndex *si = nil;
+	UInt32 stsCnt, stsEntryCnt = tir->sampleToChunkEntryCnt;
+	UInt32 chunkNum, lastChunk;
+	UInt32 sampleNum;
+	UInt64 total = 0;
+	UInt64 offset;
+	UInt32 i, j;
+	
+	tir->sampleIndex = nil;
+	
+	if (!tir->sampleSizeEntryCnt || !tir->chunkOffsetEntryCnt || !stsEntryCnt
+		|| !tir->chunkOffset || !tir->sampleToChunk || (!tir->singleSampleSize && !tir->sampleSize)
+		|| (tir->sampleToChunk[1].firstChunk != 1))
+		goto bail;
+	for (stsCnt = 1; stsCnt <= stsEntryCnt; stsCnt++) {
+		SampleToChunk *stsc = &tir->sampleToChunk[stsCnt];
+		
+		lastChunk = (stsCnt < stsEntryCnt) ? stsc[1].firstChunk - 1 : tir->chunkOffsetEntryCnt;
+		if (!stsc->samplesPerChunk || (stsc->firstChunk > lastChunk) || (lastChunk > tir->chunkOffsetEntryCnt))
+			goto bail;
+		total += (UInt64)(lastChunk - stsc->firstChunk + 1) * stsc->samplesPerChunk;
+	}
+	if (total != tir->sampleSizeEntryCnt)
+		goto bail;
+	
+	BAILIFNIL( si = (SampleIndex *)ArenaCalloc( &vg.arena, 1, sizeof(SampleIndex) ), allocFailedErr );
+	si->sampleCnt = tir->sampleSizeEntryCnt;
+	si->chunkCnt = tir->chunkOffsetEntryCnt;
+	BAILIFNIL( si->sampleOffset = (UInt64 *)ArenaAlloc( &vg.arena, (si->sampleCnt + 1) * sizeof(UInt64) ), allocFailedErr );
+	BAILIFNIL( si->sampleChunk = (UInt32 *)ArenaAlloc( &vg.arena, (si->sampleCnt + 1) * sizeof(UInt32) ), allocFailedErr );
+	BAILIFNIL( si->decodeTime = (UInt64 *)ArenaAlloc( &vg.arena, ((UInt64)si->sampleCnt + 2) * sizeof(UInt64) ), allocFailedErr );
+	BAILIFNIL( si->chunkFirstSample = (UInt32 *)ArenaAlloc( &vg.arena, (si->chunkCnt + 1) * sizeof(UInt32) ), allocFailedErr );
+	BAILIFNIL( si->chunkStsc = (UInt32 *)ArenaAlloc( &vg.arena, (si->chunkCnt + 1) * sizeof(UInt32) ), allocFailedErr );
+	
+	sampleNum = 1;
+	for (stsCnt = 1; stsCnt <= stsEntryCnt; stsCnt++) {
+		SampleToChunk *stsc = &tir->sampleToChunk[stsCnt];
+		
+		lastChunk = (stsCnt < stsEntryCnt) ? stsc[1].firstChunk - 1 : tir->chunkOffsetEntryCnt;
+		for (chunkNum = stsc->firstChunk; chunkNum <= lastChunk; chunkNum++) {
+			si->chunkFirstSample[chunkNum] = sampleNum;
+			si->chunkStsc[chunkNum] = stsCnt;
+			offset = tir->chunkOffset[chunkNum].chunkOffset;
+			for (j = 0; j < stsc->samplesPerChunk; j++, sampleNum++) {
+				si->sampleOffset[sampleNum] = offset;
+				si->sampleChunk[sampleNum] = chunkNum;
+				offset += SampleIndexSize( tir, sampleNum );
+			}
+		}
+	}
+	
+	// decode times; samples the timeToSample table does not describe get its total
+	offset = 0;
+	sampleNum = 1;
+	for (i = 1; (i <= tir->timeToSampleEntryCnt) && tir->timeToSample && (sampleNum <= si->sampleCnt); i++) {
+		for (j = 0; (j < tir->timeToSample[i].sampleCount) && (sampleNum <= si->sampleCnt); j++) {
+			si->decodeTime[sampleNum++] = offset;
+			offset += (UInt32)tir->timeToSample[i].sampleDuration;
+		}
+	}
+	while (sampleNum <= si->sampleCnt + 1)
+		si->decodeTime[sampleNum++] = offset;
+	
+	tir->sampleIndex = si;
+	
+bail:
+	return err;
+}
+
+// Find the stsc entry and the chunk that hold sampleNum, and the number of the chunk's first sample
+static void LocateSampleChunk( TrackInfoRec *tir, UInt32 sampleNum, int *stsCntOut, UInt32 *chunkNumOut, UInt32 *chunkFirstSampleOut )
+{
+	SampleIndex *si = tir->sampleIndex;
 	int stsCnt;
-	int i;
 	UInt32 sampleCnt = 1;
 	UInt32 samplesPerChunk;
-	UInt32 size = 0;
 	UInt32 chunkNum;
-	UInt32 sampleDelta;
-	UInt64 offset;
-	UInt32 sampleDescriptionIndex = 0;
-	
-	if (sampleNum > tir->sampleSizeEntryCnt) {
-		err = paramErr;
-		goto bail;
+
+	if (si && (sampleNum >= 1) && (sampleNum <= si->sampleCnt)) {
+		chunkNum = si->sampleChunk[sampleNum];
+		*stsCntOut = si->chunkStsc[chunkNum];
+		*chunkNumOut = chunkNum;
+		*chunkFirstSampleOut = si->chunkFirstSample[chunkNum];
+		return;
 	}
-	 
+
 	for (stsCnt = 1; stsCnt < tir->sampleToChunkEntryCnt; stsCnt++) {
 		int numChunks;
 		int numSamples;
@@ -303,13 +1730,54 @@ int GetSampleOffsetSize( TrackInfoRec *tir, UInt32 sampleNum, UInt64 *offsetOut,
 		sampleCnt += numSamples;
 	}
 	
-	sampleDelta = sampleNum - sampleCnt;
 	samplesPerChunk = tir->sampleToChunk[stsCnt].samplesPerChunk;
-	chunkNum = tir->sampleToChunk[stsCnt].firstChunk + (sampleDelta / samplesPerChunk);
-	sampleDelta %= samplesPerChunk;
-	
+	chunkNum = tir->sampleToChunk[stsCnt].firstChunk + ((sampleNum - sampleCnt) / samplesPerChunk);
 	sampleCnt += samplesPerChunk * (chunkNum - tir->sampleToChunk[stsCnt].firstChunk);
 
+	*stsCntOut = stsCnt;
+	*chunkNumOut = chunkNum;
+	*chunkFirstSampleOut = sampleCnt;
+}
+
+int GetSampleOffsetSize( TrackInfoRec *tir, UInt32 sampleNum, UInt64 *offsetOut, UInt32 *sizeOut, UInt32 *sampleDescriptionIndexOut )
+{
+	int err = noErr;
+	int stsCnt;
+	int i;
+	UInt32 sampleCnt;
+	UInt32 size = 0;
+	UInt32 chunkNum;
+	UInt32 sampleDelta;
+	UInt64 offset = 0;
+	UInt32 sampleDescriptionIndex = 0;
+	
+	if (sampleNum > tir->sampleSizeEntryCnt) {
+		err = paramErr;
+		goto bail;
+	}
+	
+	if (tir->sampleIndex && (sampleNum >= 1)) {
+		SampleIndex *si = tir->sampleIndex;
+		
+		offset = si->sampleOffset[sampleNum];
+		size = SampleIndexSize( tir, sampleNum );
+		sampleDescriptionIndex = tir->sampleToChunk[ si->chunkStsc[ si->sampleChunk[sampleNum] ] ].sampleDescriptionIndex;
+		goto bail;
+	}
+	 
+	// a sample table box that could not be read (e.g. cut short by the end of the file) leaves
+	//   its table out, and the sample counts of the others need not agree with it
+	if ((tir->sampleToChunk == nil) || (tir->sampleToChunkEntryCnt == 0) || (tir->chunkOffset == nil)) {
+		err = paramErr;
+		goto bail;
+	}
+	LocateSampleChunk( tir, sampleNum, &stsCnt, &chunkNum, &sampleCnt );
+	if ((chunkNum < 1) || (chunkNum > tir->chunkOffsetEntryCnt)) {
+		err = paramErr;
+		goto bail;
+	}
+	sampleDelta = sampleNum - sampleCnt;
+
 	offset = tir->chunkOffset[chunkNum].chunkOffset;
 	sampleDescriptionIndex = tir->sampleToChunk[stsCnt].sampleDescriptionIndex;
 	if (tir->singleSampleSize) {
@@ -345,6 +1813,18 @@ int GetChunkOffsetSize( TrackInfoRec *tir, UInt32 chunkNum, UInt64 *offsetOut, U
 		goto bail;
 	}
 	
+	if (tir->sampleIndex && (chunkNum >= 1)) {
+		SampleIndex *si = tir->sampleIndex;
+		UInt32 lastSample;
+		
+		stsCnt = si->chunkStsc[chunkNum];
+		lastSample = si->chunkFirstSample[chunkNum] + tir->sampleToChunk[stsCnt].samplesPerChunk - 1;
+		offset = tir->chunkOffset[chunkNum].chunkOffset;
+		size = (UInt32)(si->sampleOffset[lastSample] + SampleIndexSize( tir, lastSample ) - offset);
+		sampleDescriptionIndex = tir->sampleToChunk[stsCnt].sampleDescriptionIndex;
+		goto bail;
+	}
+	
 	for (stsCnt = 1; stsCnt < tir->sampleToChunkEntryCnt; stsCnt++) {
 		if (tir->sampleToChunk[stsCnt + 1].firstChunk > chunkNum) {
 			break;
@@ -373,36 +1853,228 @@ bail:
 	return err;
 }
 
+int GetSampleDecodeTime( TrackInfoRec *tir, UInt32 sampleNum, UInt64 *decodeTimeOut, UInt32 *durationOut )
+{
+	int err = noErr;
+	UInt64 decodeTime = 0;
+	UInt32 duration = 0;
+	UInt32 i;
+	UInt32 sampleCnt = 1;
+	
+	if ((sampleNum < 1) || (sampleNum > tir->timeToSampleSampleCnt) || !tir->timeToSample) {
+		err = paramErr;
+		goto bail;
+	}
+	
+	if (tir->sampleIndex && (sampleNum <= tir->sampleIndex->sampleCnt)) {
+		decodeTime = tir->sampleIndex->decodeTime[sampleNum];
+		duration = (UInt32)(tir->sampleIndex->decodeTime[sampleNum + 1] - decodeTime);
+		goto bail;
+	}
+	
+	for (i = 1; i <= tir->timeToSampleEntryCnt; i++) {
+		duration = (UInt32)tir->timeToSample[i].sampleDuration;
+		if (sampleNum < sampleCnt + tir->timeToSample[i].sampleCount) {
+			decodeTime += (UInt64)(sampleNum - sampleCnt) * duration;
+			break;
+		}
+		decodeTime += (UInt64)tir->timeToSample[i].sampleCount * duration;
+		sampleCnt += tir->timeToSample[i].sampleCount;
+	}
+	
+bail:
+	if (decodeTimeOut) *decodeTimeOut = decodeTime;
+	if (durationOut) *durationOut = duration;
+	return err;
+}
+
+//==========================================================================================
+
+// Sample data is read through a SampleReader: on a miss it reads the whole chunk the sample
+//   lives in (plus any following chunks that are contiguous with it, up to kSampleReadCoalesceSize)
+//   into one buffer that is reused for the whole track, and hands out views into it.
+//   A view stays valid until the next call on the same reader.
+
+void SampleReader_Init( SampleReader *sr, TrackInfoRec *tir )
+{
+	memset( sr, 0, sizeof(*sr) );
+	sr->tir = tir;
+}
+
+void SampleReader_Dispose( SampleReader *sr )
+{
+	if (sr->buffer) free( sr->buffer );
+	sr->buffer = nil;
+	sr->bufferSize = sr->windowSize = 0;
+}
+
+static int SampleReader_Fill( SampleReader *sr, UInt64 offset64, UInt64 size64 )
+{
+	int err = noErr;
+
+	if (size64 > sr->bufferSize) {
+		UInt64 newSize = sr->bufferSize * 2;
+		
+		if (newSize < size64) newSize = size64;
+		if (sr->buffer) free( sr->buffer );
+		sr->bufferSize = 0;
+		BAILIFNIL( sr->buffer = (Ptr)malloc(newSize + bitParsingSlop), allocFailedErr );
+		sr->bufferSize = newSize;
+		sr->allocCount++;
+	}
+
+	// a short read leaves zeros behind, as a calloc'd sample buffer would
+	memset( sr->buffer, 0, size64 + bitParsingSlop );
+	sr->windowStart = offset64;
+	sr->windowSize = 0;
+	sr->readCount++;
+	err = GetFileData( vg.fileaoe, sr->buffer, offset64, size64, nil );
+	if (!err) {
+		sr->windowSize = size64;
+		sr->bytesRead += size64;
+	}
+
+bail:
+	return err;
+}
+
+// View size bytes at offset64; on a miss read up to readAheadEnd so the following requests hit.
+//   Like GetFileDataView, *dataPout is only nil if we could not allocate.
+int SampleReader_GetRange( SampleReader *sr, UInt64 offset64, UInt32 size, UInt64 readAheadEnd, Ptr *dataPout )
+{
+	int err = noErr;
+
+	*dataPout = nil;
+	
+	if (vg.inMap) {
+		UInt64 mapOffset = getAdjustedFileOffset(offset64);
+		
+		if ((mapOffset <= vg.inMapSize) && (size + bitParsingSlop <= vg.inMapSize - mapOffset)) {
+			BAILIFERR( CheckHeaderOnlyRead( offset64, size ) );
+			*dataPout = (Ptr)(vg.inMap + mapOffset);
+			goto bail;
+		}
+	}
+	
+	if ((offset64 >= sr->windowStart) && (offset64 + size <= sr->windowStart + sr->windowSize)) {
+		*dataPout = sr->buffer + (offset64 - sr->windowStart);
+		goto bail;
+	}
+
+	if (vg.streamInput || (readAheadEnd < offset64 + size))
+		readAheadEnd = offset64 + size;
+	
+	err = SampleReader_Fill( sr, offset64, readAheadEnd - offset64 );
+	if (err && (err != allocFailedErr) && (readAheadEnd > offset64 + size)) {
+		// the read-ahead ran off the end of the data; settle for just this sample
+		err = SampleReader_Fill( sr, offset64, size );
+	}
+	if (sr->buffer && (err != allocFailedErr))
+		*dataPout = sr->buffer;
+	
+bail:
+	return err;
+}
+
+int SampleReader_GetSample( SampleReader *sr, UInt32 sampleNum, UInt64 *offsetOut, UInt32 *sizeOut, Ptr *dataPout )
+{
+	TrackInfoRec *tir = sr->tir;
+	int err = noErr;
+	UInt64 sampleOffset, chunkOffset;
+	UInt32 sampleSize, chunkSize;
+	UInt64 readAheadEnd;
+	int stsCnt;
+	UInt32 chunkNum, chunkFirstSample;
+	
+	*dataPout = nil;
+	err = GetSampleOffsetSize( tir, sampleNum, &sampleOffset, &sampleSize, nil );
+	*offsetOut = sampleOffset;
+	*sizeOut = sampleSize;
+	if (err) goto bail;
+	
+	// coalesce the sample's chunk with the chunks that directly follow it in the file
+	readAheadEnd = sampleOffset + sampleSize;
+	if ((sampleOffset < sr->windowStart) || (sampleOffset + sampleSize > sr->windowStart + sr->windowSize)) {
+		LocateSampleChunk( tir, sampleNum, &stsCnt, &chunkNum, &chunkFirstSample );
+		if ((GetChunkOffsetSize( tir, chunkNum, &chunkOffset, &chunkSize, nil ) == noErr)
+				&& (sampleOffset >= chunkOffset) && (readAheadEnd <= chunkOffset + chunkSize)) {
+			readAheadEnd = chunkOffset + chunkSize;
+			while ((chunkNum < tir->chunkOffsetEntryCnt)
+					&& (GetChunkOffsetSize( tir, chunkNum + 1, &chunkOffset, &chunkSize, nil ) == noErr)
+					&& (chunkOffset == readAheadEnd)
+					&& (readAheadEnd + chunkSize - sampleOffset <= kSampleReadCoalesceSize)) {
+				readAheadEnd += chunkSize;
+				chunkNum++;
+			}
+			if (readAheadEnd - sampleOffset > kSampleReadCoalesceSize)
+				readAheadEnd = sampleOffset + ((sampleSize > kSampleReadCoalesceSize) ? sampleSize : kSampleReadCoalesceSize);
+		}
+	}
+	
+	err = SampleReader_GetRange( sr, sampleOffset, sampleSize, readAheadEnd, dataPout );
+
+bail:
+	return err;
+}
+
+// Per track read statistics (-printtype stats); they differ between the input backends, so
+//   they are kept out of the sample dump
+void SampleReader_PrintStats( SampleReader *sr )
+{
+	if (!vg.print_stats)
+		return;
+	reportprint("<!-- sample reads: %u reads, %llu bytes, %u buffer allocations -->\n",
+					sr->readCount, sr->bytesRead, sr->allocCount);
+}
+
 //==========================================================================================
 
+// fgetc() equivalent that also works on a mapped, streamed or segmented input; filePos is not used for stdio
+static int GetNextFileByte( UInt64 *filePos )
+{
+	if (vg.streamInput || vg.numInSegments) {
+		UInt8 c;
+		UInt64 amtRead;
+		int err = vg.streamInput ? StreamGetData( &c, *filePos, 1, &amtRead ) : SegmentsGetData( &c, *filePos, 1, &amtRead );
+		
+		if (err || (amtRead != 1))
+			return EOF;
+		(*filePos)++;
+		return c;
+	}
+	if (vg.inMap == nil)
+		return fgetc( vg.inFile );
+	if (*filePos >= vg.inMapSize)
+		return EOF;
+	return vg.inMap[(*filePos)++];
+}
+
 int GetFileStartCode( atomOffsetEntry *aoe, UInt32 *startCode, UInt64 offset64, UInt64 *newoffset64 )
 {
 #pragma unused(aoe)
 	int err = 0;
-	long amtRead = 0;
 	UInt64 curoffset = offset64;
+	UInt64 filePos = 0;
 	UInt32 bits = 0;
 	
-	if (offset64 > 0x7FFFFFFFL) {
-		fprintf(stderr,"sorry - can't handle file offsets > 31-bits\n");
-		err = noCanDoErr;
-		goto bail;
+	if (vg.inMap || vg.streamInput || vg.numInSegments)
+		filePos = getAdjustedFileOffset(offset64);
+	else {
+		err = fseek64(vg.inFile, getAdjustedFileOffset(offset64), SEEK_SET);
+		if (err) goto bail;
 	}
 	
-	err = fseek(vg.inFile, getAdjustedFileOffset(offset64), SEEK_SET);
-	if (err) goto bail;
-	
-	bits = fgetc( vg.inFile ); curoffset++;
+	bits = GetNextFileByte( &filePos ); curoffset++;
 		if (curoffset > aoe->maxOffset) { err = outOfDataErr; goto bail;}
-	bits <<= 8; bits |= fgetc( vg.inFile ); curoffset++;
+	bits <<= 8; bits |= GetNextFileByte( &filePos ); curoffset++;
 		if (curoffset > aoe->maxOffset) { err = outOfDataErr; goto bail;}
-	bits <<= 8; bits |= fgetc( vg.inFile ); curoffset++;
+	bits <<= 8; bits |= GetNextFileByte( &filePos ); curoffset++;
 		if (curoffset > aoe->maxOffset) { err = outOfDataErr; goto bail;}
-	bits <<= 8; bits |= fgetc( vg.inFile ); curoffset++;
+	bits <<= 8; bits |= GetNextFileByte( &filePos ); curoffset++;
 		if (curoffset > aoe->maxOffset) { err = outOfDataErr; goto bail;}
 	
 	while ((bits & 0xffffff00) != 0x00000100) {
-		bits <<= 8; bits |= fgetc( vg.inFile ); curoffset++;
+		bits <<= 8; bits |= GetNextFileByte( &filePos ); curoffset++;
 			if (curoffset > aoe->maxOffset) { err = outOfDataErr; goto bail;}
 	}
 	
@@ -262,13 +262,13 @@ OSErr Validate_Hint_Track( atomOffsetEntry *aoe, TrackInfoRec *tir )
 	OSErr		err = noErr;
 	UInt64		sampleOffset;
 	UInt32		sampleSize;
-	UInt32		sampleDescriptionIndex;
 	Ptr			dataP = nil;
 	UInt32		i;
 	UInt32		startSampleNum;
 	UInt32		endSampleNum;
 	Boolean		doPrinting = false;
 	HintInfoRec	hir = {0};
+	SampleReader sr;
 	
 	UInt64 minOffset, maxOffset;
 	long cnt;
@@ -276,6 +276,7 @@ OSErr Validate_Hint_Track( atomOffsetEntry *aoe, TrackInfoRec *tir )
 	OSErr		tempErr;
 
 	// -------------------------------------------------------
+		SampleReader_Init( &sr, tir );
 		hir.aoe = aoe;
 		hir.tir = tir;
 		hir.hintSampleNum = 0;
@@ -324,7 +325,7 @@ OSErr Validate_Hint_Track( atomOffsetEntry *aoe, TrackInfoRec *tir )
 
 	H_ATOM_PRINT(("<payloadnum=\"%d\" payloadname=\"%s\">\n", hir.sdpInfo.payloadNum, hir.sdpInfo.payloadName));
 	if (hir.originalMediaTIR != NULL) {
-		H_ATOM_PRINT(("<streammediatype=\"%.4s\">\n", &hir.originalMediaTIR->mediaType));
+		H_ATOM_PRINT(("<streammediatype=\"%.4s\">\n", (char *)&hir.originalMediaTIR->mediaType));
 		//@@@ remove this restriction for other file type
 		if (hir.originalMediaTIR->mediaType == 'soun') {
 			if (!compare_nocase(hir.sdpInfo.payloadName, kMPEG4Generic_PayloadName)) {
@@ -361,16 +362,16 @@ OSErr Validate_Hint_Track( atomOffsetEntry *aoe, TrackInfoRec *tir )
     if(!vg.dashSegment)
 		for (i = startSampleNum; i <= endSampleNum; i++) {
 			if ((vg.samplenumber==0) || (vg.samplenumber==(long)i)) {
-				err = GetSampleOffsetSize( tir, i, &sampleOffset, &sampleSize, &sampleDescriptionIndex );
+				err = GetSampleOffsetSize( tir, i, &sampleOffset, &sampleSize, nil );
 				if (err != noErr) {
-					errprint("couldn't GetSampleOffsetSize for sample %ld (err %ld)\n", i, err);
+					errprint("couldn't GetSampleOffsetSize for sample %d (err %d)\n", i, err);
 					continue;
 				}
 				H_ATOM_PRINT_INCR(( "<sample num=\"%d\" offset=\"%s\" size=\"%d\"\n",i,int64toxstr(sampleOffset),sampleSize));
-					BAILIFNIL( dataP = (Ptr)malloc(sampleSize), allocFailedErr );
-					err = GetFileData( vg.fileaoe, dataP, sampleOffset, sampleSize, nil );
+					err = SampleReader_GetSample( &sr, i, &sampleOffset, &sampleSize, &dataP );
+					if (err == allocFailedErr) goto bail;
 					if (err != noErr) {
-						errprint("couldn't GetFileData for sample %ld (err %ld)\n", i, err);
+						errprint("couldn't GetFileData for sample %d (err %d)\n", i, err);
 						continue;
 					}
 									
@@ -379,14 +380,15 @@ OSErr Validate_Hint_Track( atomOffsetEntry *aoe, TrackInfoRec *tir )
 					hir.hintSampleLength = sampleSize;
 					Validate_Hint_Sample(&hir, dataP, sampleSize);
 
-					free( dataP );
 					hir.hintSampleData = NULL;
 				H_ATOM_PRINT_DECR(("</sample>\n"))
 			}
 		}
+	if (doPrinting) SampleReader_PrintStats( &sr );
 	H_ATOM_PRINT_DECR(("</hint_SAMPLE_DATA>\n"));
 
 bail:
+	SampleReader_Dispose( &sr );
 	if (hir.packetData != NULL) {
 		free(hir.packetData);
 	}
@@ -416,10 +418,10 @@ static OSErr Validate_Hint_Sample( HintInfoRec *hir, char *inSampleData, UInt32
 	if ((temp16 != 0) && (temp16 != 65535)) {
 		// alas the spec forgets to say what the reserved value is, and mpeg people always think
 		//  -1, whereas RTP people think 0 [dws]
-		warnprint("WARNING - reserved in sample data %ld should be 0 or -1\n", temp16);
+		warnprint("WARNING - reserved in sample data %d should be 0 or -1\n", temp16);
 	}
-	H_ATOM_PRINT(("numPackets=\"%ld\"\n", numPackets));
-	H_ATOM_PRINT(("reserved=\"%ld\"\n", temp16));
+	H_ATOM_PRINT(("numPackets=\"%d\"\n", numPackets));
+	H_ATOM_PRINT(("reserved=\"%d\"\n", temp16));
 
 	if (numPackets == 0) {
 		warnprint("WARNING - numPackets = 0\n");
@@ -427,12 +429,12 @@ static OSErr Validate_Hint_Sample( HintInfoRec *hir, char *inSampleData, UInt32
 
 	packetEntryPtr = inSampleData + sizeof(UInt16) + sizeof(UInt16);
 	for (i=0; i<numPackets; ++i) {
-		H_ATOM_PRINT_INCR(("<packet=\"%ld\">\n", i))
+		H_ATOM_PRINT_INCR(("<packet=\"%d\">\n", i))
 			BAILIFERR(Validate_Packet_Entry(hir, packetEntryPtr, inLength - (UInt16)(packetEntryPtr-inSampleData), &next ));
 			packetEntryPtr = next;
 		H_ATOM_PRINT_DECR(("</packet>\n"))
 		if (packetEntryPtr > (inSampleData + inLength)) {
-			errprint("ERROR - hint sample packet entries %ld overflowed\n", i);
+			errprint("ERROR - hint sample packet entries %d overflowed\n", i);
 			err = outOfDataErr;
 			goto bail;
 		}
@@ -470,7 +472,7 @@ static OSErr Validate_Packet_Entry( HintInfoRec *hir, char *inPacketEntry, UInt3
 
 	temp32 = EndianU32_BtoN(*((UInt32*)current));
 	current += sizeof(temp32);
-	H_ATOM_PRINT(("relativeTransmissionTime=\"%ld\"\n", temp32));
+	H_ATOM_PRINT(("relativeTransmissionTime=\"%d\"\n", temp32));
 	temp16 = EndianU16_BtoN(*((UInt16*)current));
 	current += sizeof(temp16);
 	H_ATOM_PRINT_INCR(("<rtpHeader>\n"));
@@ -482,7 +484,7 @@ static OSErr Validate_Packet_Entry( HintInfoRec *hir, char *inPacketEntry, UInt3
 
 	temp16 = EndianU16_BtoN(*((UInt16*)current));
 	current += sizeof(temp16);
-	H_ATOM_PRINT(("sequenceNumber=\"%ld\"\n", temp16))
+	H_ATOM_PRINT(("sequenceNumber=\"%d\"\n", temp16))
 
 #define kPacketEntry_XBit		0x0004
 #define kPacketEntry_BBit		0x0002
@@ -499,7 +501,7 @@ static OSErr Validate_Packet_Entry( HintInfoRec *hir, char *inPacketEntry, UInt3
 
 	entryCount = EndianU16_BtoN(*((UInt16*)current));
 	current += sizeof(temp16);
-	H_ATOM_PRINT(("numTableEntries=\"%ld\"\n", entryCount));
+	H_ATOM_PRINT(("numTableEntries=\"%d\"\n", entryCount));
 
 	if (hasExtraInfoTLVs) {
 		char *tlv;
@@ -514,7 +516,7 @@ static OSErr Validate_Packet_Entry( HintInfoRec *hir, char *inPacketEntry, UInt3
 			boxtype = EndianU32_BtoN(*((UInt32*)tlvdata)); tlvdata += sizeof(temp32);
 			if (boxtype == 'rtpo') {
 				temp32 = EndianU32_BtoN(*((UInt32*)tlvdata));
-				H_ATOM_PRINT(("RTP timestamp offset=\"%ld\"\n", temp32));
+				H_ATOM_PRINT(("RTP timestamp offset=\"%d\"\n", temp32));
 			}
 			else warnprint("Warning: Unknown packet extra info TLV %s\n",ostypetostr(boxtype));
 			tlv += (boxlen + 3) & (0xFFFFFFFc);		// rounded up to a 4-byte boundary
@@ -523,7 +525,7 @@ static OSErr Validate_Packet_Entry( HintInfoRec *hir, char *inPacketEntry, UInt3
 
 
 	if (current + (entryCount * kHintDataTableEntrySize) > inPacketEntry + inMaxLength) {
-		errprint("entrycount %ld is too big for data size\n", entryCount);
+		errprint("entrycount %d is too big for data size\n", entryCount);
 		err = outOfDataErr;
 		goto bail;
 	}
@@ -531,7 +533,7 @@ static OSErr Validate_Packet_Entry( HintInfoRec *hir, char *inPacketEntry, UInt3
 	hir->packetConstructedOK = true;
 	hir->packetDataCurrent = hir->packetData;
 	for (i=0; i<entryCount; ++i) {
-		H_ATOM_PRINT_INCR(("<dataEntry=\"%ld\">\n", i));
+		H_ATOM_PRINT_INCR(("<dataEntry=\"%d\">\n", i));
 			Validate_Data_Entry(hir, current);
 			current += kHintDataTableEntrySize;
 		H_ATOM_PRINT_DECR(("</dataEntry>\n"));
@@ -596,8 +598,8 @@ static OSErr Validate_Data_Entry( HintInfoRec *hir, char *inEntry )
 				goto bail;
 			}
 			if (hir->constructPacket) {
-				if (hir->packetDataCurrent-hir->packetData + (Ptr)(inEntry[1]) > (Ptr)hir->packetDataMaxLength) {
-					errprint("data entry - immed data length too big %ld", inEntry[1]);
+				if ((UInt32)(hir->packetDataCurrent-hir->packetData) + inEntry[1] > hir->packetDataMaxLength) {
+					errprint("data entry - immed data length too big %d", inEntry[1]);
 					err = paramErr;
 					goto bail;
 				}
@@ -613,9 +615,9 @@ static OSErr Validate_Data_Entry( HintInfoRec *hir, char *inEntry )
 			length = EndianU16_BtoN(*((UInt16*)(inEntry+2)));
 			H_ATOM_PRINT(("length=\"%d\"\n", length));
 			sampleNum = EndianU32_BtoN(*((UInt32*)(inEntry+4)));
-			H_ATOM_PRINT(("sampleNum=\"%ld\"\n", sampleNum));
+			H_ATOM_PRINT(("sampleNum=\"%d\"\n", sampleNum));
 			offset = EndianU32_BtoN(*((UInt32*)(inEntry+8)));
-			H_ATOM_PRINT(("offset=\"%ld\"\n", offset));
+			H_ATOM_PRINT(("offset=\"%d\"\n", offset));
 			temp16 = EndianU16_BtoN(*((UInt16*)(inEntry+12)));
 			H_ATOM_PRINT(("blockSize=\"%d\"\n", temp16));			
 			//@@@ don't check this for .mov files
@@ -638,7 +640,7 @@ static OSErr Validate_Data_Entry( HintInfoRec *hir, char *inEntry )
 				}
 
 				if (hir->constructPacket) {
-					if (hir->packetDataCurrent-hir->packetData + (Ptr)length > (Ptr)hir->packetDataMaxLength) {
+					if ((UInt32)(hir->packetDataCurrent-hir->packetData) + length > hir->packetDataMaxLength) {
 						errprint("data entry - packet data too big %ld\n", hir->packetDataCurrent-hir->packetData + length);
 						err = paramErr;
 						goto bail;
@@ -651,7 +653,7 @@ static OSErr Validate_Data_Entry( HintInfoRec *hir, char *inEntry )
 			
 				if (trackRefIndex != (SInt8)kSelfTrackRefIndex) {
 				 	if (trackRefIndex != 0) {
-						errprint("data entry - trackRefIndex (%ld) should be 0", trackRefIndex);
+						errprint("data entry - trackRefIndex (%d) should be 0", trackRefIndex);
 						err = paramErr;
 						goto bail;
 					
@@ -660,7 +662,7 @@ static OSErr Validate_Data_Entry( HintInfoRec *hir, char *inEntry )
 				}
 
 				if (thisTIR == NULL) {
-					errprint("data entry -can't find trackinfo for referenced trackid %ld\n", hir->tir->hintRefTrackID);
+					errprint("data entry -can't find trackinfo for referenced trackid %d\n", hir->tir->hintRefTrackID);
 					err = paramErr;
 					goto bail;
 				}
@@ -676,7 +678,7 @@ static OSErr Validate_Data_Entry( HintInfoRec *hir, char *inEntry )
                 }
                 
 				if (hir->constructPacket) {
-					if (hir->packetDataCurrent-hir->packetData + (Ptr)length > (Ptr)hir->packetDataMaxLength) {
+					if ((UInt32)(hir->packetDataCurrent-hir->packetData) + length > hir->packetDataMaxLength) {
 						errprint("data entry - packet data too big %ld\n", hir->packetDataCurrent-hir->packetData + length);
 						err = paramErr;
 						goto bail;
@@ -694,13 +696,13 @@ static OSErr Validate_Data_Entry( HintInfoRec *hir, char *inEntry )
 			temp16 = EndianU16_BtoN(*((UInt16*)(inEntry+2)));
 			H_ATOM_PRINT(("length=\"%d\"\n", temp16));
 			temp32 = EndianU32_BtoN(*((UInt32*)(inEntry+4)));
-			H_ATOM_PRINT(("sampleDescriptionIndex=\"%ld\"\n", temp32));
+			H_ATOM_PRINT(("sampleDescriptionIndex=\"%d\"\n", temp32));
 			temp32 = EndianU32_BtoN(*((UInt32*)(inEntry+8)));
-			H_ATOM_PRINT(("offset=\"%ld\"\n", temp32));
+			H_ATOM_PRINT(("offset=\"%d\"\n", temp32));
 			temp32 = EndianU32_BtoN(*((UInt32*)(inEntry+12)));
-			H_ATOM_PRINT(("reserved=\"%ld\"\n", temp32));
+			H_ATOM_PRINT(("reserved=\"%d\"\n", temp32));
 			if (temp32 != 0) {
-				warnprint("Warning: reserved in sample desc data entry %ld != 0\n", temp32);
+				warnprint("Warning: reserved in sample desc data entry %d != 0\n", temp32);
 			}
 			if (hir->constructPacket) {
 				errprint("can't get sample descriptions yet\n");
@@ -710,7 +712,7 @@ static OSErr Validate_Data_Entry( HintInfoRec *hir, char *inEntry )
 			}
 			break;
 		default:
-			H_ATOM_PRINT(("dataSource=unknown=\"%ld\"\n", dataSource));
+			H_ATOM_PRINT(("dataSource=unknown=\"%d\"\n", dataSource));
 			H_ATOM_PRINT_HEXDATA((char*)inEntry+1, kHintDataTableEntrySize-1);
 			warnprint("Warning: unknown datasource in data entry\n");
 			break;
@@ -750,7 +752,7 @@ static OSErr Validate_rfc3016_Payload( char *inPayload, UInt32 inLength, void *i
 				break;
 				
 			default:
-				errprint("UnknownStartCode=%ld\n", startCodeTag);
+				errprint("UnknownStartCode=%d\n", startCodeTag);
 				break;
 		}
 		if (hir->printPayloadContents) {
@@ -819,7 +821,7 @@ static OSErr Validate_Generic_MPEG4_Audio_Payload( char *inPayload, UInt32 inLen
 	numHeaders = temp32 / hir->bytesPerHeader;
 
 	if ((numHeaders % kBitsPerByte) != 0) {
-		errprint("audio payload-au header length not a multiple of 8: %ld\n", temp32);
+		errprint("audio payload-au header length not a multiple of 8: %d\n", temp32);
 		err = noCanDoErr;
 		goto bail;
 	}
@@ -829,20 +831,20 @@ static OSErr Validate_Generic_MPEG4_Audio_Payload( char *inPayload, UInt32 inLen
 	
 	auCurrent = headerCurrent + (hir->bytesPerHeader * numHeaders);
 	if (auCurrent > inPayload + inLength) {
-		errprint("num au headers %ld is too long for pkt length\n", temp32);
+		errprint("num au headers %d is too long for pkt length\n", temp32);
 		err = outOfDataErr;
 		goto bail;
 	}
 	
 	if ((hir->bytesPerHeader < 1) || (hir->bytesPerHeader > 2)) {
-		errprint("bytesPerHeader=%ld unsupported\n", hir->bytesPerHeader);
+		errprint("bytesPerHeader=%d unsupported\n", hir->bytesPerHeader);
 		err = noCanDoErr;
 		goto bail;
 	}
 
 	if (hir->printPayloadContents) {
 		H_ATOM_PRINT_INCR(("<payload>\n"));
-			H_ATOM_PRINT(("numHeaders=\"%ld\"\n", numHeaders));
+			H_ATOM_PRINT(("numHeaders=\"%d\"\n", numHeaders));
 	}
 
 	for (i=0; i<numHeaders; ++i) {
@@ -857,12 +859,12 @@ static OSErr Validate_Generic_MPEG4_Audio_Payload( char *inPayload, UInt32 inLen
 		auLength = auLength >> hir->numIndexBits;
 
 		if ((auCurrent + auLength > auMax) && (numHeaders > 1)) {
-			errprint("aulength %ld too big-overflows payload\n", auLength);
+			errprint("aulength %d too big-overflows payload\n", auLength);
 			err = outOfDataErr;
 			break;
 		}
 		if (hir->printPayloadContents) {
-			H_ATOM_PRINT_INCR(("<au=\"%ld\" length=\"%ld\" index=\"%ld\">\n", i, auLength, index));
+			H_ATOM_PRINT_INCR(("<au=\"%d\" length=\"%d\" index=\"%d\">\n", i, auLength, index));
 				H_ATOM_PRINT_HEXDATA(auCurrent, auLength);
 			H_ATOM_PRINT_DECR(("</au>\n"));
 			auCurrent += auLength;
@@ -945,7 +947,7 @@ static OSErr Validate_H264_Payload( char *inPayload, UInt32 inLength, void *inRe
 				H_ATOM_PRINT_DECR(("</NALUnit>\n"));
 				headerCurrent += nalSize;
 			}
-			if (headerCurrent > headerLimit) errprint("NAL Unit overflowed %d\n",headerCurrent-headerLimit);
+			if (headerCurrent > headerLimit) errprint("NAL Unit overflowed %ld\n",headerCurrent-headerLimit);
 			break;
 			
 		case kNAL_MTAP16:
@@ -975,7 +977,7 @@ static OSErr Validate_H264_Payload( char *inPayload, UInt32 inLength, void *inRe
 				H_ATOM_PRINT_DECR(("</NALUnit>\n"));
 				headerCurrent += nalSize;
 			}
-			if (headerCurrent > headerLimit) errprint("NAL Unit overflowed %d\n",headerCurrent-headerLimit);
+			if (headerCurrent > headerLimit) errprint("NAL Unit overflowed %ld\n",headerCurrent-headerLimit);
 			break;
 
 		case kNAL_FU_A:
@@ -1159,7 +1161,7 @@ static OSErr Validate_hnti_Atom( atomOffsetEntry *aoe, void *refcon )
 	current += sizeof(UInt32);
 	
 	if (atomLength > aoe->size - aoe->atomStartSize) {
-		errprint("atomlength %ld in 'hnti' user data too big\n", atomLength);
+		errprint("atomlength %d in 'hnti' user data too big\n", atomLength);
 		err = outOfDataErr;
 		goto bail;
 	}
@@ -1314,10 +1316,10 @@ static OSErr Validate_SDP_Media_Line( HintInfoRec *hir, char *inLine )
 //@@@ err here
 	}
 	if (!is_in_range(temp32, 0, 0x0000ffff)) {
-		warnprint("Warning: port out of range %ld\n",temp32);
+		warnprint("Warning: port out of range %d\n",temp32);
 	}
 	if (temp32 != 0) {
-		warnprint("port should be 0 but is %ld\n", temp32);
+		warnprint("port should be 0 but is %d\n", temp32);
 	}
 	current = next+1;	
 	
@@ -1342,7 +1344,7 @@ static OSErr Validate_SDP_Media_Line( HintInfoRec *hir, char *inLine )
 		goto bail;
 	}
 	if (!is_in_range(temp32, 0, 0x000000ff)) {
-		errprint("payloadnum out of range %ld\n",temp32);
+		errprint("payloadnum out of range %d\n",temp32);
 		err = paramErr;
 		goto bail;
 	}
@@ -1553,22 +1555,22 @@ static OSErr Validate_fmtp_attribute( HintInfoRec *hir, char *inValue)
 		switch (hir->genericPayloadMode) {
 			case kMPEG4GenericMode_CELPCBR:
 				if (hir->constantSize <=0) {
-					errprint("constantsize (%ld) param out of range", hir->constantSize);
+					errprint("constantsize (%d) param out of range", hir->constantSize);
 					err = paramErr;
 				}
 				break;
 
 			case kMPEG4GenericMode_CELPVBR:
 				if (hir->numLengthBits != kMPEG4Generic_CELPVBR_SizeLengthDefault) {
-					errprint("sizelength (%ld) != default (%ld)", hir->numLengthBits, kMPEG4Generic_CELPVBR_SizeLengthDefault);
+					errprint("sizelength (%d) != default (%d)", hir->numLengthBits, kMPEG4Generic_CELPVBR_SizeLengthDefault);
 					err = paramErr;
 				}
 				if (hir->numIndexBits != kMPEG4Generic_CELPVBR_IndexLengthDefault) {
-					errprint("indexlength (%ld) != default (%ld)", hir->numIndexBits, kMPEG4Generic_CELPVBR_IndexLengthDefault);
+					errprint("indexlength (%d) != default (%d)", hir->numIndexBits, kMPEG4Generic_CELPVBR_IndexLengthDefault);
 					err = paramErr;
 				}
 				if (hir->numIndexBits != kMPEG4Generic_CELPVBR_IndexDeltaLengthDefault) {
-					errprint("indexdeltalength (%ld) != default (%ld)", hir->numIndexBits, kMPEG4Generic_CELPVBR_IndexDeltaLengthDefault);
+					errprint("indexdeltalength (%d) != default (%d)", hir->numIndexBits, kMPEG4Generic_CELPVBR_IndexDeltaLengthDefault);
 					err = paramErr;
 				}
 				hir->bytesPerHeader = kMPEGGeneric_CELPVBR_OverheadBytesPerFrame;
@@ -1581,15 +1583,15 @@ static OSErr Validate_fmtp_attribute( HintInfoRec *hir, char *inValue)
 				
 			case kMPEG4GenericMode_AACLowBitRate:
 				if (hir->numLengthBits != kMPEG4Generic_AACLBR_SizeLengthDefault) {
-					errprint("sizelength (%ld) != default (%ld)", hir->numLengthBits, kMPEG4Generic_AACLBR_SizeLengthDefault);
+					errprint("sizelength (%d) != default (%d)", hir->numLengthBits, kMPEG4Generic_AACLBR_SizeLengthDefault);
 					err = paramErr;
 				}
 				if (hir->numIndexBits != kMPEG4Generic_AACLBR_IndexLengthDefault) {
-					errprint("indexlength (%ld) != default (%ld)", hir->numIndexBits, kMPEG4Generic_AACLBR_IndexLengthDefault);
+					errprint("indexlength (%d) != default (%d)", hir->numIndexBits, kMPEG4Generic_AACLBR_IndexLengthDefault);
 					err = paramErr;
 				}
 				if (hir->numIndexBits != kMPEG4Generic_AACLBR_IndexDeltaLengthDefault) {
-					errprint("indexdeltalength (%ld) != default (%ld)", hir->numIndexBits, kMPEG4Generic_AACLBR_IndexDeltaLengthDefault);
+					errprint("indexdeltalength (%d) != default (%d)", hir->numIndexBits, kMPEG4Generic_AACLBR_IndexDeltaLengthDefault);
 					err = paramErr;
 				}
 				hir->bytesPerHeader = kMPEGGeneric_AACLBR_OverheadBytesPerFrame;
@@ -1602,15 +1604,15 @@ static OSErr Validate_fmtp_attribute( HintInfoRec *hir, char *inValue)
 
 			case kMPEG4GenericMode_AACHighBitRate:
 				if (hir->numLengthBits != kMPEG4Generic_AACHBR_SizeLengthDefault) {
-					errprint("sizelength (%ld) != default (%ld)", hir->numLengthBits, kMPEG4Generic_AACHBR_SizeLengthDefault);
+					errprint("sizelength (%d) != default (%d)", hir->numLengthBits, kMPEG4Generic_AACHBR_SizeLengthDefault);
 					err = paramErr;
 				}
 				if (hir->numIndexBits != kMPEG4Generic_AACHBR_IndexLengthDefault) {
-					errprint("indexlength (%ld) != default (%ld)", hir->numIndexBits, kMPEG4Generic_AACHBR_IndexLengthDefault);
+					errprint("indexlength (%d) != default (%d)", hir->numIndexBits, kMPEG4Generic_AACHBR_IndexLengthDefault);
 					err = paramErr;
 				}
 				if (hir->numIndexBits != kMPEG4Generic_AACHBR_IndexDeltaLengthDefault) {
-					errprint("indexdeltalength (%ld) != default (%ld)", hir->numIndexBits, kMPEG4Generic_AACHBR_IndexDeltaLengthDefault);
+					errprint("indexdeltalength (%d) != default (%d)", hir->numIndexBits, kMPEG4Generic_AACHBR_IndexDeltaLengthDefault);
 					err = paramErr;
 				}
 				hir->bytesPerHeader = kMPEGGeneric_AACHBR_OverheadBytesPerFrame;
@@ -1994,7 +1996,7 @@ static SInt32 Chars_To_Num( char *inCharsStart, char *inCharsEnd, Boolean *outFo
 	memcpy(tempString, inCharsStart, length);
 	tempString[length] = '\0';
 
-	sscanf(tempString, "%ld", &value);
+	sscanf(tempString, "%d", &value);
 	found = true;
 
 bail:
@@ -2026,7 +2028,7 @@ static SInt32 Chars_To_hexNum( char *inCharsStart, char *inCharsEnd, Boolean *ou
 	memcpy(tempString, inCharsStart, length);
 	tempString[length] = '\0';
 
-	sscanf(tempString, "%lx", &value);
+	sscanf(tempString, "%x", &value);
 	found = true;
 
 bail:
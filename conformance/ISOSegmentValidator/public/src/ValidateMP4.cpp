@@ -23,10 +23,12 @@ limitations under the License.
 #include <fstream>
 #include <sstream>
 #include <string.h>
+#include <math.h>
 #include "stdio.h"
 #include "stdlib.h"
-#if STAND_ALONE_APP
-	#include "console.h"
+#if defined(_MSC_VER)
+	#include <io.h>
+	#include <fcntl.h>
 #endif
 void myexit(int num)
 {
@@ -40,15 +42,11 @@ void myexit(int num)
 #define myTAB "\t"
 #endif
 
-ValidateGlobals vg = {0};
-FILE *f;		//to print atom content to xml file (later use for xml creation)
+VALIDATE_THREAD_LOCAL ValidateGlobals *vgCurrent = nil;
 
 static int keymatch (const char * arg, const char * keyword, int minchars);
 
-void expandArgv(int srcArgc, const char** srcArgV, int &dstArgc, const char** &dstArgv);   
-
-//#define STAND_ALONE_APP 1  //  #define this if you're using a source level debugger (i.e. Visual C++ in Windows)
-							  //  also, near the beginning of main(), hard-code your arguments (e.g. your test file)
+static int expandArgv(int srcArgc, char** srcArgV, int &dstArgc, char** &dstArgv);   
 
 //==========================================================================================
 
@@ -78,26 +76,32 @@ static int keymatch (const char * arg, const char * keyword, int minchars)
   return true;			/* A-OK */
 }
 
-void writeEntry(char* srcPtr, int &srcIndex, char* &dstPtr, int &dstIndex, int maxArgc)
+int writeEntry(char* srcPtr, int &srcIndex, char* &dstPtr, int &dstIndex, int maxArgc)
 {
     if(dstIndex >= maxArgc)
     {
-        fprintf(stderr,"May number of config arguments %d overshot, exiting!\n",maxArgc);
-        exit(-1);
+        messageprint("May number of config arguments %d overshot, exiting!\n",maxArgc);
+        return -1;
     }
     dstPtr = (char*)(malloc((strlen(srcPtr) + 1) * sizeof(char)));  //allocate memory for each row
+    if(dstPtr == NULL)
+        return allocFailedErr;
     strcpy(dstPtr,srcPtr);
 
     srcIndex++;
     dstIndex++;
-    return;
+    return noErr;
 }
 
-void expandArgv(int srcArgc, char** srcArgV, int &dstArgc, char** &dstArgv)
+// the arguments with the contents of any -configfile in place of it; on failure there are none
+static int expandArgv(int srcArgc, char** srcArgV, int &dstArgc, char** &dstArgv)
 {  
 #define maxArgc 255
 
-  dstArgv= (char**)malloc(sizeof(char*) * maxArgc);		//allocate memory for no. of rows
+  int err = noErr;
+  dstArgv= (char**)calloc(maxArgc + 1, sizeof(char*));		//allocate memory for no. of rows, and the nil after them
+  if(dstArgv == NULL)
+    return allocFailedErr;
   
   int dstIndex = 0;
   
@@ -108,11 +112,12 @@ void expandArgv(int srcArgc, char** srcArgV, int &dstArgc, char** &dstArgv)
     {
         srcIndex++;
         
-        FILE* f = fopen( srcArgV[srcIndex], "r" );          //location of text file to be opened specified by str 
+        FILE* f = (srcIndex < srcArgc) ? fopen( srcArgV[srcIndex], "r" ) : NULL;          //location of text file to be opened specified by str 
         if(f == NULL)
         {
-            fprintf(stderr,"-configfile %s used, file not found, exiting!\n",srcArgV[srcIndex]);
-            exit(-1);
+            messageprint("-configfile %s used, file not found, exiting!\n",(srcIndex < srcArgc) ? srcArgV[srcIndex] : "");
+            err = -1;
+            goto bail;
         }
 
         srcIndex++;
@@ -122,17 +127,24 @@ void expandArgv(int srcArgc, char** srcArgV, int &dstArgc, char** &dstArgv)
         while (fgets( line, 1000, f ))                 //read line from text file
         {
           char * pch;
-          pch = strtok(line,"\n, ");                  //remove \n character and space
-          pch=strtok(pch," ");
+          char * save;
+          pch = strtok_r(line,"\n, ",&save);                  //remove \n character and space
+          if(pch == NULL)
+            continue;                                   //an empty line
+          pch=strtok_r(pch," ",&save);
 
           int dummy;
-          writeEntry(pch,dummy,dstArgv[dstIndex],dstIndex,maxArgc); //Dont change srcIndex any further 
+          err = writeEntry(pch,dummy,dstArgv[dstIndex],dstIndex,maxArgc); //Dont change srcIndex any further 
+          if(err)
+            break;
         }
         
         fclose(f);        
     }
     else
-        writeEntry(srcArgV[srcIndex],srcIndex,dstArgv[dstIndex],dstIndex,maxArgc);
+        err = writeEntry(srcArgV[srcIndex],srcIndex,dstArgv[dstIndex],dstIndex,maxArgc);
+    if(err)
+        goto bail;
 
     if(srcIndex >= srcArgc) //All src args processed
     {
@@ -141,7 +153,99 @@ void expandArgv(int srcArgc, char** srcArgV, int &dstArgc, char** &dstArgv)
     }
   }
   
-  return;
+  return noErr;
+
+bail:
+  for(int i = 0; i < dstIndex; i++)
+    free(dstArgv[i]);
+  free(dstArgv);
+  dstArgv = NULL;
+  dstArgc = 0;
+  return err;
+}
+
+//==========================================================================================
+
+// The output as the command line has it, and the library without callbacks: the report on outFile,
+//   the diagnostics on errFile, each error after a line naming its atom. refcon is the context.
+static void ReportToFile( void *refcon, const char *text, size_t length )
+{
+	fwrite( text, 1, length, ((ValidateGlobals *)refcon)->outFile );
+}
+
+static void DiagnosticToFile( void *refcon, int kind, const char *atomPath, const char *text, size_t length )
+{
+	FILE *errFile = ((ValidateGlobals *)refcon)->errFile;
+	
+	if (kind == kValidateMP4Error)
+		fprintf( errFile, "### error: %s \n###        ", atomPath );
+	fwrite( text, 1, length, errFile );
+}
+
+static void SetOutputToFiles( ValidateGlobals *context )
+{
+	context->output.refcon = context;
+	context->output.report = ReportToFile;
+	context->output.diagnostic = DiagnosticToFile;
+}
+
+// A context starts out empty, as a fresh process would; ValidateMain sets the options from its
+//   arguments. The output goes to the callbacks, or to stdout and stderr if there are none.
+ValidateGlobals *NewValidateContext( const ValidateMP4Callbacks *callbacks )
+{
+	ValidateGlobals *context = (ValidateGlobals *)calloc(1, sizeof(ValidateGlobals));
+	
+	if (context == nil)
+		return nil;
+	context->outFile = stdout;
+	context->errFile = stderr;
+	if (callbacks)
+		context->output = *callbacks;
+	else
+		SetOutputToFiles( context );
+	return context;
+}
+
+// Frees whatever the validation left in the context, then the context
+void DisposeValidateContext( ValidateGlobals *context )
+{
+	ValidateGlobals *previous;
+	
+	if (context == nil)
+		return;
+	previous = SetValidateContext( context );
+	
+	UnmapInputFile();
+	StreamClose();
+	CloseInputSegments();
+	ArenaRelease( &vg.arena );
+	free(vg.payloadRanges);
+	free(vg.segmentSizes);
+	free(vg.segmentEnds);
+	free(vg.simsInStyp);
+	free(vg.psshFoundInSegment);
+	free(vg.tencFoundInSegment);
+	free(vg.dsms);
+	if (vg.controlLeafInfo) {
+		for (unsigned int i = 0; i < vg.numControlTracks; i++)
+			free(vg.controlLeafInfo[i]);
+	}
+	free(vg.controlLeafInfo);
+	free(vg.numControlLeafs);
+	free(vg.trackTypeInfo);
+	free(vg.offsetEntries);
+	
+	SetValidateContext( (previous == context) ? nil : previous );
+	free(context);
+}
+
+// Binds context to the calling thread (vg is then that context); returns the one bound before
+ValidateGlobals *SetValidateContext( ValidateGlobals *context )
+{
+	ValidateGlobals *previous = vgCurrent;
+	
+	vgCurrent = context;
+	return previous;
 }
 
 //==========================================================================================
@@ -152,43 +256,47 @@ void expandArgv(int srcArgc, char** srcArgV, int &dstArgc, char** &dstArgv)
 		arg = arrayArgc[argn]; \
 		if( nil == arg ) \
 		{ \
-			fprintf( stderr, "Expected " _str_err_str_ " got end of args\n" ); \
+			messageprint( "Expected " _str_err_str_ " got end of args\n" ); \
 			err = -1; \
 			goto usageError; \
 		} \
 		if( arg[0] == '-' ) \
 		{ \
-			fprintf( stderr, "Expected " _str_err_str_ " next arg\n" ); \
+			messageprint( "Expected " _str_err_str_ " next arg\n" ); \
+			err = -1; \
+			goto usageError; \
+		} \
+		if( strlen(arg) >= sizeof(*(_str_)) ) \
+		{ \
+			messageprint( "Argument of " _str_err_str_ " is too long\n" ); \
 			err = -1; \
 			goto usageError; \
 		} \
 		strcpy(*(_str_), arg); 
 		
 
-#if !STAND_ALONE_APP
-int main(int argc, char *argv[]);
-int main(int argc, char *argv[])
+// Runs one validation as given by the (command line) arguments, in the context bound to this thread;
+//   the input is vg.inBuffers if there are any (see ValidateMP4Buffers), else the files in the arguments
+int ValidateMain( int argc, char *argv[] )
 {
-#else
-int main(void);
-int main(void)
-{
-	char *argv[] = {
-		"ValidateMP4",
-		"<mpeg4-file-path>"
-		};
-	int argc = sizeof(argv)/sizeof(char*);
-#endif
 	int argn;
 	int gotInputFile = false;
     bool gotSegmentInfoFile = false;
     bool gotleafInfoFile = false;
     bool gotOffsetFile = false;
 	bool logConsole = false;
+	ValidateMP4Callbacks callerOutput = vg.output;
+	FILE *callerOutFile = vg.outFile;
+	FILE *callerErrFile = vg.errFile;
 	int err;
 	char gInputFileFullPath[1024];
 	char leafInfoFileName[1024];
 	char offsetsFileName[1024];
+	char segmentListFileName[1024];
+	bool gotSegmentList = false;
+	char rangeSpec[1024];
+	char **segmentPaths = nil;		// more than one input file: read them as one, in order
+	long numSegmentPaths = 0;
     char sapType[1024];
     char temp[1024];
 	int usedefaultfiletype = true;
@@ -197,6 +305,7 @@ int main(void)
 	atomOffsetEntry aoe = {0};
 
 	vg.warnings = true;
+	vg.numThreads = 1;
 //	vg.qtwarnings = true;
 //	vg.print_atompath = true;
 //	strcpy( vg.atompath, "moov-1:trak-1:mdia-1:minf-1:stbl-1:stsd-1" );
@@ -247,7 +356,8 @@ int main(void)
     int boxCount = 0;
     char ** arrayArgc;
     int uArgc;
-    expandArgv(argc,argv,uArgc,arrayArgc);   
+    err = expandArgv(argc,argv,uArgc,arrayArgc);   
+    if (err) goto bail;
     
 		
 	// Check the parameters
@@ -256,12 +366,23 @@ int main(void)
 		const char *arg = arrayArgc[argn];	     //instead of reading from argv[], now read from array
 		//const char * arg=argv[argn];
 		
-		if( '-' != arg[0] )
+		if( ('-' != arg[0]) || ('\0' == arg[1]) )		// a lone "-" is stdin
 		{
 			char *extensionstartp = nil;
 			
 			if (gotInputFile) {
-				fprintf( stderr, "Unexpected argument \"%s\"\n", arg );
+				if ((strcmp(arg, "-") == 0) || (strcmp(gInputFileFullPath, "-") == 0)) {
+					messageprint( "Unexpected argument \"%s\" (stdin can't be one of several input files)\n", arg );
+					err = -1;
+					goto usageError;
+				}
+				if (numSegmentPaths == 0)
+					BAILIFERR( addSegmentPath( &segmentPaths, &numSegmentPaths, gInputFileFullPath ) );
+				BAILIFERR( addSegmentPath( &segmentPaths, &numSegmentPaths, arg ) );
+				continue;
+			}
+			if (strlen(arg) >= sizeof(gInputFileFullPath)) {
+				messageprint( "Input file name \"%s\" is too long\n", arg );
 				err = -1;
 				goto usageError;
 			}
@@ -300,6 +421,10 @@ int main(void)
 			getNextArgStr( &vg.printtypestr, "printtype" );
         } else if ( keymatch( arg, "infofile", 1 ) ) {
                 getNextArgStr( &vg.segmentOffsetInfo, "infofile" ); gotSegmentInfoFile = true;
+        } else if ( keymatch( arg, "segments", 8 ) ) {
+                getNextArgStr( &segmentListFileName, "segments" ); gotSegmentList = true;
+        } else if ( keymatch( arg, "range", 5 ) ) {
+                getNextArgStr( &rangeSpec, "range" ); vg.useRange = true;
         } else if ( keymatch( arg, "segal", 5 ) ) {
                 vg.checkSegAlignment = true;
         } else if ( keymatch( arg, "ssegal", 6 ) ) {
@@ -357,7 +482,7 @@ int main(void)
                               char * pch;
                               pch = strstr(temp, "/");
                               strncpy (pch," ",1);
-                              puts(temp);
+                              reportprint("%s\n", temp);
                               
                               char * pEnd;
                               vg.framerate = strtof(temp, &pEnd)/strtof(pEnd, NULL);
@@ -394,6 +519,18 @@ int main(void)
 
 		} else if ( keymatch( arg, "atomxml", 1)) {
 			 vg.atomxml = true;
+		} else if ( keymatch( arg, "mmap", 4)) {
+			 vg.useMmap = true;
+		} else if ( keymatch( arg, "stream", 6)) {
+			 vg.streamInput = true;
+		} else if ( keymatch( arg, "headeronly", 6)) {
+			 vg.headerOnly = true;
+		} else if ( keymatch( arg, "threads", 7)) {
+			 getNextArgStr( &temp, "threads" ); vg.numThreads = atoi(temp);
+			 if (vg.numThreads < 0) {
+				messageprint( "Invalid number of threads\n" );
+				goto usageError;
+			 }
 		} else if ( keymatch( arg, "cmaf", 1)) {
 			 vg.cmaf = true;
 		} else if ( keymatch( arg, "dvb", 1)) {
@@ -401,7 +538,7 @@ int main(void)
                 } else if ( keymatch( arg, "hbbtv", 1)) {
                          vg.hbbtv = true;
                 } else {
-			fprintf( stderr, "Unexpected option \"%s\"\n", arg);
+			messageprint( "Unexpected option \"%s\"\n", arg);
 			err = -1;
 			goto usageError;
 		}
@@ -417,7 +554,7 @@ int main(void)
 	free(arrayArgc);
 	
 	
-	if (vg.indexRange!='\0')
+	if (vg.indexRange[0]!='\0')
 	  sscanf (vg.indexRange,"%d-%d",&vg.lowerindexRange,&vg.higherindexRange);
 	
 
@@ -426,13 +563,19 @@ int main(void)
 
 	if (logConsole)
 	{
-		FILE * tempfp = freopen("stdout.txt", "w", stdout);
+		// to the files instead of the callbacks
+		FILE * tempfp = OpenOutputFile("stdout.txt", "w");
 		if (tempfp == NULL)
-			fprintf(stderr, "Error creating redirect file stdout.txt!\n");
+			messageprint("Error creating redirect file stdout.txt!\n");
+		else
+			vg.outFile = tempfp;
 
-		tempfp = freopen("stderr.txt", "w", stderr);
+		tempfp = OpenOutputFile("stderr.txt", "w");
 		if (tempfp == NULL)
-			fprintf(stderr, "Error creating redirect file stderr.txt!\n");
+			messageprint("Error creating redirect file stderr.txt!\n");
+		else
+			vg.errFile = tempfp;
+		SetOutputToFiles( vgCurrent );
 	}
 	
 	if ((usedefaultfiletype && (vg.filetypestr[0] == 0)) ||				// default to mp4
@@ -441,7 +584,7 @@ int main(void)
 	} else if (strcmp(vg.filetypestr, "mp4v") == 0) {
 		vg.filetype = filetype_mp4v;
 	} else if (vg.filetype == 0) {
-		fprintf( stderr, "Invalid filetype\n" );
+		messageprint( "Invalid filetype\n" );
 		err = -1;
 		goto usageError;
 	}
@@ -451,9 +594,48 @@ int main(void)
 	} else {
 		vg.checklevel = atoi(vg.checklevelstr);
 		if (vg.checklevel < 1) {
-			fprintf( stderr, "Invalid check level\n" );
+			messageprint( "Invalid check level\n" );
+			goto usageError;
+		}
+	}
+	if (vg.headerOnly) {
+		if (vg.filetype == filetype_mp4v) {
+			messageprint( "-headeronly needs a file made of boxes, not an elementary stream\n" );
+			goto usageError;
+		}
+		if (vg.checklevel >= checklevel_samples) {
+			messageprint( "-headeronly: samples are not read, checking at level %d instead of %ld\n", checklevel_samples - 1, vg.checklevel );
+			vg.checklevel = checklevel_samples - 1;
+		}
+	}
+
+	if (vg.useRange) {
+		// start-end in seconds of media time, or seg:first-last (or seg:number) in media segments
+		char *spec = rangeSpec;
+		int n;
+		
+		vg.rangeBySegment = (strncmp(spec, "seg:", 4) == 0);
+		if (vg.rangeBySegment)
+			spec += 4;
+		n = sscanf(spec, "%lf-%lf", &vg.rangeStart, &vg.rangeEnd);
+		if ((n == 1) && vg.rangeBySegment)
+			vg.rangeEnd = vg.rangeStart;
+		else if (n != 2)
+			vg.rangeStart = vg.rangeEnd = -1;
+		if ((vg.rangeStart < 0) || (vg.rangeEnd < vg.rangeStart) || (vg.rangeBySegment && (vg.rangeStart < 1))) {
+			messageprint( "Invalid -range \"%s\"\n", rangeSpec );
+			err = -1;
+			goto usageError;
+		}
+		if (vg.filetype == filetype_mp4v || vg.streamInput || gotOffsetFile) {
+			messageprint( "-range needs a seekable file made of boxes, and can't be combined with -offsetinfo\n" );
+			err = -1;
 			goto usageError;
 		}
+		if (vg.useMmap) {
+			messageprint( "-mmap does not apply to -range, reading the input through stdio\n" );
+			vg.useMmap = false;
+		}
 	}
 
 	if (vg.printtypestr[0] == 0) {
@@ -461,9 +643,10 @@ int main(void)
 	} else {
 		char instr[256];
 		char *tokstr;
+		char *save;
 
 		strcpy(instr, vg.printtypestr);
-		tokstr = strtok(instr,"+");
+		tokstr = strtok_r(instr,"+",&save);
 		while (tokstr) {
 			if        (keymatch(tokstr, "atompath", 5)) {
 				vg.print_atompath = true;
@@ -477,22 +660,28 @@ int main(void)
 				vg.print_sample = true;
 			} else if (keymatch(tokstr, "hintpayload", 1)) {
 				vg.print_hintpayload = true;
+			} else if (keymatch(tokstr, "memory", 6)) {
+				vg.print_memory = true;
+			} else if (keymatch(tokstr, "timing", 6)) {
+				vg.print_timing = true;
+			} else if (keymatch(tokstr, "stats", 5)) {
+				vg.print_stats = true;
 			} else {
-				fprintf( stderr, "Invalid print type option\n" );
+				messageprint( "Invalid print type option\n" );
 				goto usageError;
 			}
-			tokstr = strtok(nil,"+");
+			tokstr = strtok_r(nil,"+",&save);
 		}
 	}
 
     if((vg.minBufferTime == -1) != (vg.bandwidth == -1))
     {
-        fprintf( stderr, "minBufferTime and bandwidth must be provided together as options!\n" );
+        messageprint( "minBufferTime and bandwidth must be provided together as options!\n" );
         goto usageError;
     }
     if((vg.width == 0) != (vg.height == 0))
     {
-        fprintf( stderr, "width and height must be provided together as options!\n" );
+        messageprint( "width and height must be provided together as options!\n" );
         goto usageError;
     }
 
@@ -502,39 +691,113 @@ int main(void)
 		vg.samplenumber = atoi(vg.samplenumberstr);
 		if (vg.samplenumber < 1) goto usageError;
 	}
+	if (vg.numThreads == 0)			// one per processor
+		vg.numThreads = ValidateProcessorCount();
 
 	//=====================
 
+	if (gotSegmentList) {
+		if (gotInputFile) {
+			err = -1;
+			messageprint( "Give either -segments or the input file(s), not both\n" );
+			goto usageError;
+		}
+		if (loadSegmentList( segmentListFileName, &segmentPaths, &numSegmentPaths ) != noErr) {
+			err = -1;
+			goto usageError;
+		}
+		snprintf(gInputFileFullPath, sizeof(gInputFileFullPath), "%s", segmentListFileName);
+		gotInputFile = true;
+	}
+
+	if (vg.numInBuffers > 0) {
+		if (gotInputFile) {
+			err = -1;
+			messageprint( "Give either the input buffers or input files, not both\n" );
+			goto usageError;
+		}
+		strcpy(gInputFileFullPath, "(buffer)");
+		gotInputFile = true;
+	}
+
 	if (!gotInputFile) {
 		err = -1;
-		fprintf( stderr, "No input file specified\n" );
+		messageprint( "No input file specified\n" );
 		goto usageError;
 	}
 
-    infile = fopen(gInputFileFullPath, "rb");
-	if (!infile) {
+	if (vg.numInBuffers > 0) {
+		// read through the segmented input, with the buffers as its segments; see ValidateFileIO.cpp
+		if (vg.streamInput || vg.useMmap) {
+			messageprint( "-stream and -mmap don't apply to input buffers\n" );
+			vg.streamInput = vg.useMmap = false;
+		}
+		if (gotSegmentInfoFile && (vg.numInBuffers > 1)) {
+			messageprint( "-infofile is not needed with several input buffers, using the sizes of the buffers themselves\n" );
+			gotSegmentInfoFile = false;
+		}
+		err = OpenInputBuffers( vg.inBuffers, vg.numInBuffers );
+		if (err) goto bail;
+	} else if (numSegmentPaths > 0) {
+		// the segments themselves are opened (a few at a time) by the segmented input; see ValidateFileIO.cpp
+		if (vg.streamInput || vg.useMmap) {
+			messageprint( "-stream and -mmap don't apply to a list of segment files, reading them through stdio\n" );
+			vg.streamInput = vg.useMmap = false;
+		}
+		if (gotSegmentInfoFile) {
+			messageprint( "-infofile is not needed with a list of segment files, using the sizes of the files themselves\n" );
+			gotSegmentInfoFile = false;
+		}
+		err = OpenInputSegments( segmentPaths, numSegmentPaths );
+		if (err) goto bail;
+	} else if (strcmp(gInputFileFullPath, "-") == 0) {
+		infile = stdin;
+		vg.streamInput = true;
+#if defined(_MSC_VER)
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+	} else
+		infile = fopen(gInputFileFullPath, "rb");
+	if (!infile && (vg.numInSegments == 0)) {
 		err = -1;
-		fprintf( stderr, "Could not open input file \"%s\"\n", gInputFileFullPath );
+		messageprint( "Could not open input file \"%s\"\n", gInputFileFullPath );
 		goto usageError;
 	}
 
-	fprintf(stdout,"\n\n\n<!-- Source file is '%s' -->\n", gInputFileFullPath);
+	reportprint("\n\n\n<!-- Source file is '%s' -->\n", gInputFileFullPath);
 	
 	if(vg.atomxml){
-		f = fopen("atominfo.xml", "w");
+		vg.atomXmlFile = OpenOutputFile("atominfo.xml", "w");
+		if (vg.atomXmlFile == nil) {
+			messageprint( "Could not create atominfo.xml\n" );
+			vg.atomxml = false;
+		}
 	}
 
-	if (gotOffsetFile)
-		loadOffsetInfo(offsetsFileName);
+	if (gotOffsetFile) {
+		err = loadOffsetInfo(offsetsFileName);
+		if (err) goto bail;
+	}
 
 	vg.inFile = infile;
 	vg.inOffset = 0;
-	err = fseek(infile, 0, SEEK_END);
-	if (err) goto bail;
-	vg.inMaxOffset = inflateOffset(ftell(infile));
-	if (vg.inMaxOffset < 0) {
-		err = vg.inMaxOffset;
-		goto bail;
+	if (vg.streamInput) {
+		// can't seek, so we don't know how big it is until we've read it all; see ValidateStreamedFileAtoms
+		vg.inMaxOffset = kStreamUnknownFileSize;
+	} else if (vg.numInSegments) {
+		InputSegment *last = &vg.inSegments[vg.numInSegments - 1];
+		
+		vg.inMaxOffset = inflateOffset(last->offset + last->size);
+	} else {
+		if (vg.useMmap && MapInputFile(infile) != noErr)
+			messageprint( "Could not map input file \"%s\", reading it through stdio instead\n", gInputFileFullPath );
+		err = fseek64(infile, 0, SEEK_END);
+		if (err) goto bail;
+		vg.inMaxOffset = inflateOffset(ftell64(infile));
+		if (vg.inMaxOffset < 0) {
+			err = vg.inMaxOffset;
+			goto bail;
+		}
 	}
 
 	aoe.type = 'file';
@@ -545,82 +808,94 @@ int main(void)
 	
 	vg.fileaoe = &aoe;		// used when you need to read file & size from the file
 	
-    if(gotSegmentInfoFile)
+    if((numSegmentPaths > 0) || (vg.numInBuffers > 1))
     {
-        int numSegments = 0;
-        
-        for(int ii = 0 ; ii < 2 ; ii++)
-        {
-            FILE *segmentOffsetInfoFile = fopen(vg.segmentOffsetInfo, "rb");
-        	if (!segmentOffsetInfoFile) {
-        		err = -1;
-        		fprintf( stderr, "Could not open segment info file \"%s\"\n", vg.segmentOffsetInfo );
-        		goto usageError;
-        	}
-
-            if(ii == 1)
-            {
-                vg.segmentSizes = (UInt64 *)malloc(sizeof(UInt64)*numSegments);
-                vg.segmentInfoSize = numSegments;
-                vg.simsInStyp = (bool *)malloc(sizeof(bool)*numSegments);
-                vg.psshFoundInSegment = (bool *)malloc(sizeof(bool)*numSegments);
-                vg.tencFoundInSegment = (bool *)malloc(sizeof(bool)*numSegments);
-                vg.dsms = (bool *)malloc(sizeof(bool)*numSegments);
-            }
+        // one segment per input file (or buffer); the first is an initialization segment if it has the moov
+        allocSegmentInfo(vg.numInSegments);
+        for(long ii = 0 ; ii < vg.numInSegments ; ii++)
+            vg.segmentSizes[ii] = vg.inSegments[ii].size;
+        vg.initializationSegment = InputSegmentHasAtom(0, 'moov');
+        vg.dashSegment = true;
+    }
+    else if(gotSegmentInfoFile)
+    {
+        FILE *segmentOffsetInfoFile = fopen(vg.segmentOffsetInfo, "rb");
+        UInt64 *sizes = nil;
+        long numSegments = 0, maxSegments = 0;
+        int firstIndex = 0;
+
+        if (!segmentOffsetInfoFile) {
+            err = -1;
+            messageprint( "Could not open segment info file \"%s\"\n", vg.segmentOffsetInfo );
+            goto usageError;
+        }
 
-            numSegments = 0;
+        while(1)
+        {
+            int temp1;
+            UInt64 temp2;
+            int ret = fscanf(segmentOffsetInfoFile,"%d %llu\n",&temp1,&temp2);
+            if(ret < 2)
+                break;
 
-            while(1)
+            if(numSegments == maxSegments)
             {
-                int temp1;
-                UInt64 temp2;
-                int ret = fscanf(segmentOffsetInfoFile,"%d %lld\n",&temp1,&temp2);
-                if(ret < 2)
-                    break;
-                
-                if(ii == 1)
-                {
-                    vg.segmentSizes[numSegments] = temp2;
-                    vg.simsInStyp[numSegments] = false;
-                    vg.psshFoundInSegment[numSegments] = false;
-                    vg.tencFoundInSegment[numSegments] = false;
-                    vg.dsms[numSegments] = false;
-                }
-                numSegments++;
-                if(numSegments == 1 && temp1 > 0)
-                    vg.initializationSegment=false;
-                else
-                    vg.initializationSegment=true;
-                
+                maxSegments = maxSegments ? 2*maxSegments : 64;
+                sizes = (UInt64 *)realloc(sizes, sizeof(UInt64)*maxSegments);
             }
-
             if(numSegments == 0)
-                {
-                    err = -1;
-                    fprintf( stderr, "Empty segment info file \"%s\"\n", vg.segmentOffsetInfo );
-                    goto usageError;
-                }
+                firstIndex = temp1;
+            sizes[numSegments++] = temp2;
+        }
+        fclose(segmentOffsetInfoFile);
 
-            fclose(segmentOffsetInfoFile);
+        if(numSegments == 0)
+        {
+            err = -1;
+            messageprint( "Empty segment info file \"%s\"\n", vg.segmentOffsetInfo );
+            goto usageError;
         }
+
+        allocSegmentInfo(numSegments);
+        memcpy(vg.segmentSizes, sizes, sizeof(UInt64)*numSegments);
+        free(sizes);
+        // Assemble numbers the segments from 0 when the first one is an initialization segment, from 1 otherwise
+        vg.initializationSegment = (firstIndex == 0);
         vg.dashSegment = true;    //Either this, or for non-segmented file = self-intializing segment, brand DASH shall be in ftyp, or use another dash-specific brand to initialize this
     }
     else
     {
-        vg.segmentSizes = (UInt64 *)malloc(sizeof(UInt64)*1);
-        vg.segmentInfoSize = 1;
+        allocSegmentInfo(1);
         vg.initializationSegment=false;
         vg.segmentSizes[0] = aoe.size;
-        vg.simsInStyp = (bool *)malloc(sizeof(bool)*1);
-        vg.simsInStyp[0] = false;
-        vg.psshFoundInSegment = (bool *)malloc(sizeof(bool)*1);
-        vg.psshFoundInSegment[0] = false;
-        vg.tencFoundInSegment = (bool *)malloc(sizeof(bool)*1);
-        vg.tencFoundInSegment[0] = false;
-        vg.dsms = (bool *)malloc(sizeof(bool)*1);
-        vg.dsms[0] = false;
         vg.dashSegment = false;
     }
+
+    if(vg.useRange)
+    {
+        // read through the segmented input from here on; it is cut down to the window
+        if(vg.numInSegments == 0)
+        {
+            char *inputPath = gInputFileFullPath;
+
+            err = OpenInputSegments( &inputPath, 1 );
+            if (err) goto bail;
+        }
+        err = SelectInputRange();
+        if (err) goto bail;
+
+        vg.inMaxOffset = vg.inSegments[vg.numInSegments - 1].offset + vg.inSegments[vg.numInSegments - 1].size;
+        aoe.size = aoe.maxOffset = vg.inMaxOffset;
+        if(vg.dashSegment)
+        {
+            allocSegmentInfo(vg.numInSegments);
+            for(long ii = 0 ; ii < vg.numInSegments ; ii++)
+                vg.segmentSizes[ii] = vg.inSegments[ii].size;
+        }
+        else
+            vg.segmentSizes[0] = aoe.size;
+    }
+    updateSegmentMap();
     
     vg.psshInInit = false;
     vg.tencInInit = false;
@@ -633,7 +908,7 @@ int main(void)
             loadLeafInfo(leafInfoFileName);
         else
         {
-            printf("Segment/Subsegment alignment check request, leaf info file not found!\n");
+            reportprint("Segment/Subsegment alignment check request, leaf info file not found!\n");
             vg.checkSegAlignment = vg.checkSubSegAlignment = false;
         }
     }
@@ -642,7 +917,9 @@ int main(void)
 		err = ValidateElementaryVideoStream( &aoe, nil );
 	} else {
 		err = ValidateFileAtoms( &aoe, nil );
-		fprintf(stdout,"<!#- Finished testing file '%s' -->\n", gInputFileFullPath);
+		if (vg.headerOnly)
+			reportprint("<!-- Header-only: read %llu of the %llu bytes in the file -->\n", vg.bytesRead, aoe.size);
+		reportprint("<!#- Finished testing file '%s' -->\n", gInputFileFullPath);
 	}
     
 	goto bail;
@@ -650,75 +927,101 @@ int main(void)
 	//=====================
 
 usageError:
-	fprintf( stderr, "Usage: %s [-filetype <type>] "
-								"[-printtype <options>] [-checklevel <level>] [-infofile <Segment Info File>] [-leafinfo <Leaf Info File>] [-segal] [-ssegal] [-startwithsap TYPE] [-level] [-bss] [-isolive] [-isoondemand] [-isomain] [-dynamic] [-dash264base] [-dashifbase] [-dash264enc] [-repIndex] [-atomxml] [-cmaf] [-dvb] [-hbbtv]", "ValidateMP4" );
-	fprintf( stderr, " [-samplenumber <number>] [-verbose <options>] [-offsetinfo <Offset Info File>] [-logconsole ] [-help] inputfile\n" );
-	fprintf( stderr, "    -a[tompath]      <atompath> - limit certain operations to <atompath> (e.g. moov-1:trak-2)\n" );
-	fprintf( stderr, "                     this effects -checklevel and -printtype (default is everything) \n" );
-	fprintf( stderr, "    -p[rinttype]     <options> - controls output (combine options with +) \n" );
-	fprintf( stderr, "                     atompath - output the atompath for each atom \n" );
-	fprintf( stderr, "                     atom - output the contents of each atom \n" );
-	fprintf( stderr, "                     fulltable - output those long tables (e.g. samplesize tables)  \n" );
-	fprintf( stderr, "                     sample - output the samples as well \n" );
-	fprintf( stderr, "                                 (depending on the track type, this is the same as sampleraw) \n" );
-	fprintf( stderr, "                     sampleraw - output the samples in raw form \n" );
-	fprintf( stderr, "                     hintpayload - output payload for hint tracks \n" );
-	fprintf( stderr, "    -c[hecklevel]    <level> - increase the amount of checking performed \n" );
-	fprintf( stderr, "                     1: check the moov container (default -atompath is ignored) \n" );
-	fprintf( stderr, "                     2: check the samples \n" );
-	fprintf( stderr, "                     3: check the payload of hint track samples \n" );
-	fprintf( stderr, "    -infofile        <Segment Info File> - Offset file generated by assembler \n" );
-	fprintf( stderr, "    -leafinfo         <Leaf Info File> - Information file generated by this software (named leafinfo.txt) for another representation, provided to run for cross-checks of alignment\n" );
-	fprintf( stderr, "    -segal  -         Check Segment alignment based on <Leaf Info File>\n" );
-	fprintf( stderr, "    -ssegal -         Check Subegment alignment based on <Leaf Info File>\n" );
-	fprintf( stderr, "    -bandwidth        For checking @bandwidth/@minBufferTime\n" );
-	fprintf( stderr, "    -minbuffertime    For checking @bandwidth/@minBufferTime\n" );
-	fprintf( stderr, "    -width            For checking width\n" );
-	fprintf( stderr, "    -height           For checking height\n" );
-	fprintf( stderr, "    -sbw              Suggest a good @bandwidth if the one provided is non-conforming\n" );
-	fprintf( stderr, "    -isolive          Make checks specific for media segments conforming to ISO Base media file format live profile\n" );
-	fprintf( stderr, "    -isoondemand      Make checks specific for media segments conforming to ISO Base media file format On Demand profile\n" );
-	fprintf( stderr, "    -isomain          Make checks specific for media segments conforming to ISO Base media file format main profile\n" );
-	fprintf( stderr, "    -dynamic          MPD type=dynamic\n" );
-	fprintf( stderr, "    -startwithsap     Check for a specific SAP type as announced in the MPD\n" );
-	fprintf( stderr, "    -level            SubRepresentation@level checks\n" );
-	fprintf( stderr, "    -bss              Make checks specific for bitstream switching\n" );
-	fprintf( stderr, "    -dash264base      Make checks specific for DASH264 Base IOP\n" );
-	fprintf( stderr, "    -dashifbase      Make checks specific for DASHIF Base IOP\n" );
-	fprintf( stderr, "    -dash264enc       Make checks specific for encrypted DASH264 content\n" );
-	fprintf( stderr, "    -repIndex         Make checks specific for @RepresentationIndex");
-	fprintf( stderr, "    -indexrange       Byte range where sidx is expected\n");
-	fprintf( stderr, "    -width            Expected width of the video track\n");
-	fprintf( stderr, "    -height           Expected height of the video track\n");
-        fprintf( stderr, "    -framerate        Expected framerate of the video track\n");
-        fprintf( stderr, "    -codecprofile     Expected codec profile of the video track\n");
-        fprintf( stderr, "    -codectier        Expected codec tier of the video track\n");
-        fprintf( stderr, "    -codeclevel       Expected codec level of the video track\n");
-	fprintf( stderr, "    -default_kid      Expected default_KID for the mp4 content protection\n");
-	fprintf( stderr, "    -s[amplenumber]   <number> - limit sample checking or printing operations to sample <number> \n" );
-	fprintf( stderr, "                      most effective in combination with -atompath (default is all samples) \n" );
-	fprintf( stderr, "    -offsetinfo       <Offset Info File> - Partial file optimization information file: if the file has several byte ranges removed, this file provides the information as offset-bytes removed pairs\n");
-	fprintf( stderr, "    -logconsole       Redirect stdout and stderr to stdout.txt and stderr.txt, respectively \n");
-	fprintf( stderr, "    -atomxml          Output the contents of each atom into an xml \n" );
-	fprintf( stderr, "    -cmaf             Check for CMAF conformance \n" );
-        fprintf( stderr, "    -dvb              Check for DVB conformance \n" );
-        fprintf( stderr, "    -hbbtv            Check for HbbTV conformance \n" );
-	fprintf( stderr, "    -h[elp] - print this usage message \n" );
+	err = -1;		// not all the ways here set it
+	messageprint( "Usage: %s [-filetype <type>] "
+								"[-printtype <options>] [-checklevel <level>] [-infofile <Segment Info File>] [-leafinfo <Leaf Info File>] [-segal] [-ssegal] [-startwithsap TYPE] [-level] [-bss] [-isolive] [-isoondemand] [-isomain] [-dynamic] [-dash264base] [-dashifbase] [-dash264enc] [-repIndex] [-atomxml] [-mmap] [-stream] [-headeronly] [-threads <number>] [-cmaf] [-dvb] [-hbbtv]", "ValidateMP4" );
+	messageprint( " [-samplenumber <number>] [-verbose <options>] [-offsetinfo <Offset Info File>] [-segments <Segment List File>] [-range <start>-<end>|seg:<first>-<last>] [-logconsole ] [-help] inputfile ...|-\n" );
+	messageprint( "    inputfile ...    several input files are validated as one, as if concatenated in the order given \n" );
+	messageprint( "                     (e.g. the initialization segment and then the media segments of a Representation) \n" );
+	messageprint( "    -a[tompath]      <atompath> - limit certain operations to <atompath> (e.g. moov-1:trak-2)\n" );
+	messageprint( "                     this effects -checklevel and -printtype (default is everything) \n" );
+	messageprint( "    -p[rinttype]     <options> - controls output (combine options with +) \n" );
+	messageprint( "                     atompath - output the atompath for each atom \n" );
+	messageprint( "                     atom - output the contents of each atom \n" );
+	messageprint( "                     fulltable - output those long tables (e.g. samplesize tables)  \n" );
+	messageprint( "                     sample - output the samples as well \n" );
+	messageprint( "                                 (depending on the track type, this is the same as sampleraw) \n" );
+	messageprint( "                     sampleraw - output the samples in raw form \n" );
+	messageprint( "                     hintpayload - output payload for hint tracks \n" );
+	messageprint( "                     memory - report the memory held for the parsed movie state \n" );
+	messageprint( "                     timing - report the time spent in each post-processing check \n" );
+	messageprint( "                     stats - report how the sample data was read (this depends on the input, e.g. -mmap) \n" );
+	messageprint( "    -c[hecklevel]    <level> - increase the amount of checking performed \n" );
+	messageprint( "                     1: check the moov container (default -atompath is ignored) \n" );
+	messageprint( "                     2: check the samples \n" );
+	messageprint( "                     3: check the payload of hint track samples \n" );
+	messageprint( "    -infofile        <Segment Info File> - Offset file generated by assembler \n" );
+	messageprint( "    -segments        <Segment List File> - validate the files listed in it (one path per line) as one input, instead of assembling them first \n" );
+	messageprint( "    -range           <start>-<end> - only validate the media segments (or subsegments of a top-level sidx, or movie fragments) \n" );
+	messageprint( "                     overlapping media time <start> to <end> seconds, plus the initialization segment; \n" );
+	messageprint( "                     seg:<first>-<last> picks them by number instead (counting from 1, not counting the initialization segment) \n" );
+	messageprint( "    -leafinfo         <Leaf Info File> - Information file generated by this software (named leafinfo.txt) for another representation, provided to run for cross-checks of alignment\n" );
+	messageprint( "    -segal  -         Check Segment alignment based on <Leaf Info File>\n" );
+	messageprint( "    -ssegal -         Check Subegment alignment based on <Leaf Info File>\n" );
+	messageprint( "    -bandwidth        For checking @bandwidth/@minBufferTime\n" );
+	messageprint( "    -minbuffertime    For checking @bandwidth/@minBufferTime\n" );
+	messageprint( "    -width            For checking width\n" );
+	messageprint( "    -height           For checking height\n" );
+	messageprint( "    -sbw              Suggest a good @bandwidth if the one provided is non-conforming\n" );
+	messageprint( "    -isolive          Make checks specific for media segments conforming to ISO Base media file format live profile\n" );
+	messageprint( "    -isoondemand      Make checks specific for media segments conforming to ISO Base media file format On Demand profile\n" );
+	messageprint( "    -isomain          Make checks specific for media segments conforming to ISO Base media file format main profile\n" );
+	messageprint( "    -dynamic          MPD type=dynamic\n" );
+	messageprint( "    -startwithsap     Check for a specific SAP type as announced in the MPD\n" );
+	messageprint( "    -level            SubRepresentation@level checks\n" );
+	messageprint( "    -bss              Make checks specific for bitstream switching\n" );
+	messageprint( "    -dash264base      Make checks specific for DASH264 Base IOP\n" );
+	messageprint( "    -dashifbase      Make checks specific for DASHIF Base IOP\n" );
+	messageprint( "    -dash264enc       Make checks specific for encrypted DASH264 content\n" );
+	messageprint( "    -repIndex         Make checks specific for @RepresentationIndex");
+	messageprint( "    -indexrange       Byte range where sidx is expected\n");
+	messageprint( "    -width            Expected width of the video track\n");
+	messageprint( "    -height           Expected height of the video track\n");
+        messageprint( "    -framerate        Expected framerate of the video track\n");
+        messageprint( "    -codecprofile     Expected codec profile of the video track\n");
+        messageprint( "    -codectier        Expected codec tier of the video track\n");
+        messageprint( "    -codeclevel       Expected codec level of the video track\n");
+	messageprint( "    -default_kid      Expected default_KID for the mp4 content protection\n");
+	messageprint( "    -s[amplenumber]   <number> - limit sample checking or printing operations to sample <number> \n" );
+	messageprint( "                      most effective in combination with -atompath (default is all samples) \n" );
+	messageprint( "    -offsetinfo       <Offset Info File> - Partial file optimization information file: if the file has several byte ranges removed, this file provides the information as offset-bytes removed pairs\n");
+	messageprint( "    -logconsole       Redirect stdout and stderr to stdout.txt and stderr.txt, respectively \n");
+	messageprint( "    -atomxml          Output the contents of each atom into an xml \n" );
+	messageprint( "    -mmap             Read the input file through a memory mapping instead of stdio \n" );
+	messageprint( "    -stream           Read the input front to back without seeking (for pipes and FIFOs); implied when inputfile is - (stdin) \n" );
+	messageprint( "    -headeronly       Check the box structure only, never reading media data (implies -checklevel 1); reports how much of the file was read \n" );
+	messageprint( "    -threads          <number> - validate the samples (-checklevel 2) on this many threads; the output is the same (default is 1, 0 is one per processor) \n" );
+	messageprint( "    -cmaf             Check for CMAF conformance \n" );
+        messageprint( "    -dvb              Check for DVB conformance \n" );
+        messageprint( "    -hbbtv            Check for HbbTV conformance \n" );
+	messageprint( "    -h[elp] - print this usage message \n" );
 
 
 	//=====================
 
 bail:
-	if (infile) {
+	UnmapInputFile();
+	StreamClose();
+	CloseInputSegments();
+	for (long i = 0; i < numSegmentPaths; i++)
+		free(segmentPaths[i]);
+	free(segmentPaths);
+	if (infile && (infile != stdin)) {
 		fclose(infile);
 	}
 	if (logConsole)
 	{
-		fclose(stdout);
-		fclose(stderr);
+		if (vg.outFile != callerOutFile)
+			fclose(vg.outFile);
+		if (vg.errFile != callerErrFile)
+			fclose(vg.errFile);
+		vg.outFile = callerOutFile;
+		vg.errFile = callerErrFile;
+		vg.output = callerOutput;
 	}
 	if(vg.atomxml){
-		fclose(f);
+		fclose(vg.atomXmlFile);
+		vg.atomXmlFile = nil;
 	}
 
 	return err;
@@ -729,13 +1032,13 @@ void loadLeafInfo(char *leafInfoFileName)
     FILE *leafInfoFile = fopen(leafInfoFileName,"rt");
     if(leafInfoFile == NULL)
     {
-        printf("Leaf info file %s not found, alignment wont be checked!\n",leafInfoFileName);
+        reportprint("Leaf info file %s not found, alignment wont be checked!\n",leafInfoFileName);
         vg.checkSegAlignment = vg.checkSubSegAlignment = false;
         vg.bss = false;
         return;
     }
     
-    fscanf(leafInfoFile,"%lu\n",&vg.accessUnitDurationNonIndexedTrack);
+    fscanf(leafInfoFile,"%u\n",&vg.accessUnitDurationNonIndexedTrack);
     
     fscanf(leafInfoFile,"%u\n",&vg.numControlTracks);
     
@@ -745,7 +1048,7 @@ void loadLeafInfo(char *leafInfoFileName)
 
     for(unsigned int i = 0 ; i < vg.numControlTracks ; i++)
     {
-        fscanf(leafInfoFile,"%lu %lu\n",&vg.trackTypeInfo[i].track_ID,&vg.trackTypeInfo[i].componentSubType);
+        fscanf(leafInfoFile,"%u %u\n",&vg.trackTypeInfo[i].track_ID,&vg.trackTypeInfo[i].componentSubType);
     }
     
     for(unsigned int i = 0 ; i < vg.numControlTracks ; i++)
@@ -755,20 +1058,29 @@ void loadLeafInfo(char *leafInfoFileName)
         vg.controlLeafInfo[i] = (LeafInfo *)malloc(vg.numControlLeafs[i]*sizeof(LeafInfo));
         
         for(UInt32 j = 0 ; j < vg.numControlLeafs[i] ; j++)
-            fscanf(leafInfoFile,"%d %Lf %Lf\n",(int *)&vg.controlLeafInfo[i][j].firstInSegment,&vg.controlLeafInfo[i][j].earliestPresentationTime,&vg.controlLeafInfo[i][j].lastPresentationTime);
+        {
+            int firstInSegment = 0;
+            long double earliestPresentationTime = 0, lastPresentationTime = 0;
+
+            fscanf(leafInfoFile,"%d %Lf %Lf\n",&firstInSegment,&earliestPresentationTime,&lastPresentationTime);
+            vg.controlLeafInfo[i][j].firstInSegment = firstInSegment != 0;
+            vg.controlLeafInfo[i][j].earliestPresentationTime = MediaTimeMake((SInt64)roundl(earliestPresentationTime*kLeafInfoTimescale),kLeafInfoTimescale);
+            vg.controlLeafInfo[i][j].lastPresentationTime = MediaTimeMake((SInt64)roundl(lastPresentationTime*kLeafInfoTimescale),kLeafInfoTimescale);
+        }
             
     }
 
     fclose(leafInfoFile);
 }
 
-void loadOffsetInfo(char *offsetsFileName)
+int loadOffsetInfo(char *offsetsFileName)
 {
+    int err = noErr;
     FILE *offsetsFile = fopen(offsetsFileName,"rt");
     if(offsetsFile == NULL)
     {
-        printf("Offset info file %s not found, exiting!\n",offsetsFileName);
-        exit(-1);
+        reportprint("Offset info file %s not found, exiting!\n",offsetsFileName);
+        return -1;
     }
 
 	int numEntries = 0;
@@ -779,8 +1091,9 @@ void loadOffsetInfo(char *offsetsFileName)
         int ret = fscanf(offsetsFile,"%llu %llu\n",&dummy1,&dummy2);
         if(ret > 2)
         {
-            printf("%d entries found on entry number %d, improper offset info file, exiting!\n",ret,numEntries+1);
-            exit(-1);
+            reportprint("%d entries found on entry number %d, improper offset info file, exiting!\n",ret,numEntries+1);
+            err = -1;
+            goto bail;
         }
         if(ret < 2)
             break;
@@ -789,16 +1102,18 @@ void loadOffsetInfo(char *offsetsFileName)
     
     if(numEntries == 0)
     {
-        printf("No valid entries found in offset info file, exiting!\n");
-        exit(-1);
+        reportprint("No valid entries found in offset info file, exiting!\n");
+        err = -1;
+        goto bail;
     }
     vg.numOffsetEntries = numEntries;
 
     vg.offsetEntries = (OffsetInfo *)malloc(vg.numOffsetEntries*sizeof(OffsetInfo));
     if(vg.offsetEntries == NULL)
     {
-        printf("Failure to allocate %d offset entries, exiting!\n",vg.numOffsetEntries);
-        exit(-1);
+        reportprint("Failure to allocate %d offset entries, exiting!\n",vg.numOffsetEntries);
+        err = allocFailedErr;
+        goto bail;
     }
 
 	rewind(offsetsFile);
@@ -806,23 +1121,136 @@ void loadOffsetInfo(char *offsetsFileName)
     for(unsigned int index = 0 ; index < vg.numOffsetEntries ; index ++)
     {
         fscanf(offsetsFile,"%llu %llu\n",&vg.offsetEntries[index].offset,&vg.offsetEntries[index].sizeRemoved);
-		index = index;
+
+        // the offset translation (see ValidateFileIO.cpp) needs them in order and not overlapping
+        if(index > 0 && vg.offsetEntries[index].offset < vg.offsetEntries[index-1].offset + vg.offsetEntries[index-1].sizeRemoved)
+        {
+            reportprint("Offset info entry number %d overlaps or comes before the previous one, improper offset info file, exiting!\n",index+1);
+            err = -1;
+            goto bail;
+        }
+        vg.offsetEntries[index].removedBefore = (index == 0) ? 0 : vg.offsetEntries[index-1].removedBefore + vg.offsetEntries[index-1].sizeRemoved;
+        vg.offsetEntries[index].physicalOffset = vg.offsetEntries[index].offset - vg.offsetEntries[index].removedBefore;
     }
+    vg.lastLogicalOffsetEntry = vg.lastPhysicalOffsetEntry = 0;
     
+bail:
     fclose(offsetsFile);
+    return err;
+}
+
+void allocSegmentInfo(long numSegments)
+{
+    // -range sizes them again once it has picked the segments
+    free(vg.segmentSizes);
+    free(vg.segmentEnds);
+    free(vg.simsInStyp);
+    free(vg.psshFoundInSegment);
+    free(vg.tencFoundInSegment);
+    free(vg.dsms);
+
+    vg.segmentSizes = (UInt64 *)calloc(numSegments, sizeof(UInt64));
+    vg.segmentEnds = (UInt64 *)calloc(numSegments, sizeof(UInt64));
+    vg.segmentCursor = 0;
+    vg.segmentInfoSize = numSegments;
+    vg.simsInStyp = (bool *)calloc(numSegments, sizeof(bool));
+    vg.psshFoundInSegment = (bool *)calloc(numSegments, sizeof(bool));
+    vg.tencFoundInSegment = (bool *)calloc(numSegments, sizeof(bool));
+    vg.dsms = (bool *)calloc(numSegments, sizeof(bool));
+}
+
+// to be called whenever segmentSizes changes; the segment lookups in HelperMethods.cpp use segmentEnds
+void updateSegmentMap(void)
+{
+    UInt64 end = 0;
+
+    for(long i = 0 ; i < vg.segmentInfoSize ; i++)
+    {
+        end += vg.segmentSizes[i];
+        vg.segmentEnds[i] = end;
+    }
+    vg.segmentCursor = 0;
+}
+
+int addSegmentPath(char ***paths, long *count, const char *path)
+{
+    char **newPaths = (char **)realloc(*paths, (*count + 1)*sizeof(char *));
+    char *newPath = strdup(path);
+
+    if(newPaths == NULL || newPath == NULL)
+    {
+        free(newPath);
+        if(newPaths != NULL)
+            *paths = newPaths;
+        messageprint("Out of memory for the segment list\n");
+        return allocFailedErr;
+    }
+    *paths = newPaths;
+    (*paths)[(*count)++] = newPath;
+    return noErr;
+}
+
+// one segment file per line, in order; relative paths are relative to the list file
+int loadSegmentList(char *segmentListFileName, char ***pathsOut, long *countOut)
+{
+    FILE *segmentListFile = fopen(segmentListFileName,"rt");
+    char line[1024];
+    char path[2048];
+    const char *dirEnd = strrchr(segmentListFileName, '/');
+    int dirLength = dirEnd ? (int)(dirEnd - segmentListFileName + 1) : 0;
+    int pathLength;
+    int err = noErr;
+
+    if(segmentListFile == NULL)
+    {
+        messageprint("Could not open segment list file \"%s\"\n", segmentListFileName);
+        return -1;
+    }
+
+    while(fgets(line, sizeof(line), segmentListFile))
+    {
+        size_t length = strcspn(line, "\r\n");
+
+        if(line[length] == '\0' && !feof(segmentListFile))
+        {
+            messageprint("Line too long in segment list file \"%s\"\n", segmentListFileName);
+            err = -1;
+            break;
+        }
+        line[length] = '\0';
+        if(length == 0 || line[0] == '#')
+            continue;
+
+        if(line[0] == '/' || dirLength == 0)
+            pathLength = snprintf(path, sizeof(path), "%s", line);
+        else
+            pathLength = snprintf(path, sizeof(path), "%.*s%s", dirLength, segmentListFileName, line);
+        if(pathLength < 0 || pathLength >= (int)sizeof(path))
+        {
+            messageprint("Path too long in segment list file \"%s\": \"%s\"\n", segmentListFileName, line);
+            err = -1;
+            break;
+        }
+        err = addSegmentPath(pathsOut, countOut, path);
+        if(err)
+            break;
+    }
+
+    fclose(segmentListFile);
+    if(err)
+        return err;
+
+    if(*countOut == 0)
+    {
+        messageprint("Empty segment list file \"%s\"\n", segmentListFileName);
+        return -1;
+    }
+    return noErr;
 }
 
 //==========================================================================================
 
 #include <stdarg.h>
-// change here if you want to send both types of output to stdout to get interleaved output
-#if 1
-	#define _stdout stdout
-	#define _stderr stderr
-#else
-	#define _stdout stdout
-	#define _stderr stdout
-#endif
 
 void toggleprintatom( Boolean onOff )
 {
@@ -831,9 +1259,9 @@ void toggleprintatom( Boolean onOff )
 	// true is on, false is off
 	vg.printatom = onOff;
 //	if( vg.printatom )
-//		fprintf( _stdout, "--> turning ON vg.printatom \n");
+//		reportprint( "--> turning ON vg.printatom \n");
 //	else
-//		fprintf( _stdout, "--> turning OFF vg.printatom \n" );
+//		reportprint( "--> turning OFF vg.printatom \n" );
 
 }
 
@@ -845,9 +1273,9 @@ void toggleprintatomdetailed( Boolean onOff )
 	vg.printatom = onOff;
 	vg.print_fulltable = onOff;
 //	if( vg.printatom )
-//		fprintf( _stdout, "--> turning ON vg.printatom and vg.print_fulltable \n" );
+//		reportprint( "--> turning ON vg.printatom and vg.print_fulltable \n" );
 //	else
-//		fprintf( _stdout, "--> turning OFF vg.printatom and vg.print_fulltable \n" );
+//		reportprint( "--> turning OFF vg.printatom and vg.print_fulltable \n" );
 
 }
 
@@ -860,18 +1288,86 @@ void toggleprintsample( Boolean onOff )
 
 }
 
+//==========================================================================================
+
+#define kReportOutput	0		// the kind of output that isn't a diagnostic
+
+// All the output goes through here to the callbacks of the context (see ValidateMP4Lib.h): tabcnt
+//   tabs and then the text, formatted once into a buffer (on the stack unless it is long).
+static void voutput( int kind, long tabcnt, const char *formatStr, va_list ap )
+{
+	char local[1024];
+	char *text = local;
+	size_t tabLength = sizeof(myTAB) - 1;
+	size_t prefix = tabcnt * tabLength;
+	int length;
+	va_list apCopy;
+	long i;
+	
+	if ((kind == kReportOutput) ? (vg.output.report == nil) : (vg.output.diagnostic == nil))
+		return;
+	
+	va_copy( apCopy, ap );
+	if (prefix < sizeof(local))
+		length = vsnprintf( local + prefix, sizeof(local) - prefix, formatStr, apCopy );
+	else
+		length = vsnprintf( nil, 0, formatStr, apCopy );
+	va_end( apCopy );
+	if (length < 0)
+		return;
+	if (prefix + length >= sizeof(local)) {
+		text = (char *)malloc( prefix + length + 1 );
+		if (text == nil)
+			return;
+		vsnprintf( text + prefix, length + 1, formatStr, ap );
+	}
+	for (i = 0; i < tabcnt; i++)
+		memcpy( text + i * tabLength, myTAB, tabLength );
+	
+	if (kind == kReportOutput)
+		vg.output.report( vg.output.refcon, text, prefix + length );
+	else
+		vg.output.diagnostic( vg.output.refcon, kind, (kind == kValidateMP4Message) ? nil : vg.curatompath, text, prefix + length );
+	
+	if (text != local)
+		free(text);
+}
+
+// what the command line prints on stdout besides the atoms and samples
+void reportprint(const char *formatStr, ...)
+{
+	va_list 		ap;
+	va_start(ap, formatStr);
+	
+	voutput( kReportOutput, 0, formatStr, ap );
+	
+	va_end(ap);
+}
+
+// what the command line prints on stderr that is not an error or warning
+void messageprint(const char *formatStr, ...)
+{
+	va_list 		ap;
+	va_start(ap, formatStr);
+	
+	voutput( kValidateMP4Message, 0, formatStr, ap );
+	
+	va_end(ap);
+}
+
 void atomprinttofile(const char* formatStr, va_list ap)
 {
-	vfprintf (f, formatStr, ap);
+	vfprintf (vg.atomXmlFile, formatStr, ap);
 }
 
 void atomprintnotab(const char *formatStr, ...)
 {
 	va_list 		ap;
-	va_start(ap, formatStr);
 	
 	if (vg.printatom) {
-		vfprintf( _stdout, formatStr, ap );
+		va_start(ap, formatStr);
+		voutput( kReportOutput, 0, formatStr, ap );
+		va_end(ap);
 	}
 	
 	if(vg.atomxml){
@@ -879,27 +1375,22 @@ void atomprintnotab(const char *formatStr, ...)
 		atomprinttofile(formatStr, ap);
 		va_end(ap);
 	}
-	
-	va_end(ap);
 }
 
 void atomprint(const char *formatStr, ...)
 {
 	va_list 		ap;
-	va_start(ap, formatStr);
 	
 	if (vg.printatom) {
-		long tabcnt = vg.tabcnt;
-		while (tabcnt--) {
-			fprintf(_stdout,myTAB);
-		}
-		vfprintf( _stdout, formatStr, ap );
+		va_start(ap, formatStr);
+		voutput( kReportOutput, vg.tabcnt, formatStr, ap );
+		va_end(ap);
 	}
 	
 	if(vg.atomxml){
 		long tabcnt = vg.tabcnt;
  		while (tabcnt--) {
- 			fprintf(f,myTAB);
+ 			fprintf(vg.atomXmlFile,myTAB);
  		}
 		va_start(ap, formatStr);
 		atomprinttofile(formatStr, ap);
@@ -943,11 +1434,7 @@ void atomprintdetailed(const char *formatStr, ...)
 	va_start(ap, formatStr);
 	
 	if (vg.printatom && vg.print_fulltable) {
-		long tabcnt = vg.tabcnt;
-		while (tabcnt--) {
-			fprintf(_stdout,myTAB);
-		}
-		vfprintf( _stdout, formatStr, ap );
+		voutput( kReportOutput, vg.tabcnt, formatStr, ap );
 	}
 	
 	va_end(ap);
@@ -959,11 +1446,7 @@ void sampleprint(const char *formatStr, ...)
 	va_start(ap, formatStr);
 	
 	if (vg.printsample) {
-		long tabcnt = vg.tabcnt;
-		while (tabcnt--) {
-			fprintf(_stdout,myTAB);
-		}
-		vfprintf( _stdout, formatStr, ap );
+		voutput( kReportOutput, vg.tabcnt, formatStr, ap );
 	}
 	
 	va_end(ap);
@@ -975,7 +1458,7 @@ void sampleprintnotab(const char *formatStr, ...)
 	va_start(ap, formatStr);
 	
 	if (vg.printsample) {
-		vfprintf( _stdout, formatStr, ap );
+		voutput( kReportOutput, 0, formatStr, ap );
 	}
 	
 	va_end(ap);
@@ -1080,7 +1563,7 @@ void warnprint(const char *formatStr, ...)
 	va_start(ap, formatStr);
 	
 	if (vg.warnings)
-		vfprintf( _stderr, formatStr, ap );
+		voutput( kValidateMP4Warning, 0, formatStr, ap );
 	
 	va_end(ap);
 }
@@ -1091,8 +1574,7 @@ void errprint(const char *formatStr, ...)
 	va_list 		ap;
 	va_start(ap, formatStr);
 	
-	fprintf( _stderr, "### error: %s \n###        ",vg.curatompath);
-	vfprintf( _stderr, formatStr, ap );
+	voutput( kValidateMP4Error, 0, formatStr, ap );
 	
 	va_end(ap);
 }
@@ -1142,7 +1624,7 @@ int mapStringToUInt32(char *src, UInt32 *target)
 {
     if(src == NULL || target == NULL)
     {
-        fprintf(stderr, "mapStringToUInt32: NULL pointer exception");
+        messageprint("mapStringToUInt32: NULL pointer exception");
         return -1;
     }
 
@@ -1161,7 +1643,7 @@ int mapStringToUInt32(char *src, UInt32 *target)
 
 char *ostypetostr(UInt32 num)
 {
-	static char str[sizeof(num)+1] = {0};
+	static VALIDATE_THREAD_LOCAL char str[sizeof(num)+1] = {0};
 	
 	str[0] = (num >> 24) & 0xff;
 	str[1] = (num >> 16) & 0xff;
@@ -1186,30 +1668,14 @@ char *ostypetostr_r(UInt32 num, char * buffer)
 //    for cases where you need it more than once in the same print statment, use int64toxstr_r() instead
 char *int64toxstr(UInt64 num)
 {
-	static char str[20];
-	UInt32 hi,lo;
-	
-	hi = num>>32;
-	lo = num&(0xffffffff);
-	if (hi) {
-		sprintf(str,"0x%lx%8.8lx",hi,lo);
-	} else {
-		sprintf(str,"0x%lx",lo);
-	}
+	static VALIDATE_THREAD_LOCAL char str[20];
+	sprintf(str,"0x%llx",(unsigned long long)num);
 	return str;
 }
 
 char *int64toxstr_r(UInt64 num, char * str)
 {
-	UInt32 hi,lo;
-	
-	hi = num>>32;
-	lo = num&(0xffffffff);
-	if (hi) {
-		sprintf(str,"0x%lx%8.8lx",hi,lo);
-	} else {
-		sprintf(str,"0x%lx",lo);
-	}
+	sprintf(str,"0x%llx",(unsigned long long)num);
 	return str;
 }
 
@@ -1217,38 +1683,22 @@ char *int64toxstr_r(UInt64 num, char * str)
 //    for cases where you need it more than once in the same print statment, use int64toxstr_r() instead
 char *int64todstr(UInt64 num)
 {
-	static char str[40];
-	UInt32 hi,lo;
-	
-	hi = num>>32;
-	lo = num&(0xffffffff);
-	
-	if (hi) 
-		sprintf(str,"%ld%8.8ld",hi,lo);
-	else
-		sprintf(str,"%ld",lo);
+	static VALIDATE_THREAD_LOCAL char str[40];
+	sprintf(str,"%llu",(unsigned long long)num);
 	return str;
 }
 
 
 char *int64todstr_r(UInt64 num, char * str)
 {
-	UInt32 hi,lo;
-	
-	hi = num>>32;
-	lo = num&(0xffffffff);
-	
-	if (hi) 
-		sprintf(str,"%ld%8.8ld",hi,lo);
-	else
-		sprintf(str,"%ld",lo);
+	sprintf(str,"%llu",(unsigned long long)num);
 	return str;
 }
 
 //  careful about using more than one call to this in the same print statement, they end up all being the same
 char *langtodstr(UInt16 num)
 {
-	static char str[5];
+	static VALIDATE_THREAD_LOCAL char str[5];
 
 	str[4] = 0;
 	
@@ -1269,7 +1719,7 @@ char *langtodstr(UInt16 num)
 //    for cases where you need it more than once in the same print statment, use fixed16str_r() instead
 char *fixed16str(SInt16 num)
 {
-	static char str[40];
+	static VALIDATE_THREAD_LOCAL char str[40];
 	float f;
 	
 	f = num;
@@ -1297,7 +1747,7 @@ char *fixed16str_r(SInt16 num, char * str)
 //    for cases where you need it more than once in the same print statment, use fixed32str_r() instead
 char *fixed32str(SInt32 num)
 {
-	static char str[40];
+	static VALIDATE_THREAD_LOCAL char str[40];
 	double f;
 	
 	f = num;
@@ -1326,7 +1776,7 @@ char *fixed32str_r(SInt32 num, char * str)
 //    for cases where you need it more than once in the same print statment, use fixedU32str_r() instead
 char *fixedU32str(UInt32 num)
 {
-	static char str[40];
+	static VALIDATE_THREAD_LOCAL char str[40];
 	double f;
 	
 	f = num;
@@ -1510,16 +1960,21 @@ OSErr ValidateElementaryVideoStream( atomOffsetEntry *aoe, void *refcon )
 	Ptr dataP;
 	UInt32 dataSize;
 	UInt32 refcons[2];
+	SampleReader sr;
 	
+	SampleReader_Init( &sr, nil );
 	if (vg.checklevel < checklevel_samples)
 		vg.checklevel = checklevel_samples;
 
 	tir.sampleDescriptionCnt = 1;
 	tir.validatedSampleDescriptionRefCons = &refcons[0];
 	
+	if (vg.streamInput)
+		StreamSetLimit( (UInt64)-1 );		// no atom structure to bound the read-ahead
+	
 	err = GetFileStartCode( aoe, &prevStartCode, offset1, &offset2 );
 	if (err) {
-		fprintf(stderr,"### did NOT find ANY start codes\n");
+		messageprint("### did NOT find ANY start codes\n");
 		goto bail;
 	}
 	
@@ -1527,7 +1982,7 @@ OSErr ValidateElementaryVideoStream( atomOffsetEntry *aoe, void *refcon )
 		err = GetFileStartCode( aoe, &startCode, offset2, &offset3 );
 		
 		if (err) {
-			offset3 = aoe->maxOffset;
+			offset3 = vg.streamInput ? inflateOffset(vg.stream.head) : aoe->maxOffset;
 		}
 		
 		if (err || (startCode == 0x000001B6) || (startCode == 0x000001B3)) {
@@ -1536,8 +1991,9 @@ OSErr ValidateElementaryVideoStream( atomOffsetEntry *aoe, void *refcon )
 			}
 			
 			dataSize = (UInt32)(offset3 - offset1);
-			BAILIFNIL( dataP = (Ptr)malloc(dataSize), allocFailedErr );
-			err = GetFileData( vg.fileaoe, dataP, offset1, dataSize, nil );
+			err = SampleReader_GetRange( &sr, offset1, dataSize, 
+						(aoe->maxOffset < offset1 + kSampleReadCoalesceSize) ? aoe->maxOffset : offset1 + kSampleReadCoalesceSize, &dataP );
+			BAILIFNIL( dataP, allocFailedErr );
 			
 			err = BitBuffer_Init(&bb, (UInt8 *)dataP, dataSize);
 
@@ -1555,15 +2011,19 @@ OSErr ValidateElementaryVideoStream( atomOffsetEntry *aoe, void *refcon )
 			
 			sampleNum++;
 			offset1 = offset2 = offset3;
+			if (vg.streamInput)
+				StreamRelease( getAdjustedFileOffset(offset1) );
 		}
 nextone:
 		prevStartCode = startCode;
 		offset2 = offset3 + 4;
 	} while (!err);
+	SampleReader_PrintStats( &sr );
 	
 	
 	
 bail:
+	SampleReader_Dispose( &sr );
 	return err;
 }
 
@@ -27,9 +27,13 @@ limitations under the License.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <ctype.h>
 #include <string.h>
 
+#include "ValidateMP4Lib.h"
+
 #if defined(__GNUC__) && ( defined(__APPLE_CPP__) || defined(__APPLE_CC__) || defined(__MACOS_CLASSIC__) )
  #if defined(__i386__) || defined(__x86_64__) 
   #define LITTLEENDIAN 1
@@ -56,7 +60,7 @@ limitations under the License.
 #endif
 
 typedef char *Ptr;
-typedef unsigned long OSType;
+typedef uint32_t OSType;
 typedef unsigned char Boolean;
 typedef short OSErr;
 
@@ -71,23 +75,19 @@ enum {
 	kSkipUnknownAtoms = 1L<<0
 };
 
-typedef unsigned char UInt8;
+// fixed width, so the same on 32-bit and 64-bit (LP64/LLP64) builds
+typedef uint8_t UInt8;
 typedef char SInt8;
-typedef long SInt32;
-typedef unsigned long UInt32;
-typedef long Int32;
-typedef short SInt16;
-typedef unsigned short UInt16;
+typedef int32_t SInt32;
+typedef uint32_t UInt32;
+typedef int32_t Int32;
+typedef int16_t SInt16;
+typedef uint16_t UInt16;
 typedef UInt32 UnsignedFixed;
 
 typedef unsigned char uuidType[16];		// 128-bit uuid (guid)
-#ifdef  _MSC_VER
-typedef unsigned __int64 UInt64;
-typedef __int64 SInt64;
-#else
-typedef unsigned long long UInt64;
+typedef unsigned long long UInt64;	// not uint64_t, which is a long on LP64 and would upset every %llu
 typedef long long SInt64;
-#endif
 typedef UInt32 TimeValue;
 typedef UInt32 PriorityType;
 typedef SInt32 Fixed;
@@ -108,7 +108,6 @@ typedef struct startAtomType {
 } startAtomType;
 
 
-// Limitation:  we don't handle atom's with sizes or file offsets that need more than 32-bits
 typedef struct atomOffsetEntry {
 	OSType 		type;			// if atomId == 'uuid', use uuid field
 	uuidType 	uuid;
@@ -120,7 +119,7 @@ typedef struct atomOffsetEntry {
 	UInt32		atomStartSize;	// size of id & size info, so it is easy to skip
 
 	UInt32 		aoeflags;			// used for processing	
-	UInt32 		refconOverride;		// used for processing	
+	void *		refconOverride;		// used for processing	
 } atomOffsetEntry;
 
 enum {
@@ -273,6 +272,53 @@ typedef struct VideoSampleDescriptionInfo {
 } VideoSampleDescriptionInfo;
 
 
+// Region allocator owning the parsed movie state of one validation run: the MovieInfoRec and
+//   everything hanging off it.  Allocation bumps a pointer in the current block; nothing is freed
+//   on its own, the whole arena goes at once at the end of the run (see HelperMethods.cpp)
+#define kArenaBlockSize     (1024*1024)     // requests over a quarter of this get a block of their own
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    UInt64  size;               // bytes available after the header
+    UInt64  used;
+} ArenaBlock;
+
+typedef struct Arena {
+    ArenaBlock *current;        // the block being filled; earlier ones hang off it
+    UInt64  allocated;          // bytes handed out since the last release
+    UInt32  allocCount;
+    UInt32  blockCount;
+    UInt64  reserved;           // bytes held in blocks
+    UInt64  highWater;          // most bytes ever held at once, kept across releases
+} Arena;
+
+void *ArenaAlloc( Arena *arena, UInt64 size );
+void *ArenaCalloc( Arena *arena, UInt64 count, UInt64 size );
+void *ArenaGrow( Arena *arena, void *p, UInt64 oldSize, UInt64 newSize );
+void ArenaRelease( Arena *arena );
+void ArenaPrintStats( Arena *arena, const char *name );
+
+// Times on a media timeline are whole ticks of its timescale in 64-bit integers, so sums and
+//   comparisons are exact.  Where timelines meet (a track and its 'sidx', or the leaves of another
+//   representation) a MediaTime carries its timescale along; long double seconds are only
+//   made for printing (see HelperMethods.cpp)
+typedef struct MediaTime {
+    SInt64  value;          // ticks
+    UInt32  timescale;      // ticks per second
+} MediaTime;
+
+// the ends of the timeline, alike so any time can be negated
+#define kMediaTimeMax   ((SInt64)0x7FFFFFFFFFFFFFFFLL)
+#define kMediaTimeMin   (-kMediaTimeMax)
+
+MediaTime MediaTimeMake( SInt64 value, UInt32 timescale );
+int MediaTimeCompare( MediaTime a, MediaTime b );
+Boolean MediaTimeApart( MediaTime a, MediaTime b, UInt32 timescale );
+Boolean MediaTimeRescale( SInt64 value, UInt32 fromTimescale, UInt32 toTimescale, SInt64 *result );
+Boolean MediaTimeAdd( SInt64 *sum, SInt64 ticks );
+long double MediaTimeSeconds( MediaTime t );
+
+
 // Section 8.8.8. of ISO/IEC 14496-12 4th edition
 
 typedef struct {
@@ -289,12 +335,16 @@ typedef struct {
     UInt32 data_offset;
     UInt32 first_sample_flags;
     
+    // The per-sample arrays are views into the track's FragmentSampleStore columns,
+    //   sample_count entries starting at track sample number firstSample; NULL if sample_count is 0
+    UInt32 firstSample;
     UInt32 *sample_duration;
     UInt32 *sample_size;
     UInt32 *sample_flags;
     UInt32 *sample_composition_time_offset; //Use it as a signed int when version is non-zero
+    UInt64 *sampleDecodeTime;       //Relative to the start of the track fragment
 
-    long double *samplePresentationTime;
+    SInt64 *samplePresentationTime;  //In media timescale
     Boolean *sampleToBePresented;  //After applying edits
     Boolean *sap3;
     Boolean *sap4;
@@ -303,14 +353,94 @@ typedef struct {
 
 } TrunInfoRec;
 
+// Column store for the samples of all of a track's fragments.  The columns live in blocks,
+//   each a single allocation from vg.arena, doubling from kFragmentSampleBlockMin up to kFragmentSampleBlockMax
+//   samples; a trun's samples never straddle blocks, so its views stay contiguous and never move
+#define kFragmentSampleBlockMin     1024
+#define kFragmentSampleBlockMax     65536
+
+typedef struct FragmentSampleBlock {
+    struct FragmentSampleBlock *next;
+    UInt32  firstSample;            // track sample number of the block's first sample
+    UInt32  count;
+    UInt32  capacity;
+    SInt64  *presentationTime;      // the columns, capacity entries each
+    UInt64  *decodeTime;
+    UInt32  *duration;
+    UInt32  *size;
+    UInt32  *flags;
+    UInt32  *compositionOffset;
+    Boolean *toBePresented;
+    Boolean *sap3;
+    Boolean *sap4;
+} FragmentSampleBlock;
+
+typedef struct FragmentSampleStore {
+    UInt32  count;                  // samples in all blocks
+    FragmentSampleBlock *first;
+    FragmentSampleBlock *last;
+} FragmentSampleStore;
+
+OSErr FragmentSamplesAllocate( FragmentSampleStore *store, TrunInfoRec *trunInfo );
+
+// Where one of a track's 'traf's sits: mir->moofInfo[moofIndex].trafInfo[trafIndex]
+typedef struct TrackFragmentRef {
+    UInt32  moofIndex;
+    UInt32  trafIndex;
+} TrackFragmentRef;
+
+// Hashed index from a key (a track_ID, a box offset, a grouping_type) to the position of the
+//   record holding it in one of the arrays below; filled in as the boxes are validated, with the
+//   tables taken from vg.arena (see HelperMethods.cpp)
+typedef struct KeyIndex {
+    UInt32  capacity;       // number of slots, a power of two; 0 until the first insert
+    UInt32  count;
+    UInt64  *keys;
+    UInt32  *values;        // position + 1, 0 marks an empty slot
+} KeyIndex;
+
+OSErr KeyIndexInsert( KeyIndex *ki, UInt64 key, UInt32 value );
+UInt32 KeyIndexFind( KeyIndex *ki, UInt64 key, UInt32 notFound );
+
+// The atoms of a list from FindAtomOffsets (or of the streamed top level) bucketed by type, so that
+//   ValidateAtomOfType only visits the atoms of the type it is after; each bucket chains the positions
+//   of its atoms in list order. Shorter lists are quicker to scan than to index.
+#define kAtomTypeIndexMinCount 32
+
+typedef struct AtomTypeBucket {
+    long    last;           // position of the last atom of the type
+    long    pending;        // position of the first atom of the type not yet seen validated, -1 if none
+    long    settled;        // atoms of the type ahead of pending, all of them validated
+} AtomTypeBucket;
+
+typedef struct AtomTypeIndex {
+    atomOffsetEntry *list;
+    long    cnt;            // atoms of the list indexed so far, the list may grow
+    long    capacity;       // of next
+    long    *next;          // per atom, position of the next atom of the same type, -1 at the last
+    KeyIndex types;         // type -> into buckets
+    AtomTypeBucket *buckets;
+    UInt32  numBuckets;
+    UInt32  bucketCapacity;
+    Boolean broken;         // ran out of memory part way, the list is scanned instead
+} AtomTypeIndex;
+
+AtomTypeIndex *AtomTypeIndexFor( atomOffsetEntry *list, long cnt );
+
+typedef struct {
+
+    UInt32 sample_count; 
+    UInt32 group_description_index;
+    
+} SbgpEntry;
+
 typedef struct {
 
     UInt32 version;
     UInt32 grouping_type; 
     UInt32 grouping_type_parameter;
     UInt32 entry_count;
-    UInt32 *sample_count; 
-    UInt32 *group_description_index;
+    SbgpEntry *entries;
     
 } SbgpInfoRec;
 
@@ -352,6 +482,7 @@ typedef struct {
     UInt32 numSgpd;
     UInt32 processedSgpd;
     SgpdInfoRec *sgpdInfo;
+    KeyIndex sgpdByGroupingType;
     
     UInt32 numSbgp;
     UInt32 processedSbgp;
@@ -380,9 +511,9 @@ typedef struct {
     
     Boolean *compositionInfoMissingPerTrack;
     
-    long double  *moofEarliestPresentationTimePerTrack;
-    long double  *moofPresentationEndTimePerTrack;
-    long double  *moofLastPresentationTimePerTrack; //Differs from moofPresentationEndTimePerTrack by the sample delta
+    SInt64  *moofEarliestPresentationTimePerTrack;     //In the track's media timescale
+    SInt64  *moofPresentationEndTimePerTrack;
+    SInt64  *moofLastPresentationTimePerTrack; //Differs from moofPresentationEndTimePerTrack by the sample delta
     
     UInt64  *tfdt;
     
@@ -404,7 +535,7 @@ typedef struct {
 
     UInt64 offset;
     UInt64 size;
-    long double cumulatedDuration;
+    MediaTime cumulatedDuration;    //In timescale
     
     UInt32 reference_ID;
     UInt32 timescale; 
@@ -415,16 +546,19 @@ typedef struct {
 } SidxInfoRec;
 
 //===========================
+// leafinfo.txt has the leaf times in seconds with six decimals
+#define kLeafInfoTimescale  1000000
+
 typedef struct {
     bool segmentIndexed;
     bool hasFragments;
     UInt64 firstMoofIndex;
     UInt64 lastMoofIndex;
     bool firstInSegment;
-    long double earliestPresentationTime;
-    long double lastPresentationTime;
-    long double presentationEndTime;
-    long double sidxReportedDuration;
+    MediaTime earliestPresentationTime;     //In the track's media timescale, or kLeafInfoTimescale for the control leafs
+    MediaTime lastPresentationTime;
+    MediaTime presentationEndTime;
+    MediaTime sidxReportedDuration;         //In the 'sidx' timescale
     Boolean samplesToBePresented;
 	UInt64 offset;
 } LeafInfo;
@@ -455,6 +589,18 @@ typedef struct HandlerInfoRecord {
     char    Name[1];
 } HandlerInfoRecord;
 
+// Prefix sums over the sample tables, built once per track when 'stbl' has been validated,
+//   so that sample and chunk lookups do not walk the sampleToChunk table
+typedef struct SampleIndex {
+	UInt32	sampleCnt;
+	UInt32	chunkCnt;
+	UInt64	*sampleOffset;		// 1 based, file offset of each sample
+	UInt32	*sampleChunk;		// 1 based, chunk holding each sample
+	UInt64	*decodeTime;		// 1 based, sampleCnt+1 entries; the last is the end of the last sample
+	UInt32	*chunkFirstSample;	// 1 based, first sample of each chunk
+	UInt32	*chunkStsc;			// 1 based, sampleToChunk entry describing each chunk
+} SampleIndex;
+
 typedef struct {
 	OSType mediaType;
 	SInt16 trackVolume;
@@ -492,12 +638,18 @@ typedef struct {
 	UInt32 timeToSampleSampleCnt;			// number of samples described in the timeToSampleAtom
 	UInt64 timeToSampleDuration;			// duration described by timeToSampleAtom (this is Total duration of all samples, 
 											//   not a single sample's duration)
+	SampleIndex *sampleIndex;				// nil until built, or if the tables are inconsistent
     UInt32    default_sample_description_index;     // Section 8.3.3. of ISO/IEC 14496-12 4th edition
     UInt32    default_sample_duration;              // Section 8.3.3. of ISO/IEC 14496-12 4th edition
     UInt32    default_sample_size;                  // Section 8.3.3. of ISO/IEC 14496-12 4th edition
     UInt32    default_sample_flags;                 // Section 8.3.3. of ISO/IEC 14496-12 4th edition
 
     UInt64 cumulatedTackFragmentDecodeTime;
+    Boolean timelineOverflow;               // some presentation time was clamped to the 64-bit timeline
+    FragmentSampleStore fragmentSamples;    // the samples of every 'trun' of this track
+    UInt32  numTrackFragments;              // this track's 'traf's in file order, as the 'moof's are validated
+    UInt32  trackFragmentCapacity;
+    TrackFragmentRef *trackFragments;
 
     UInt32  numLeafs;
     LeafInfo *leafInfo;
@@ -509,6 +661,38 @@ typedef struct {
 
 int GetSampleOffsetSize( TrackInfoRec *tir, UInt32 sampleNum, UInt64 *offsetOut, UInt32 *sizeOut, UInt32 *sampleDescriptionIndexOut );
 int GetChunkOffsetSize( TrackInfoRec *tir, UInt32 chunkNum, UInt64 *offsetOut, UInt32 *sizeOut, UInt32 *sampleDescriptionIndexOut );
+int GetSampleDecodeTime( TrackInfoRec *tir, UInt32 sampleNum, UInt64 *decodeTimeOut, UInt32 *durationOut );
+int BuildSampleIndex( TrackInfoRec *tir );
+
+// Pooled, chunk-coalescing reader for sample data (see ValidateFileIO.cpp)
+#define kSampleReadCoalesceSize	(4*1024*1024)	// most we read ahead of a requested sample
+typedef struct SampleReader {
+	TrackInfoRec	*tir;			// nil when only SampleReader_GetRange is used
+	Ptr				buffer;			// bufferSize bytes plus bitParsingSlop
+	UInt64			bufferSize;
+	UInt64			windowStart;	// file offset of buffer[0]
+	UInt64			windowSize;		// bytes of buffer holding file data
+	UInt32			readCount;
+	UInt32			allocCount;
+	UInt64			bytesRead;
+} SampleReader;
+
+void SampleReader_Init( SampleReader *sr, TrackInfoRec *tir );
+void SampleReader_Dispose( SampleReader *sr );
+int SampleReader_GetRange( SampleReader *sr, UInt64 offset64, UInt32 size, UInt64 readAheadEnd, Ptr *dataPout );
+int SampleReader_GetSample( SampleReader *sr, UInt32 sampleNum, UInt64 *offsetOut, UInt32 *sizeOut, Ptr *dataPout );
+void SampleReader_PrintStats( SampleReader *sr );
+
+// Worker threads that validate samples in parallel, the output coming out in order (see ValidateTasks.cpp)
+typedef void (*ValidateTaskProcPtr)( void *taskData );
+typedef struct ValidateTaskQueue ValidateTaskQueue;
+long ValidateProcessorCount( void );
+ValidateTaskQueue *NewValidateTaskQueue( long numThreads );
+void ValidateTaskQueue_Submit( ValidateTaskQueue *queue, ValidateTaskProcPtr proc, void *taskData );
+void ValidateTaskQueue_BeginHere( ValidateTaskQueue *queue );
+void ValidateTaskQueue_EndHere( ValidateTaskQueue *queue );
+void ValidateTaskQueue_Finish( ValidateTaskQueue *queue );
+void DisposeValidateTaskQueue( ValidateTaskQueue *queue );
 
 // movie Globals
 typedef struct {
@@ -520,16 +704,25 @@ typedef struct {
     UInt64  fragment_duration;
 	UInt32  mvhd_timescale;
 
-	long			numTIRs;
-	TrackInfoRec	tirList[1];
     MoofInfoRec     *moofInfo;
+    UInt32  moofInfoCapacity;       // entries allocated; a streamed input grows moofInfo and sidxInfo as they turn up
 
     UInt32  numSidx;
     UInt32  processedSdixs;
     SidxInfoRec     *sidxInfo;
+    UInt32  sidxInfoCapacity;
+
+    KeyIndex    trakByID;           // into tirList
+    KeyIndex    moofByOffset;       // into moofInfo
+    KeyIndex    sidxByOffset;       // into sidxInfo
 
+	long			numTIRs;
+	TrackInfoRec	tirList[1];		// must stay last, allocated with room for numTIRs entries
 } MovieInfoRec;
 
+OSErr TrackFragmentsAppend( MovieInfoRec *mir, UInt32 moofIndex, UInt32 trafIndex, UInt32 track_ID );
+UInt32 TrackFragmentsFind( TrackInfoRec *tir, UInt32 moofIndex );
+
 
 // enums for fileType
 enum {
@@ -561,14 +754,83 @@ typedef struct{
 typedef struct{
 	UInt64 offset;
 	UInt64 sizeRemoved;
+	UInt64 removedBefore;		// sizeRemoved of all the entries before this one
+	UInt64 physicalOffset;		// where the removed range would have been in the partial file (offset - removedBefore)
 } OffsetInfo;
 
 
+// forward-only window over a streamed input (stdin, pipe, FIFO); see ValidateFileIO.cpp
+typedef struct{
+	UInt8 *buf;			// holds input bytes [base, head)
+	UInt64 capacity;
+	UInt64 base;		// everything before this has been released
+	UInt64 head;		// next byte to be read from the input
+	UInt64 limit;		// don't read ahead past this (end of the current top-level atom)
+	UInt64 peak;		// largest the window got, in bytes
+	Boolean eof;
+} StreamWindow;
+
+// file size we use for a streamed input until we have seen its end
+#define kStreamUnknownFileSize	0x7FFFFFFFFFFFFFFFLL
+
+// what getAdjustedFileOffset gives for an offset in a region -offsetinfo says was removed: past any input, so reads there fail
+#define kRemovedFileOffset		0xFFFFFFFFFFFFFFFFULL
+
+// [start, end) in the input
+typedef struct{
+	UInt64 start;
+	UInt64 end;
+} ByteRange;
+
+// one file of a virtual input made of several segment files laid end to end; see ValidateFileIO.cpp
+typedef struct{
+	char *path;			// nil for a buffer
+	const UInt8 *data;	// the caller's buffer when the input is in memory (ValidateMP4Buffers); nil for a file
+	UInt64 offset;		// where it starts in the virtual input
+	UInt64 size;
+	UInt64 fileOffset;	// where its bytes start in that file (-range can pick out part of a file)
+	FILE *fp;			// nil unless it is one of the few we keep open
+} InputSegment;
+
+#define kMaxOpenInputSegments	16
+
+
 // Validate Globals
+//   Everything one validation works with lives here, so several of them can run in one process:
+//   each gets its own (see NewValidateContext) and binds it to the thread running it.
 typedef struct {
+	ValidateMP4Callbacks output;	// where the report and the diagnostics go (see reportprint, errprint)
+	FILE *outFile;			// the report and the diagnostics when they go to files (the command line: stdout, stderr)
+	FILE *errFile;
+	FILE *atomXmlFile;		// -atomxml: atominfo.xml
+	const char *outputDir;	// where the files we write (atominfo.xml, sidxinfo.txt, ...) go; nil for the current directory
+
 	FILE *inFile;
-	long inOffset;
-	long inMaxOffset;
+	SInt64 inOffset;
+	SInt64 inMaxOffset;
+	Boolean useMmap;		// -mmap: read the input through a memory mapping
+	UInt8 *inMap;			// the mapping, or nil when reading through stdio
+	UInt64 inMapSize;
+	Boolean streamInput;	// input is stdin/pipe/FIFO ("-" or -stream): read forward only, no seeking
+	StreamWindow stream;
+	Boolean headerOnly;		// -headeronly: only read the boxes, never the media data (see GetFileData)
+	ByteRange *payloadRanges;	// the payloads of the 'mdat's found so far, in order
+	long numPayloadRanges;
+	UInt64 bytesRead;		// how much of the input we have asked for
+	const ValidateMP4Buffer *inBuffers;	// ValidateMP4Buffers: the input is these, not files
+	long numInBuffers;
+	InputSegment *inSegments;	// input is several segment files read as one (-segments, or more than one input file)
+	long numInSegments;
+	long curInSegment;
+	long openInputSegments[kMaxOpenInputSegments];	// which of them have their file open
+	long numOpenInputSegments;
+	long nextOpenInputSegmentSlot;
+	Boolean useRange;		// -range: only validate the segments (subsegments, fragments) that overlap a window
+	Boolean rangeBySegment;	//   the window is media segment numbers (1 based) rather than media time in seconds
+	double rangeStart;
+	double rangeEnd;
+	Boolean rangeCutsStart;	//   the window starts after the first segment of the input
+	Boolean rangeCutsEnd;	//   the window stops short of the last segment of the input
 	
 	atompathType curatompath;
 	Boolean printatom; 
@@ -580,8 +842,15 @@ typedef struct {
 	Boolean warnings;
 	
 	MovieInfoRec	*mir;
+	Arena	arena;			// owns mir and the rest of the parsed movie state
+	KeyIndex atomTypeIndexByList;		// atom list address -> into atomTypeIndexes, see AtomTypeIndexFor
+	AtomTypeIndex **atomTypeIndexes;
+	UInt32	numAtomTypeIndexes;
+	UInt32	atomTypeIndexCapacity;
 
     UInt64 *segmentSizes;
+    UInt64 *segmentEnds;        // running total of segmentSizes: the offset just past each segment
+    long    segmentCursor;      // last segment looked up, tried first by the next lookup
     bool   *simsInStyp;
     bool psshInInit;
     bool tencInInit;
@@ -632,6 +901,8 @@ typedef struct {
 
 	unsigned int numOffsetEntries;
 	OffsetInfo *offsetEntries;
+	unsigned int lastLogicalOffsetEntry;	// last answers of the offset translation, for sequential reads
+	unsigned int lastPhysicalOffsetEntry;
 
 	// -----
 	atompathType atompath;
@@ -645,6 +916,7 @@ typedef struct {
 	long	filetype;
 	long	checklevel;
 	long	samplenumber;
+	long	numThreads;		// -threads: how many validate the samples (1: this one alone)
 
 	long	majorBrand;
 	Boolean	dashSegment;
@@ -657,6 +929,9 @@ typedef struct {
 	Boolean	print_sample;
 	Boolean	print_sampleraw;
 	Boolean	print_hintpayload;
+	Boolean	print_memory;
+	Boolean	print_timing;
+	Boolean	print_stats;
 	
 	UInt32  visualProfileLevelIndication;// to validate if IOD corresponds to VSC
 	 argstr default_KID;
@@ -671,10 +946,26 @@ typedef struct {
 	 
 } ValidateGlobals;
 
-extern ValidateGlobals vg;
+#if defined(_MSC_VER)
+	#define VALIDATE_THREAD_LOCAL	__declspec(thread)
+	#define strtok_r( str, delim, saveptr )	strtok_s( (str), (delim), (saveptr) )
+#else
+	#define VALIDATE_THREAD_LOCAL	__thread
+#endif
+
+// vg is the context of the validation running on this thread
+extern VALIDATE_THREAD_LOCAL ValidateGlobals *vgCurrent;
+#define vg (*vgCurrent)
+
+ValidateGlobals *NewValidateContext( const ValidateMP4Callbacks *callbacks );
+void DisposeValidateContext( ValidateGlobals *context );
+ValidateGlobals *SetValidateContext( ValidateGlobals *context );
+int ValidateMain( int argc, char *argv[] );
+char *OutputFilePath( const char *name );
+FILE *OpenOutputFile( const char *name, const char *mode );
 
 typedef struct AtomSizeType {
-	unsigned long atomSize;
+	UInt32 atomSize;
 	OSType atomType;
 } AtomSizeType;
 
@@ -683,7 +974,7 @@ typedef struct AtomStartRecord {
 	UInt32 versFlags;
 } AtomStartRecord;
 
-typedef OSErr (*ValidateAtomProcPtr)(OSType atomId, unsigned long atomSize, void *atomRec);
+typedef OSErr (*ValidateAtomProcPtr)(OSType atomId, UInt32 atomSize, void *atomRec);
 #define CallValidateAtomProc(userRoutine, atomId, atomSize, atomRec)		\
 		(*(userRoutine))((atomId), (atomSize), (atomRec))
 
@@ -695,21 +986,34 @@ typedef struct ValidateAtomDispatch {
 	short cnt;
 } ValidateAtomDispatch;
 
-void warnprint(const char *formatStr, ...);
-void errprint(const char *formatStr, ...);
+// lets gcc check the arguments against the format string, which matters now that UInt32 isn't a long
+#if defined(__GNUC__)
+	#define PRINTF_STYLE( fmtarg, firstarg )	__attribute__((format(printf, fmtarg, firstarg)))
+#else
+	#define PRINTF_STYLE( fmtarg, firstarg )
+#endif
+
+void warnprint(const char *formatStr, ...) PRINTF_STYLE(1, 2);
+void errprint(const char *formatStr, ...) PRINTF_STYLE(1, 2);
+void reportprint(const char *formatStr, ...) PRINTF_STYLE(1, 2);
+void messageprint(const char *formatStr, ...) PRINTF_STYLE(1, 2);
 void bailprint(const char *level, OSErr errcode);
 void atomprinttofile(const char* formatStr, va_list ap);
-void atomprint(const char *formatStr, ...);
-void atomprintnotab(const char *formatStr, ...);
-void atomprintdetailed(const char *formatStr, ...);
+void atomprint(const char *formatStr, ...) PRINTF_STYLE(1, 2);
+void atomprintnotab(const char *formatStr, ...) PRINTF_STYLE(1, 2);
+void atomprintdetailed(const char *formatStr, ...) PRINTF_STYLE(1, 2);
 void atomprinthexdata(char *dataP, UInt32 size);
-void sampleprint(const char *formatStr, ...);
-void sampleprintnotab(const char *formatStr, ...);
+void sampleprint(const char *formatStr, ...) PRINTF_STYLE(1, 2);
+void sampleprintnotab(const char *formatStr, ...) PRINTF_STYLE(1, 2);
 void sampleprinthexdata(char *dataP, UInt32 size);
 void sampleprinthexandasciidata(char *dataP, UInt32 size);
 void toggleprintatom( Boolean onOff );
 void loadLeafInfo(char *leafInfoFileName);
-void loadOffsetInfo(char *offsetsFileName);
+int loadOffsetInfo(char *offsetsFileName);
+void allocSegmentInfo(long numSegments);
+void updateSegmentMap(void);
+int addSegmentPath(char ***paths, long *count, const char *path);
+int loadSegmentList(char *segmentListFileName, char ***pathsOut, long *countOut);
 void toggleprintatomdetailed( Boolean onOff );
 void toggleprintsample( Boolean onOff );
 void copyCharsToStr( char *chars, char *str, UInt16 count );
@@ -951,22 +1255,135 @@ enum {
 OSErr PeekDescriptorTag(BitBuffer *bb, UInt32 *tag, UInt32 *size);
 OSErr GetDescriptorTagAndSize(BitBuffer *bb, UInt32 *tag, UInt32 *size);
 
-OSErr Validate_iods_OD_Bits( Ptr dataP, unsigned long dataSize, Boolean fileForm );
+OSErr Validate_iods_OD_Bits( Ptr dataP, UInt32 dataSize, Boolean fileForm );
 
 
+// 64-bit file positioning, so offsets past 2GB work on 32-bit builds too
+#if defined(_MSC_VER)
+	#define fseek64( f, offset, whence )	_fseeki64( (f), (__int64)(offset), (whence) )
+	#define ftell64( f )					_ftelli64( f )
+#else
+	#define fseek64( f, offset, whence )	fseeko( (f), (off_t)(offset), (whence) )
+	#define ftell64( f )					ftello( f )
+#endif
+
 int FindAtomOffsets( atomOffsetEntry *aoe, UInt64 startOffset, UInt64 maxOffset, 
 			long *atomCountOut, atomOffsetEntry **atomOffsetsOut );
+int GetAtomOffsetEntry( atomOffsetEntry *aoe, UInt64 offset, UInt64 maxOffset, 
+			atomOffsetEntry *entry, Boolean *runsToEndOut );
 UInt64 getAdjustedFileOffset(UInt64 offset64);
 UInt64 inflateOffset(UInt64 offset64);
 int GetFileDataN64( atomOffsetEntry *aoe, void *dataP, UInt64 offset64, UInt64 *newoffset64 );
 int GetFileDataN32( atomOffsetEntry *aoe, void *dataP, UInt64 offset64, UInt64 *newoffset64 );
 int GetFileDataN16( atomOffsetEntry *aoe, void *dataP, UInt64 offset64, UInt64 *newoffset64 );
+int GetFileDataN64Array( atomOffsetEntry *aoe, UInt64 *dataP, UInt64 count, UInt64 offset64, UInt64 *newoffset64 );
+int GetFileDataN32Array( atomOffsetEntry *aoe, UInt32 *dataP, UInt64 count, UInt64 offset64, UInt64 *newoffset64 );
+int GetFileDataN16Array( atomOffsetEntry *aoe, UInt16 *dataP, UInt64 count, UInt64 offset64, UInt64 *newoffset64 );
+void EndianU64Array_BtoN( UInt64 *values, UInt64 count );
+void EndianU32Array_BtoN( UInt32 *values, UInt64 count );
+void EndianU16Array_BtoN( UInt16 *values, UInt64 count );
 int GetFileData( atomOffsetEntry *aoe, void *dataP, UInt64 offset64, UInt64 size64, UInt64 *newoffset64 );
 int GetFileCString( atomOffsetEntry *aoe, char **strP, UInt64 offset64, UInt64 maxSize64, UInt64 *newoffset64 );
 int GetFileUTFString( atomOffsetEntry *aoe, char **strP, UInt64 offset64, UInt64 maxSize64, UInt64 *newoffset64 );
 int GetFileBitStreamData( atomOffsetEntry *aoe, Ptr bsDataP, UInt32 bsSize, UInt64 offset64, UInt64 *newoffset64 );
 int GetFileBitStreamDataToEndOfAtom( atomOffsetEntry *aoe, Ptr *bsDataPout, UInt32 *bsSizeout, UInt64 offset64, UInt64 *newoffset64 );
 int GetFileStartCode( atomOffsetEntry *aoe, UInt32 *startCode, UInt64 offset64, UInt64 *newoffset64 );
+int GetFileDataView( atomOffsetEntry *aoe, Ptr *dataPout, UInt64 offset64, UInt64 size64, UInt32 slop, UInt64 *newoffset64 );
+void ReleaseFileDataView( Ptr dataP );
+int MapInputFile( FILE *inFile );
+void UnmapInputFile( void );
+int StreamGetData( void *dataP, UInt64 offset, UInt64 size, UInt64 *amtReadOut );
+Boolean StreamHasData( UInt64 offset );
+void StreamSetLimit( UInt64 limit );
+void StreamRelease( UInt64 offset );
+UInt64 StreamDrain( void );
+void StreamClose( void );
+int OpenInputSegments( char **paths, long count );
+int OpenInputBuffers( const ValidateMP4Buffer *buffers, long count );
+int SegmentsGetData( void *dataP, UInt64 offset, UInt64 size, UInt64 *amtReadOut );
+Boolean InputSegmentHasAtom( long index, OSType atomType );
+void CloseInputSegments( void );
+
+
+// Declarative box bodies.  A BoxLayout lists the fields of a box body in file order: where each one
+//   lands in the decoded record, how wide it is in the file, and whether it is only there for some
+//   versions, flags or values of an earlier field.  The body is read once (a borrowed view of the
+//   mapping where there is one) and every field is decoded from memory with a single bounds check;
+//   whatever the layout does not describe is left at the cursor for the validator to pick up.
+enum {
+	kBoxFieldUInt = 1,		// big-endian unsigned integer, 'width' bytes in the file; may be cut to a bit field
+	kBoxFieldBits,			// another bit field of the word the previous kBoxFieldUInt read
+	kBoxFieldCString,		// nul-terminated string, copied into the arena (char *)
+	kBoxFieldArray			// 'count' records laid out by 'element', in an arena array (record *)
+};
+
+enum {
+	kBoxFieldAlways = 0,
+	kBoxFieldIfVersion,		// version == arg
+	kBoxFieldIfNotVersion,	// version != arg
+	kBoxFieldIfFlags,		// (flags & arg) != 0
+	kBoxFieldIfZero			// the earlier field with index arg decoded to zero
+};
+
+#define kBoxLayoutMaxFields	16
+
+typedef struct BoxLayout BoxLayout;
+
+typedef struct BoxField {
+	UInt8	kind;
+	UInt8	width;			// kBoxFieldUInt: bytes in the file, 1 to 8
+	UInt8	shift;			// bit fields: (word >> shift) & ((1 << bits) - 1)
+	UInt8	bits;			//   0 bits keeps the whole word
+	UInt8	when;
+	UInt8	count;			// kBoxFieldArray: index of the earlier field holding the element count
+	UInt16	dest;			// offsetof the member in the decoded record
+	UInt32	destSize;		// sizeof that member
+	UInt32	arg;
+	const BoxLayout *element;
+} BoxField;
+
+struct BoxLayout {
+	const BoxField *fields;
+	UInt32	numFields;
+	UInt32	recordSize;		// sizeof the decoded record, for arrays of them
+};
+
+#define BOX_MEMBER( rec, m )	(UInt16)offsetof(rec, m), (UInt32)sizeof(((rec *)0)->m)
+
+#define BOX_UINT( width, rec, m )							{ kBoxFieldUInt, (width), 0, 0, kBoxFieldAlways, 0, BOX_MEMBER(rec, m), 0, nil }
+#define BOX_UINT_IF( width, rec, m, when, arg )				{ kBoxFieldUInt, (width), 0, 0, (when), 0, BOX_MEMBER(rec, m), (arg), nil }
+#define BOX_BITFIELD( width, shift, bits, rec, m )			{ kBoxFieldUInt, (width), (shift), (bits), kBoxFieldAlways, 0, BOX_MEMBER(rec, m), 0, nil }
+#define BOX_BITS( shift, bits, rec, m )						{ kBoxFieldBits, 0, (shift), (bits), kBoxFieldAlways, 0, BOX_MEMBER(rec, m), 0, nil }
+#define BOX_CSTRING( rec, m )								{ kBoxFieldCString, 0, 0, 0, kBoxFieldAlways, 0, BOX_MEMBER(rec, m), 0, nil }
+#define BOX_ARRAY( count, element, rec, m )					{ kBoxFieldArray, 0, 0, 0, kBoxFieldAlways, (count), BOX_MEMBER(rec, m), 0, &(element) }
+#define BOX_ARRAY_IF( count, element, rec, m, when, arg )	{ kBoxFieldArray, 0, 0, 0, (when), (count), BOX_MEMBER(rec, m), (arg), &(element) }
+
+// DecodeBoxFields keeps a value per field on the stack, so a longer layout does not compile
+template <size_t numFields> struct BoxLayoutFieldCount {
+	static_assert( numFields <= kBoxLayoutMaxFields, "box layout has more than kBoxLayoutMaxFields fields" );
+	enum { value = numFields };
+};
+
+#define BOX_LAYOUT( fields, rec )	{ (fields), BoxLayoutFieldCount<sizeof(fields)/sizeof((fields)[0])>::value, sizeof(rec) }
+
+#define kBoxBodyLocalSize	256
+
+typedef struct BoxBody {
+	Ptr		view;			// the whole body, from GetFileDataView; nil when it is in local
+	const UInt8 *cur;		// next byte to decode
+	const UInt8 *end;
+	UInt64	offset;			// file offset of cur
+	UInt32	version;		// full boxes only
+	UInt32	flags;
+	UInt8	local[kBoxBodyLocalSize];	// small bodies, when there is no mapping to borrow from
+} BoxBody;
+
+int OpenBoxBody( atomOffsetEntry *aoe, Boolean fullBox, BoxBody *body );
+int DecodeBoxFields( BoxBody *body, const BoxLayout *layout, void *record );
+void CloseBoxBody( BoxBody *body );
+int DecodeFullBox( atomOffsetEntry *aoe, const BoxLayout *layout, void *record, UInt32 *version, UInt32 *flags );
+int SelectInputRange( void );
+int AddPayloadRange( UInt64 start, UInt64 end );
 
 OSErr Base64DecodeToBuffer(const char *inData, UInt32 *ioEncodedLength, char *outDecodedData, UInt32 *ioDecodedDataLength);
 
@@ -1042,6 +1459,7 @@ OSErr Validate_emsg_Atom( atomOffsetEntry *aoe, void *refcon );
 OSErr Validate_tfdt_Atom( atomOffsetEntry *aoe, void *refcon );
 OSErr Validate_senc_Atom( atomOffsetEntry *aoe, void *refcon );
 OSErr Validate_saio_Atom( atomOffsetEntry *aoe, void *refcon );
+OSErr Validate_saiz_Atom( atomOffsetEntry *aoe, void *refcon );
 OSErr Validate_sidx_Atom( atomOffsetEntry *aoe, void *refcon );
 
 OSErr Validate_edts_Atom( atomOffsetEntry *aoe, void *refcon );
@@ -1086,7 +1504,8 @@ OSErr Validate_pasp_Atom( atomOffsetEntry *aoe, void *refcon, char *esname );
 enum { 
 	kTypeAtomFlagMustHaveOne = 1<<0,
 	kTypeAtomFlagCanHaveAtMostOne = 1<<1,
-	kTypeAtomFlagMustBeFirst = 1<<2
+	kTypeAtomFlagMustBeFirst = 1<<2,
+	kTypeAtomFlagCountValidated = 1<<3		// atoms of this type validated by an earlier call still count (streamed input)
 };
 
 typedef OSErr (*ValidateAtomTypeProcPtr)( atomOffsetEntry *aoe, void *refcon );
@@ -1096,6 +1515,7 @@ typedef OSErr (*ValidateAtomTypeProcPtr)( atomOffsetEntry *aoe, void *refcon );
 OSErr ValidateAtomOfType( OSType theType, long flags, ValidateAtomTypeProcPtr validateProc, 
 		long cnt, atomOffsetEntry *list, void *refcon );
 
+// errstr takes two conversions: the expected value, then the one found
 #define FieldMustBe( num, value, errstr ) \
 do { if ((num) != (value)) { err = badAtomErr; warnprint(errstr "\n", (value), num); } } while (false)
 
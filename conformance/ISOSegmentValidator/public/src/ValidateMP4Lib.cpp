@@ -0,0 +1,74 @@
+/*
+
+This file contains Original Code and/or Modifications of Original Code
+as defined in and that are subject to the Apple Public Source License
+Version 2.0 (the 'License'). You may not use this file except in
+compliance with the License. Please obtain a copy of the License at
+http://www.opensource.apple.com/apsl/ and read it before using this
+file.
+
+The Original Code and all software distributed under the License are
+distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+Please see the License for the specific language governing rights and
+limitations under the License.
+
+*/
+
+
+#include "ValidateMP4.h"
+
+// The library API (ValidateMP4Lib.h). Each validation gets a context of its own, bound to the calling
+//   thread while it runs, and is otherwise what the command line does with the same arguments.
+
+static int RunValidation( int argc, const char *const argv[], const ValidateMP4Buffer *buffers, long numBuffers,
+							const char *outputDir, const ValidateMP4Callbacks *callbacks )
+{
+	ValidateGlobals *context = NewValidateContext( callbacks );
+	ValidateGlobals *previous;
+	int err;
+	
+	if (context == nil)
+		return allocFailedErr;
+	context->outputDir = outputDir;
+	context->inBuffers = buffers;
+	context->numInBuffers = numBuffers;
+	
+	previous = SetValidateContext( context );
+	err = ValidateMain( argc, (char **)argv );
+	DisposeValidateContext( context );
+	SetValidateContext( previous );
+	return err;
+}
+
+int ValidateMP4Buffers( const ValidateMP4Buffer *buffers, int numBuffers, int numOptions, const char *const options[],
+							const char *outputDir, const ValidateMP4Callbacks *callbacks )
+{
+	int err = noErr;
+	const char **argv = nil;
+	int i;
+	
+	BAILIF( (buffers == nil) || (numBuffers < 1), paramErr );
+	BAILIF( (numOptions < 0) || ((options == nil) && (numOptions > 0)), paramErr );
+	
+	// the program name, the options, and the nil after them
+	BAILIFNIL( argv = (const char **)calloc(numOptions + 2, sizeof(char *)), allocFailedErr );
+	argv[0] = "ValidateMP4";
+	for (i = 0; i < numOptions; i++)
+		argv[i + 1] = options[i];
+	
+	err = RunValidation( numOptions + 1, argv, buffers, numBuffers, outputDir, callbacks );
+
+bail:
+	free(argv);
+	return err;
+}
+
+int ValidateMP4Run( int argc, const char *const argv[], const char *outputDir, const ValidateMP4Callbacks *callbacks )
+{
+	if ((argc < 1) || (argv == nil))
+		return paramErr;
+	return RunValidation( argc, argv, nil, 0, outputDir, callbacks );
+}
@@ -0,0 +1,95 @@
+/*
+
+This file contains Original Code and/or Modifications of Original Code
+as defined in and that are subject to the Apple Public Source License
+Version 2.0 (the 'License'). You may not use this file except in
+compliance with the License. Please obtain a copy of the License at
+http://www.opensource.apple.com/apsl/ and read it before using this
+file.
+
+The Original Code and all software distributed under the License are
+distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+Please see the License for the specific language governing rights and
+limitations under the License.
+
+*/
+
+
+#ifndef _SRC_VALIDATE_MP4_LIB_H_
+#define _SRC_VALIDATE_MP4_LIB_H_
+
+// The validator as a library (libValidateMP4.a; ValidateMP4.exe is a thin client of it).
+//   A validation takes the same options as the command line and gives the same results, but the
+//   input can be buffers in memory, and what the command line prints comes back through callbacks.
+//   Validations are independent of each other: several can run at once, on different threads.
+//   A validation checking samples uses one thread unless it is given more with -threads ("0" for
+//   one per processor); when you run several at once, one each is usually what you want.
+//   The library is C++ inside, so link it with the C++ runtime (g++, or -lstdc++).
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// What a validation returns: 0 if the input was validated to the end (which says nothing about
+//   whether it conforms; that's what the diagnostics are for), otherwise why it stopped.
+//   Other negative values are errors from the system.
+enum {
+	kValidateMP4NoErr			= 0,
+	kValidateMP4UsageErr		= -1,		// bad options, or an input or option file we could not open
+	kValidateMP4ParamErr		= -50,
+	kValidateMP4AllocFailedErr	= -2019,
+	kValidateMP4OutOfDataErr	= -2020,	// the input ends in the middle of a box
+	kValidateMP4TooMuchDataErr	= -2021,
+	kValidateMP4NoCanDoErr		= -2022,	// could not read the input
+	kValidateMP4BadAtomSizeErr	= -2023,
+	kValidateMP4BadAtomErr		= -2024,
+	kValidateMP4AtomOverRunErr	= -2025
+};
+
+// kinds of diagnostic
+enum {
+	kValidateMP4Error			= 1,		// the input does not conform
+	kValidateMP4Warning			= 2,		// it may not (-warnings, on by default)
+	kValidateMP4Message			= 3			// anything else the command line prints on stderr: usage, options, input trouble
+};
+
+// Where the output goes. report gets what the command line prints on stdout: the XML-ish report of
+//   the boxes (with -printtype), the notes on the run, and so on, in pieces that make it up when
+//   concatenated. diagnostic gets one error, warning or message at a time; atomPath is the path of
+//   the box being validated for errors and warnings (e.g. "moov-1:trak-1:tkhd-1"), and nil for
+//   messages. text is not nul-terminated for the report; it is for diagnostics. Either callback
+//   can be nil if you don't want that output, which also saves the work of formatting it.
+typedef struct ValidateMP4Callbacks {
+	void *refcon;
+	void (*report)( void *refcon, const char *text, size_t length );
+	void (*diagnostic)( void *refcon, int kind, const char *atomPath, const char *text, size_t length );
+} ValidateMP4Callbacks;
+
+typedef struct ValidateMP4Buffer {
+	const void *data;
+	unsigned long long size;
+} ValidateMP4Buffer;
+
+// Validates the buffers as one input, as if they were concatenated; like giving the command line
+//   several input files, each buffer is a segment (the first one is the initialization segment if it
+//   has a 'moov'). A single buffer is like a single input file. The buffers are only read, and not
+//   after this returns. options are the command line options (e.g. "-checklevel", "2", "-dash264base"),
+//   without the program name and without input files. The files some options write (atominfo.xml,
+//   leafinfo.txt, ...) go into outputDir, or the current directory if it is nil. callbacks can be
+//   nil to print to stdout and stderr as the command line does.
+int ValidateMP4Buffers( const ValidateMP4Buffer *buffers, int numBuffers, int numOptions, const char *const options[],
+							const char *outputDir, const ValidateMP4Callbacks *callbacks );
+
+// Validates as the command line does with these arguments (argv[0] being the program name), input files and all.
+int ValidateMP4Run( int argc, const char *const argv[], const char *outputDir, const ValidateMP4Callbacks *callbacks );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,46 @@
+/*
+
+This file contains Original Code and/or Modifications of Original Code
+as defined in and that are subject to the Apple Public Source License
+Version 2.0 (the 'License'). You may not use this file except in
+compliance with the License. Please obtain a copy of the License at
+http://www.opensource.apple.com/apsl/ and read it before using this
+file.
+
+The Original Code and all software distributed under the License are
+distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+Please see the License for the specific language governing rights and
+limitations under the License.
+
+*/
+
+
+#include "ValidateMP4Lib.h"
+#if STAND_ALONE_APP
+	#include "console.h"
+#endif
+
+//#define STAND_ALONE_APP 1  //  #define this if you're using a source level debugger (i.e. Visual C++ in Windows)
+							  //  also, near the beginning of main(), hard-code your arguments (e.g. your test file)
+
+// The command line: the validator library run on the files in the arguments, printing to stdout and stderr
+
+#if !STAND_ALONE_APP
+int main(int argc, char *argv[]);
+int main(int argc, char *argv[])
+{
+#else
+int main(void);
+int main(void)
+{
+	char *argv[] = {
+		"ValidateMP4",
+		"<mpeg4-file-path>"
+		};
+	int argc = sizeof(argv)/sizeof(char*);
+#endif
+	return ValidateMP4Run( argc, argv, NULL, NULL );
+}
@@ -0,0 +1,465 @@
+/*
+
+This file contains Original Code and/or Modifications of Original Code
+as defined in and that are subject to the Apple Public Source License
+Version 2.0 (the 'License'). You may not use this file except in
+compliance with the License. Please obtain a copy of the License at
+http://www.opensource.apple.com/apsl/ and read it before using this
+file.
+
+The Original Code and all software distributed under the License are
+distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+Please see the License for the specific language governing rights and
+limitations under the License.
+
+*/
+
+
+#if defined(_MSC_VER)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <pthread.h>
+	#include <unistd.h>
+#endif
+
+#include "ValidateMP4.h"
+
+// Worker threads for the sample validation (-threads).
+//   A task runs on a worker with vg bound to a copy of the submitting thread's context, taken when
+//   it was submitted, whose output is recorded rather than passed on. The submitting thread passes
+//   the recorded output on to its own vg.output in the order the tasks were submitted, so the report
+//   and the diagnostics come out just as if it had run the tasks itself, one after the other.
+//   A task must only read what it shares with the submitting thread (the TrackInfoRec, the sample
+//   descriptions, ...); anything it changes in vg is its own copy, and is dropped when it is done.
+
+#if defined(_MSC_VER)
+	typedef HANDLE				TaskThread;
+	typedef CRITICAL_SECTION	TaskMutex;
+	typedef CONDITION_VARIABLE	TaskCondition;
+
+	#define TaskMutexInit( m )				InitializeCriticalSection( m )
+	#define TaskMutexDispose( m )			DeleteCriticalSection( m )
+	#define TaskMutexLock( m )				EnterCriticalSection( m )
+	#define TaskMutexUnlock( m )			LeaveCriticalSection( m )
+	#define TaskConditionInit( c )			InitializeConditionVariable( c )
+	#define TaskConditionDispose( c )
+	#define TaskConditionWait( c, m )		SleepConditionVariableCS( (c), (m), INFINITE )
+	#define TaskConditionSignal( c )		WakeConditionVariable( c )
+	#define TaskConditionBroadcast( c )		WakeAllConditionVariable( c )
+#else
+	typedef pthread_t			TaskThread;
+	typedef pthread_mutex_t		TaskMutex;
+	typedef pthread_cond_t		TaskCondition;
+
+	#define TaskMutexInit( m )				pthread_mutex_init( (m), nil )
+	#define TaskMutexDispose( m )			pthread_mutex_destroy( m )
+	#define TaskMutexLock( m )				pthread_mutex_lock( m )
+	#define TaskMutexUnlock( m )			pthread_mutex_unlock( m )
+	#define TaskConditionInit( c )			pthread_cond_init( (c), nil )
+	#define TaskConditionDispose( c )		pthread_cond_destroy( c )
+	#define TaskConditionWait( c, m )		pthread_cond_wait( (c), (m) )
+	#define TaskConditionSignal( c )		pthread_cond_signal( c )
+	#define TaskConditionBroadcast( c )		pthread_cond_broadcast( c )
+#endif
+
+#define kMaxValidateThreads		64
+#define kTasksPerThread			2		// how many tasks we let each worker have queued up, or running
+#define kReportOutput			0		// the kind of output that isn't a diagnostic, as in ValidateMP4.cpp
+
+// The recorded output is a run of records, each a RecordHeader followed by the atom path and then
+//   the text, both nul-terminated; consecutive report text is gathered into one record.
+typedef struct RecordHeader {
+	int kind;				// kReportOutput or a diagnostic kind
+	long pathLength;		// -1 if there is no atom path
+	size_t textLength;
+} RecordHeader;
+
+typedef struct ValidateTask {
+	struct ValidateTask *next;
+	ValidateTaskProcPtr proc;
+	void *taskData;
+	Boolean done;
+	Boolean outputLost;		// we could not allocate to record some of it
+
+	char *records;
+	size_t recordsSize;
+	size_t recordsAllocated;
+	size_t lastRecord;		// offset of the last record, if recordsSize isn't zero
+
+	ValidateGlobals context;
+} ValidateTask;
+
+struct ValidateTaskQueue {
+	TaskMutex mutex;
+	TaskCondition workReady;	// there is a task to run, or the workers are to quit
+	TaskCondition taskDone;
+
+	ValidateTask *oldest;		// the tasks whose output we have yet to pass on, in the order submitted
+	ValidateTask *newest;
+	ValidateTask *nextToRun;	// the first of them that no worker has started
+	long numPending;
+	long maxPending;
+	Boolean quit;
+
+	ValidateTask *hereTask;		// records the submitting thread's own output, between BeginHere and EndHere
+	ValidateMP4Callbacks hereOutput;	// what it replaced
+	Boolean recordingHere;
+
+	long numThreads;
+	TaskThread threads[kMaxValidateThreads];
+};
+
+//==========================================================================================
+
+// Number of processors we can run on, for -threads 0
+long ValidateProcessorCount( void )
+{
+	long count;
+
+#if defined(_MSC_VER)
+	SYSTEM_INFO info;
+
+	GetSystemInfo( &info );
+	count = info.dwNumberOfProcessors;
+#else
+	count = sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+	if (count < 1)
+		count = 1;
+	if (count > kMaxValidateThreads)
+		count = kMaxValidateThreads;
+	return count;
+}
+
+//==========================================================================================
+
+static Boolean RecordReserve( ValidateTask *task, size_t more )
+{
+	size_t newSize;
+	char *records;
+
+	if (task->recordsSize + more <= task->recordsAllocated)
+		return true;
+	newSize = task->recordsAllocated ? task->recordsAllocated * 2 : 4096;
+	while (newSize < task->recordsSize + more)
+		newSize *= 2;
+	records = (char *)realloc( task->records, newSize );
+	if (records == nil) {
+		task->outputLost = true;
+		return false;
+	}
+	task->records = records;
+	task->recordsAllocated = newSize;
+	return true;
+}
+
+static void RecordOutput( ValidateTask *task, int kind, const char *atomPath, const char *text, size_t length )
+{
+	RecordHeader header;
+	long pathLength = atomPath ? (long)strlen(atomPath) : -1;
+	char *p;
+
+	if ((kind == kReportOutput) && task->recordsSize) {
+		memcpy( &header, task->records + task->lastRecord, sizeof(header) );
+		if (header.kind == kReportOutput) {
+			if (!RecordReserve( task, length ))
+				return;
+			// over the nul that ended the text
+			memcpy( task->records + task->recordsSize - 1, text, length );
+			task->records[task->recordsSize - 1 + length] = 0;
+			task->recordsSize += length;
+			header.textLength += length;
+			memcpy( task->records + task->lastRecord, &header, sizeof(header) );
+			return;
+		}
+	}
+
+	if (!RecordReserve( task, sizeof(header) + (pathLength + 1) + (length + 1) ))
+		return;
+	header.kind = kind;
+	header.pathLength = pathLength;
+	header.textLength = length;
+	task->lastRecord = task->recordsSize;
+	p = task->records + task->recordsSize;
+	memcpy( p, &header, sizeof(header) );
+	p += sizeof(header);
+	if (pathLength >= 0) {
+		memcpy( p, atomPath, pathLength + 1 );
+		p += pathLength + 1;
+	}
+	memcpy( p, text, length );
+	p[length] = 0;
+	task->recordsSize = (p + length + 1) - task->records;
+}
+
+static void RecordReport( void *refcon, const char *text, size_t length )
+{
+	RecordOutput( (ValidateTask *)refcon, kReportOutput, nil, text, length );
+}
+
+static void RecordDiagnostic( void *refcon, int kind, const char *atomPath, const char *text, size_t length )
+{
+	RecordOutput( (ValidateTask *)refcon, kind, atomPath, text, length );
+}
+
+// Passes the task's output on to vg.output, as it would have gone had we run the task ourselves
+static void ReplayOutput( ValidateTask *task )
+{
+	size_t offset = 0;
+	RecordHeader header;
+	const char *atomPath;
+	const char *text;
+
+	while (offset < task->recordsSize) {
+		memcpy( &header, task->records + offset, sizeof(header) );
+		atomPath = nil;
+		text = task->records + offset + sizeof(header);
+		if (header.pathLength >= 0) {
+			atomPath = text;
+			text += header.pathLength + 1;
+		}
+		if (header.kind == kReportOutput)
+			vg.output.report( vg.output.refcon, text, header.textLength );
+		else
+			vg.output.diagnostic( vg.output.refcon, header.kind, atomPath, text, header.textLength );
+		offset = (text + header.textLength + 1) - task->records;
+	}
+	if (task->outputLost)
+		messageprint( "Out of memory while validating samples in parallel: some of their output was lost\n" );
+}
+
+//==========================================================================================
+
+#if defined(_MSC_VER)
+static DWORD WINAPI TaskWorker( LPVOID refcon )
+#else
+static void *TaskWorker( void *refcon )
+#endif
+{
+	ValidateTaskQueue *queue = (ValidateTaskQueue *)refcon;
+	ValidateTask *task;
+
+	TaskMutexLock( &queue->mutex );
+	for (;;) {
+		while ((queue->nextToRun == nil) && !queue->quit)
+			TaskConditionWait( &queue->workReady, &queue->mutex );
+		if (queue->nextToRun == nil)
+			break;
+		task = queue->nextToRun;
+		queue->nextToRun = task->next;
+		while (queue->nextToRun && queue->nextToRun->done)	// recorded by the submitting thread: nothing to run
+			queue->nextToRun = queue->nextToRun->next;
+		TaskMutexUnlock( &queue->mutex );
+
+		SetValidateContext( &task->context );
+		task->proc( task->taskData );
+		SetValidateContext( nil );
+
+		TaskMutexLock( &queue->mutex );
+		task->done = true;
+		TaskConditionBroadcast( &queue->taskDone );
+	}
+	TaskMutexUnlock( &queue->mutex );
+	return 0;
+}
+
+static Boolean StartTaskThread( ValidateTaskQueue *queue, TaskThread *thread )
+{
+#if defined(_MSC_VER)
+	*thread = CreateThread( nil, 0, TaskWorker, queue, 0, nil );
+	return (*thread != nil);
+#else
+	return (pthread_create( thread, nil, TaskWorker, queue ) == 0);
+#endif
+}
+
+static void JoinTaskThread( TaskThread thread )
+{
+#if defined(_MSC_VER)
+	WaitForSingleObject( thread, INFINITE );
+	CloseHandle( thread );
+#else
+	pthread_join( thread, nil );
+#endif
+}
+
+// Passes on the output of the oldest task, waiting for it to be done if wait is set
+static Boolean RetireOldestTask( ValidateTaskQueue *queue, Boolean wait )
+{
+	ValidateTask *task;
+
+	TaskMutexLock( &queue->mutex );
+	task = queue->oldest;
+	if (wait) {
+		while (task && !task->done)
+			TaskConditionWait( &queue->taskDone, &queue->mutex );
+	}
+	if (task && task->done) {
+		queue->oldest = task->next;
+		if (queue->oldest == nil)
+			queue->newest = nil;
+		queue->numPending--;
+	} else
+		task = nil;
+	TaskMutexUnlock( &queue->mutex );
+
+	if (task == nil)
+		return false;
+	ReplayOutput( task );
+	free( task->records );
+	free( task );
+	return true;
+}
+
+// Points output at the task's record; output nobody wants stays unformatted
+static void RecordOutputOf( ValidateTask *task, ValidateMP4Callbacks *output )
+{
+	output->refcon = task;
+	if (output->report)
+		output->report = RecordReport;
+	if (output->diagnostic)
+		output->diagnostic = RecordDiagnostic;
+}
+
+// Adds the task to the end of the queue; one that is done already was recorded by the submitting thread
+static void AppendTask( ValidateTaskQueue *queue, ValidateTask *task )
+{
+	TaskMutexLock( &queue->mutex );
+	if (queue->newest)
+		queue->newest->next = task;
+	else
+		queue->oldest = task;
+	queue->newest = task;
+	queue->numPending++;
+	if (!task->done) {
+		if (queue->nextToRun == nil)
+			queue->nextToRun = task;
+		TaskConditionSignal( &queue->workReady );
+	}
+	TaskMutexUnlock( &queue->mutex );
+}
+
+//==========================================================================================
+
+// A queue with numThreads workers; nil if we could not start any
+ValidateTaskQueue *NewValidateTaskQueue( long numThreads )
+{
+	ValidateTaskQueue *queue;
+
+	if (numThreads > kMaxValidateThreads)
+		numThreads = kMaxValidateThreads;
+	queue = (ValidateTaskQueue *)calloc( 1, sizeof(ValidateTaskQueue) );
+	if (queue == nil)
+		return nil;
+	TaskMutexInit( &queue->mutex );
+	TaskConditionInit( &queue->workReady );
+	TaskConditionInit( &queue->taskDone );
+	queue->maxPending = numThreads * kTasksPerThread;
+
+	while (queue->numThreads < numThreads) {
+		if (!StartTaskThread( queue, &queue->threads[queue->numThreads] ))
+			break;
+		queue->numThreads++;
+	}
+	if (queue->numThreads == 0) {
+		DisposeValidateTaskQueue( queue );
+		return nil;
+	}
+	return queue;
+}
+
+// Runs proc(taskData) on a worker; proc owns taskData from here on. If the queue is full, this first
+//   waits for the oldest task and passes its output on; it passes on that of any others already done.
+void ValidateTaskQueue_Submit( ValidateTaskQueue *queue, ValidateTaskProcPtr proc, void *taskData )
+{
+	ValidateTask *task;
+
+	while (queue->numPending >= queue->maxPending)
+		RetireOldestTask( queue, true );
+
+	task = (ValidateTask *)calloc( 1, sizeof(ValidateTask) );
+	if (task == nil) {
+		// run it here, once what came before it is out
+		ValidateTaskQueue_Finish( queue );
+		proc( taskData );
+		return;
+	}
+	task->proc = proc;
+	task->taskData = taskData;
+	task->context = vg;
+	RecordOutputOf( task, &task->context.output );
+	AppendTask( queue, task );
+
+	while (RetireOldestTask( queue, false ))
+		;
+}
+
+// The submitting thread's own output, between ValidateTaskQueue_BeginHere and _EndHere, has to wait
+//   for that of the tasks it submitted before: it is recorded, and passed on after theirs.
+void ValidateTaskQueue_BeginHere( ValidateTaskQueue *queue )
+{
+	if (queue->numPending == 0)
+		return;
+	if (queue->hereTask == nil) {
+		queue->hereTask = (ValidateTask *)calloc( 1, sizeof(ValidateTask) );
+		if (queue->hereTask == nil) {
+			ValidateTaskQueue_Finish( queue );
+			return;
+		}
+	}
+	queue->hereOutput = vg.output;
+	RecordOutputOf( queue->hereTask, &vg.output );
+	queue->recordingHere = true;
+}
+
+void ValidateTaskQueue_EndHere( ValidateTaskQueue *queue )
+{
+	ValidateTask *task = queue->hereTask;
+
+	if (!queue->recordingHere)
+		return;
+	vg.output = queue->hereOutput;
+	queue->recordingHere = false;
+	if ((task->recordsSize == 0) && !task->outputLost)
+		return;		// nothing to wait; keep it for next time
+	queue->hereTask = nil;
+	task->done = true;
+	AppendTask( queue, task );
+}
+
+// Waits for all the tasks submitted, passing their output on
+void ValidateTaskQueue_Finish( ValidateTaskQueue *queue )
+{
+	ValidateTaskQueue_EndHere( queue );
+	while (queue->numPending)
+		RetireOldestTask( queue, true );
+}
+
+void DisposeValidateTaskQueue( ValidateTaskQueue *queue )
+{
+	long i;
+
+	if (queue == nil)
+		return;
+	ValidateTaskQueue_Finish( queue );
+
+	TaskMutexLock( &queue->mutex );
+	queue->quit = true;
+	TaskConditionBroadcast( &queue->workReady );
+	TaskMutexUnlock( &queue->mutex );
+	for (i = 0; i < queue->numThreads; i++)
+		JoinTaskThread( queue->threads[i] );
+
+	if (queue->hereTask) {
+		free( queue->hereTask->records );
+		free( queue->hereTask );
+	}
+	TaskConditionDispose( &queue->taskDone );
+	TaskConditionDispose( &queue->workReady );
+	TaskMutexDispose( &queue->mutex );
+	free( queue );
+}
@@ -0,0 +1,135 @@
+/*
+
+This file contains Original Code and/or Modifications of Original Code
+as defined in and that are subject to the Apple Public Source License
+Version 2.0 (the 'License'). You may not use this file except in
+compliance with the License. Please obtain a copy of the License at
+http://www.opensource.apple.com/apsl/ and read it before using this
+file.
+
+The Original Code and all software distributed under the License are
+distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+Please see the License for the specific language governing rights and
+limitations under the License.
+
+*/
+
+// Microbenchmark for the bulk big-endian decode of the sample tables (EndianU32Array_BtoN).
+//   It compares the library kernel (a plain loop, auto-vectorised and, with gcc on x86-64
+//   Linux, dispatched through target_clones) with the per-entry loop it replaced compiled
+//   without vectorisation, and on x86-64 with a hand-written SSSE3 pshufb loop, to show
+//   whether explicit intrinsics would buy anything over what the compiler produces.
+//
+//   EndianBench [entries] [repeats]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ValidateMP4.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+	#include <immintrin.h>
+	#define HAVE_SSSE3_REFERENCE 1
+#endif
+
+typedef void (*SwapProc)( UInt32 *values, UInt64 count );
+
+// what the table validators did before: one swap per entry, no vector code
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-tree-vectorize")))
+#endif
+static void ScalarSwap( UInt32 *values, UInt64 count )
+{
+	UInt64 i;
+
+	for (i = 0; i < count; i++)
+		values[i] = EndianU32_BtoN(values[i]);
+}
+
+#if HAVE_SSSE3_REFERENCE
+__attribute__((target("ssse3")))
+static void Ssse3Swap( UInt32 *values, UInt64 count )
+{
+	const __m128i order = _mm_set_epi8( 12,13,14,15, 8,9,10,11, 4,5,6,7, 0,1,2,3 );
+	UInt64 i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128( (const __m128i *)&values[i] );
+		_mm_storeu_si128( (__m128i *)&values[i], _mm_shuffle_epi8( v, order ) );
+	}
+	for (; i < count; i++)
+		values[i] = EndianU32_BtoN(values[i]);
+}
+#endif
+
+static double Seconds( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// best time of repeats passes over a fresh copy of the table, in milliseconds
+static double TimeSwap( SwapProc proc, const UInt32 *table, UInt32 *work, UInt64 count, int repeats, UInt32 *checkOut )
+{
+	double best = 1e30;
+	int r;
+
+	for (r = 0; r < repeats; r++) {
+		double t;
+
+		memcpy( work, table, count * sizeof(UInt32) );
+		t = Seconds();
+		proc( work, count );
+		t = Seconds() - t;
+		if (t < best)
+			best = t;
+	}
+	*checkOut = work[0] ^ work[count / 2] ^ work[count - 1];
+	return best * 1000;
+}
+
+int main( int argc, char *argv[] )
+{
+	UInt64 count = (argc > 1) ? strtoull( argv[1], NULL, 10 ) : 2000000;	// a 1M entry stts
+	int repeats = (argc > 2) ? atoi( argv[2] ) : 50;
+	UInt32 *table, *work;
+	UInt32 check, expected;
+	UInt64 i;
+	double ms;
+
+	if (count < 1 || repeats < 1) {
+		fprintf( stderr, "usage: %s [entries] [repeats]\n", argv[0] );
+		return 1;
+	}
+	table = (UInt32 *)malloc( count * sizeof(UInt32) );
+	work = (UInt32 *)malloc( count * sizeof(UInt32) );
+	if (!table || !work) {
+		fprintf( stderr, "out of memory\n" );
+		return 1;
+	}
+	srand( 8 );
+	for (i = 0; i < count; i++)
+		table[i] = ((UInt32)rand() << 16) ^ (UInt32)rand();
+
+	printf( "%llu entries, best of %d\n", (unsigned long long)count, repeats );
+	ms = TimeSwap( ScalarSwap, table, work, count, repeats, &expected );
+	printf( "  per-entry loop          %8.3f ms  %6.2f GB/s\n", ms, count * 4 / ms / 1e6 );
+	ms = TimeSwap( EndianU32Array_BtoN, table, work, count, repeats, &check );
+	printf( "  EndianU32Array_BtoN     %8.3f ms  %6.2f GB/s%s\n", ms, count * 4 / ms / 1e6, (check == expected) ? "" : "  WRONG RESULT" );
+#if HAVE_SSSE3_REFERENCE
+	if (__builtin_cpu_supports( "ssse3" )) {
+		ms = TimeSwap( Ssse3Swap, table, work, count, repeats, &check );
+		printf( "  SSSE3 intrinsics        %8.3f ms  %6.2f GB/s%s\n", ms, count * 4 / ms / 1e6, (check == expected) ? "" : "  WRONG RESULT" );
+	}
+#endif
+	free( table );
+	free( work );
+	return (check == expected) ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+/*
+
+This file contains Original Code and/or Modifications of Original Code
+as defined in and that are subject to the Apple Public Source License
+Version 2.0 (the 'License'). You may not use this file except in
+compliance with the License. Please obtain a copy of the License at
+http://www.opensource.apple.com/apsl/ and read it before using this
+file.
+
+The Original Code and all software distributed under the License are
+distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+Please see the License for the specific language governing rights and
+limitations under the License.
+
+*/
+
+// Concurrency stress test for the library (ValidateMP4Lib.h). Each input file is loaded into
+//   a buffer and validated once on its own; then the threads validate them all at once, each
+//   thread starting at a different input so that different buffers are in flight together, and
+//   every result (return value, report and diagnostics) has to be the same as the one on its own.
+//   The files the options write go to outputDir/serial and outputDir/thread-<n>.
+//
+//   LibStress outputDir threads iterations [options] -- input ...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "ValidateMP4Lib.h"
+
+struct Result {
+	int			rc;
+	std::string	report;
+	std::string	diagnostics;
+};
+
+struct Input {
+	const char			*path;
+	std::vector<char>	data;
+	Result				expected;
+};
+
+static std::vector<Input> inputs;
+static std::vector<const char *> options;
+static const char *outputRoot;
+static int iterations;
+
+static pthread_mutex_t failureLock = PTHREAD_MUTEX_INITIALIZER;
+static int failures;
+
+static void Report( void *refcon, const char *text, size_t length )
+{
+	((Result *)refcon)->report.append( text, length );
+}
+
+static void Diagnostic( void *refcon, int kind, const char *atomPath, const char *text, size_t length )
+{
+	Result *result = (Result *)refcon;
+	char header[16];
+
+	snprintf( header, sizeof(header), "[%d] ", kind );
+	result->diagnostics += header;
+	if (atomPath != NULL) {
+		result->diagnostics += atomPath;
+		result->diagnostics += ": ";
+	}
+	result->diagnostics.append( text, length );
+}
+
+static void Validate( Input *input, const char *outputDir, Result *result )
+{
+	ValidateMP4Buffer buffer = { input->data.data(), input->data.size() };
+	ValidateMP4Callbacks callbacks = { result, Report, Diagnostic };
+
+	result->rc = ValidateMP4Buffers( &buffer, 1, (int)options.size(), options.data(), outputDir, &callbacks );
+}
+
+static void *Worker( void *arg )
+{
+	long thread = (long)arg;
+	char dir[1024];
+
+	snprintf( dir, sizeof(dir), "%s/thread-%ld", outputRoot, thread );
+	mkdir( dir, 0777 );
+	for (int i = 0; i < iterations; i++) {
+		for (size_t k = 0; k < inputs.size(); k++) {
+			Input *input = &inputs[(thread + k) % inputs.size()];
+			Result result;
+			const char *what = NULL;
+
+			Validate( input, dir, &result );
+			if (result.rc != input->expected.rc)
+				what = "return value";
+			else if (result.report != input->expected.report)
+				what = "report";
+			else if (result.diagnostics != input->expected.diagnostics)
+				what = "diagnostics";
+			if (what != NULL) {
+				pthread_mutex_lock( &failureLock );
+				fprintf( stderr, "FAIL: %s: %s on thread %ld (iteration %d) differs from the serial run\n", input->path, what, thread, i + 1 );
+				failures++;
+				pthread_mutex_unlock( &failureLock );
+			}
+		}
+	}
+	return NULL;
+}
+
+static bool LoadInput( const char *path, Input *input )
+{
+	FILE *f = fopen( path, "rb" );
+	long size;
+
+	if (f == NULL)
+		return false;
+	input->path = path;
+	if (fseek( f, 0, SEEK_END ) != 0 || (size = ftell( f )) < 0 || fseek( f, 0, SEEK_SET ) != 0) {
+		fclose( f );
+		return false;
+	}
+	input->data.resize( size );
+	if (size > 0 && fread( input->data.data(), 1, size, f ) != (size_t)size) {
+		fclose( f );
+		return false;
+	}
+	fclose( f );
+	return true;
+}
+
+int main( int argc, char *argv[] )
+{
+	std::vector<pthread_t> threads;
+	char dir[1024];
+	int numThreads;
+	int i;
+
+	if (argc < 5) {
+		fprintf( stderr, "Usage: LibStress outputDir threads iterations [options] -- input ...\n" );
+		return 1;
+	}
+	outputRoot = argv[1];
+	numThreads = atoi( argv[2] );
+	iterations = atoi( argv[3] );
+	for (i = 4; i < argc && strcmp( argv[i], "--" ) != 0; i++)
+		options.push_back( argv[i] );
+	if (numThreads < 1 || iterations < 1 || i + 1 >= argc) {
+		fprintf( stderr, "Usage: LibStress outputDir threads iterations [options] -- input ...\n" );
+		return 1;
+	}
+
+	inputs.resize( argc - i - 1 );
+	for (size_t k = 0; k < inputs.size(); k++)
+		if (!LoadInput( argv[i + 1 + k], &inputs[k] )) {
+			fprintf( stderr, "Could not read %s\n", argv[i + 1 + k] );
+			return 1;
+		}
+
+	mkdir( outputRoot, 0777 );
+	snprintf( dir, sizeof(dir), "%s/serial", outputRoot );
+	mkdir( dir, 0777 );
+	for (size_t k = 0; k < inputs.size(); k++)
+		Validate( &inputs[k], dir, &inputs[k].expected );
+
+	threads.resize( numThreads );
+	for (long t = 0; t < numThreads; t++)
+		if (pthread_create( &threads[t], NULL, Worker, (void *)t ) != 0) {
+			fprintf( stderr, "Could not start thread %ld\n", t );
+			return 1;
+		}
+	for (int t = 0; t < numThreads; t++)
+		pthread_join( threads[t], NULL );
+
+	printf( "%d validations of %d inputs on %d threads, %d differ from the serial run\n",
+		numThreads * iterations * (int)inputs.size(), (int)inputs.size(), numThreads, failures );
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+#! /usr/bin/env python3
+#
+# Writes a plain (not fragmented) MP4 with --tracks avc1 video tracks for the sample validation
+# cases and benchmarks (-checklevel 2).  Each sample is length-prefixed NAL units: an access unit
+# delimiter, then every 30th sample an SPS, a PPS and an IDR slice, otherwise a non-IDR slice.
+# The parameter sets are real Baseline profile ones, so they validate; slice data is random.
+# With --bad some samples get a NAL unit with the forbidden zero bit set, trailing zero bytes, or
+# a length running past the end of the sample, so that the sample validation has errors to report.
+# With --zero-length the first NAL unit of the second sample has a length of zero.  With --hint
+# the tracks have a 'hint' handler, and the validator reads hint samples at any -checklevel.
+#
+#   make_avc.py [options] out.mp4
+
+import argparse, random, struct
+
+def box(t, payload): return struct.pack('>I4s', 8+len(payload), t) + payload
+def full(t, v, f, payload): return box(t, struct.pack('>I', (v<<24)|f) + payload)
+
+W, H = 320, 240
+ident = struct.pack('>9I', 0x10000,0,0,0,0x10000,0,0,0,0x40000000)
+
+class BitWriter:
+	def __init__(self): self.bits = []
+	def u(self, n, v): self.bits += [(v >> (n-1-i)) & 1 for i in range(n)]
+	def ue(self, v):
+		v += 1
+		n = v.bit_length()
+		self.u(n-1, 0)
+		self.u(n, v)
+	def se(self, v): self.ue(2*v-1 if v > 0 else -2*v)
+	def rbsp(self):
+		self.u(1, 1)
+		while len(self.bits) % 8: self.u(1, 0)
+		return bytes(int(''.join(map(str, self.bits[i:i+8])), 2) for i in range(0, len(self.bits), 8))
+
+def emulation_prevention(b):
+	out, zeros = bytearray(), 0
+	for c in b:
+		if zeros >= 2 and c <= 3:
+			out.append(3)
+			zeros = 0
+		out.append(c)
+		zeros = zeros+1 if c == 0 else 0
+	return bytes(out)
+
+def parameter_sets():
+	b = BitWriter()
+	b.u(8,66); b.u(8,0xc0); b.u(8,30); b.ue(0); b.ue(0); b.ue(2); b.ue(1); b.u(1,0)
+	b.ue(W//16-1); b.ue(H//16-1); b.u(1,1); b.u(1,1); b.u(1,0); b.u(1,0)
+	sps = bytes([0x67]) + emulation_prevention(b.rbsp())
+	b = BitWriter()
+	b.ue(0); b.ue(0); b.u(1,0); b.u(1,0); b.ue(0); b.ue(0); b.ue(0); b.u(1,0); b.u(2,0)
+	b.se(0); b.se(0); b.se(0); b.u(1,1); b.u(1,0); b.u(1,0)
+	pps = bytes([0x68]) + emulation_prevention(b.rbsp())
+	return sps, pps
+
+def main():
+	ap = argparse.ArgumentParser()
+	ap.add_argument('out')
+	ap.add_argument('--tracks', type=int, default=1)
+	ap.add_argument('--samples', type=int, default=300, help='samples per track')
+	ap.add_argument('--sample-size', type=int, default=2000, help='average bytes of slice data per sample')
+	ap.add_argument('--bad', action='store_true', help='put some malformed NAL units in')
+	ap.add_argument('--zero-length', action='store_true', help='give a NAL unit a length of zero')
+	ap.add_argument('--hint', action='store_true', help="make the tracks 'hint' tracks")
+	ap.add_argument('--seed', type=int, default=25)
+	args = ap.parse_args()
+	random.seed(args.seed)
+
+	ntracks, nsamples, avg = args.tracks, args.samples, args.sample_size
+	spc, ts, dur = 10, 90000, 3000
+	sps, pps = parameter_sets()
+	avcC = box(b'avcC', bytes([1,66,0xc0,30,0xff,0xe1]) + struct.pack('>H',len(sps)) + sps + bytes([1]) + struct.pack('>H',len(pps)) + pps)
+	avc1 = box(b'avc1', b'\0'*6 + struct.pack('>H',1) + b'\0'*16 + struct.pack('>HHIIIH',W,H,0x480000,0x480000,0,1) + bytes([0]) + b'\0'*31 + struct.pack('>Hh',0x18,-1) + avcC)
+
+	def nal(t, payload): return struct.pack('>I', len(payload)+1) + bytes([t]) + payload
+	def slice_data(n): return emulation_prevention(random.randbytes(n-1) + bytes([0x80]))
+
+	tracks = []
+	for t in range(ntracks):
+		samples = []
+		for i in range(nsamples):
+			size = random.randint(avg//2, avg*3//2)
+			s = nal(0x09, bytes([0xf0]))
+			if args.zero_length and i == 1:
+				s = struct.pack('>I', 0) + s[4:]
+			if i % 30 == 0:
+				s += struct.pack('>I',len(sps)) + sps + struct.pack('>I',len(pps)) + pps + nal(0x65, slice_data(avg*3))
+			elif args.bad and i % 7 == 3:
+				s += nal(0xc1, slice_data(size))
+			elif args.bad and i % 11 == 5:
+				s += nal(0x41, slice_data(size) + b'\0\0')
+			elif args.bad and i % 13 == 7:
+				s += struct.pack('>I', size + 1000) + bytes([0x41]) + slice_data(size)
+			else:
+				s += nal(0x41, slice_data(size))
+			samples.append(s)
+		tracks.append(samples)
+
+	ftyp = box(b'ftyp', b'isom' + struct.pack('>I',0x200) + b'isomiso2avc1mp41')
+	def moov(mdatData):
+		off, traks = mdatData, b''
+		for t, samples in enumerate(tracks):
+			chunks = []
+			for c in range(0, nsamples, spc):
+				chunks.append(off)
+				off += sum(len(x) for x in samples[c:c+spc])
+			tkhd = full(b'tkhd',0,7,struct.pack('>IIIII',0,0,t+1,0,nsamples*dur*1000//ts) + b'\0'*8 + struct.pack('>hhhH',0,0,0,0) + ident + struct.pack('>II',W<<16,H<<16))
+			mdhd = full(b'mdhd',0,0,struct.pack('>IIIIHH',0,0,ts,nsamples*dur,0x55c4,0))
+			hdlr = full(b'hdlr',0,0,b'\0'*4 + (b'hint' if args.hint else b'vide') + b'\0'*12 + b'video\0')
+			vmhd = full(b'vmhd',0,1,b'\0'*8)
+			dinf = box(b'dinf', full(b'dref',0,0,struct.pack('>I',1) + full(b'url ',0,1,b'')))
+			stsd = full(b'stsd',0,0,struct.pack('>I',1) + avc1)
+			stts = full(b'stts',0,0,struct.pack('>III',1,nsamples,dur))
+			stsc = full(b'stsc',0,0,struct.pack('>I',2 if nsamples%spc else 1) + struct.pack('>III',1,spc,1) + (struct.pack('>III',len(chunks),nsamples%spc,1) if nsamples%spc else b''))
+			stsz = full(b'stsz',0,0,struct.pack('>II',0,nsamples) + b''.join(struct.pack('>I',len(x)) for x in samples))
+			stco = full(b'stco',0,0,struct.pack('>I',len(chunks)) + b''.join(struct.pack('>I',c) for c in chunks))
+			stss = full(b'stss',0,0,struct.pack('>I',(nsamples+29)//30) + b''.join(struct.pack('>I',i+1) for i in range(0,nsamples,30)))
+			stbl = box(b'stbl', stsd + stts + stsc + stsz + stco + stss)
+			traks += box(b'trak', tkhd + box(b'mdia', mdhd + hdlr + box(b'minf', vmhd + dinf + stbl)))
+		mvhd = full(b'mvhd',0,0,struct.pack('>IIII',0,0,1000,nsamples*dur*1000//ts) + struct.pack('>IH',0x10000,0x100) + b'\0'*10 + ident + b'\0'*24 + struct.pack('>I',ntracks+1))
+		return box(b'moov', mvhd + traks)
+
+	# the chunk offsets depend on the size of the moov, which does not depend on them
+	m = moov(0)
+	m = moov(len(ftyp) + len(m) + 8)
+	mdat = box(b'mdat', b''.join(b''.join(s) for s in tracks))
+	with open(args.out, 'wb') as f:
+		f.write(ftyp + m + mdat)
+
+main()
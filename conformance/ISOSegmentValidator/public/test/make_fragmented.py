@@ -0,0 +1,115 @@
+#! /usr/bin/env python3
+#
+# Writes a fragmented MP4 for the regression cases and benchmarks: an initialization segment
+# (ftyp, moov with one avc1 track per --tracks) followed by --segments media segments, each
+# with a styp, a sidx and --fragments moof/mdat pairs per track (with --ondemand, the fragments
+# follow one top-level sidx instead).  Sample data is random, so only the box
+# structure is worth validating.  A segment info file for -infofile is written next to it,
+# and with --split also each segment as a file of its own plus a list of them for -segments.
+#
+#   make_fragmented.py [options] out.mp4
+
+import argparse, os, random, struct
+
+def box(t, payload): return struct.pack('>I4s', 8+len(payload), t) + payload
+def full(t, v, f, payload): return box(t, struct.pack('>I', (v<<24)|f) + payload)
+
+W, H = 320, 240
+ident = struct.pack('>9I', 0x10000,0,0,0,0x10000,0,0,0,0x40000000)
+
+def avc1():
+	avcC = box(b'avcC', bytes([1,0x64,0,0x1f,0xff,0xe0,0]))
+	p = b'\0'*6 + struct.pack('>H',1) + b'\0'*16 + struct.pack('>HHIIIH',W,H,0x480000,0x480000,0,1) + bytes([0]) + b'\0'*31 + struct.pack('>Hh',0x18,-1)
+	return box(b'avc1', p+avcC)
+
+def trak(tid, timescale):
+	tkhd = full(b'tkhd',0,7,struct.pack('>IIIII',0,0,tid,0,0) + b'\0'*8 + struct.pack('>hhhH',0,0,0,0) + ident + struct.pack('>II',W<<16,H<<16))
+	mdhd = full(b'mdhd',0,0,struct.pack('>IIIIHH',0,0,timescale,0,0x55c4,0))
+	hdlr = full(b'hdlr',0,0,b'\0'*4 + b'vide' + b'\0'*12 + b'video\0')
+	vmhd = full(b'vmhd',0,1,b'\0'*8)
+	dinf = box(b'dinf', full(b'dref',0,0,struct.pack('>I',1) + full(b'url ',0,1,b'')))
+	stsd = full(b'stsd',0,0,struct.pack('>I',1) + avc1())
+	z = struct.pack('>I',0)
+	stbl = box(b'stbl', stsd + full(b'stts',0,0,z) + full(b'stsc',0,0,z) + full(b'stsz',0,0,z+z) + full(b'stco',0,0,z))
+	return box(b'trak', tkhd + box(b'mdia', mdhd + hdlr + box(b'minf', vmhd + dinf + stbl)))
+
+def main():
+	ap = argparse.ArgumentParser()
+	ap.add_argument('out')
+	ap.add_argument('--tracks', type=int, default=1)
+	ap.add_argument('--segments', type=int, default=4)
+	ap.add_argument('--fragments', type=int, default=1, help='movie fragments per track in each segment')
+	ap.add_argument('--samples', type=int, default=30, help='samples per fragment')
+	ap.add_argument('--sample-size', type=int, default=0, help='bytes per sample (default random, 50 to 400)')
+	ap.add_argument('--ondemand', action='store_true', help='no styp, one top-level sidx referencing every fragment')
+	ap.add_argument('--timescale', type=int, default=90000)
+	ap.add_argument('--duration', type=int, default=3000, help='sample duration in timescale ticks')
+	ap.add_argument('--base-time', type=int, default=0, help='decode time of the first sample, in ticks')
+	ap.add_argument('--sidx-delta', type=int, default=0, help='ticks added to each subsegment_duration in the sidx')
+	ap.add_argument('--brands', default='iso6,dash,msix,avc1', help='ftyp brands, the first is the major brand')
+	ap.add_argument('--seed', type=int, default=7)
+	ap.add_argument('--split', action='store_true', help='also write out-<n>.mp4 per segment and out.list')
+	args = ap.parse_args()
+	random.seed(args.seed)
+
+	ntracks, spf, ts, dur = args.tracks, args.samples, args.timescale, args.duration
+	brands = [b.encode().ljust(4) for b in args.brands.split(',')]
+	ftyp = box(b'ftyp', brands[0] + struct.pack('>I',0) + b''.join(brands))
+	mvhd = full(b'mvhd',0,0,struct.pack('>IIII',0,0,1000,0) + struct.pack('>IH',0x10000,0x100) + b'\0'*10 + ident + b'\0'*24 + struct.pack('>I',ntracks+1))
+	mvex = box(b'mvex', b''.join(full(b'trex',0,0,struct.pack('>IIIII',t,1,0,0,0)) for t in range(1,ntracks+1)))
+	init = ftyp + box(b'moov', mvhd + b''.join(trak(t,ts) for t in range(1,ntracks+1)) + mvex)
+
+	segs = []
+	allFrags = []
+	seq = 1
+	for s in range(args.segments):
+		styp = box(b'styp', b'msdh' + struct.pack('>I',0) + b'msdhmsix')
+		frags = []
+		for fr in range(args.fragments):
+			decodeTime = args.base_time + (s*args.fragments + fr)*spf*dur
+			for t in range(1, ntracks+1):
+				sizes = [args.sample_size]*spf if args.sample_size else [random.randint(50,400) for _ in range(spf)]
+				flags = [0x02000000 if i == 0 else 0x01010000 for i in range(spf)]
+				ctos = [dur if i % 3 else 0 for i in range(spf)]
+				def moof(dataoff):
+					tfhd = full(b'tfhd',0,0x020000,struct.pack('>I',t))
+					tfdt = full(b'tfdt',1,0,struct.pack('>Q',decodeTime))
+					trun = full(b'trun',0,0xf01,struct.pack('>Ii',spf,dataoff) + b''.join(struct.pack('>IIII',dur,sizes[i],flags[i],ctos[i]) for i in range(spf)))
+					return box(b'moof', full(b'mfhd',0,0,struct.pack('>I',seq)) + box(b'traf', tfhd + tfdt + trun))
+				m = moof(0)
+				m = moof(len(m) + 8)
+				mdat = box(b'mdat', random.randbytes(sum(sizes)))
+				frags.append((m + mdat, spf*dur))
+				seq += 1
+		body = b''.join(f for f, d in frags)
+		if args.ondemand:
+			allFrags += frags
+			continue
+		refs = b''.join(struct.pack('>III', len(f), d + args.sidx_delta, 0x90000000) for f, d in frags)
+		sidx = full(b'sidx',1,0,struct.pack('>IIQQHH',1,ts,args.base_time + s*args.fragments*spf*dur,0,0,len(frags)) + refs)
+		segs.append(styp + sidx + body)
+	if args.ondemand:
+		# one top-level sidx referencing every fragment, and the rest of the file as one segment
+		refs = b''.join(struct.pack('>III', len(f), d + args.sidx_delta, 0x90000000) for f, d in allFrags)
+		sidx = full(b'sidx',1,0,struct.pack('>IIQQHH',1,ts,args.base_time,0,0,len(allFrags)) + refs)
+		segs = [sidx + b''.join(f for f, d in allFrags)]
+
+	with open(args.out, 'wb') as f:
+		f.write(init + b''.join(segs))
+	with open(args.out + '.info', 'w') as f:
+		f.write('0 %d\n' % len(init))
+		for i, sg in enumerate(segs):
+			f.write('%d %d\n' % (i+1, len(sg)))
+	if args.split:
+		base = args.out[:-4] if args.out.endswith('.mp4') else args.out
+		names = []
+		for i, sg in enumerate([init] + segs):
+			names.append('%s-%d.mp4' % (base, i))
+			with open(names[-1], 'wb') as f:
+				f.write(sg)
+		with open(base + '.list', 'w') as f:
+			f.write('# initialization segment first\n')
+			for n in names:
+				f.write(os.path.basename(n) + '\n')
+
+main()
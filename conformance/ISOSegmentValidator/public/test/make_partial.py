@@ -0,0 +1,54 @@
+#! /usr/bin/env python3
+#
+# Writes a partial copy of an MP4 for -offsetinfo, the way a partial file optimization would:
+# the payload of every top-level mdat is removed in --pieces ranges, with --keep bytes left
+# between them, so that each mdat is split across several entries of the offset info file and
+# the box after it starts right where a removed range ends.  The offset info file (complete
+# file offset and bytes removed, one range per line) is written as out.offsets.
+#
+#   make_partial.py [options] in.mp4 out.mp4
+
+import argparse, struct
+
+def main():
+	ap = argparse.ArgumentParser()
+	ap.add_argument('input')
+	ap.add_argument('out')
+	ap.add_argument('--pieces', type=int, default=3, help='removed ranges per mdat')
+	ap.add_argument('--keep', type=int, default=4, help='bytes kept between the removed ranges')
+	args = ap.parse_args()
+
+	data = open(args.input, 'rb').read()
+	removed = []
+	offset = 0
+	while offset + 8 <= len(data):
+		size, t = struct.unpack('>I4s', data[offset:offset+8])
+		header = 8
+		if size == 1:
+			size = struct.unpack('>Q', data[offset+8:offset+16])[0]
+			header = 16
+		elif size == 0:
+			size = len(data) - offset
+		if size < header:
+			break
+		if t == b'mdat':
+			start, end = offset + header, offset + size
+			piece = (end - start) // args.pieces
+			if piece > args.keep:
+				for k in range(args.pieces):
+					last = (k == args.pieces - 1)
+					removed.append((start + k*piece, (end if last else start + (k+1)*piece - args.keep)))
+		offset += size
+
+	out, kept = bytearray(), 0
+	for start, end in removed:
+		out += data[kept:start]
+		kept = end
+	out += data[kept:]
+	with open(args.out, 'wb') as f:
+		f.write(out)
+	with open(args.out.rsplit('.', 1)[0] + '.offsets', 'w') as f:
+		for start, end in removed:
+			f.write('%d %d\n' % (start, end - start))
+
+main()
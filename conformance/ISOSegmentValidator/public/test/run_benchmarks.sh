@@ -0,0 +1,90 @@
+#! /bin/bash
+#
+# Timing benchmarks for ValidateMP4.
+#
+#   run_benchmarks.sh [-r runs] [-b benchmark] ValidateMP4.exe [ValidateMP4.exe ...]
+#
+# Each benchmark validates a generated fixture (made once, under output/bench) and reports
+# the best wall clock time over the runs, for every binary given, so an optimised build of
+# the tree can be compared with one of an earlier revision.  Run from this directory, or
+# through "make bench" in ../linux (which uses the binary built there).
+
+if [[ ! -f run_benchmarks.sh ]]; then
+	echo "You're in the wrong directory. You must be in the same directory as $0";
+	exit 1;
+fi
+
+HERE=`pwd`
+OUT=$HERE/output/bench
+runs=5
+only=
+
+while getopts "r:b:" opt; do
+	case $opt in
+		r) runs=$OPTARG ;;
+		b) only=$OPTARG ;;
+		*) exit 1 ;;
+	esac
+done
+shift $((OPTIND-1))
+if [ $# -eq 0 ]; then
+	echo "usage: $0 [-r runs] [-b benchmark] ValidateMP4.exe [ValidateMP4.exe ...]"
+	exit 1
+fi
+
+mkdir -p $OUT
+
+# fixture <file> <generator arguments...>: makes <file> under output/bench unless it is there already
+fixture()
+{
+	if [ ! -f $OUT/$1 ]; then
+		echo "generating $1"
+		python3 "${@:2}" $OUT/$1 || exit 1
+	fi
+}
+
+# best <binary> <validator arguments...>: prints the best wall clock time in seconds, or "crashed"
+best()
+{
+	bin=$1; shift
+	for i in `seq $runs`; do
+		start=`date +%s%N`
+		( cd $OUT && exec "$bin" "$@" > /dev/null 2>&1 )
+		rc=$?
+		end=`date +%s%N`
+		if [ $rc -gt 128 ] && [ $rc -le 192 ]; then echo crashed; return; fi
+		echo $(( (end - start) / 1000000 ))
+	done | sort -n | head -1 | awk '{ if ($1 == "crashed") print "crashed"; else printf "%.3fs\n", $1 / 1000 }'
+}
+
+# bench <name> <validator arguments...>: times every binary on the command line
+bench()
+{
+	name=$1; shift
+	[ -n "$only" ] && [ "$only" != "$name" ] && return
+	for bin in $BINS; do
+		printf "%-12s %9s  %s\n" $name `best $bin "$@"` $bin
+	done
+}
+
+BINS=
+for bin in "$@"; do
+	case $bin in /*) ;; *) bin=$HERE/$bin ;; esac
+	BINS="$BINS $bin"
+done
+
+
+# trun: 20 fragments of 20000 samples each, so the time goes into the 'trun' sample tables
+[ -z "$only" -o "$only" = trun ] && fixture trun.mp4 make_fragmented.py --segments 20 --samples 20000
+bench trun -infofile trun.mp4.info trun.mp4
+
+# fragments: an on-demand file, 50000 small fragments behind one top-level sidx, so the time goes
+#   into finding tracks, fragments and sidx references among many
+[ -z "$only" -o "$only" = fragments ] && fixture fragments.mp4 make_fragmented.py --ondemand --segments 1 --fragments 50000 --sample-size 16
+bench fragments fragments.mp4
+
+# samples: 3000 avc1 samples of about 20 KB validated NAL unit by NAL unit (-checklevel 2), on the
+#   one thread and on four (samples_4t; builds from before -threads only time the usage message)
+[ -z "$only" -o "$only" = samples -o "$only" = samples_4t ] && fixture avc.mp4 make_avc.py --samples 3000 --sample-size 20000
+bench samples -checklevel 2 avc.mp4
+bench samples_4t -checklevel 2 -threads 4 avc.mp4
@@ -0,0 +1,240 @@
+#! /bin/bash
+#
+# Regression checks for ValidateMP4.
+#
+#   run_tests.sh [path to ValidateMP4.exe]
+#
+# Each case runs the validator on one input and checks that it exits normally (a crash
+# is always a failure) and that its output does or does not contain given text.
+# Run from this directory, or through "make test" in ../linux.
+
+if [[ ! -f run_tests.sh ]]; then
+	echo "You're in the wrong directory. You must be in the same directory as $0";
+	exit 1;
+fi
+
+HERE=`pwd`
+BIN=${1:-../linux/bin/ValidateMP4.exe}
+case $BIN in /*) ;; *) BIN=$HERE/$BIN ;; esac
+MEDIA=$HERE/../../../MPDCrypto/test/input/cleartext
+OUT=$HERE/output/tests
+
+rm -rf $OUT
+mkdir -p $OUT/media
+
+# generated inputs
+python3 make_fragmented.py --split $OUT/media/frag.mp4 || exit 1
+python3 make_fragmented.py --base-time 900000 $OUT/media/late.mp4 || exit 1
+python3 make_avc.py --samples 120 --bad $OUT/media/avc.mp4 || exit 1
+python3 make_avc.py --samples 120 --zero-length $OUT/media/avc_zero.mp4 || exit 1
+python3 make_avc.py --samples 30 --hint $OUT/media/hint.mp4 || exit 1
+head -c $((`wc -c < $OUT/media/avc.mp4` * 2 / 3)) $OUT/media/avc.mp4 > $OUT/media/avc_short.mp4
+python3 make_fragmented.py --segments 2 --timescale 30000 --sidx-delta 1 $OUT/media/tick1.mp4 || exit 1
+python3 make_fragmented.py --segments 2 --timescale 30000 --sidx-delta 2 $OUT/media/tick2.mp4 || exit 1
+
+failures=0
+cases=0
+
+fail()
+{
+	echo "FAIL: $1: $2"
+	failures=$((failures+1))
+}
+
+# run <name> <validator arguments...>
+#   runs in output/<name>, so leafinfo.txt and friends do not collide; stdout and stderr go to output/<name>.txt
+run()
+{
+	name=$1; shift
+	cases=$((cases+1))
+	mkdir -p $OUT/$name
+	(cd $OUT/$name && "$BIN" "$@" > $OUT/$name.txt 2>&1)
+	rc=$?
+	echo $rc > $OUT/$name.rc
+	if [ $rc -gt 128 ] && [ $rc -le 192 ]; then fail $name "killed by signal $((rc-128))"; fi
+}
+
+# run_stdin <name> <input file> <validator arguments...>: as run, with the input piped in
+run_stdin()
+{
+	name=$1; input=$2; shift 2
+	cases=$((cases+1))
+	mkdir -p $OUT/$name
+	(cd $OUT/$name && cat "$input" | "$BIN" "$@" > $OUT/$name.txt 2>&1)
+	rc=$?
+	echo $rc > $OUT/$name.rc
+	if [ $rc -gt 128 ] && [ $rc -le 192 ]; then fail $name "killed by signal $((rc-128))"; fi
+}
+
+# expect <name> <text>, expect_not <name> <text>: check the output of the last run of <name>
+expect()
+{
+	grep -qF -- "$2" $OUT/$1.txt || fail $1 "missing \"$2\""
+}
+
+expect_not()
+{
+	grep -qF -- "$2" $OUT/$1.txt && fail $1 "unexpected \"$2\""
+}
+
+# exit_ok <name>: the last run of <name> exited with status 0 (a sanitizer build exits 1 on what it finds)
+exit_ok()
+{
+	[ "`cat $OUT/$1.rc`" = 0 ] || fail $1 "exit status `cat $OUT/$1.rc`"
+}
+
+# same <name> <other name>: the two runs gave the same output
+same()
+{
+	cmp -s $OUT/$1.txt $OUT/$2.txt || fail $1 "output differs from $2"
+}
+
+
+# fragmented files without a dash brand have an empty chunk table in 'moov'
+run seg1 $MEDIA/seg1.mp4
+expect_not seg1 "program error"
+expect seg1 "Finished testing file"
+run_stdin seg2_stdin $MEDIA/seg2.mp4 -
+expect seg2_stdin "Finished testing file"
+
+# the sample dump does not depend on how the input is read; read statistics only with -printtype stats
+run samples_stdio -checklevel 2 -printtype sample $MEDIA/seg3.mp4
+run samples_mmap -mmap -checklevel 2 -printtype sample $MEDIA/seg3.mp4
+same samples_mmap samples_stdio
+expect_not samples_stdio "sample reads:"
+run samples_stats -checklevel 2 -printtype stats $MEDIA/seg3.mp4
+expect samples_stats "sample reads:"
+# seg1.mp4 ends in the middle of its 'stco', so there is no chunk table to read the samples with
+run samples_no_chunks -checklevel 2 $MEDIA/seg1.mp4
+expect samples_no_chunks "Finished testing file"
+
+# avc1 samples are split into their NAL units and each is validated, on any number of threads
+#   with the same output; a NAL unit length past the end of the sample stops at the sample
+run avc_threads1 -checklevel 2 -threads 1 $OUT/media/avc.mp4
+expect avc_threads1 "Validate NALUnit: zero_bit != 0"
+expect avc_threads1 "is more than the"
+run avc_threads4 -checklevel 2 -threads 4 $OUT/media/avc.mp4
+same avc_threads4 avc_threads1
+# a NAL unit length of zero is an error, not an empty NAL unit to read on from
+run avc_zero_length -checklevel 2 $OUT/media/avc_zero.mp4
+exit_ok avc_zero_length
+expect avc_zero_length "NAL unit length is zero"
+expect avc_zero_length "Finished testing file"
+# avc_short.mp4 ends a third of the way into its samples, and those past the end are not validated
+run avc_short -checklevel 2 -threads 1 $OUT/media/avc_short.mp4
+exit_ok avc_short
+expect avc_short "could not be read"
+expect avc_short "Finished testing file"
+run avc_short4 -checklevel 2 -threads 4 $OUT/media/avc_short.mp4
+exit_ok avc_short4
+same avc_short4 avc_short
+
+# -offsetinfo: a partial file (the mdat payloads removed, in several ranges each) validates as the
+#   complete one does; both are run as in.mp4, so that the outputs can be compared
+for f in frag avc; do
+	mkdir -p $OUT/offsets_$f $OUT/offsets_${f}_partial
+	cp $OUT/media/$f.mp4 $OUT/offsets_$f/in.mp4
+	python3 make_partial.py $OUT/media/$f.mp4 $OUT/offsets_${f}_partial/in.mp4 || exit 1
+	run offsets_$f in.mp4
+	run offsets_${f}_partial -offsetinfo in.offsets in.mp4
+	expect offsets_${f}_partial "Finished testing file"
+	same offsets_${f}_partial offsets_$f
+done
+
+# -headeronly reads the box structure and nothing in an mdat; the only samples read below level 2
+#   are those of hint tracks, and reading them is refused and reported. frag.mp4 gives the same
+#   report as it does in full (offsets_frag), apart from the line saying how much was read
+mkdir -p $OUT/headeronly_frag
+cp $OUT/media/frag.mp4 $OUT/headeronly_frag/in.mp4
+run headeronly_frag -headeronly in.mp4
+expect headeronly_frag "Header-only: read"
+expect_not headeronly_frag "not reading"
+grep -vF "Header-only: read" $OUT/headeronly_frag.txt | cmp -s - $OUT/offsets_frag.txt || fail headeronly_frag "output differs from offsets_frag"
+run headeronly_avc -headeronly -checklevel 2 $OUT/media/avc.mp4
+exit_ok headeronly_avc
+expect headeronly_avc "samples are not read, checking at level 1"
+expect headeronly_avc "Header-only: read"
+expect_not headeronly_avc "not reading"
+run headeronly_hint -headeronly $OUT/media/hint.mp4
+expect headeronly_hint "-headeronly: not reading"
+expect headeronly_hint "couldn't GetFileData for sample 1"
+expect headeronly_hint "Finished testing file"
+
+# streamed input without -infofile: the one segment has no known end
+fragBytes=`wc -c < $OUT/media/frag.mp4 | tr -d ' '`
+run_stdin frag_stdin $OUT/media/frag.mp4 -
+expect frag_stdin "Streamed $fragBytes bytes"
+expect_not frag_stdin "beyond any input"
+run_stdin frag_stream $OUT/media/frag.mp4 -stream -
+expect frag_stream "Streamed $fragBytes bytes"
+
+# -segments: a list of segment files validated as one input
+run seglist -segments $OUT/media/frag.list
+expect seglist "Finished testing file"
+expect_not seglist "Could not open"
+(echo frag-0.mp4; printf 'x%.0s' $(seq 1 2100); echo) > $OUT/media/long.list
+run seglist_line -segments $OUT/media/long.list
+expect seglist_line "Line too long in segment list file"
+deep=$OUT/media/`printf 'd%.0s' $(seq 1 200)`/`printf 'e%.0s' $(seq 1 200)`/`printf 'f%.0s' $(seq 1 200)`/`printf 'g%.0s' $(seq 1 200)`/`printf 'h%.0s' $(seq 1 200)`
+mkdir -p $deep
+echo ../../../../../frag-0.mp4 > $deep/long.list
+# option arguments are copied into 1024 byte buffers; a longer one is refused
+run seglist_path -segments $deep/long.list
+expect seglist_path "Argument of segments is too long"
+# a largesize that would wrap the offset around ends the walk over the atoms instead of looping
+python3 -c "import struct,sys; sys.stdout.buffer.write(struct.pack('>I4s8xI4sQ32x', 16, b'free', 1, b'free', 2**64-16))" > $OUT/media/wrap.mp4
+(echo wrap.mp4; echo frag-0.mp4) > $OUT/media/wrap.list
+run seglist_wrap -segments $OUT/media/wrap.list
+expect seglist_wrap "Finished testing file"
+
+# -range picks the units (fragments, or segments with -infofile) overlapping the window;
+#   frag.mp4 has four of one second each from 0, late.mp4 the same from 10 s
+run range_mid -range 0.5-1.5 $OUT/media/frag.mp4
+expect range_mid "validating media fragments 1 to 2 of 4"
+run range_point -range 2-2 $OUT/media/frag.mp4
+expect range_point "validating media fragments 3 to 3 of 4"
+run range_tail -range 3.5-100 $OUT/media/frag.mp4
+expect range_tail "validating media fragments 4 to 4 of 4"
+run range_after -range 100-200 $OUT/media/frag.mp4
+expect range_after "no media in range 100-200"
+run range_after_segments -infofile $OUT/media/frag.mp4.info -range 4-5 $OUT/media/frag.mp4
+expect range_after_segments "no media in range 4-5"
+run range_before -range 0-5 $OUT/media/late.mp4
+expect range_before "no media in range 0-5"
+run range_late -range 5-11 $OUT/media/late.mp4
+expect range_late "validating media fragments 1 to 1 of 4"
+
+# sidx durations within one tick of the media are accepted, two ticks off are not; the first
+#   segment of each file is otherwise exact (the last one is a sample's composition offset long)
+run sidx_tick1 -infofile $OUT/media/tick1.mp4.info $OUT/media/tick1.mp4
+expect_not sidx_tick1 "Violated for Media Segment 1."
+expect_not sidx_tick1 "(Leaf count 1)"
+run sidx_tick2 -infofile $OUT/media/tick2.mp4.info $OUT/media/tick2.mp4
+expect sidx_tick2 "Violated for Media Segment 1."
+expect sidx_tick2 "(Leaf count 1)"
+
+# a sidx whose reference_count is one more than the references it has: the references that did
+#   decode are not used as if they were all of them
+python3 -c "
+import struct, sys
+b = bytearray(open(sys.argv[1], 'rb').read())
+i = b.find(b'sidx') + 4
+i += 12 + (8 if b[i] == 0 else 16) + 2
+b[i:i+2] = struct.pack('>H', struct.unpack('>H', b[i:i+2])[0] + 1)
+open(sys.argv[2], 'wb').write(b)" $OUT/media/frag.mp4 $OUT/media/sidx_count.mp4
+run sidx_count $OUT/media/sidx_count.mp4
+expect sidx_count "Finished testing file"
+
+# the library: validations of different inputs on many threads at once give what each gives alone
+#   (LibStress.exe is built with "make test")
+STRESS=`dirname $BIN`/LibStress.exe
+if [ -x $STRESS ]; then
+	cases=$((cases+1))
+	$STRESS $OUT/stress 8 2 -checklevel 2 -- $MEDIA/seg1.mp4 $MEDIA/seg3.mp4 $OUT/media/avc.mp4 $OUT/media/frag.mp4 $OUT/media/late.mp4 $OUT/media/tick1.mp4 > $OUT/stress.txt 2>&1
+	rc=$?
+	if [ $rc -ne 0 ]; then fail stress "exit status $rc, see $OUT/stress.txt"; fi
+fi
+
+
+echo "$cases cases, $failures failures"
+[ $failures -eq 0 ]